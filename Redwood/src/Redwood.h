@@ -2,4 +2,6 @@
 
 #include "Core/App.h"
 #include "core/Window.h"
+#include "core/Ecs.h"
+#include "core/Input.h"
 #include "Core/EntryPoint.h"
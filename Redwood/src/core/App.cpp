@@ -1,65 +1,336 @@
 #include "pch.h"
+#include <chrono>
+#include <filesystem>
 #include "SDL.h"
 #include "Log.h"
 #include "Window.h"
 #include "Events.h"
-#include "renderer/OpenGL/OpenGLRenderer.h"
+#include "Input.h"
+#include "JobSystem.h"
+#include "AsyncIO.h"
+#include "Vfs.h"
+#include "AssetManager.h"
+#include "Ecs.h"
 #include "renderer/Vulkan/VulkanRenderer.h"
-#include "renderer/Mesh.h"
-#include "renderer/Shader.h"
+#include "renderer/Vulkan/VulkanAssetLoaders.h"
+#include "renderer/Vulkan/VulkanTextureStreamer.h"
+#include "renderer/RenderPacket.h"
 #include "App.h"
 
 namespace rwd {
 
-	VulkanRenderer* renderer;
-	Mesh* triangleMesh;
-	Shader shader;
-
 	App::App() {
 		mRunning = true;
 
 		Log::Init();
+		JobSystem::Init();
+		AsyncIO::Init();
+
+		// Mount packed assets first so the loose files mounted after them take precedence
+		if (std::filesystem::exists("Assets.rwdpak")) {
+			Vfs::Mount("Assets.rwdpak");
+		}
+		Vfs::Mount("../Redwood/src", "shaders");
+
 		SDL_Init(SDL_INIT_EVERYTHING);
 
 		mWindow = Window::Create();
-		windowCloseEventHandler.Subscribe(BIND_EVENT_FN(App::OnWindowClose));
+		windowCloseEvents.Subscribe<&App::OnWindowClose>(this);
 
-		renderer = new VulkanRenderer;
-		renderer->Init(std::dynamic_pointer_cast<VulkanContext>(mWindow->mContext));
+		mRenderer = MakeScope<VulkanRenderer>();
+		Ref<VulkanContext> vulkanContext = std::dynamic_pointer_cast<VulkanContext>(mWindow->mContext);
+		mRenderer->Init(vulkanContext);
 
-		f32 verts[] {
-			-0.5, -0.5, 0.0,
-			0.5, -0.5, 0.0,
-			 0.0, 0.5, 0.0,
-		};
+		mTextureStreamer = MakeScope<VulkanTextureStreamer>(mRenderer.get());
 
-		i32 indices[] {
-			0, 1, 2
-		};
+#if !RWD_PRODUCTION
+		mRenderer->EnableShaderHotReload();
+#endif
+
+		mAssetManager = new AssetManager;
+		mAssetManager->RegisterLoader(AssetType::Mesh, MakeScope<VulkanMeshLoader>(mRenderer.get()));
+		mAssetManager->RegisterLoader(AssetType::Shader, MakeScope<VulkanShaderLoader>(vulkanContext->mDevice));
+		mAssetManager->RegisterLoader(AssetType::Texture, MakeScope<VulkanTextureLoader>(mRenderer.get(), mTextureStreamer.get()));
+
+		// Under memory pressure drop texture detail first, then streamed mips, then unreferenced assets.
+		// The governor only calls back while frames are drawn, which has stopped before either is destroyed.
+		mRenderer->MemoryGovernor().AddLodBiasCallback([streamer = mTextureStreamer.get()] (i32 lodBias) {
+			streamer->SetMipBias((u32)lodBias);
+		});
 
-		//triangleMesh = new Mesh(verts, sizeof(f32) * 9, indices, sizeof(i32) * 3, 3);
+		mRenderer->MemoryGovernor().AddEvictCallback([streamer = mTextureStreamer.get(), assets = mAssetManager] (u64 bytesToFree) {
+			size_t freed = streamer->Trim(bytesToFree);
+			if (freed < bytesToFree) {
+				assets->Trim(bytesToFree - freed);
+			}
+		});
 
-		//shader = Shader("../Redwood/src/Color.vert", "../Redwood/src/Color.frag");
+		mWorld = new World;
+		mSystems = new SystemScheduler;
 	}
 
 	App::~App() {
+		delete mFramePipeline;
+		delete mSystems;
+		delete mWorld;
+
+		// Assets hold GPU resources so they have to go before the renderer and window
+		delete mAssetManager;
+		mTextureStreamer.reset();
+
+		// Destroying assets only retires their GPU resources, Deinit waits for the device and frees them
+		mRenderer->Deinit();
+		mRenderer.reset();
 		delete mWindow;
+		Vfs::UnmountAll();
+		AsyncIO::Shutdown();
+		JobSystem::Shutdown();
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Main Loop
+	//
+	//-------------------------------------------------------------------------
+
+	using LoopClock = std::chrono::steady_clock;
+
+	static const LoopClock::time_point loopEpoch = LoopClock::now();
+
+	// Weight of each new sample in the smoothed stats, about a second's worth of samples at 60 a second
+	const f64 STATS_SMOOTHING = 1.0 / 60.0;
+
+	// sleep_for can overshoot by a scheduler quantum, so waits sleep until this close to the deadline and spin the rest
+	const f64 SPIN_WAIT_SECONDS = 0.002;
+
+	// How long the input thread sleeps waiting for events before checking whether the app is still running
+	const u32 INPUT_WAIT_MS = 10;
+
+	static f64 Now() {
+		return std::chrono::duration<f64>(LoopClock::now() - loopEpoch).count();
+	}
+
+	static void WaitUntil(f64 deadline) {
+		while (true) {
+			f64 remaining = deadline - Now();
+			if (remaining <= 0.0) {
+				return;
+			}
+
+			if (remaining > SPIN_WAIT_SECONDS) {
+				std::this_thread::sleep_for(std::chrono::duration<f64>(remaining - SPIN_WAIT_SECONDS));
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	static void Smooth(f64& average, f64 sample) {
+		average += (sample - average) * STATS_SMOOTHING;
+	}
+
+	static void Smooth(std::atomic<f64>& average, f64 sample) {
+		f64 value = average.load(std::memory_order_relaxed);
+		average.store(value + (sample - value) * STATS_SMOOTHING, std::memory_order_relaxed);
 	}
 
 	void App::Run() {
-		while (mRunning) {
-			MainUpdateLoop();
+		if (mLoopSettings.inputThread) {
+			std::thread frameThread(&App::FrameLoop, this);
+
+			// The OS hands window events to the thread that created the window, so the main thread
+			// stays behind to pump them while frames run on a thread of their own
+			while (mRunning) {
+				mWindow->WaitEvents(INPUT_WAIT_MS);
+			}
+
+			frameThread.join();
+		} else {
+			FrameLoop();
 		}
+
 		SDL_Quit();
 	}
 
-	void App::MainUpdateLoop() {
-		//static OpenGLRenderer renderer;
+	void App::FrameLoop() {
+		const f64 dt = 1.0 / mLoopSettings.tickRate;
+		const f64 maxAccumulated = mLoopSettings.maxTicksPerFrame * dt;
+		const bool threaded = mLoopSettings.threadedSimulation;
+		const bool pipelined = mLoopSettings.framesAhead > 0;
+		const bool pumpEvents = !mLoopSettings.inputThread;
+
+		if (threaded) {
+			mSimulationThread = std::thread(&App::SimulationLoop, this);
+		}
+
+		// Without the render thread the one packet is built and drawn in turn
+		RenderPacket inlinePacket;
+		if (pipelined) {
+			mFramePipeline = new FramePipeline<RenderPacket>(mLoopSettings.framesAhead);
+			mRenderThread = std::thread(&App::RenderLoop, this);
+		}
+
+		f64 accumulator = 0.0;
+		f64 previousFrameStart = Now();
+
+		while (mRunning) {
+			const f64 frameStart = Now();
+			const f64 frameTime = frameStart - previousFrameStart;
+			previousFrameStart = frameStart;
+
+			if (pumpEvents) {
+				mWindow->Update();
+			}
+			Input::BeginFrame();
+			DeliverQueuedEvents();
+
+			f64 alpha;
+			if (threaded) {
+				// Interpolate against when the tick was due rather than when it finished, so jitter
+				// in how long ticks take doesn't show up as jitter on screen
+				mRenderStates.Acquire();
+				alpha = std::clamp((frameStart - mRenderStates.Current().time) / dt, 0.0, 1.0);
+			} else {
+				accumulator = std::min(accumulator + frameTime, maxAccumulated);
+
+				u32 ticks = 0;
+				while (accumulator >= dt) {
+					f64 tickStart = Now();
+					Tick(dt);
+					Smooth(mTickMs, (Now() - tickStart) * 1000.0);
+
+					// Acquired after every tick rather than once a frame, so the previous and current
+					// states are always consecutive ticks
+					accumulator -= dt;
+					PublishState(frameStart - accumulator);
+					mRenderStates.Acquire();
+					ticks++;
+				}
+
+				if (frameTime > 0.0) {
+					Smooth(mTicksPerSecond, ticks / frameTime);
+				}
+
+				alpha = accumulator / dt;
+			}
+
+			const f64 renderStart = Now();
+			if (pipelined) {
+				// Blocks while the render thread is framesAhead frames behind
+				BuildFrame(mFramePipeline->BeginFrame(), alpha);
+				mFramePipeline->SubmitFrame();
+			} else {
+				BuildFrame(inlinePacket, alpha);
+				DrawFrame(inlinePacket);
+			}
+			const f64 renderEnd = Now();
+			Input::FrameSubmitted();
+
+			f64 idle = 0.0;
+			if (mLoopSettings.maxFrameRate > 0.0) {
+				WaitUntil(frameStart + 1.0 / mLoopSettings.maxFrameRate);
+				idle = Now() - renderEnd;
+			}
+
+			Smooth(mRenderMs, (renderEnd - renderStart) * 1000.0);
+			Smooth(mFrameIdleMs, idle * 1000.0);
+			if (frameTime > 0.0) {
+				Smooth(mFrameMs, frameTime * 1000.0);
+				Smooth(mFramesPerSecond, 1.0 / frameTime);
+			}
+		}
+
+		if (mSimulationThread.joinable()) {
+			mSimulationThread.join();
+		}
+
+		// The render thread draws the frames already submitted, then stops
+		if (pipelined) {
+			mFramePipeline->Shutdown();
+			mRenderThread.join();
+		}
+	}
+
+	void App::SimulationLoop() {
+		const f64 dt = 1.0 / mLoopSettings.tickRate;
+		f64 nextTick = Now();
+
+		while (mRunning) {
+			const f64 tickStart = Now();
+			Tick(dt);
+			PublishState(nextTick);
+			const f64 tickEnd = Now();
+
+			nextTick += dt;
+
+			// Fell too far behind, drop the time instead of running ticks back to back to catch up
+			if (tickEnd - nextTick > mLoopSettings.maxTicksPerFrame * dt) {
+				nextTick = tickEnd;
+			}
+
+			WaitUntil(nextTick);
+
+			Smooth(mTickMs, (tickEnd - tickStart) * 1000.0);
+			Smooth(mTickIdleMs, (Now() - tickEnd) * 1000.0);
+			Smooth(mTicksPerSecond, 1.0 / (Now() - tickStart));
+		}
+	}
+
+	void App::Tick(f64 dt) {
+		OnTick(dt);
+		mSystems->Run(*mWorld);
+	}
+
+	void App::PublishState(f64 time) {
+		RenderState& state = mRenderStates.WriteState();
+		state.Clear();
+		state.tick = ++mTickIndex;
+		state.time = time;
+
+		OnPublish(state);
+		mRenderStates.Publish(state.tick);
+	}
+
+	void App::RenderLoop() {
+		while (const RenderPacket* packet = mFramePipeline->AcquireFrame()) {
+			DrawFrame(*packet);
+			mFramePipeline->ReleaseFrame();
+		}
+	}
+
+	void App::BuildFrame(RenderPacket& packet, f64 alpha) {
+		packet.Clear();
+		packet.frame = mFrameIndex++;
+		packet.alpha = alpha;
+		OnRender(packet, mRenderStates.Previous(), mRenderStates.Current(), alpha);
+	}
+
+	// On whichever thread draws, so it also runs the uploads that create GPU resources
+	void App::DrawFrame(const RenderPacket& packet) {
+		mAssetManager->Update();
+		mTextureStreamer->Update();
+
+		for (size_t i = 0; i < packet.draws.size(); i++) {
+			mRenderer->Draw(packet.drawKeys[i], packet.draws[i]);
+		}
+
+		mRenderer->DrawFrame();
+	}
+
+	LoopStats App::Stats() const {
+		return LoopStats {
+			.frameMs = mFrameMs,
+			.renderMs = mRenderMs,
+			.tickMs = mTickMs.load(std::memory_order_relaxed),
+			.frameIdleMs = mFrameIdleMs,
+			.tickIdleMs = mTickIdleMs.load(std::memory_order_relaxed),
+			.framesPerSecond = mFramesPerSecond,
+			.ticksPerSecond = mTicksPerSecond.load(std::memory_order_relaxed),
+		};
+	}
 
-		renderer->DrawFrame();
-		//renderer.Clear();
-		//renderer.DrawMesh(*triangleMesh, shader);
-		mWindow->Update();
+	FramePipelineStats App::PipelineStats() const {
+		return mFramePipeline ? mFramePipeline->Stats() : FramePipelineStats { };
 	}
 
 	void App::OnWindowClose(const WindowCloseEvent& e) {
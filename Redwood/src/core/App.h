@@ -1,23 +1,134 @@
 #pragma once
+#include <atomic>
+#include <thread>
 #include "Core.h"
+#include "FramePipeline.h"
+#include "RenderState.h"
+#include "RenderStateBuffer.h"
 
 namespace rwd {
 
 	class Window;
-	class WindowCloseEvent;
+	struct WindowCloseEvent;
+	class AssetManager;
+	class VulkanRenderer;
+	class VulkanTextureStreamer;
+	class World;
+	class SystemScheduler;
+	struct RenderPacket;
 
+	struct LoopSettings {
+		f64 tickRate = 60.0;
+
+		// Time beyond this many ticks a frame is dropped, so a long stall doesn't leave the
+		// simulation running ever more ticks to catch up
+		u32 maxTicksPerFrame = 5;
+
+		// Ticks on a thread of their own, so rendering runs as fast as the GPU allows while the
+		// simulation keeps its own rate. The world then belongs to the simulation thread, rendering
+		// only sees what OnPublish hands it.
+		bool threadedSimulation = false;
+
+		// Caps how often frames are rendered, 0 renders as fast as presentation allows
+		f64 maxFrameRate = 0.0;
+
+		// Frames the main thread can build ahead of the one being drawn. 0 draws on the main thread,
+		// 1 or 2 draw on a render thread so building a frame overlaps drawing the last, at the cost
+		// of up to that many frames of latency.
+		u32 framesAhead = 0;
+
+		// Leaves the main thread pumping window events while frames run on a thread of their own,
+		// so input is taken in as it arrives rather than once a frame
+		bool inputThread = false;
+	};
+
+	// Smoothed over roughly the last second
+	struct LoopStats {
+		f64 frameMs = 0.0;
+		f64 renderMs = 0.0;    // Building the frame, and drawing it too without framesAhead
+		f64 tickMs = 0.0;      // Per tick
+		f64 frameIdleMs = 0.0; // Waiting on maxFrameRate
+		f64 tickIdleMs = 0.0;  // Waiting for the next tick on the simulation thread
+		f64 framesPerSecond = 0.0;
+		f64 ticksPerSecond = 0.0;
+	};
+
+	// Runs the simulation in fixed ticks and renders as often as it can.
+	//
+	// Time accumulates each frame and is spent in whole ticks of 1 / tickRate, so the simulation
+	// behaves the same at any frame rate. After every tick OnPublish copies what rendering needs
+	// into a RenderState. Rendering falls somewhere after the last tick, OnRender gets the last two
+	// published states and how far along as alpha to interpolate between them.
+	//
+	// Frames are built into a RenderPacket and drawn from it, either right away or on the render
+	// thread while the main thread moves on to the next frame. Window events stay on the main thread.
 	class RWD_API App {
 	public:
 		App();
 		virtual ~App();
 		void Run();
+
+		LoopStats Stats() const;
+
+		// Zeroed unless frames are drawn on the render thread
+		FramePipelineStats PipelineStats() const;
+	protected:
+		// A fixed step of the simulation, on the simulation thread when it's threaded. Input edges
+		// are per frame, so only read held input here (see Input).
+		virtual void OnTick(f64 dt) { }
+
+		// Fills in the state rendering gets from this tick, on the same thread as OnTick. The state
+		// starts out cleared.
+		virtual void OnPublish(RenderState& state) { }
+
+		// Fills in the frame's draws on the main thread, the packet starts out cleared. alpha is the
+		// time since the current state's tick over the tick length, 0 to 1. Only read the states here,
+		// the world may be ticking on another thread. With framesAhead the renderer may still be
+		// drawing earlier frames, so only hand it state through the packet.
+		virtual void OnRender(RenderPacket& packet, const RenderState& previous, const RenderState& current, f64 alpha) { }
 	protected:
 		Window* mWindow;
+		AssetManager* mAssetManager;
+
+		// Systems added by the app run over the world once per tick
+		World* mWorld;
+		SystemScheduler* mSystems;
+
+		// Read when Run starts
+		LoopSettings mLoopSettings;
 	private:
-		void MainUpdateLoop();
+		void FrameLoop();
+		void Tick(f64 dt);
+		void PublishState(f64 time);
+		void BuildFrame(RenderPacket& packet, f64 alpha);
+		void DrawFrame(const RenderPacket& packet);
+		void SimulationLoop();
+		void RenderLoop();
 		void OnWindowClose(const WindowCloseEvent& e);
 	private:
-		bool mRunning;
+		std::atomic<bool> mRunning;
+
+		Scope<VulkanRenderer> mRenderer;
+		Scope<VulkanTextureStreamer> mTextureStreamer;
+
+		std::thread mSimulationThread;
+		std::thread mRenderThread;
+
+		FramePipeline<RenderPacket>* mFramePipeline = nullptr;
+		u64 mFrameIndex = 0;
+
+		// Published by whichever thread ticks, acquired by the main thread
+		RenderStateBuffer<RenderState> mRenderStates;
+		u64 mTickIndex = 0;
+
+		// Written by the thread that measures them
+		f64 mFrameMs = 0.0;
+		f64 mRenderMs = 0.0;
+		f64 mFrameIdleMs = 0.0;
+		f64 mFramesPerSecond = 0.0;
+		std::atomic<f64> mTickMs { 0.0 };
+		std::atomic<f64> mTickIdleMs { 0.0 };
+		std::atomic<f64> mTicksPerSecond { 0.0 };
 	};
 
 	App* CreateApp();
@@ -0,0 +1,323 @@
+#include "pch.h"
+#include <thread>
+#include "Log.h"
+#include "Hash.h"
+#include "JobSystem.h"
+#include "Vfs.h"
+#include "AssetManager.h"
+
+namespace rwd {
+
+	const char* AssetStateName(AssetState state) {
+		switch (state) {
+			case(AssetState::Queued):    return "Queued";
+			case(AssetState::Decoding):  return "Decoding";
+			case(AssetState::Uploading): return "Uploading";
+			case(AssetState::Ready):     return "Ready";
+			case(AssetState::Failed):    return "Failed";
+			case(AssetState::Evicted):   return "Evicted";
+		}
+		return "Unknown";
+	}
+
+	AssetManager::AssetManager(size_t memoryBudget)
+		: mMemoryBudget(memoryBudget), mJobs(MakeScope<JobCounter>())
+	{
+		// Slot 0 is never handed out so a zeroed handle is always invalid
+		mSlots.emplace_back();
+		mSlots[0].generation = 0;
+	}
+
+	AssetManager::~AssetManager() {
+		// Reads and decodes in flight reference this manager, so wait them out
+		while (mLoadsInFlight.load() > 0) {
+			JobSystem::Wait(*mJobs);
+			std::this_thread::yield();
+		}
+
+		for (u32 i = 1; i < mSlots.size(); i++) {
+			AssetSlot& slot = mSlots[i];
+			if (slot.state == AssetState::Ready && slot.asset) {
+				mLoaders[(u32)slot.type]->Unload(*slot.asset);
+			}
+		}
+	}
+
+	void AssetManager::RegisterLoader(AssetType type, Scope<AssetLoader> loader) {
+		mLoaders[(u32)type] = std::move(loader);
+	}
+
+	std::pair<u32, u32> AssetManager::LoadInternal(AssetType type, const std::string& path) {
+		RWD_ASSERT(mLoaders[(u32)type], "No asset loader registered for type {0}", (u32)type);
+
+		std::string normalized = Vfs::NormalizePath(path);
+		u64 pathHash = HashString(normalized);
+
+		u32 index;
+		u32 generation;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+
+			auto [first, last] = mPathLookup.equal_range(pathHash);
+			for (auto existing = first; existing != last; existing++) {
+				AssetSlot& slot = mSlots[existing->second];
+				if (slot.path == normalized) {
+					slot.refCount++;
+					return { existing->second, slot.generation };
+				}
+			}
+
+			if (!mFreeSlots.empty()) {
+				index = mFreeSlots.back();
+				mFreeSlots.pop_back();
+			} else {
+				index = (u32)mSlots.size();
+				mSlots.emplace_back();
+			}
+
+			AssetSlot& slot = mSlots[index];
+			slot.type = type;
+			slot.path = normalized;
+			slot.pathHash = pathHash;
+			slot.refCount = 1;
+			slot.requestTime = std::chrono::steady_clock::now();
+			generation = slot.generation;
+
+			mPathLookup.emplace(pathHash, index);
+			SetState(index, AssetState::Queued);
+		}
+
+		mLoadsInFlight++;
+
+		Vfs::ReadFile(normalized, [this, index, generation, type, normalized] (ReadResult&& result) {
+			if (!result.success) {
+				std::lock_guard<std::mutex> lock(mMutex);
+				FailSlot(index);
+				mLoadsInFlight--;
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				SetState(index, AssetState::Decoding);
+			}
+
+			// Decode on a worker rather than the I/O thread so reads keep flowing.
+			// Job functions have to be copyable, so the move only buffer rides in a Ref.
+			Ref<ReadResult> contents = MakeRef<ReadResult>(std::move(result));
+
+			JobSystem::Execute(*mJobs, [this, index, generation, type, normalized, contents] {
+				Scope<Asset> asset = mLoaders[(u32)type]->Decode(normalized, contents->buffer);
+
+				std::lock_guard<std::mutex> lock(mMutex);
+				AssetSlot& slot = mSlots[index];
+
+				if (!asset) {
+					RWD_LOG_ERROR("Failed to decode asset {0}", normalized);
+					FailSlot(index);
+				} else {
+					slot.asset = std::move(asset);
+					SetState(index, AssetState::Uploading);
+					mUploadQueue.push_back(index);
+				}
+
+				mLoadsInFlight--;
+			});
+		});
+
+		return { index, generation };
+	}
+
+	void AssetManager::AddReference(u32 index, u32 generation, i32 delta) {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		if (index >= mSlots.size() || mSlots[index].generation != generation || generation == 0) {
+			RWD_LOG_WARN("Reference change on a stale asset handle");
+			return;
+		}
+
+		AssetSlot& slot = mSlots[index];
+		slot.refCount += delta;
+		RWD_ASSERT(slot.refCount >= 0, "Asset {0} was released more times than it was acquired", slot.path);
+
+		if (slot.refCount == 0) {
+			slot.releaseFrame = mFrame;
+
+			// Failed assets hold no memory, free the slot right away so the path can be retried
+			if (slot.state == AssetState::Failed) {
+				FreeSlot(index);
+			}
+		}
+	}
+
+	Asset* AssetManager::GetInternal(u32 index, u32 generation) {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		if (index >= mSlots.size() || mSlots[index].generation != generation || generation == 0) {
+			return nullptr;
+		}
+
+		const AssetSlot& slot = mSlots[index];
+		return slot.state == AssetState::Ready ? slot.asset.get() : nullptr;
+	}
+
+	AssetState AssetManager::StateInternal(u32 index, u32 generation) {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		if (index >= mSlots.size() || mSlots[index].generation != generation || generation == 0) {
+			return AssetState::Evicted;
+		}
+
+		return mSlots[index].state;
+	}
+
+	void AssetManager::Update() {
+		std::vector<u32> uploads;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mFrame++;
+			uploads.swap(mUploadQueue);
+		}
+
+		for (u32 index : uploads) {
+			// The asset is owned by its slot and nothing else touches it while it's
+			// Uploading, so the (potentially slow) upload can run without the lock
+			Asset* asset;
+			AssetType type;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				asset = mSlots[index].asset.get();
+				type = mSlots[index].type;
+			}
+
+			bool uploaded = mLoaders[(u32)type]->Upload(*asset);
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (uploaded) {
+				mMemoryUsed += asset->mMemorySize;
+				SetState(index, AssetState::Ready);
+			} else {
+				mSlots[index].asset.reset();
+				FailSlot(index);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		EvictOverBudget();
+	}
+
+	void AssetManager::EvictOverBudget() {
+		if (mMemoryUsed <= mMemoryBudget) {
+			return;
+		}
+
+		EvictUnreferenced(mMemoryUsed - mMemoryBudget);
+
+		if (mMemoryUsed > mMemoryBudget) {
+			RWD_LOG_WARN("Assets are using {0} bytes, over the {1} byte budget, but everything left is referenced", 
+				mMemoryUsed, mMemoryBudget);
+		}
+	}
+
+	size_t AssetManager::EvictUnreferenced(size_t bytes) {
+		std::vector<u32> candidates;
+		for (u32 i = 1; i < mSlots.size(); i++) {
+			if (mSlots[i].state == AssetState::Ready && mSlots[i].refCount == 0) {
+				candidates.push_back(i);
+			}
+		}
+
+		// Evict whatever has gone unreferenced the longest first
+		std::sort(candidates.begin(), candidates.end(), [this] (u32 lhs, u32 rhs) {
+			return mSlots[lhs].releaseFrame < mSlots[rhs].releaseFrame;
+		});
+
+		size_t freed = 0;
+		for (u32 index : candidates) {
+			if (freed >= bytes) {
+				break;
+			}
+
+			AssetSlot& slot = mSlots[index];
+			mLoaders[(u32)slot.type]->Unload(*slot.asset);
+			mMemoryUsed -= slot.asset->mMemorySize;
+			freed += slot.asset->mMemorySize;
+			mEvictionCount++;
+
+			SetState(index, AssetState::Evicted);
+			FreeSlot(index);
+		}
+
+		return freed;
+	}
+
+	void AssetManager::FreeSlot(u32 index) {
+		AssetSlot& slot = mSlots[index];
+
+		auto [first, last] = mPathLookup.equal_range(slot.pathHash);
+		for (auto entry = first; entry != last; entry++) {
+			if (entry->second == index) {
+				mPathLookup.erase(entry);
+				break;
+			}
+		}
+
+		// Bump the generation so outstanding handles go stale, skipping 0 which marks invalid handles
+		u32 generation = slot.generation + 1;
+		slot = AssetSlot { };
+		slot.generation = generation == 0 ? 1 : generation;
+
+		mFreeSlots.push_back(index);
+	}
+
+	// Nothing can release the last reference once it's gone, so a slot already unreferenced is freed here
+	void AssetManager::FailSlot(u32 index) {
+		SetState(index, AssetState::Failed);
+
+		if (mSlots[index].refCount == 0) {
+			FreeSlot(index);
+		}
+	}
+
+	void AssetManager::SetState(u32 index, AssetState state) {
+		AssetSlot& slot = mSlots[index];
+		slot.state = state;
+
+		if (mEventCallback) {
+			f64 elapsedMs = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - slot.requestTime).count();
+			mEventCallback(AssetEvent { .index = index, .type = slot.type, .path = slot.path, .state = state, .elapsedMs = elapsedMs });
+		}
+	}
+
+	void AssetManager::SetMemoryBudget(size_t bytes) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mMemoryBudget = bytes;
+	}
+
+	size_t AssetManager::Trim(size_t bytes) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return EvictUnreferenced(bytes);
+	}
+
+	void AssetManager::SetEventCallback(EventCallback callback) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mEventCallback = std::move(callback);
+	}
+
+	AssetStats AssetManager::Stats() {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		AssetStats stats;
+		for (u32 i = 1; i < mSlots.size(); i++) {
+			if (!mSlots[i].path.empty()) {
+				stats.stateCounts[(u32)mSlots[i].state]++;
+			}
+		}
+
+		stats.memoryUsed = mMemoryUsed;
+		stats.memoryBudget = mMemoryBudget;
+		stats.evictionCount = mEvictionCount;
+		return stats;
+	}
+
+}
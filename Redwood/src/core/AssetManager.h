@@ -0,0 +1,178 @@
+#pragma once
+#include "pch.h"
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "Core.h"
+
+namespace rwd {
+
+	class IoBuffer;
+	class JobCounter;
+
+	enum class AssetType : u32 {
+		Mesh,
+		Shader,
+		Texture,
+		Count,
+	};
+
+	// Assets move forward through these states, Failed and Evicted are terminal
+	enum class AssetState : u32 {
+		Queued,    // Waiting for its file to be read
+		Decoding,  // File read, being decoded on a worker thread
+		Uploading, // Decoded, waiting for the render thread to create GPU resources
+		Ready,
+		Failed,
+		Evicted,
+	};
+
+	const char* AssetStateName(AssetState state);
+
+	// Base class for everything the asset manager owns
+	class Asset {
+	public:
+		virtual ~Asset() = default;
+
+		// Memory the asset occupies once ready, counted against the manager's budget
+		size_t mMemorySize = 0;
+	};
+
+	// Generational handle, the generation changes when the slot is reused
+	// so handles to evicted assets can be detected instead of aliasing new ones
+	template<typename T>
+	struct AssetHandle {
+		u32 index = 0;
+		u32 generation = 0;
+
+		bool IsValid() const { return generation != 0; }
+		bool operator==(const AssetHandle& other) const = default;
+	};
+
+	// Knows how to turn files of one asset type into assets
+	class AssetLoader {
+	public:
+		virtual ~AssetLoader() = default;
+
+		// Runs on a worker thread, parses the file into CPU side data
+		virtual Scope<Asset> Decode(const std::string& path, IoBuffer& contents) = 0;
+
+		// Runs on the render thread, creates any GPU resources and fills in the asset's memory size
+		virtual bool Upload(Asset& asset) = 0;
+
+		// Runs on the render thread when the asset is evicted
+		virtual void Unload(Asset& asset) = 0;
+	};
+
+	struct AssetEvent {
+		u32 index;
+		AssetType type;
+		const std::string& path;
+		AssetState state;
+
+		// Time since the load was requested
+		f64 elapsedMs;
+	};
+
+	struct AssetStats {
+		u32 stateCounts[(u32)AssetState::Evicted + 1] = { };
+		size_t memoryUsed = 0;
+		size_t memoryBudget = 0;
+		u32 evictionCount = 0;
+	};
+
+	// Owns every loaded asset.
+	//
+	// Loads are deduplicated by path, read through the Vfs, decoded on the job system and
+	// uploaded on the render thread in Update. Assets are reference counted, and unreferenced ready
+	// assets are evicted least recently released first once memory use goes over the budget.
+	class RWD_API AssetManager {
+	public:
+		using EventCallback = std::function<void(const AssetEvent&)>;
+
+		AssetManager(size_t memoryBudget = 512ull * 1024 * 1024);
+		~AssetManager();
+
+		void RegisterLoader(AssetType type, Scope<AssetLoader> loader);
+
+		// Returns the existing handle if the path is already loaded or loading, adding a reference
+		template<typename T>
+		AssetHandle<T> Load(const std::string& path) {
+			auto [index, generation] = LoadInternal(T::Type, path);
+			return AssetHandle<T> { index, generation };
+		}
+
+		template<typename T>
+		void Acquire(AssetHandle<T> handle) { AddReference(handle.index, handle.generation, 1); }
+
+		template<typename T>
+		void Release(AssetHandle<T> handle) { AddReference(handle.index, handle.generation, -1); }
+
+		// Returns nullptr until the asset is ready, or if the handle is stale
+		template<typename T>
+		T* Get(AssetHandle<T> handle) { return static_cast<T*>(GetInternal(handle.index, handle.generation)); }
+
+		template<typename T>
+		AssetState State(AssetHandle<T> handle) { return StateInternal(handle.index, handle.generation); }
+
+		// Uploads decoded assets and evicts over budget, call once per frame on the render thread
+		void Update();
+
+		void SetMemoryBudget(size_t bytes);
+
+		// Evicts unreferenced assets regardless of the budget until at least bytes are freed,
+		// for when memory runs short elsewhere. Returns the bytes actually freed.
+		size_t Trim(size_t bytes);
+
+		// The callback is invoked with the manager locked, from whichever thread changed the state,
+		// so it should just record the event and must not call back into the manager
+		void SetEventCallback(EventCallback callback);
+		AssetStats Stats();
+	private:
+		struct AssetSlot {
+			u32 generation = 1;
+			AssetType type = AssetType::Mesh;
+			AssetState state = AssetState::Queued;
+			std::string path;
+			u64 pathHash = 0;
+			i32 refCount = 0;
+			Scope<Asset> asset;
+			std::chrono::steady_clock::time_point requestTime;
+
+			// Frame the last reference was released, used to pick eviction victims
+			u64 releaseFrame = 0;
+		};
+
+		std::pair<u32, u32> LoadInternal(AssetType type, const std::string& path);
+		void AddReference(u32 index, u32 generation, i32 delta);
+		Asset* GetInternal(u32 index, u32 generation);
+		AssetState StateInternal(u32 index, u32 generation);
+
+		// Must be called with mMutex held
+		void SetState(u32 index, AssetState state);
+		void FreeSlot(u32 index);
+		void FailSlot(u32 index);
+		void EvictOverBudget();
+		size_t EvictUnreferenced(size_t bytes);
+	private:
+		std::mutex mMutex;
+		std::vector<AssetSlot> mSlots;
+		std::vector<u32> mFreeSlots;
+		// Keyed by path hash, with the paths compared since two can share a hash
+		std::unordered_multimap<u64, u32> mPathLookup;
+		std::vector<u32> mUploadQueue;
+
+		Scope<AssetLoader> mLoaders[(u32)AssetType::Count];
+		EventCallback mEventCallback;
+
+		size_t mMemoryUsed = 0;
+		size_t mMemoryBudget;
+		u32 mEvictionCount = 0;
+		u64 mFrame = 0;
+
+		// Tracks the decode jobs so the destructor can wait for them
+		Scope<JobCounter> mJobs;
+		std::atomic<u32> mLoadsInFlight = 0;
+	};
+
+}
@@ -0,0 +1,480 @@
+#include "pch.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include "Log.h"
+#include "JobSystem.h"
+#include "AsyncIO.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+	#include <malloc.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+#endif
+
+#ifdef RWD_IO_URING
+	#include <liburing.h>
+#endif
+
+namespace rwd {
+
+	using Clock = std::chrono::steady_clock;
+
+	//-------------------------------------------------------------------------
+	//
+	// IO Buffer
+	//
+	//-------------------------------------------------------------------------
+
+	static size_t AlignUp(size_t value, size_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	IoBuffer::IoBuffer(size_t size) : mSize(size) {
+		// Always allocate at least one block and round up to whole blocks,
+		// unbuffered reads write in block sized chunks even at the end of the file
+		size_t allocationSize = AlignUp(std::max(size, (size_t)1), IO_DIRECT_ALIGNMENT);
+
+#ifdef _WIN32
+		mData = (u8*)_aligned_malloc(allocationSize, IO_DIRECT_ALIGNMENT);
+#else
+		mData = (u8*)std::aligned_alloc(IO_DIRECT_ALIGNMENT, allocationSize);
+#endif
+	}
+
+	IoBuffer::~IoBuffer() {
+#ifdef _WIN32
+		_aligned_free(mData);
+#else
+		std::free(mData);
+#endif
+	}
+
+	IoBuffer::IoBuffer(IoBuffer&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	IoBuffer& IoBuffer::operator=(IoBuffer&& other) noexcept {
+		std::swap(mData, other.mData);
+		std::swap(mSize, other.mSize);
+		return *this;
+	}
+
+	u8* IoBuffer::Data() const {
+		return mData;
+	}
+
+	size_t IoBuffer::Size() const {
+		return mSize;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Statistics
+	//
+	//-------------------------------------------------------------------------
+
+	static std::mutex statsMutex;
+	static IoStats stats;
+	static u32 inFlightCount = 0;
+	static Clock::time_point busyStart;
+
+	static void BeginRequest() {
+		std::lock_guard<std::mutex> lock(statsMutex);
+		if (inFlightCount++ == 0) {
+			busyStart = Clock::now();
+		}
+	}
+
+	static void EndRequest(const ReadResult& result) {
+		std::lock_guard<std::mutex> lock(statsMutex);
+
+		stats.requestCount++;
+		stats.failedCount += result.success ? 0 : 1;
+		stats.bytesRead += result.success ? result.buffer.Size() : 0;
+		stats.totalLatencyMs += result.latencyMs;
+		stats.maxLatencyMs = std::max(stats.maxLatencyMs, result.latencyMs);
+
+		if (--inFlightCount == 0) {
+			stats.busyTimeMs += std::chrono::duration<f64, std::milli>(Clock::now() - busyStart).count();
+		}
+	}
+
+	struct ReadRequest {
+		std::string filepath;
+		ReadFlags flags;
+		AsyncIO::ReadCallback callback;
+		Clock::time_point issueTime;
+
+		ReadResult result;
+		size_t bytesDone = 0;
+
+#ifndef _WIN32
+		int fd = -1;
+#endif
+	};
+
+	static void CompleteRequest(ReadRequest& request, bool success) {
+#ifndef _WIN32
+		if (request.fd >= 0) {
+			close(request.fd);
+			request.fd = -1;
+		}
+#endif
+
+		request.result.filepath = std::move(request.filepath);
+		request.result.success = success;
+		request.result.latencyMs = std::chrono::duration<f64, std::milli>(Clock::now() - request.issueTime).count();
+
+		if (!success) {
+			RWD_LOG_ERROR("Failed to read file {0}", request.result.filepath);
+		}
+
+		EndRequest(request.result);
+		request.callback(std::move(request.result));
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Blocking Reads (job system backend)
+	//
+	//-------------------------------------------------------------------------
+
+	// Opens the file and allocates the destination buffer, shared by both backends
+	static bool OpenRequest(ReadRequest& request) {
+#ifdef _WIN32
+		return true;
+#else
+		int openFlags = O_RDONLY;
+	#ifdef O_DIRECT
+		if ((u32)request.flags & (u32)ReadFlags::Direct) {
+			openFlags |= O_DIRECT;
+		}
+	#endif
+
+		request.fd = open(request.filepath.c_str(), openFlags);
+
+		// Some file systems (tmpfs for one) refuse O_DIRECT, a buffered read is better than failing
+		if (request.fd < 0 && openFlags != O_RDONLY) {
+			request.fd = open(request.filepath.c_str(), O_RDONLY);
+		}
+
+		if (request.fd < 0) {
+			return false;
+		}
+
+		struct stat fileStat;
+		if (fstat(request.fd, &fileStat) != 0) {
+			return false;
+		}
+
+		request.result.buffer = IoBuffer((size_t)fileStat.st_size);
+		return request.result.buffer.Data() != nullptr;
+#endif
+	}
+
+	static void ReadBlocking(ReadRequest& request) {
+#ifdef _WIN32
+		DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+		if ((u32)request.flags & (u32)ReadFlags::Direct) {
+			flags |= FILE_FLAG_NO_BUFFERING;
+		}
+
+		HANDLE file = CreateFileA(request.filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			CompleteRequest(request, false);
+			return;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			CompleteRequest(request, false);
+			return;
+		}
+
+		request.result.buffer = IoBuffer((size_t)fileSize.QuadPart);
+
+		// Unbuffered reads must request whole blocks, the last one just comes back short
+		size_t readSize = AlignUp(request.result.buffer.Size(), IO_DIRECT_ALIGNMENT);
+		bool success = true;
+
+		while (request.bytesDone < request.result.buffer.Size()) {
+			DWORD chunk = (DWORD)std::min(readSize - request.bytesDone, (size_t)1 << 30);
+			DWORD bytesRead = 0;
+
+			if (!::ReadFile(file, request.result.buffer.Data() + request.bytesDone, chunk, &bytesRead, nullptr) || bytesRead == 0) {
+				success = false;
+				break;
+			}
+
+			request.bytesDone += bytesRead;
+		}
+
+		CloseHandle(file);
+		CompleteRequest(request, success);
+#else
+		if (!OpenRequest(request)) {
+			CompleteRequest(request, false);
+			return;
+		}
+
+		const size_t fileSize = request.result.buffer.Size();
+		const size_t readSize = AlignUp(fileSize, IO_DIRECT_ALIGNMENT);
+
+		while (request.bytesDone < fileSize) {
+			ssize_t bytesRead = pread(request.fd, request.result.buffer.Data() + request.bytesDone,
+				readSize - request.bytesDone, (off_t)request.bytesDone);
+
+			if (bytesRead <= 0) {
+				CompleteRequest(request, false);
+				return;
+			}
+
+			request.bytesDone += (size_t)bytesRead;
+		}
+
+		CompleteRequest(request, true);
+#endif
+	}
+
+	static JobCounter blockingReadsCounter;
+
+	//-------------------------------------------------------------------------
+	//
+	// io_uring Backend
+	//
+	//-------------------------------------------------------------------------
+
+#ifdef RWD_IO_URING
+
+	static io_uring ring;
+	static bool ringInitialized = false;
+	static u32 ringQueueDepth = 0;
+
+	static std::thread ioThread;
+	static std::mutex pendingMutex;
+	static std::condition_variable pendingCondition;
+	static std::deque<ReadRequest*> pendingRequests;
+	static bool ioThreadRunning = false;
+
+	// Queues the next chunk of the request's read onto the ring, returns false if the ring is full
+	static bool QueueRead(ReadRequest* request) {
+		io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+		if (!sqe) {
+			return false;
+		}
+
+		size_t readSize = AlignUp(request->result.buffer.Size(), IO_DIRECT_ALIGNMENT);
+		io_uring_prep_read(sqe, request->fd, request->result.buffer.Data() + request->bytesDone,
+			(u32)std::min(readSize - request->bytesDone, (size_t)1 << 30), request->bytesDone);
+		io_uring_sqe_set_data(sqe, request);
+		return true;
+	}
+
+	static void IoThreadLoop() {
+		u32 inFlight = 0;
+
+		// Requests waiting for a free submission slot, some may already be open from a previous pass
+		std::vector<ReadRequest*> batch;
+		std::vector<ReadRequest*> deferred;
+
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(pendingMutex);
+
+				// Only sleep on the condition when there is nothing to reap or submit
+				if (inFlight == 0 && batch.empty()) {
+					pendingCondition.wait(lock, [] { return !pendingRequests.empty() || !ioThreadRunning; });
+				}
+
+				if (!ioThreadRunning && pendingRequests.empty() && inFlight == 0 && batch.empty()) {
+					return;
+				}
+
+				// Take as many requests as there are free submission slots
+				while (!pendingRequests.empty() && inFlight + batch.size() < ringQueueDepth) {
+					batch.push_back(pendingRequests.front());
+					pendingRequests.pop_front();
+				}
+			}
+
+			for (ReadRequest* request : batch) {
+				if (request->fd < 0) {
+					if (!OpenRequest(*request)) {
+						CompleteRequest(*request, false);
+						delete request;
+						continue;
+					}
+
+					if (request->result.buffer.Size() == 0) {
+						CompleteRequest(*request, true);
+						delete request;
+						continue;
+					}
+				}
+
+				if (QueueRead(request)) {
+					inFlight++;
+				} else {
+					deferred.push_back(request);
+				}
+			}
+
+			batch.swap(deferred);
+			deferred.clear();
+
+			// One syscall submits the whole batch
+			io_uring_submit(&ring);
+
+			if (inFlight == 0) {
+				continue;
+			}
+
+			// Wait briefly for a completion so newly queued requests still get picked up promptly
+			io_uring_cqe* cqe = nullptr;
+			__kernel_timespec timeout { .tv_sec = 0, .tv_nsec = 1000000 };
+			io_uring_wait_cqe_timeout(&ring, &cqe, &timeout);
+
+			u32 head;
+			u32 reaped = 0;
+
+			io_uring_for_each_cqe(&ring, head, cqe) {
+				reaped++;
+				inFlight--;
+				ReadRequest* request = (ReadRequest*)io_uring_cqe_get_data(cqe);
+
+				if (cqe->res <= 0) {
+					CompleteRequest(*request, false);
+					delete request;
+					continue;
+				}
+
+				request->bytesDone += (size_t)cqe->res;
+
+				// Short reads happen for large files, the remainder goes out with the next batch
+				if (request->bytesDone < request->result.buffer.Size()) {
+					batch.push_back(request);
+					continue;
+				}
+
+				CompleteRequest(*request, true);
+				delete request;
+			}
+
+			io_uring_cq_advance(&ring, reaped);
+		}
+	}
+
+#endif
+
+	//-------------------------------------------------------------------------
+	//
+	// Async IO
+	//
+	//-------------------------------------------------------------------------
+
+	void AsyncIO::Init(u32 queueDepth) {
+#ifdef RWD_IO_URING
+		int result = io_uring_queue_init(queueDepth, &ring, 0);
+
+		if (result < 0) {
+			// Kernels older than 5.1 or sandboxes which block io_uring land here
+			RWD_LOG_WARN("io_uring unavailable ({0}), falling back to blocking reads on the job system", result);
+			return;
+		}
+
+		ringInitialized = true;
+		ringQueueDepth = queueDepth;
+		ioThreadRunning = true;
+		ioThread = std::thread(IoThreadLoop);
+
+		RWD_LOG_INFO("Async IO using io_uring with a queue depth of {0}", queueDepth);
+#endif
+	}
+
+	void AsyncIO::Shutdown() {
+		JobSystem::Wait(blockingReadsCounter);
+
+#ifdef RWD_IO_URING
+		if (ringInitialized) {
+			{
+				std::lock_guard<std::mutex> lock(pendingMutex);
+				ioThreadRunning = false;
+			}
+			pendingCondition.notify_one();
+			ioThread.join();
+
+			io_uring_queue_exit(&ring);
+			ringInitialized = false;
+		}
+#endif
+	}
+
+	void AsyncIO::ReadFile(const std::string& filepath, ReadCallback callback, ReadFlags flags) {
+		ReadRequest* request = new ReadRequest {
+			.filepath = filepath,
+			.flags = flags,
+			.callback = std::move(callback),
+			.issueTime = Clock::now(),
+		};
+
+		BeginRequest();
+
+#ifdef RWD_IO_URING
+		if (ringInitialized) {
+			{
+				std::lock_guard<std::mutex> lock(pendingMutex);
+				pendingRequests.push_back(request);
+			}
+			pendingCondition.notify_one();
+			return;
+		}
+#endif
+
+		JobSystem::Execute(blockingReadsCounter, [request] {
+			ReadBlocking(*request);
+			delete request;
+		});
+	}
+
+	std::future<ReadResult> AsyncIO::ReadFile(const std::string& filepath, ReadFlags flags) {
+		Ref<std::promise<ReadResult>> promise = MakeRef<std::promise<ReadResult>>();
+		std::future<ReadResult> future = promise->get_future();
+
+		ReadFile(filepath, [promise] (ReadResult&& result) {
+			promise->set_value(std::move(result));
+		}, flags);
+
+		return future;
+	}
+
+	std::vector<std::future<ReadResult>> AsyncIO::ReadFiles(const std::vector<std::string>& filepaths, ReadFlags flags) {
+		std::vector<std::future<ReadResult>> futures;
+		futures.reserve(filepaths.size());
+
+		for (const std::string& filepath : filepaths) {
+			futures.push_back(ReadFile(filepath, flags));
+		}
+
+		return futures;
+	}
+
+	IoStats AsyncIO::Stats() {
+		std::lock_guard<std::mutex> lock(statsMutex);
+		return stats;
+	}
+
+	void AsyncIO::ResetStats() {
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats = IoStats { };
+	}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "pch.h"
+#include <future>
+#include "Core.h"
+
+namespace rwd {
+
+	// Block size used for unbuffered reads, buffers, offsets and lengths must all be multiples of it
+	const size_t IO_DIRECT_ALIGNMENT = 4096;
+
+	// Heap buffer aligned to IO_DIRECT_ALIGNMENT so it can be handed straight to unbuffered reads
+	class RWD_API IoBuffer {
+	public:
+		IoBuffer() = default;
+		IoBuffer(size_t size);
+		~IoBuffer();
+
+		IoBuffer(const IoBuffer&) = delete;
+		IoBuffer& operator=(const IoBuffer&) = delete;
+		IoBuffer(IoBuffer&& other) noexcept;
+		IoBuffer& operator=(IoBuffer&& other) noexcept;
+
+		u8* Data() const;
+
+		// Size of the file contents, the allocation may be larger to satisfy alignment
+		size_t Size() const;
+	private:
+		u8* mData = nullptr;
+		size_t mSize = 0;
+	};
+
+	enum class ReadFlags : u32 {
+		None = 0,
+
+		// Bypass the OS page cache (O_DIRECT / FILE_FLAG_NO_BUFFERING).
+		// Best for large assets which are read once and uploaded, so they don't evict useful cache.
+		Direct = 1 << 0,
+	};
+
+	struct ReadResult {
+		std::string filepath;
+		IoBuffer buffer;
+		bool success = false;
+
+		// Time from the request being issued to its completion
+		f64 latencyMs = 0.0;
+	};
+
+	struct IoStats {
+		u64 requestCount = 0;
+		u64 failedCount = 0;
+		u64 bytesRead = 0;
+
+		f64 totalLatencyMs = 0.0;
+		f64 maxLatencyMs = 0.0;
+
+		// Wall time during which at least one request was in flight
+		f64 busyTimeMs = 0.0;
+
+		f64 AverageLatencyMs() const { return requestCount ? totalLatencyMs / requestCount : 0.0; }
+		f64 ThroughputMBps() const { return busyTimeMs > 0.0 ? (bytesRead / (1024.0 * 1024.0)) / (busyTimeMs / 1000.0) : 0.0; }
+	};
+
+	// Asynchronous file reads.
+	//
+	// On Linux builds with RWD_IO_URING defined, requests are batched onto an io_uring by a dedicated
+	// I/O thread, so thousands of reads cost a handful of syscalls. Everywhere else each read runs as a
+	// blocking job on the job system, which still overlaps reads with each other and with the main thread.
+	class RWD_API AsyncIO {
+	public:
+		using ReadCallback = std::function<void(ReadResult&&)>;
+
+		static void Init(u32 queueDepth = 256);
+		static void Shutdown();
+
+		// The callback is invoked on an I/O or worker thread
+		static void ReadFile(const std::string& filepath, ReadCallback callback, ReadFlags flags = ReadFlags::None);
+		static std::future<ReadResult> ReadFile(const std::string& filepath, ReadFlags flags = ReadFlags::None);
+
+		// Issues every read before waiting on any of them, which is what lets the backend batch them
+		static std::vector<std::future<ReadResult>> ReadFiles(const std::vector<std::string>& filepaths, ReadFlags flags = ReadFlags::None);
+
+		static IoStats Stats();
+		static void ResetStats();
+	};
+
+}
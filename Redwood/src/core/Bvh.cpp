@@ -0,0 +1,581 @@
+#include "pch.h"
+#include <limits>
+#include "Log.h"
+#include "JobSystem.h"
+#include "Bvh.h"
+
+namespace rwd {
+
+	const u32 SAH_BINS = 16;
+
+	// Cost of visiting a node relative to testing one object. Leaves are culled 4 or 8 objects per
+	// instruction, so a node visit costs about as much as a handful of objects.
+	const f32 SAH_TRAVERSAL_COST = 4.0f;
+
+	// Past this depth splits go down the middle of the object range, which bounds the depth of
+	// the traversal stacks whatever the heuristic makes of clustered objects
+	const u32 MAX_SAH_DEPTH = 48;
+	const u32 TRAVERSAL_STACK_SIZE = 128;
+
+	// Rebuild once the unsorted tail or the removals reach these fractions of the tree,
+	// or once refits have made queries this much more expensive than after the build
+	const f32 REBUILD_INSERT_RATIO = 0.1f;
+	const f32 REBUILD_REMOVE_RATIO = 0.25f;
+	const f32 REBUILD_COST_RATIO = 1.5f;
+	const u32 MIN_INSERTS_FOR_REBUILD = 64;
+
+	const u32 NODES_PER_REFIT_JOB = 4096;
+
+	// Removed objects get infinitely negative extents so the SIMD culling rejects them without a check
+	const f32 REMOVED_EXTENT = -std::numeric_limits<f32>::infinity();
+
+	static f32 HalfArea(const Vec3& min, const Vec3& max) {
+		Vec3 size = max - min;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Objects
+	//
+	//-------------------------------------------------------------------------
+
+	u32 Bvh::Insert(const Aabb& bounds, u32 value) {
+		u32 proxy;
+		if (!mFreeProxies.empty()) {
+			proxy = mFreeProxies.back();
+			mFreeProxies.pop_back();
+		} else {
+			proxy = (u32)mProxyObjects.size();
+			mProxyObjects.push_back(0);
+		}
+
+		Vec3 center = (bounds.min + bounds.max) * 0.5f;
+		Vec3 extent = (bounds.max - bounds.min) * 0.5f;
+
+		mProxyObjects[proxy] = (u32)mValues.size();
+		mCenterX.push_back(center.x);
+		mCenterY.push_back(center.y);
+		mCenterZ.push_back(center.z);
+		mExtentX.push_back(extent.x);
+		mExtentY.push_back(extent.y);
+		mExtentZ.push_back(extent.z);
+		mValues.push_back(value);
+		mObjectProxies.push_back(proxy);
+
+		return proxy;
+	}
+
+	void Bvh::Remove(u32 proxy) {
+		u32 object = mProxyObjects[proxy];
+		RWD_ASSERT(!IsRemoved(object), "BVH proxy {0} has already been removed", proxy);
+
+		mExtentX[object] = REMOVED_EXTENT;
+		mExtentY[object] = REMOVED_EXTENT;
+		mExtentZ[object] = REMOVED_EXTENT;
+		mObjectProxies[object] = NO_PROXY;
+		mRemovedCount++;
+
+		mFreeProxies.push_back(proxy);
+		mBoundsChanged.store(true, std::memory_order_relaxed);
+	}
+
+	void Bvh::UpdateBounds(u32 proxy, const Aabb& bounds) {
+		u32 object = mProxyObjects[proxy];
+
+		mCenterX[object] = (bounds.min.x + bounds.max.x) * 0.5f;
+		mCenterY[object] = (bounds.min.y + bounds.max.y) * 0.5f;
+		mCenterZ[object] = (bounds.min.z + bounds.max.z) * 0.5f;
+		mExtentX[object] = (bounds.max.x - bounds.min.x) * 0.5f;
+		mExtentY[object] = (bounds.max.y - bounds.min.y) * 0.5f;
+		mExtentZ[object] = (bounds.max.z - bounds.min.z) * 0.5f;
+
+		mBoundsChanged.store(true, std::memory_order_relaxed);
+	}
+
+	Aabb Bvh::ObjectBounds(u32 object) const {
+		Vec3 center(mCenterX[object], mCenterY[object], mCenterZ[object]);
+		Vec3 extent(mExtentX[object], mExtentY[object], mExtentZ[object]);
+		return Aabb { center - extent, center + extent };
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Building
+	//
+	//-------------------------------------------------------------------------
+
+	void Bvh::Update() {
+		const u32 pending = (u32)mValues.size() - mTreeObjectCount;
+
+		bool rebuild = pending > std::max(MIN_INSERTS_FOR_REBUILD, (u32)(mTreeObjectCount * REBUILD_INSERT_RATIO))
+			|| mRemovedCount > mTreeObjectCount * REBUILD_REMOVE_RATIO;
+
+		if (rebuild) {
+			Rebuild();
+			return;
+		}
+
+		if (mBoundsChanged.exchange(false, std::memory_order_relaxed)) {
+			Refit();
+
+			if (mCost > mBuiltCost * REBUILD_COST_RATIO) {
+				Rebuild();
+			}
+		}
+	}
+
+	void Bvh::Rebuild() {
+		struct BuildTask {
+			u32 node;
+			u32 begin;
+			u32 end;
+			u32 depth;
+		};
+
+		struct Bin {
+			Vec3 min = Vec3(std::numeric_limits<f32>::max());
+			Vec3 max = Vec3(-std::numeric_limits<f32>::max());
+			u32 count = 0;
+
+			void Grow(const Vec3& objectMin, const Vec3& objectMax) {
+				min = glm::min(min, objectMin);
+				max = glm::max(max, objectMax);
+			}
+		};
+
+		// The build partitions copies of the bounds rather than indices into the SoA arrays,
+		// so every pass over a node's objects reads memory in order
+		struct BuildObject {
+			Vec3 min;
+			u32 object;
+			Vec3 max;
+		};
+
+		std::vector<BuildObject> objects;
+		objects.reserve(mValues.size() - mRemovedCount);
+		for (u32 object = 0; object < mValues.size(); object++) {
+			if (!IsRemoved(object)) {
+				Aabb bounds = ObjectBounds(object);
+				objects.push_back(BuildObject { bounds.min, object, bounds.max });
+			}
+		}
+
+		mNodes.clear();
+		mNodes.reserve(objects.empty() ? 0 : 2 * objects.size() / 4 + 1);
+
+		std::vector<BuildTask> tasks;
+		if (!objects.empty()) {
+			mNodes.emplace_back();
+			tasks.push_back(BuildTask { 0, 0, (u32)objects.size(), 0 });
+		}
+
+		while (!tasks.empty()) {
+			BuildTask task = tasks.back();
+			tasks.pop_back();
+
+			const u32 count = task.end - task.begin;
+
+			// Bounds of the objects and of their centers, which is what gets split
+			Vec3 min(std::numeric_limits<f32>::max()), max(-std::numeric_limits<f32>::max());
+			Vec3 centerMin = min, centerMax = max;
+			for (u32 i = task.begin; i < task.end; i++) {
+				const BuildObject& object = objects[i];
+				Vec3 center = (object.min + object.max) * 0.5f;
+
+				min = glm::min(min, object.min);
+				max = glm::max(max, object.max);
+				centerMin = glm::min(centerMin, center);
+				centerMax = glm::max(centerMax, center);
+			}
+
+			mNodes[task.node].min = min;
+			mNodes[task.node].max = max;
+
+			auto makeLeaf = [&] {
+				mNodes[task.node].first = task.begin;
+				mNodes[task.node].count = count;
+			};
+
+			if (count <= 2) {
+				makeLeaf();
+				continue;
+			}
+
+			Vec3 centerSize = centerMax - centerMin;
+			u32 axis = centerSize.x > centerSize.y ? (centerSize.x > centerSize.z ? 0 : 2) : (centerSize.y > centerSize.z ? 1 : 2);
+
+			u32 mid = task.begin + count / 2;
+			bool split = true;
+
+			if (centerSize[axis] > 0.0f && task.depth < MAX_SAH_DEPTH) {
+				Bin bins[SAH_BINS];
+				const f32 scale = SAH_BINS / centerSize[axis];
+				auto binOf = [&] (const BuildObject& object) {
+					f32 center = (object.min[axis] + object.max[axis]) * 0.5f;
+					return std::min((u32)((center - centerMin[axis]) * scale), SAH_BINS - 1);
+				};
+
+				for (u32 i = task.begin; i < task.end; i++) {
+					Bin& bin = bins[binOf(objects[i])];
+					bin.Grow(objects[i].min, objects[i].max);
+					bin.count++;
+				}
+
+				// Sweep from the right to get the cost of every right side, then from the left
+				f32 rightCosts[SAH_BINS];
+				Bin right;
+				for (u32 i = SAH_BINS - 1; i > 0; i--) {
+					right.Grow(bins[i].min, bins[i].max);
+					right.count += bins[i].count;
+					rightCosts[i] = right.count > 0 ? HalfArea(right.min, right.max) * right.count : 0.0f;
+				}
+
+				f32 bestCost = std::numeric_limits<f32>::max();
+				u32 bestSplit = 0;
+				Bin left;
+				for (u32 i = 0; i < SAH_BINS - 1; i++) {
+					left.Grow(bins[i].min, bins[i].max);
+					left.count += bins[i].count;
+
+					f32 cost = (left.count > 0 ? HalfArea(left.min, left.max) * left.count : 0.0f) + rightCosts[i + 1];
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestSplit = i + 1;
+					}
+				}
+
+				f32 splitCost = SAH_TRAVERSAL_COST + bestCost / std::max(HalfArea(min, max), 1e-12f);
+				if (count <= MAX_LEAF_SIZE && splitCost >= (f32)count) {
+					split = false;
+				} else {
+					auto it = std::partition(objects.begin() + task.begin, objects.begin() + task.end, [&] (const BuildObject& object) {
+						return binOf(object) < bestSplit;
+					});
+					mid = (u32)(it - objects.begin());
+
+					// Everything landed on one side, fall back to splitting the range in half
+					if (mid == task.begin || mid == task.end) {
+						mid = task.begin + count / 2;
+					}
+				}
+			} else if (count <= MAX_LEAF_SIZE) {
+				split = false;
+			}
+
+			if (!split) {
+				makeLeaf();
+				continue;
+			}
+
+			u32 left = (u32)mNodes.size();
+			mNodes.emplace_back();
+			mNodes.emplace_back();
+
+			mNodes[task.node].first = left;
+			mNodes[task.node].count = 0;
+
+			tasks.push_back(BuildTask { left + 1, mid, task.end, task.depth + 1 });
+			tasks.push_back(BuildTask { left, task.begin, mid, task.depth + 1 });
+		}
+
+		// Store the objects in leaf order so every leaf is a contiguous range
+		auto reorder = [&objects] (auto& array) {
+			std::remove_reference_t<decltype(array)> sorted(objects.size());
+			for (size_t i = 0; i < objects.size(); i++) {
+				sorted[i] = array[objects[i].object];
+			}
+			array.swap(sorted);
+		};
+
+		reorder(mCenterX);
+		reorder(mCenterY);
+		reorder(mCenterZ);
+		reorder(mExtentX);
+		reorder(mExtentY);
+		reorder(mExtentZ);
+		reorder(mValues);
+		reorder(mObjectProxies);
+
+		for (u32 object = 0; object < mObjectProxies.size(); object++) {
+			mProxyObjects[mObjectProxies[object]] = object;
+		}
+
+		mTreeObjectCount = (u32)objects.size();
+		mRemovedCount = 0;
+		mBoundsChanged.store(false, std::memory_order_relaxed);
+
+		mCost = ComputeCost();
+		mBuiltCost = mCost;
+	}
+
+	void Bvh::Refit() {
+		// Leaves only read their objects, so they can be refit in parallel. Children always come after
+		// their parent, so walking the inner nodes backwards finishes children before parents.
+		auto refitLeaves = [this] (u32 begin, u32 end) {
+			for (u32 n = begin; n < end; n++) {
+				Node& node = mNodes[n];
+				if (node.count == 0) {
+					continue;
+				}
+
+				Vec3 min(std::numeric_limits<f32>::max()), max(-std::numeric_limits<f32>::max());
+				for (u32 object = node.first; object < node.first + node.count; object++) {
+					if (!IsRemoved(object)) {
+						Aabb bounds = ObjectBounds(object);
+						min = glm::min(min, bounds.min);
+						max = glm::max(max, bounds.max);
+					}
+				}
+
+				node.min = min;
+				node.max = max;
+			}
+		};
+
+		const u32 nodeCount = (u32)mNodes.size();
+		if (nodeCount <= NODES_PER_REFIT_JOB) {
+			refitLeaves(0, nodeCount);
+		} else {
+			JobCounter counter;
+			JobSystem::Dispatch(counter, (nodeCount + NODES_PER_REFIT_JOB - 1) / NODES_PER_REFIT_JOB, 1, [&] (JobArgs args) {
+				u32 begin = args.jobIndex * NODES_PER_REFIT_JOB;
+				refitLeaves(begin, std::min(begin + NODES_PER_REFIT_JOB, nodeCount));
+			});
+			JobSystem::Wait(counter);
+		}
+
+		for (u32 n = nodeCount; n-- > 0;) {
+			Node& node = mNodes[n];
+			if (node.count == 0) {
+				const Node& left = mNodes[node.first];
+				const Node& right = mNodes[node.first + 1];
+				node.min = glm::min(left.min, right.min);
+				node.max = glm::max(left.max, right.max);
+			}
+		}
+
+		mCost = ComputeCost();
+	}
+
+	f32 Bvh::ComputeCost() const {
+		if (mNodes.empty()) {
+			return 0.0f;
+		}
+
+		f32 cost = 0.0f;
+		for (const Node& node : mNodes) {
+			// Leaves whose objects were all removed have inverted bounds
+			if (node.min.x > node.max.x) {
+				continue;
+			}
+
+			cost += HalfArea(node.min, node.max) * (node.count == 0 ? SAH_TRAVERSAL_COST : (f32)node.count);
+		}
+
+		return cost / std::max(HalfArea(mNodes[0].min, mNodes[0].max), 1e-12f);
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Queries
+	//
+	//-------------------------------------------------------------------------
+
+	void Bvh::AppendRange(u32 begin, u32 end, std::vector<u32>& values) const {
+		for (u32 object = begin; object < end; object++) {
+			if (!IsRemoved(object)) {
+				values.push_back(mValues[object]);
+			}
+		}
+	}
+
+	void Bvh::CullRange(const Frustum& frustum, u32 begin, u32 end, std::vector<u32>& values) const {
+		u32 visible[MAX_LEAF_SIZE];
+
+		for (u32 batch = begin; batch < end; batch += MAX_LEAF_SIZE) {
+			AabbBoundsSoA boxes {
+				mCenterX.data() + batch, mCenterY.data() + batch, mCenterZ.data() + batch,
+				mExtentX.data() + batch, mExtentY.data() + batch, mExtentZ.data() + batch,
+			};
+
+			size_t visibleCount = CullAabbs(frustum, boxes, std::min(end - batch, MAX_LEAF_SIZE), visible);
+			for (size_t i = 0; i < visibleCount; i++) {
+				values.push_back(mValues[batch + visible[i]]);
+			}
+		}
+	}
+
+	void Bvh::QueryFrustum(const Frustum& frustum, std::vector<u32>& values) const {
+		if (!mNodes.empty()) {
+			u32 stack[TRAVERSAL_STACK_SIZE];
+			u32 stackSize = 0;
+			stack[stackSize++] = 0;
+
+			while (stackSize > 0) {
+				const Node& node = mNodes[stack[--stackSize]];
+
+				Vec3 center = (node.min + node.max) * 0.5f;
+				Vec3 extent = (node.max - node.min) * 0.5f;
+
+				bool outside = false;
+				bool inside = true;
+				for (const Vec4& plane : frustum.planes) {
+					f32 distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+					f32 radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+					outside |= distance < -radius;
+					inside &= distance >= radius;
+				}
+
+				if (outside) {
+					continue;
+				}
+
+				if (node.count > 0) {
+					if (inside) {
+						AppendRange(node.first, node.first + node.count, values);
+					} else {
+						CullRange(frustum, node.first, node.first + node.count, values);
+					}
+					continue;
+				}
+
+				// A subtree entirely inside is emitted leaf by leaf without testing anything
+				if (inside) {
+					u32 first = node.first;
+					u32 last = node.first + 1;
+					while (mNodes[first].count == 0) {
+						first = mNodes[first].first;
+					}
+					while (mNodes[last].count == 0) {
+						last = mNodes[last].first + 1;
+					}
+
+					AppendRange(mNodes[first].first, mNodes[last].first + mNodes[last].count, values);
+					continue;
+				}
+
+				RWD_ASSERT(stackSize + 2 <= TRAVERSAL_STACK_SIZE, "BVH is deeper than the traversal stack");
+				stack[stackSize++] = node.first + 1;
+				stack[stackSize++] = node.first;
+			}
+		}
+
+		CullRange(frustum, mTreeObjectCount, (u32)mValues.size(), values);
+	}
+
+	void Bvh::QuerySphere(const Vec3& center, f32 radius, std::vector<u32>& values) const {
+		const f32 radiusSquared = radius * radius;
+
+		auto overlaps = [&] (const Vec3& min, const Vec3& max) {
+			Vec3 closest = glm::clamp(center, min, max);
+			Vec3 offset = closest - center;
+			return glm::dot(offset, offset) <= radiusSquared;
+		};
+
+		auto testRange = [&] (u32 begin, u32 end) {
+			for (u32 object = begin; object < end; object++) {
+				Aabb bounds = ObjectBounds(object);
+				if (!IsRemoved(object) && overlaps(bounds.min, bounds.max)) {
+					values.push_back(mValues[object]);
+				}
+			}
+		};
+
+		if (!mNodes.empty()) {
+			u32 stack[TRAVERSAL_STACK_SIZE];
+			u32 stackSize = 0;
+			stack[stackSize++] = 0;
+
+			while (stackSize > 0) {
+				const Node& node = mNodes[stack[--stackSize]];
+				if (!overlaps(node.min, node.max)) {
+					continue;
+				}
+
+				if (node.count > 0) {
+					testRange(node.first, node.first + node.count);
+					continue;
+				}
+
+				RWD_ASSERT(stackSize + 2 <= TRAVERSAL_STACK_SIZE, "BVH is deeper than the traversal stack");
+				stack[stackSize++] = node.first + 1;
+				stack[stackSize++] = node.first;
+			}
+		}
+
+		testRange(mTreeObjectCount, (u32)mValues.size());
+	}
+
+	bool Bvh::Raycast(const Vec3& origin, const Vec3& direction, f32 maxDistance, RayHit& hit) const {
+		const Vec3 inverseDirection = 1.0f / direction;
+		f32 closest = maxDistance;
+		u32 closestObject = NO_PROXY;
+
+		// Distance along the ray to where it enters the box, or infinity when it misses within closest
+		auto slab = [&] (const Vec3& min, const Vec3& max) {
+			Vec3 t0 = (min - origin) * inverseDirection;
+			Vec3 t1 = (max - origin) * inverseDirection;
+			Vec3 near = glm::min(t0, t1);
+			Vec3 far = glm::max(t0, t1);
+
+			f32 enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+			f32 exit = std::min(std::min(far.x, far.y), std::min(far.z, closest));
+			return enter <= exit ? enter : std::numeric_limits<f32>::infinity();
+		};
+
+		auto testRange = [&] (u32 begin, u32 end) {
+			for (u32 object = begin; object < end; object++) {
+				if (IsRemoved(object)) {
+					continue;
+				}
+
+				Aabb bounds = ObjectBounds(object);
+				f32 distance = slab(bounds.min, bounds.max);
+				if (distance != std::numeric_limits<f32>::infinity() && (distance < closest || closestObject == NO_PROXY)) {
+					closest = distance;
+					closestObject = object;
+				}
+			}
+		};
+
+		if (!mNodes.empty()) {
+			u32 stack[TRAVERSAL_STACK_SIZE];
+			u32 stackSize = 0;
+			stack[stackSize++] = 0;
+
+			while (stackSize > 0) {
+				const Node& node = mNodes[stack[--stackSize]];
+				if (slab(node.min, node.max) == std::numeric_limits<f32>::infinity()) {
+					continue;
+				}
+
+				if (node.count > 0) {
+					testRange(node.first, node.first + node.count);
+					continue;
+				}
+
+				// Visit the nearer child first so the closest hit shrinks the ray sooner
+				u32 near = node.first;
+				u32 far = node.first + 1;
+				if (slab(mNodes[far].min, mNodes[far].max) < slab(mNodes[near].min, mNodes[near].max)) {
+					std::swap(near, far);
+				}
+
+				RWD_ASSERT(stackSize + 2 <= TRAVERSAL_STACK_SIZE, "BVH is deeper than the traversal stack");
+				stack[stackSize++] = far;
+				stack[stackSize++] = near;
+			}
+		}
+
+		testRange(mTreeObjectCount, (u32)mValues.size());
+
+		if (closestObject == NO_PROXY) {
+			return false;
+		}
+
+		hit = RayHit { mValues[closestObject], closest };
+		return true;
+	}
+
+}
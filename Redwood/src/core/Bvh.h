@@ -0,0 +1,97 @@
+#pragma once
+#include "pch.h"
+#include <atomic>
+#include "Core.h"
+#include "Math.h"
+#include "SimdMath.h"
+
+namespace rwd {
+
+	struct Aabb {
+		Vec3 min;
+		Vec3 max;
+	};
+
+	struct RayHit {
+		u32 value;
+		f32 distance;
+	};
+
+	// Bounding volume hierarchy over object bounds, for culling, overlap tests and picking.
+	//
+	// Built top down with the binned surface area heuristic. The objects are stored as SoA bounds in
+	// leaf order, so a leaf is a contiguous range the SIMD culling in SimdMath.h tests in one call,
+	// and nodes entirely inside a frustum emit their objects without testing them at all.
+	//
+	// Moving objects only refits the node bounds. Inserted objects go in an unsorted tail that
+	// queries scan linearly, and removed ones are masked out, until Update decides the tail, the
+	// removals or the refits have degraded the tree enough to rebuild it.
+	class RWD_API Bvh {
+	public:
+		static const u32 MAX_LEAF_SIZE = 16;
+
+		// Returns a proxy for the object, value is what queries report for it, e.g. the index of its draw
+		u32 Insert(const Aabb& bounds, u32 value);
+		void Remove(u32 proxy);
+
+		// Safe to call from several threads at once for different proxies, so bounds can be
+		// updated in batches on the job system. Takes effect on the next Update.
+		void UpdateBounds(u32 proxy, const Aabb& bounds);
+
+		// Refits or rebuilds the tree, call once per frame before querying and not alongside anything else
+		void Update();
+		void Rebuild();
+
+		// Append the values of the objects that pass. Queries can run from several threads at once.
+		// A frustum query gives a view's visibility set, the draws to push to its RenderQueue.
+		void QueryFrustum(const Frustum& frustum, std::vector<u32>& values) const;
+		void QuerySphere(const Vec3& center, f32 radius, std::vector<u32>& values) const;
+
+		// Closest object whose bounds the ray hits within maxDistance, direction has to be normalized
+		bool Raycast(const Vec3& origin, const Vec3& direction, f32 maxDistance, RayHit& hit) const;
+
+		u32 Count() const { return (u32)mValues.size() - mRemovedCount; }
+		u32 NodeCount() const { return (u32)mNodes.size(); }
+
+		// Expected cost of a query relative to testing the root alone, lower is better
+		f32 SahCost() const { return mCost; }
+	private:
+		static const u32 NO_PROXY = ~0u;
+
+		// Leaves point at a range of objects, inner nodes at two adjacent children
+		struct Node {
+			Vec3 min;
+			u32 first; // First object of a leaf, left child of an inner node
+			Vec3 max;
+			u32 count; // 0 for inner nodes
+		};
+
+		Aabb ObjectBounds(u32 object) const;
+		bool IsRemoved(u32 object) const { return mObjectProxies[object] == NO_PROXY; }
+
+		void Refit();
+		f32 ComputeCost() const;
+
+		// Appends values of objects in [begin, end) that aren't removed
+		void AppendRange(u32 begin, u32 end, std::vector<u32>& values) const;
+		void CullRange(const Frustum& frustum, u32 begin, u32 end, std::vector<u32>& values) const;
+	private:
+		// Objects in leaf order, then the ones inserted since the last rebuild
+		std::vector<f32> mCenterX, mCenterY, mCenterZ;
+		std::vector<f32> mExtentX, mExtentY, mExtentZ;
+		std::vector<u32> mValues;
+		std::vector<u32> mObjectProxies;
+
+		std::vector<u32> mProxyObjects;
+		std::vector<u32> mFreeProxies;
+
+		std::vector<Node> mNodes;
+		u32 mTreeObjectCount = 0;
+		u32 mRemovedCount = 0;
+
+		f32 mBuiltCost = 0.0f;
+		f32 mCost = 0.0f;
+		std::atomic<bool> mBoundsChanged { false };
+	};
+
+}
@@ -1,15 +1,24 @@
 #pragma once
 
-#ifdef RWD_BUILD_DLL
-	#define	RWD_API __declspec(dllexport)
+#ifdef _WIN32
+	#ifdef RWD_BUILD_DLL
+		#define	RWD_API __declspec(dllexport)
+	#else
+		#define	RWD_API __declspec(dllimport)
+	#endif
 #else
-	#define	RWD_API __declspec(dllimport)
+	#define RWD_API __attribute__((visibility("default")))
+#endif
+
+#ifndef RWD_BUILD_DLL
 	#include <memory>
 #endif
 
 using u8  = char;
+using u16 = unsigned short;
 using i32 = int;
 using u32 = unsigned int;
+using u64 = unsigned long long;
 using f32 = float;
 using f64 = double;
 
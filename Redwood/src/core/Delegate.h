@@ -0,0 +1,62 @@
+#pragma once
+#include "pch.h"
+#include "Core.h"
+
+namespace rwd {
+
+	template<typename Signature>
+	class Delegate;
+
+	// A callback that's an object pointer and a function pointer, two words that never allocate.
+	//
+	// The function is a thunk generated per bound function, so calls are one indirect call with the
+	// target inlined into the thunk. The delegate doesn't own the object, the object has to outlive the delegate.
+	// Delegates bound to the same function and object compare equal, so they can be used to unsubscribe.
+	template<typename R, typename... Args>
+	class Delegate<R(Args...)> {
+	public:
+		Delegate() = default;
+
+		// Delegate::Bind<&Class::Method>(object)
+		template<auto Method, typename C>
+		static Delegate Bind(C* instance) {
+			return Delegate(const_cast<void*>(static_cast<const void*>(instance)), [] (void* object, Args... args) -> R {
+				return (static_cast<C*>(object)->*Method)(std::forward<Args>(args)...);
+			});
+		}
+
+		// Delegate::Bind<&Function>()
+		template<auto Function>
+		static Delegate Bind() {
+			return Delegate(nullptr, [] (void*, Args... args) -> R {
+				return Function(std::forward<Args>(args)...);
+			});
+		}
+
+		// A lambda or other callable kept alive by the caller
+		template<typename F>
+		static Delegate Bind(F& callable) {
+			return Delegate(const_cast<void*>(static_cast<const void*>(&callable)), [] (void* object, Args... args) -> R {
+				return (*static_cast<F*>(object))(std::forward<Args>(args)...);
+			});
+		}
+
+		R operator()(Args... args) const {
+			return mThunk(mInstance, std::forward<Args>(args)...);
+		}
+
+		bool IsBound() const { return mThunk != nullptr; }
+
+		bool operator==(const Delegate& other) const {
+			return mInstance == other.mInstance && mThunk == other.mThunk;
+		}
+	private:
+		using Thunk = R(*)(void*, Args...);
+
+		Delegate(void* instance, Thunk thunk) : mInstance(instance), mThunk(thunk) { }
+	private:
+		void* mInstance = nullptr;
+		Thunk mThunk = nullptr;
+	};
+
+}
@@ -0,0 +1,428 @@
+#include "pch.h"
+#include <bit>
+#include <mutex>
+#include <cstring>
+#include "Log.h"
+#include "JobSystem.h"
+#include "Ecs.h"
+
+namespace rwd {
+
+	// Component arrays start on at least this boundary so SIMD code can load them aligned
+	const u32 COLUMN_ALIGNMENT = 16;
+	const size_t CHUNK_ALIGNMENT = 64;
+
+	// Split parallel work into about this many groups per thread, so uneven chunks even out
+	// without paying the dispatch cost for every single chunk
+	const u32 GROUPS_PER_THREAD = 4;
+
+	//-------------------------------------------------------------------------
+	//
+	// Component Registry
+	//
+	//-------------------------------------------------------------------------
+
+	// A fixed array so GetComponentInfo can hand out references without locking
+	static ComponentInfo componentInfos[MAX_COMPONENT_TYPES];
+	static u32 componentCount = 0;
+	static std::unordered_map<u64, u32> componentIdByHash;
+	static std::mutex registryMutex;
+
+	u32 RegisterComponent(const ComponentInfo& info) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		auto it = componentIdByHash.find(info.typeHash);
+		if (it != componentIdByHash.end()) {
+			return it->second;
+		}
+
+		RWD_ASSERT(componentCount < MAX_COMPONENT_TYPES, "More than {0} component types", MAX_COMPONENT_TYPES);
+
+		u32 id = componentCount++;
+		componentInfos[id] = info;
+		componentIdByHash[info.typeHash] = id;
+		return id;
+	}
+
+	const ComponentInfo& GetComponentInfo(u32 id) {
+		return componentInfos[id];
+	}
+
+	static u32 DispatchGroupSize(size_t taskCount) {
+		size_t groups = (size_t)(JobSystem::ThreadCount() + 1) * GROUPS_PER_THREAD;
+		return (u32)std::max<size_t>(1, taskCount / groups);
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Archetype
+	//
+	//-------------------------------------------------------------------------
+
+	static u32 AlignUp(u32 value, u32 alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Size of a chunk holding capacity rows, filling in where each component's array starts
+	static u32 ChunkLayout(const std::vector<u32>& components, u32 capacity, u32* offsets) {
+		u32 size = sizeof(Entity) * capacity;
+
+		for (u32 id : components) {
+			const ComponentInfo& info = GetComponentInfo(id);
+			size = AlignUp(size, std::max(info.alignment, COLUMN_ALIGNMENT));
+			offsets[id] = size;
+			size += info.size * capacity;
+		}
+
+		return size;
+	}
+
+	Archetype::Archetype(ComponentMask mask) : mMask(mask) {
+		std::fill(std::begin(mColumnOffsets), std::end(mColumnOffsets), NO_COLUMN);
+
+		u32 rowSize = sizeof(Entity);
+		for (ComponentMask bits = mask; bits != 0; bits &= bits - 1) {
+			u32 id = (u32)std::countr_zero(bits);
+			mComponents.push_back(id);
+			rowSize += GetComponentInfo(id).size;
+		}
+
+		// Start from the capacity without padding and back off until the aligned arrays fit
+		mCapacity = (u32)(ECS_CHUNK_SIZE / rowSize);
+		while (mCapacity > 0 && ChunkLayout(mComponents, mCapacity, mColumnOffsets) > ECS_CHUNK_SIZE) {
+			mCapacity--;
+		}
+
+		RWD_ASSERT(mCapacity > 0, "Components of archetype {0:#x} don't fit in a {1} byte chunk", mask, ECS_CHUNK_SIZE);
+	}
+
+	Archetype::~Archetype() {
+		for (Chunk& chunk : mChunks) {
+			for (u32 id : mComponents) {
+				const ComponentInfo& info = GetComponentInfo(id);
+				if (info.trivial) {
+					continue;
+				}
+
+				u8* column = Column(chunk, id);
+				for (u32 row = 0; row < chunk.count; row++) {
+					info.destroy(column + row * info.size);
+				}
+			}
+
+			::operator delete(chunk.data, std::align_val_t(CHUNK_ALIGNMENT));
+		}
+	}
+
+	u32 Archetype::Allocate(Entity entity, u32& chunkIndex) {
+		if (mChunks.empty() || mChunks.back().count == mCapacity) {
+			mChunks.push_back(Chunk { .data = (u8*)::operator new(ECS_CHUNK_SIZE, std::align_val_t(CHUNK_ALIGNMENT)) });
+		}
+
+		chunkIndex = (u32)mChunks.size() - 1;
+		Chunk& chunk = mChunks.back();
+
+		u32 row = chunk.count++;
+		Entities(chunk)[row] = entity;
+		return row;
+	}
+
+	Entity Archetype::Remove(u32 chunkIndex, u32 row, bool destroyComponents) {
+		Chunk& chunk = mChunks[chunkIndex];
+		Chunk& last = mChunks.back();
+		const u32 lastRow = last.count - 1;
+		const bool fillHole = &chunk != &last || row != lastRow;
+
+		for (u32 id : mComponents) {
+			const ComponentInfo& info = GetComponentInfo(id);
+			u8* dst = Column(chunk, id) + row * info.size;
+
+			if (destroyComponents && !info.trivial) {
+				info.destroy(dst);
+			}
+
+			if (fillHole) {
+				u8* src = Column(last, id) + lastRow * info.size;
+				if (info.trivial) {
+					memcpy(dst, src, info.size);
+				} else {
+					info.moveConstruct(dst, src);
+				}
+			}
+		}
+
+		Entity moved;
+		if (fillHole) {
+			moved = Entities(last)[lastRow];
+			Entities(chunk)[row] = moved;
+		}
+
+		if (--last.count == 0) {
+			::operator delete(last.data, std::align_val_t(CHUNK_ALIGNMENT));
+			mChunks.pop_back();
+		}
+
+		return moved;
+	}
+
+	size_t Archetype::EntityCount() const {
+		if (mChunks.empty()) {
+			return 0;
+		}
+
+		return (mChunks.size() - 1) * mCapacity + mChunks.back().count;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// World
+	//
+	//-------------------------------------------------------------------------
+
+	World::World() { }
+
+	World::~World() { }
+
+	Entity World::Create() {
+		Archetype* archetype;
+		u32 chunkIndex, row;
+		return CreateInArchetype(0, 0, archetype, chunkIndex, row);
+	}
+
+	Entity World::CreateInArchetype(ComponentMask mask, u32 componentCount, Archetype*& archetype, u32& chunkIndex, u32& row) {
+		RWD_ASSERT(mIterating == 0, "Entities can't be created while iterating");
+		RWD_ASSERT((u32)std::popcount(mask) == componentCount, "An entity can't have the same component twice");
+
+		u32 index;
+		if (!mFreeIndices.empty()) {
+			index = mFreeIndices.back();
+			mFreeIndices.pop_back();
+		} else {
+			index = (u32)mRecords.size();
+			mRecords.emplace_back();
+		}
+
+		EntityRecord& record = mRecords[index];
+		Entity entity { index, record.generation };
+
+		archetype = GetArchetype(mask);
+		row = archetype->Allocate(entity, chunkIndex);
+
+		record.archetype = archetype;
+		record.chunk = chunkIndex;
+		record.row = row;
+		return entity;
+	}
+
+	void World::Destroy(Entity entity) {
+		RWD_ASSERT(mIterating == 0, "Entities can't be destroyed while iterating");
+
+		if (!IsAlive(entity)) {
+			return;
+		}
+
+		EntityRecord& record = mRecords[entity.index];
+		Entity moved = record.archetype->Remove(record.chunk, record.row, true);
+		if (moved.IsValid()) {
+			mRecords[moved.index].chunk = record.chunk;
+			mRecords[moved.index].row = record.row;
+		}
+
+		// Generation 0 marks invalid handles, skip it when wrapping around
+		record.archetype = nullptr;
+		record.generation = record.generation + 1 == 0 ? 1 : record.generation + 1;
+		mFreeIndices.push_back(entity.index);
+	}
+
+	bool World::IsAlive(Entity entity) const {
+		return Record(entity) != nullptr;
+	}
+
+	const World::EntityRecord* World::Record(Entity entity) const {
+		if (entity.index >= mRecords.size()) {
+			return nullptr;
+		}
+
+		const EntityRecord& record = mRecords[entity.index];
+		if (record.archetype == nullptr || record.generation != entity.generation) {
+			return nullptr;
+		}
+
+		return &record;
+	}
+
+	void* World::GetComponent(Entity entity, u32 componentId) const {
+		const EntityRecord* record = Record(entity);
+		if (record == nullptr || !record->archetype->Has(componentId)) {
+			return nullptr;
+		}
+
+		const Chunk& chunk = record->archetype->mChunks[record->chunk];
+		return record->archetype->Column(chunk, componentId) + record->row * GetComponentInfo(componentId).size;
+	}
+
+	void* World::ChangeArchetype(Entity entity, u32 componentId, bool add) {
+		RWD_ASSERT(mIterating == 0, "Components can't be added or removed while iterating");
+		RWD_ASSERT(IsAlive(entity), "Components can't be added to or removed from a destroyed entity");
+
+		EntityRecord& record = mRecords[entity.index];
+		Archetype* source = record.archetype;
+
+		ComponentMask bit = 1ull << componentId;
+		Archetype* target = GetArchetype(add ? source->mMask | bit : source->mMask & ~bit);
+
+		u32 targetChunkIndex;
+		u32 targetRow = target->Allocate(entity, targetChunkIndex);
+		const Chunk& targetChunk = target->mChunks[targetChunkIndex];
+		const Chunk& sourceChunk = source->mChunks[record.chunk];
+
+		// Move the shared components over, leaving the source row's components destroyed
+		for (u32 id : source->mComponents) {
+			const ComponentInfo& info = GetComponentInfo(id);
+			u8* src = source->Column(sourceChunk, id) + record.row * info.size;
+
+			if (!target->Has(id)) {
+				if (!info.trivial) {
+					info.destroy(src);
+				}
+				continue;
+			}
+
+			u8* dst = target->Column(targetChunk, id) + targetRow * info.size;
+			if (info.trivial) {
+				memcpy(dst, src, info.size);
+			} else {
+				info.moveConstruct(dst, src);
+			}
+		}
+
+		Entity moved = source->Remove(record.chunk, record.row, false);
+		if (moved.IsValid()) {
+			mRecords[moved.index].chunk = record.chunk;
+			mRecords[moved.index].row = record.row;
+		}
+
+		record.archetype = target;
+		record.chunk = targetChunkIndex;
+		record.row = targetRow;
+
+		if (!add) {
+			return nullptr;
+		}
+
+		return target->Column(target->mChunks[targetChunkIndex], componentId) + targetRow * GetComponentInfo(componentId).size;
+	}
+
+	Archetype* World::GetArchetype(ComponentMask mask) {
+		Scope<Archetype>& archetype = mArchetypeByMask[mask];
+		if (!archetype) {
+			archetype = MakeScope<Archetype>(mask);
+			mArchetypes.push_back(archetype.get());
+		}
+
+		return archetype.get();
+	}
+
+	const std::vector<Archetype*>& World::Match(ComponentMask required) {
+		QueryCache& query = mQueries[required];
+
+		for (; query.scanned < mArchetypes.size(); query.scanned++) {
+			Archetype* archetype = mArchetypes[query.scanned];
+			if ((archetype->mMask & required) == required) {
+				query.archetypes.push_back(archetype);
+			}
+		}
+
+		return query.archetypes;
+	}
+
+	void World::ParallelForChunks(ComponentMask required, const ChunkFn& fn) {
+		std::vector<ChunkView> chunks;
+		for (Archetype* archetype : Match(required)) {
+			for (const Chunk& chunk : archetype->mChunks) {
+				chunks.emplace_back(*archetype, chunk);
+			}
+		}
+
+		mIterating++;
+
+		if (chunks.size() == 1) {
+			fn(chunks[0]);
+		} else if (!chunks.empty()) {
+			JobCounter counter;
+			JobSystem::Dispatch(counter, (u32)chunks.size(), DispatchGroupSize(chunks.size()), [&] (JobArgs args) {
+				fn(chunks[args.jobIndex]);
+			});
+			JobSystem::Wait(counter);
+		}
+
+		mIterating--;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// System Scheduler
+	//
+	//-------------------------------------------------------------------------
+
+	void SystemScheduler::AddSystem(const std::string& name, ComponentMask required, ComponentMask writes, World::ChunkFn fn) {
+		u32 stage = 0;
+		for (const System& other : mSystems) {
+			bool conflicts = (writes & other.required) != 0 || (other.writes & required) != 0;
+			if (conflicts) {
+				stage = std::max(stage, other.stage + 1);
+			}
+		}
+
+		mStageCount = std::max(mStageCount, stage + 1);
+		mSystems.push_back(System { name, required, writes, std::move(fn), stage });
+	}
+
+	void SystemScheduler::Run(World& world) {
+		RWD_ASSERT(world.mIterating == 0, "Systems can't run while the world is being iterated");
+		world.mIterating++;
+
+		for (u32 stage = 0; stage < mStageCount; stage++) {
+			mTasks.clear();
+
+			for (const System& system : mSystems) {
+				if (system.stage != stage) {
+					continue;
+				}
+
+				for (const Archetype* archetype : world.Match(system.required)) {
+					for (const Chunk& chunk : archetype->mChunks) {
+						mTasks.push_back(ChunkTask { &system, archetype, &chunk });
+					}
+				}
+			}
+
+			if (mTasks.empty()) {
+				continue;
+			}
+
+			JobCounter counter;
+			JobSystem::Dispatch(counter, (u32)mTasks.size(), DispatchGroupSize(mTasks.size()), [this] (JobArgs args) {
+				const ChunkTask& task = mTasks[args.jobIndex];
+				task.system->fn(ChunkView(*task.archetype, *task.chunk));
+			});
+			JobSystem::Wait(counter);
+		}
+
+		world.mIterating--;
+	}
+
+	void SystemScheduler::LogStages() const {
+		for (u32 stage = 0; stage < mStageCount; stage++) {
+			std::string names;
+			for (const System& system : mSystems) {
+				if (system.stage == stage) {
+					names += names.empty() ? system.name : ", " + system.name;
+				}
+			}
+
+			RWD_LOG_INFO("Stage {0}: {1}", stage, names);
+		}
+	}
+
+}
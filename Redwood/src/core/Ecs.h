@@ -0,0 +1,371 @@
+#pragma once
+#include "pch.h"
+#include <string_view>
+#include <type_traits>
+#include "Core.h"
+
+namespace rwd {
+
+	// Entities and their components, stored by archetype.
+	//
+	// Every distinct set of component types is an archetype, and an archetype's entities live in
+	// 16 KiB chunks that hold one array per component type. A query walks the chunks of the
+	// archetypes that have its components, touching nothing but those arrays, and each chunk is
+	// an independent piece of work for the job system.
+
+	const size_t ECS_CHUNK_SIZE = 16 * 1024;
+	const u32 MAX_COMPONENT_TYPES = 64;
+
+	// One bit per component id
+	using ComponentMask = u64;
+
+	// Generational handle like AssetHandle, the generation changes when the slot is reused
+	struct Entity {
+		u32 index = 0;
+		u32 generation = 0;
+
+		bool IsValid() const { return generation != 0; }
+		bool operator==(const Entity& other) const = default;
+	};
+
+	// How to create, move and destroy a component without knowing its type
+	struct ComponentInfo {
+		u64 typeHash;
+		u32 size;
+		u32 alignment;
+		bool trivial;
+		void (*construct)(void* dst);
+		void (*moveConstruct)(void* dst, void* src); // Leaves src destroyed
+		void (*destroy)(void* component);
+	};
+
+	// Ids are handed out in registration order and keyed by the type's name rather than a
+	// template static, so the engine and the app agree on them across the DLL boundary
+	RWD_API u32 RegisterComponent(const ComponentInfo& info);
+	RWD_API const ComponentInfo& GetComponentInfo(u32 id);
+
+	template<typename T>
+	constexpr std::string_view ComponentTypeName() {
+#ifdef _MSC_VER
+		return __FUNCSIG__;
+#else
+		return __PRETTY_FUNCTION__;
+#endif
+	}
+
+	template<typename T>
+	ComponentInfo MakeComponentInfo() {
+		std::string_view name = ComponentTypeName<T>();
+
+		// FNV-1a, Hash.h can't be used in a constant expression
+		u64 hash = 0xCBF29CE484222325ull;
+		for (char c : name) {
+			hash = (hash ^ (unsigned char)c) * 0x100000001B3ull;
+		}
+
+		return ComponentInfo {
+			.typeHash = hash,
+			.size = sizeof(T),
+			.alignment = alignof(T),
+			.trivial = std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+			.construct = [] (void* dst) { new (dst) T(); },
+			.moveConstruct = [] (void* dst, void* src) {
+				new (dst) T(std::move(*(T*)src));
+				((T*)src)->~T();
+			},
+			.destroy = [] (void* component) { ((T*)component)->~T(); },
+		};
+	}
+
+	template<typename T>
+	u32 ComponentId() {
+		static const u32 id = RegisterComponent(MakeComponentInfo<std::remove_const_t<T>>());
+		return id;
+	}
+
+	template<typename... Ts>
+	ComponentMask MaskOf() {
+		return ((1ull << ComponentId<Ts>()) | ... | 0ull);
+	}
+
+	// Components a query writes, the ones not declared const
+	template<typename... Ts>
+	ComponentMask WriteMaskOf() {
+		return ((std::is_const_v<Ts> ? 0ull : 1ull << ComponentId<Ts>()) | ... | 0ull);
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Archetype Storage
+	//
+	//-------------------------------------------------------------------------
+
+	// Chunks start with the entity array, followed by one array per component in id order
+	struct Chunk {
+		u8* data = nullptr;
+		u32 count = 0;
+	};
+
+	class RWD_API Archetype {
+	public:
+		static const u32 NO_COLUMN = ~0u;
+
+		Archetype(ComponentMask mask);
+		~Archetype();
+
+		Archetype(const Archetype&) = delete;
+		Archetype& operator=(const Archetype&) = delete;
+
+		bool Has(u32 componentId) const { return mColumnOffsets[componentId] != NO_COLUMN; }
+
+		u8* Column(const Chunk& chunk, u32 componentId) const { return chunk.data + mColumnOffsets[componentId]; }
+		Entity* Entities(const Chunk& chunk) const { return (Entity*)chunk.data; }
+
+		// Appends a row for the entity to the last chunk, adding a chunk when it's full.
+		// The row's components are left uninitialized.
+		u32 Allocate(Entity entity, u32& chunkIndex);
+
+		// Fills the hole by moving the archetype's last row into it, so every chunk but the last
+		// stays full. Returns the entity that moved, or an invalid one if the removed row was last.
+		Entity Remove(u32 chunkIndex, u32 row, bool destroyComponents);
+
+		size_t EntityCount() const;
+
+		ComponentMask mMask;
+		std::vector<u32> mComponents;
+		u32 mColumnOffsets[MAX_COMPONENT_TYPES];
+		u32 mCapacity;
+		std::vector<Chunk> mChunks;
+	};
+
+	// The part of a chunk a query or system sees
+	class ChunkView {
+	public:
+		ChunkView(const Archetype& archetype, const Chunk& chunk)
+			: mArchetype(&archetype), mChunk(&chunk) { }
+
+		u32 Count() const { return mChunk->count; }
+		const Entity* Entities() const { return mArchetype->Entities(*mChunk); }
+
+		// The chunk's array of T, nullptr if the archetype doesn't have it
+		template<typename T>
+		T* Get() const {
+			u32 id = ComponentId<T>();
+			return mArchetype->Has(id) ? (T*)mArchetype->Column(*mChunk, id) : nullptr;
+		}
+
+		// Calls fn(Ts&...) for every entity in the chunk
+		template<typename... Ts, typename Fn>
+		void ForEach(Fn& fn) const {
+			ForEachRow(fn, Get<Ts>()...);
+		}
+	private:
+		template<typename Fn, typename... Ps>
+		void ForEachRow(Fn& fn, Ps*... columns) const {
+			const u32 count = mChunk->count;
+			for (u32 i = 0; i < count; i++) {
+				fn(columns[i]...);
+			}
+		}
+	private:
+		const Archetype* mArchetype;
+		const Chunk* mChunk;
+	};
+
+	//-------------------------------------------------------------------------
+	//
+	// World
+	//
+	//-------------------------------------------------------------------------
+
+	// Owns every entity and archetype. Structural changes (creating and destroying entities,
+	// adding and removing components) move entities between chunks and have to happen on one
+	// thread, outside of queries. Components can be modified anywhere a query allows.
+	class RWD_API World {
+	public:
+		using ChunkFn = std::function<void(const ChunkView&)>;
+
+		World();
+		~World();
+
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		Entity Create();
+
+		template<typename... Ts>
+		Entity Create(Ts&&... components) {
+			static_assert(sizeof...(Ts) > 0);
+
+			Archetype* archetype;
+			u32 chunkIndex, row;
+			Entity entity = CreateInArchetype(MaskOf<std::decay_t<Ts>...>(), sizeof...(Ts), archetype, chunkIndex, row);
+
+			const Chunk& chunk = archetype->mChunks[chunkIndex];
+			(new (archetype->Column(chunk, ComponentId<std::decay_t<Ts>>()) + row * sizeof(std::decay_t<Ts>))
+				std::decay_t<Ts>(std::forward<Ts>(components)), ...);
+
+			return entity;
+		}
+
+		void Destroy(Entity entity);
+		bool IsAlive(Entity entity) const;
+
+		// Replaces the component if the entity already has one
+		template<typename T>
+		T& Add(Entity entity, T component = T()) {
+			if (T* existing = Get<T>(entity)) {
+				*existing = std::move(component);
+				return *existing;
+			}
+
+			void* slot = ChangeArchetype(entity, ComponentId<T>(), true);
+			return *new (slot) T(std::move(component));
+		}
+
+		template<typename T>
+		void Remove(Entity entity) {
+			if (Has<T>(entity)) {
+				ChangeArchetype(entity, ComponentId<T>(), false);
+			}
+		}
+
+		// nullptr if the entity is stale or doesn't have the component. The pointer is valid until
+		// the next structural change.
+		template<typename T>
+		T* Get(Entity entity) const {
+			return (T*)GetComponent(entity, ComponentId<T>());
+		}
+
+		template<typename T>
+		bool Has(Entity entity) const {
+			return GetComponent(entity, ComponentId<T>()) != nullptr;
+		}
+
+		// Calls fn(Ts&...) for every entity that has all of Ts, declare read only components const
+		template<typename... Ts, typename Fn>
+		void Each(Fn&& fn) {
+			EachChunk<Ts...>([&fn] (const ChunkView& chunk) {
+				chunk.ForEach<Ts...>(fn);
+			});
+		}
+
+		// Calls fn(chunk) for every chunk of the archetypes that have all of Ts
+		template<typename... Ts, typename Fn>
+		void EachChunk(Fn&& fn) {
+			mIterating++;
+			for (Archetype* archetype : Match(MaskOf<Ts...>())) {
+				for (const Chunk& chunk : archetype->mChunks) {
+					fn(ChunkView(*archetype, chunk));
+				}
+			}
+			mIterating--;
+		}
+
+		// Each with the chunks split over the job system, fn is called from several threads at once
+		template<typename... Ts, typename Fn>
+		void ParallelEach(Fn&& fn) {
+			ParallelForChunks(MaskOf<Ts...>(), [&fn] (const ChunkView& chunk) {
+				chunk.ForEach<Ts...>(fn);
+			});
+		}
+
+		void ParallelForChunks(ComponentMask required, const ChunkFn& fn);
+
+		// Archetypes with every component in required. Cached per mask and only extended
+		// with archetypes created since the last call.
+		const std::vector<Archetype*>& Match(ComponentMask required);
+
+		size_t EntityCount() const { return mRecords.size() - mFreeIndices.size(); }
+		size_t ArchetypeCount() const { return mArchetypes.size(); }
+	private:
+		friend class SystemScheduler;
+
+		struct EntityRecord {
+			Archetype* archetype = nullptr;
+			u32 chunk = 0;
+			u32 row = 0;
+			u32 generation = 1;
+		};
+
+		struct QueryCache {
+			std::vector<Archetype*> archetypes;
+			size_t scanned = 0;
+		};
+
+		Archetype* GetArchetype(ComponentMask mask);
+		// componentCount is only there to catch a component type passed twice
+		Entity CreateInArchetype(ComponentMask mask, u32 componentCount, Archetype*& archetype, u32& chunkIndex, u32& row);
+		void* GetComponent(Entity entity, u32 componentId) const;
+		const EntityRecord* Record(Entity entity) const;
+
+		// Moves the entity to the archetype with the component added or removed. Returns the
+		// uninitialized slot for an added component, a removed one is destroyed.
+		void* ChangeArchetype(Entity entity, u32 componentId, bool add);
+	private:
+		std::vector<EntityRecord> mRecords;
+		std::vector<u32> mFreeIndices;
+
+		std::unordered_map<ComponentMask, Scope<Archetype>> mArchetypeByMask;
+		std::vector<Archetype*> mArchetypes;
+		std::unordered_map<ComponentMask, QueryCache> mQueries;
+
+		u32 mIterating = 0;
+	};
+
+	//-------------------------------------------------------------------------
+	//
+	// Systems
+	//
+	//-------------------------------------------------------------------------
+
+	// Runs systems over a world's chunks on the job system.
+	//
+	// Each system declares the components it touches as template arguments, const for reads.
+	// Systems are grouped into stages in the order they're added: a system goes in the stage after
+	// the last earlier system it conflicts with (one writes a component the other reads or writes),
+	// so conflicting systems keep their order and everything else runs side by side. All chunks of
+	// all systems in a stage are dispatched together.
+	class RWD_API SystemScheduler {
+	public:
+		// fn(Ts&...) per entity
+		template<typename... Ts, typename Fn>
+		void Add(const std::string& name, Fn fn) {
+			AddChunkSystem<Ts...>(name, [fn] (const ChunkView& chunk) {
+				chunk.ForEach<Ts...>(fn);
+			});
+		}
+
+		// fn(chunk) per chunk, for systems that work on whole arrays
+		template<typename... Ts, typename Fn>
+		void AddChunkSystem(const std::string& name, Fn fn) {
+			AddSystem(name, MaskOf<Ts...>(), WriteMaskOf<Ts...>(), World::ChunkFn(std::move(fn)));
+		}
+
+		void Run(World& world);
+
+		u32 StageCount() const { return mStageCount; }
+		void LogStages() const;
+	private:
+		struct System {
+			std::string name;
+			ComponentMask required;
+			ComponentMask writes;
+			World::ChunkFn fn;
+			u32 stage;
+		};
+
+		struct ChunkTask {
+			const System* system;
+			const Archetype* archetype;
+			const Chunk* chunk;
+		};
+
+		void AddSystem(const std::string& name, ComponentMask required, ComponentMask writes, World::ChunkFn fn);
+	private:
+		std::vector<System> mSystems;
+		std::vector<ChunkTask> mTasks;
+		u32 mStageCount = 0;
+	};
+
+}
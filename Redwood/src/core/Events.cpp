@@ -0,0 +1,26 @@
+#include "pch.h"
+#include "Events.h"
+
+namespace rwd {
+
+	// Channels are globals, so the list has to exist before the first of them is constructed
+	static std::vector<EventQueue*>& EventQueues() {
+		static std::vector<EventQueue*> queues;
+		return queues;
+	}
+
+	EventQueue::EventQueue() {
+		EventQueues().push_back(this);
+	}
+
+	EventQueue::~EventQueue() {
+		std::erase(EventQueues(), this);
+	}
+
+	void DeliverQueuedEvents() {
+		for (EventQueue* queue : EventQueues()) {
+			queue->Deliver();
+		}
+	}
+
+}
@@ -1,53 +1,187 @@
 #pragma once
 #include "pch.h"
+#include <atomic>
+#include <span>
+#include <type_traits>
 #include "Core.h"
+#include "Delegate.h"
 
 namespace rwd {
 
-	#define BIND_EVENT_FN(fn) std::bind(&fn, this, std::placeholders::_1)
+	// Channels with a queue, so DeliverQueuedEvents can reach all of them
+	class RWD_API EventQueue {
+	public:
+		EventQueue();
+		virtual ~EventQueue();
+
+		virtual void Deliver() = 0;
+	};
 
-	class Event { };
+	// Delivers everything posted to every channel, call once per frame on the thread running frames
+	RWD_API void DeliverQueuedEvents();
 
+	// Subscribers to one type of event, the type is the channel so there's nothing to cast.
+	//
+	// Dispatch calls the subscribers right away, on the calling thread. Post queues the event for
+	// the next delivery instead, and can be called from any number of threads at once without
+	// locking. Delivery hands every subscriber all the events queued since the last one in a row,
+	// and batch subscribers get them as a single span, e.g. to act only on the last resize.
+	//
+	// Subscribing, dispatching and delivering are for the thread running frames. Subscribers are
+	// delegates, so neither subscribing nor sending events allocates once the channel is set up.
 	template<typename T>
-	class EventHandler {
+	class EventChannel : public EventQueue {
 	public:
+		using Callback = Delegate<void(const T&)>;
+		using BatchCallback = Delegate<void(std::span<const T>)>;
 
-		using CallbackFn = std::function<void(T&)>;
+		static_assert(std::is_trivially_copyable_v<T>, "Events are copied through the queue, keep them plain data");
 
-		void Subscribe(CallbackFn callback) {
-			callbacks.push_back(callback);
+		// Posts beyond the capacity before the next delivery are dropped, it's rounded up to a power of 2
+		explicit EventChannel(u32 queueCapacity = 256) {
+			u32 capacity = 1;
+			while (capacity < queueCapacity) {
+				capacity <<= 1;
+			}
+
+			mCells = MakeScope<Cell[]>(capacity);
+			mMask = capacity - 1;
+			for (u32 i = 0; i < capacity; i++) {
+				mCells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+			mBatch.reserve(capacity);
 		}
 
-		void Dispatch(const Event& event) const {
-			for (const auto& callback : callbacks) {
-				callback(*(T*)&event);
+		void Subscribe(Callback callback) { mCallbacks.push_back(callback); }
+		void SubscribeBatch(BatchCallback callback) { mBatchCallbacks.push_back(callback); }
+
+		// channel.Subscribe<&Class::OnEvent>(this)
+		template<auto Method, typename C>
+		void Subscribe(C* instance) { Subscribe(Callback::template Bind<Method>(instance)); }
+
+		template<auto Method, typename C>
+		void SubscribeBatch(C* instance) { SubscribeBatch(BatchCallback::template Bind<Method>(instance)); }
+
+		void Unsubscribe(Callback callback) { std::erase(mCallbacks, callback); }
+		void UnsubscribeBatch(BatchCallback callback) { std::erase(mBatchCallbacks, callback); }
+
+		template<auto Method, typename C>
+		void Unsubscribe(C* instance) { Unsubscribe(Callback::template Bind<Method>(instance)); }
+
+		template<auto Method, typename C>
+		void UnsubscribeBatch(C* instance) { UnsubscribeBatch(BatchCallback::template Bind<Method>(instance)); }
+
+		void Dispatch(const T& event) const {
+			// Indexed, subscribing from a callback mustn't invalidate the loop
+			for (size_t i = 0; i < mCallbacks.size(); i++) {
+				mCallbacks[i](event);
+			}
+
+			for (size_t i = 0; i < mBatchCallbacks.size(); i++) {
+				mBatchCallbacks[i](std::span<const T>(&event, 1));
 			}
 		}
 
+		// Returns false when the queue is full and the event was dropped
+		bool Post(const T& event) {
+			u32 position = mEnqueuePosition.load(std::memory_order_relaxed);
+			Cell* cell;
+
+			// Bounded queue after Vyukov, each cell's sequence says whose turn it is
+			while (true) {
+				cell = &mCells[position & mMask];
+				u32 sequence = cell->sequence.load(std::memory_order_acquire);
+				i32 difference = (i32)(sequence - position);
+
+				if (difference == 0) {
+					if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (difference < 0) {
+					mDropped.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				} else {
+					position = mEnqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+
+			cell->event = event;
+			cell->sequence.store(position + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Events posted by the callbacks themselves wait for the next delivery
+		void Deliver() override {
+			mBatch.clear();
+
+			while (true) {
+				Cell& cell = mCells[mDequeuePosition & mMask];
+				if (cell.sequence.load(std::memory_order_acquire) != mDequeuePosition + 1) {
+					break;
+				}
+
+				mBatch.push_back(cell.event);
+				cell.sequence.store(mDequeuePosition + mMask + 1, std::memory_order_release);
+				mDequeuePosition++;
+			}
+
+			if (mBatch.empty()) {
+				return;
+			}
+
+			for (size_t i = 0; i < mCallbacks.size(); i++) {
+				Callback callback = mCallbacks[i];
+				for (const T& event : mBatch) {
+					callback(event);
+				}
+			}
+
+			for (size_t i = 0; i < mBatchCallbacks.size(); i++) {
+				mBatchCallbacks[i](std::span<const T>(mBatch));
+			}
+		}
+
+		u32 DroppedCount() const { return mDropped.load(std::memory_order_relaxed); }
+	private:
+		struct Cell {
+			std::atomic<u32> sequence;
+			T event;
+		};
 	private:
-		std::vector<CallbackFn> callbacks;
+		std::vector<Callback> mCallbacks;
+		std::vector<BatchCallback> mBatchCallbacks;
+
+		Scope<Cell[]> mCells;
+		u32 mMask = 0;
+
+		// Producers share the enqueue position, only the delivering thread touches the dequeue one
+		alignas(64) std::atomic<u32> mEnqueuePosition { 0 };
+		alignas(64) u32 mDequeuePosition = 0;
+
+		std::vector<T> mBatch;
+		std::atomic<u32> mDropped { 0 };
 	};
 
 	//-------------------------------------------------------------------------
 	//
-	// Window Event Classes
+	// Window Events
 	//
 	//-------------------------------------------------------------------------
 
-	class WindowResizeEvent : public Event {
-	public:
+	struct WindowResizeEvent {
 		i32 width, height;
 	};
 
-	class WindowCloseEvent : public Event { };
+	struct WindowCloseEvent { };
 
 	//-------------------------------------------------------------------------
 	//
-	// Event Handlers
+	// Event Channels
 	//
 	//-------------------------------------------------------------------------
 
-	inline EventHandler<WindowResizeEvent> windowResizeEventHandler;
-	inline EventHandler<WindowCloseEvent> windowCloseEventHandler;
+	inline EventChannel<WindowResizeEvent> windowResizeEvents;
+	inline EventChannel<WindowCloseEvent> windowCloseEvents;
 
 }
@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "Log.h"
+#include "FileWatcher.h"
+
+#ifdef __linux__
+	#include <unistd.h>
+	#include <sys/inotify.h>
+#endif
+
+namespace rwd {
+
+	// How often modification times are checked where there's no change notification
+	const std::chrono::milliseconds POLL_INTERVAL(500);
+
+	// Directory and file name joined the same way inotify's events are, so they compare equal
+	static std::string WatchKey(const std::filesystem::path& path) {
+		return path.parent_path().string() + "/" + path.filename().string();
+	}
+
+	static std::filesystem::file_time_type WriteTime(const std::string& filepath) {
+		std::error_code error;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(filepath, error);
+		return error ? std::filesystem::file_time_type::min() : time;
+	}
+
+	FileWatcher::FileWatcher() {
+#ifdef __linux__
+		mNotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (mNotifyFd < 0) {
+			RWD_LOG_WARN("inotify is unavailable, falling back to polling for file changes");
+		}
+#endif
+	}
+
+	FileWatcher::~FileWatcher() {
+#ifdef __linux__
+		if (mNotifyFd >= 0) {
+			close(mNotifyFd);
+		}
+#endif
+	}
+
+	void FileWatcher::Watch(const std::string& filepath) {
+		std::filesystem::path path(filepath);
+		std::string key = WatchKey(path);
+
+		for (const WatchedFile& file : mFiles) {
+			if (file.key == key) {
+				return;
+			}
+		}
+
+		mFiles.push_back(WatchedFile { .filepath = filepath, .key = key, .writeTime = WriteTime(filepath) });
+
+#ifdef __linux__
+		if (mNotifyFd < 0) {
+			return;
+		}
+
+		// Editors often save by writing a new file and renaming it over the old one, which a watch
+		// on the file itself would lose track of, so the directory is watched instead
+		std::string directory = path.parent_path().string();
+		for (const auto& [wd, watchedDirectory] : mWatchDirectories) {
+			if (watchedDirectory == directory) {
+				return;
+			}
+		}
+
+		i32 wd = inotify_add_watch(mNotifyFd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd < 0) {
+			RWD_LOG_WARN("Failed to watch {0} for changes", directory);
+			return;
+		}
+
+		mWatchDirectories[wd] = directory;
+#endif
+	}
+
+	void FileWatcher::Poll(std::vector<std::string>& changed) {
+		size_t firstChanged = changed.size();
+		auto addChanged = [&changed, firstChanged] (const std::string& filepath) {
+			if (std::find(changed.begin() + firstChanged, changed.end(), filepath) == changed.end()) {
+				changed.push_back(filepath);
+			}
+		};
+
+#ifdef __linux__
+		if (mNotifyFd >= 0) {
+			alignas(inotify_event) char buffer[4096];
+
+			while (true) {
+				ssize_t size = read(mNotifyFd, buffer, sizeof(buffer));
+				if (size <= 0) {
+					break;
+				}
+
+				for (char* cursor = buffer; cursor < buffer + size; ) {
+					const inotify_event* event = (const inotify_event*)cursor;
+					cursor += sizeof(inotify_event) + event->len;
+
+					auto directory = mWatchDirectories.find(event->wd);
+					if (event->len == 0 || directory == mWatchDirectories.end()) {
+						continue;
+					}
+
+					std::string key = directory->second + "/" + event->name;
+					for (const WatchedFile& file : mFiles) {
+						if (file.key == key) {
+							addChanged(file.filepath);
+						}
+					}
+				}
+			}
+
+			return;
+		}
+#endif
+
+		auto now = std::chrono::steady_clock::now();
+		if (now - mLastPoll < POLL_INTERVAL) {
+			return;
+		}
+		mLastPoll = now;
+
+		for (WatchedFile& file : mFiles) {
+			std::filesystem::file_time_type writeTime = WriteTime(file.filepath);
+			if (writeTime != file.writeTime) {
+				file.writeTime = writeTime;
+				addChanged(file.filepath);
+			}
+		}
+	}
+
+}
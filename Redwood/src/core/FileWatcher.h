@@ -0,0 +1,43 @@
+#pragma once
+#include "pch.h"
+#include <chrono>
+#include <filesystem>
+#include "Core.h"
+
+namespace rwd {
+
+	// Reports files on disk that have been written since the last poll.
+	//
+	// On Linux the directories holding the files are watched with inotify, which only reports
+	// once a writer closes the file, so a file is never picked up half written. Elsewhere the
+	// modification times are checked a couple of times a second. Either way Poll doesn't block,
+	// so it can run every frame.
+	class RWD_API FileWatcher {
+	public:
+		FileWatcher();
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		void Watch(const std::string& filepath);
+
+		// Appends the watched files that changed as they were passed to Watch, each once however
+		// often it was written
+		void Poll(std::vector<std::string>& changed);
+	private:
+		struct WatchedFile {
+			std::string filepath;
+			std::string key; // Directory and file name joined the way inotify reports them
+			std::filesystem::file_time_type writeTime;
+		};
+
+		std::vector<WatchedFile> mFiles;
+		std::chrono::steady_clock::time_point mLastPoll;
+
+		// inotify descriptor and the directory each watch descriptor is on
+		i32 mNotifyFd = -1;
+		std::unordered_map<i32, std::string> mWatchDirectories;
+	};
+
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include "pch.h"
+#include <atomic>
+#include <chrono>
+#include "Core.h"
+
+namespace rwd {
+
+	// Smoothed over roughly the last second
+	struct FramePipelineStats {
+		f64 buildMs = 0.0;        // BeginFrame to SubmitFrame on the producer
+		f64 queuedMs = 0.0;       // Submitted, waiting for the consumer
+		f64 consumeMs = 0.0;      // AcquireFrame to ReleaseFrame on the consumer
+		f64 latencyMs = 0.0;      // BeginFrame to ReleaseFrame, how old a frame is once it's done
+		f64 producerWaitMs = 0.0; // Producer blocked on a free packet, the consumer is the bottleneck
+		f64 consumerWaitMs = 0.0; // Consumer blocked on a submitted packet, the producer is the bottleneck
+		f64 framesPerSecond = 0.0;
+	};
+
+	// Hands frames from one stage to the next through a fixed set of packets.
+	//
+	// The producer fills a packet and submits it, the consumer works from it and releases it back.
+	// A submitted packet belongs to the consumer until released, so the producer can build the next
+	// frame while the consumer works on this one without sharing anything. With a depth of 1 the
+	// producer can be one frame ahead, the classic two stage pipeline, a depth of 2 allows a third
+	// frame in between for a three stage pipeline. When it's that far ahead BeginFrame blocks,
+	// which bounds the latency the pipeline adds.
+	//
+	// The packet rings are single producer, single consumer and lock free. Waiting uses
+	// std::atomic wait and notify rather than spinning.
+	template<typename Packet>
+	class FramePipeline {
+	public:
+		explicit FramePipeline(u32 depth = 1) : mSlots(depth + 1) {
+			// One ring entry more than packets, room for the shutdown marker with every packet queued
+			const u32 capacity = (u32)mSlots.size() + 1;
+			mFree.entries.resize(capacity);
+			mReady.entries.resize(capacity);
+
+			for (u32 i = 0; i < mSlots.size(); i++) {
+				mFree.Push(i);
+			}
+		}
+
+		//---------------------------------------------------------------------
+		// Producer
+		//---------------------------------------------------------------------
+
+		// Waits for a packet the consumer is done with. It holds an old frame, reset what you use.
+		Packet& BeginFrame() {
+			f64 waitStart = Now();
+			mBuilding = mFree.Pop();
+			f64 now = Now();
+
+			Smooth(mStats.producerWaitMs, (now - waitStart) * 1000.0);
+			mSlots[mBuilding].beginTime = now;
+			return mSlots[mBuilding].packet;
+		}
+
+		void SubmitFrame() {
+			Slot& slot = mSlots[mBuilding];
+			slot.submitTime = Now();
+			Smooth(mStats.buildMs, (slot.submitTime - slot.beginTime) * 1000.0);
+
+			mReady.Push(mBuilding);
+		}
+
+		// Tells the consumer to stop once it has worked through the submitted frames
+		void Shutdown() {
+			mReady.Push(SHUTDOWN);
+		}
+
+		//---------------------------------------------------------------------
+		// Consumer
+		//---------------------------------------------------------------------
+
+		// Waits for the next submitted packet, nullptr once the producer has shut down
+		const Packet* AcquireFrame() {
+			f64 waitStart = Now();
+			u32 index = mReady.Pop();
+			f64 now = Now();
+
+			if (index == SHUTDOWN) {
+				return nullptr;
+			}
+
+			Smooth(mStats.consumerWaitMs, (now - waitStart) * 1000.0);
+
+			Slot& slot = mSlots[index];
+			slot.acquireTime = now;
+			Smooth(mStats.queuedMs, (now - slot.submitTime) * 1000.0);
+
+			mConsuming = index;
+			return &slot.packet;
+		}
+
+		void ReleaseFrame() {
+			Slot& slot = mSlots[mConsuming];
+			f64 now = Now();
+
+			Smooth(mStats.consumeMs, (now - slot.acquireTime) * 1000.0);
+			Smooth(mStats.latencyMs, (now - slot.beginTime) * 1000.0);
+			if (mLastRelease > 0.0) {
+				Smooth(mStats.framesPerSecond, 1.0 / std::max(now - mLastRelease, 1e-9));
+			}
+			mLastRelease = now;
+
+			mFree.Push(mConsuming);
+		}
+
+		// Read from either side, each value is written by one side and may be a frame stale
+		FramePipelineStats Stats() const {
+			FramePipelineStats stats;
+			stats.buildMs = mStats.buildMs.load(std::memory_order_relaxed);
+			stats.queuedMs = mStats.queuedMs.load(std::memory_order_relaxed);
+			stats.consumeMs = mStats.consumeMs.load(std::memory_order_relaxed);
+			stats.latencyMs = mStats.latencyMs.load(std::memory_order_relaxed);
+			stats.producerWaitMs = mStats.producerWaitMs.load(std::memory_order_relaxed);
+			stats.consumerWaitMs = mStats.consumerWaitMs.load(std::memory_order_relaxed);
+			stats.framesPerSecond = mStats.framesPerSecond.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		u32 Depth() const { return (u32)mSlots.size() - 1; }
+	private:
+		static const u32 SHUTDOWN = ~0u;
+
+		struct Slot {
+			Packet packet { };
+
+			// Written by whichever side owns the packet at the time, the ring handoff orders them
+			f64 beginTime = 0.0;
+			f64 submitTime = 0.0;
+			f64 acquireTime = 0.0;
+		};
+
+		// Single producer single consumer ring of packet indices. It can't overflow, there are
+		// never more indices in flight than entries.
+		struct Ring {
+			std::vector<u32> entries;
+			alignas(64) std::atomic<u32> head { 0 };
+			alignas(64) std::atomic<u32> tail { 0 };
+
+			void Push(u32 index) {
+				u32 position = tail.load(std::memory_order_relaxed);
+				entries[position % entries.size()] = index;
+				tail.store(position + 1, std::memory_order_release);
+				tail.notify_one();
+			}
+
+			u32 Pop() {
+				u32 position = head.load(std::memory_order_relaxed);
+				u32 end = tail.load(std::memory_order_acquire);
+				while (end == position) {
+					tail.wait(end, std::memory_order_acquire);
+					end = tail.load(std::memory_order_acquire);
+				}
+
+				u32 index = entries[position % entries.size()];
+				head.store(position + 1, std::memory_order_relaxed);
+				return index;
+			}
+		};
+
+		struct AtomicStats {
+			std::atomic<f64> buildMs { 0.0 };
+			std::atomic<f64> queuedMs { 0.0 };
+			std::atomic<f64> consumeMs { 0.0 };
+			std::atomic<f64> latencyMs { 0.0 };
+			std::atomic<f64> producerWaitMs { 0.0 };
+			std::atomic<f64> consumerWaitMs { 0.0 };
+			std::atomic<f64> framesPerSecond { 0.0 };
+		};
+
+		static f64 Now() {
+			using Clock = std::chrono::steady_clock;
+			return std::chrono::duration<f64>(Clock::now().time_since_epoch()).count();
+		}
+
+		// Only ever written by one side, so a load and store is enough
+		static void Smooth(std::atomic<f64>& average, f64 sample) {
+			f64 value = average.load(std::memory_order_relaxed);
+			average.store(value + (sample - value) / 60.0, std::memory_order_relaxed);
+		}
+	private:
+		std::vector<Slot> mSlots;
+		Ring mFree;
+		Ring mReady;
+		AtomicStats mStats;
+
+		u32 mBuilding = 0;  // Producer only
+		u32 mConsuming = 0; // Consumer only
+		f64 mLastRelease = 0.0;
+	};
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string_view>
+#include "Core.h"
+
+namespace rwd {
+
+	const u64 FNV_OFFSET_BASIS = 0xCBF29CE484222325ull;
+	const u64 FNV_PRIME = 0x100000001B3ull;
+
+	// 64 bit FNV-1a, fast for the short keys (paths, names) we hash and stable across runs,
+	// so hashes can be written into asset files
+	inline u64 HashBytes(const void* data, size_t size, u64 seed = FNV_OFFSET_BASIS) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		u64 hash = seed;
+
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= FNV_PRIME;
+		}
+
+		return hash;
+	}
+
+	inline u64 HashString(std::string_view string, u64 seed = FNV_OFFSET_BASIS) {
+		return HashBytes(string.data(), string.size(), seed);
+	}
+
+}
@@ -0,0 +1,357 @@
+#include "pch.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "SDL.h"
+#include "Input.h"
+
+namespace rwd {
+
+	// Enough for a few frames of a 8000 Hz mouse
+	const u32 EVENT_RING_SIZE = 4096;
+	const u32 EVENT_RING_MASK = EVENT_RING_SIZE - 1;
+
+	// Weight of each new sample in the smoothed stats, about a second's worth of samples at 60 a second
+	const f64 STATS_SMOOTHING = 1.0 / 60.0;
+
+	// Input as it is right now, written by the thread pumping events. The pressed and released edges,
+	// deltas and wheel accumulate until BeginFrame takes them.
+	struct LiveState {
+		std::atomic<u64> keysDown[INPUT_KEY_WORDS];
+		std::atomic<u64> keysPressed[INPUT_KEY_WORDS];
+		std::atomic<u64> keysReleased[INPUT_KEY_WORDS];
+
+		std::atomic<u32> buttonsDown;
+		std::atomic<u32> buttonsPressed;
+		std::atomic<u32> buttonsReleased;
+
+		std::atomic<i32> mouseX, mouseY;
+		std::atomic<i32> mouseDeltaX, mouseDeltaY;
+		std::atomic<i32> wheelX, wheelY;
+	};
+
+	// The frame's snapshot, word by word so single queries are one load. Snapshot reads all of it
+	// under the sequence count, which is odd while BeginFrame is writing.
+	struct PublishedState {
+		std::atomic<u64> keysDown[INPUT_KEY_WORDS];
+		std::atomic<u64> keysPressed[INPUT_KEY_WORDS];
+		std::atomic<u64> keysReleased[INPUT_KEY_WORDS];
+
+		std::atomic<u32> buttonsDown;
+		std::atomic<u32> buttonsPressed;
+		std::atomic<u32> buttonsReleased;
+
+		std::atomic<i32> mouseX, mouseY;
+		std::atomic<i32> mouseDeltaX, mouseDeltaY;
+		std::atomic<i32> wheelX, wheelY;
+
+		std::atomic<u64> frame;
+		std::atomic<u32> sequence;
+	};
+
+	static LiveState live;
+	static PublishedState published;
+
+	// Single producer single consumer, the pumping thread pushes and BeginFrame drains
+	static InputEvent eventRing[EVENT_RING_SIZE];
+	alignas(64) static std::atomic<u32> ringHead { 0 };
+	alignas(64) static std::atomic<u32> ringTail { 0 };
+	static std::atomic<u32> droppedEvents { 0 };
+
+	// Only touched by the thread running frames
+	static std::vector<InputEvent> frameEvents;
+	static u64 frameIndex = 0;
+	static u64 frameStartNs = 0;
+	static u64 frameEventAgeSum = 0; // Nanoseconds each event was old at the start of the frame
+	static u64 frameOldestEventNs = 0;
+	static bool frameLatencyPending = false;
+	static InputStats stats;
+
+	static u64 NowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static void Smooth(f64& average, f64 sample) {
+		average += (sample - average) * STATS_SMOOTHING;
+	}
+
+	static void PushEvent(const InputEvent& event) {
+		u32 tail = ringTail.load(std::memory_order_relaxed);
+		if (tail - ringHead.load(std::memory_order_acquire) == EVENT_RING_SIZE) {
+			droppedEvents.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		eventRing[tail & EVENT_RING_MASK] = event;
+		ringTail.store(tail + 1, std::memory_order_release);
+	}
+
+	static bool TestBit(const std::atomic<u64>* words, u32 key) {
+		if (key >= INPUT_KEY_COUNT) {
+			return false;
+		}
+
+		return (words[key / 64].load(std::memory_order_relaxed) >> (key % 64)) & 1;
+	}
+
+	static bool TestButton(const std::atomic<u32>& buttons, MouseButton button) {
+		return (buttons.load(std::memory_order_relaxed) >> (u32)button) & 1;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Queries
+	//
+	//-------------------------------------------------------------------------
+
+	bool Input::IsKeyDown(u32 key) {
+		return TestBit(published.keysDown, key);
+	}
+
+	bool Input::WasKeyPressed(u32 key) {
+		return TestBit(published.keysPressed, key);
+	}
+
+	bool Input::WasKeyReleased(u32 key) {
+		return TestBit(published.keysReleased, key);
+	}
+
+	bool Input::IsButtonDown(MouseButton button) {
+		return TestButton(published.buttonsDown, button);
+	}
+
+	bool Input::WasButtonPressed(MouseButton button) {
+		return TestButton(published.buttonsPressed, button);
+	}
+
+	bool Input::WasButtonReleased(MouseButton button) {
+		return TestButton(published.buttonsReleased, button);
+	}
+
+	void Input::MousePosition(i32& x, i32& y) {
+		x = published.mouseX.load(std::memory_order_relaxed);
+		y = published.mouseY.load(std::memory_order_relaxed);
+	}
+
+	void Input::MouseDelta(i32& x, i32& y) {
+		x = published.mouseDeltaX.load(std::memory_order_relaxed);
+		y = published.mouseDeltaY.load(std::memory_order_relaxed);
+	}
+
+	void Input::WheelDelta(i32& x, i32& y) {
+		x = published.wheelX.load(std::memory_order_relaxed);
+		y = published.wheelY.load(std::memory_order_relaxed);
+	}
+
+	InputSnapshot Input::Snapshot() {
+		InputSnapshot snapshot;
+
+		while (true) {
+			u32 sequence = published.sequence.load(std::memory_order_acquire);
+			if (sequence & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			for (u32 i = 0; i < INPUT_KEY_WORDS; i++) {
+				snapshot.keysDown[i] = published.keysDown[i].load(std::memory_order_relaxed);
+				snapshot.keysPressed[i] = published.keysPressed[i].load(std::memory_order_relaxed);
+				snapshot.keysReleased[i] = published.keysReleased[i].load(std::memory_order_relaxed);
+			}
+
+			snapshot.buttonsDown = published.buttonsDown.load(std::memory_order_relaxed);
+			snapshot.buttonsPressed = published.buttonsPressed.load(std::memory_order_relaxed);
+			snapshot.buttonsReleased = published.buttonsReleased.load(std::memory_order_relaxed);
+			snapshot.mouseX = published.mouseX.load(std::memory_order_relaxed);
+			snapshot.mouseY = published.mouseY.load(std::memory_order_relaxed);
+			snapshot.mouseDeltaX = published.mouseDeltaX.load(std::memory_order_relaxed);
+			snapshot.mouseDeltaY = published.mouseDeltaY.load(std::memory_order_relaxed);
+			snapshot.wheelX = published.wheelX.load(std::memory_order_relaxed);
+			snapshot.wheelY = published.wheelY.load(std::memory_order_relaxed);
+			snapshot.frame = published.frame.load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (published.sequence.load(std::memory_order_relaxed) == sequence) {
+				return snapshot;
+			}
+		}
+	}
+
+	std::span<const InputEvent> Input::FrameEvents() {
+		return frameEvents;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Sampling
+	//
+	//-------------------------------------------------------------------------
+
+	void Input::ProcessEvent(const SDL_Event& sdlEvent) {
+		// SDL stamps events in milliseconds when it receives them, move that onto our clock
+		u32 ageMs = SDL_GetTicks() - sdlEvent.common.timestamp;
+		InputEvent event { .timeNs = NowNs() - (u64)ageMs * 1000000 };
+
+		switch (sdlEvent.type) {
+			case(SDL_KEYDOWN):case(SDL_KEYUP): {
+				u32 key = sdlEvent.key.keysym.scancode;
+				if (sdlEvent.key.repeat || key >= INPUT_KEY_COUNT) {
+					return;
+				}
+
+				u64 bit = 1ull << (key % 64);
+				if (sdlEvent.type == SDL_KEYDOWN) {
+					live.keysDown[key / 64].fetch_or(bit, std::memory_order_relaxed);
+					live.keysPressed[key / 64].fetch_or(bit, std::memory_order_relaxed);
+					event.type = InputEventType::KeyDown;
+				} else {
+					live.keysDown[key / 64].fetch_and(~bit, std::memory_order_relaxed);
+					live.keysReleased[key / 64].fetch_or(bit, std::memory_order_relaxed);
+					event.type = InputEventType::KeyUp;
+				}
+
+				event.code = key;
+				break;
+			}
+
+			case(SDL_MOUSEBUTTONDOWN):case(SDL_MOUSEBUTTONUP): {
+				// SDL numbers the buttons from 1 in the same order as MouseButton
+				u32 button = sdlEvent.button.button - 1;
+				if (button > (u32)MouseButton::X2) {
+					return;
+				}
+
+				u32 bit = 1u << button;
+				if (sdlEvent.type == SDL_MOUSEBUTTONDOWN) {
+					live.buttonsDown.fetch_or(bit, std::memory_order_relaxed);
+					live.buttonsPressed.fetch_or(bit, std::memory_order_relaxed);
+					event.type = InputEventType::ButtonDown;
+				} else {
+					live.buttonsDown.fetch_and(~bit, std::memory_order_relaxed);
+					live.buttonsReleased.fetch_or(bit, std::memory_order_relaxed);
+					event.type = InputEventType::ButtonUp;
+				}
+
+				event.code = button;
+				event.x = sdlEvent.button.x;
+				event.y = sdlEvent.button.y;
+				break;
+			}
+
+			case(SDL_MOUSEMOTION): {
+				live.mouseX.store(sdlEvent.motion.x, std::memory_order_relaxed);
+				live.mouseY.store(sdlEvent.motion.y, std::memory_order_relaxed);
+				live.mouseDeltaX.fetch_add(sdlEvent.motion.xrel, std::memory_order_relaxed);
+				live.mouseDeltaY.fetch_add(sdlEvent.motion.yrel, std::memory_order_relaxed);
+
+				event.type = InputEventType::MouseMotion;
+				event.x = sdlEvent.motion.x;
+				event.y = sdlEvent.motion.y;
+				event.deltaX = sdlEvent.motion.xrel;
+				event.deltaY = sdlEvent.motion.yrel;
+				break;
+			}
+
+			case(SDL_MOUSEWHEEL): {
+				i32 sign = sdlEvent.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? -1 : 1;
+				live.wheelX.fetch_add(sdlEvent.wheel.x * sign, std::memory_order_relaxed);
+				live.wheelY.fetch_add(sdlEvent.wheel.y * sign, std::memory_order_relaxed);
+
+				event.type = InputEventType::MouseWheel;
+				event.x = sdlEvent.wheel.x * sign;
+				event.y = sdlEvent.wheel.y * sign;
+				break;
+			}
+
+			default:
+				return;
+		}
+
+		PushEvent(event);
+	}
+
+	void Input::BeginFrame() {
+		// Edges first, a key going down in between is then down without its press until next frame
+		// rather than pressed without being down
+		u64 keysPressed[INPUT_KEY_WORDS];
+		u64 keysReleased[INPUT_KEY_WORDS];
+		for (u32 i = 0; i < INPUT_KEY_WORDS; i++) {
+			keysPressed[i] = live.keysPressed[i].exchange(0, std::memory_order_relaxed);
+			keysReleased[i] = live.keysReleased[i].exchange(0, std::memory_order_relaxed);
+		}
+
+		u32 buttonsPressed = live.buttonsPressed.exchange(0, std::memory_order_relaxed);
+		u32 buttonsReleased = live.buttonsReleased.exchange(0, std::memory_order_relaxed);
+
+		u32 sequence = published.sequence.load(std::memory_order_relaxed);
+		published.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (u32 i = 0; i < INPUT_KEY_WORDS; i++) {
+			published.keysDown[i].store(live.keysDown[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+			published.keysPressed[i].store(keysPressed[i], std::memory_order_relaxed);
+			published.keysReleased[i].store(keysReleased[i], std::memory_order_relaxed);
+		}
+
+		published.buttonsDown.store(live.buttonsDown.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		published.buttonsPressed.store(buttonsPressed, std::memory_order_relaxed);
+		published.buttonsReleased.store(buttonsReleased, std::memory_order_relaxed);
+		published.mouseX.store(live.mouseX.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		published.mouseY.store(live.mouseY.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		published.mouseDeltaX.store(live.mouseDeltaX.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+		published.mouseDeltaY.store(live.mouseDeltaY.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+		published.wheelX.store(live.wheelX.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+		published.wheelY.store(live.wheelY.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+		published.frame.store(frameIndex++, std::memory_order_relaxed);
+
+		published.sequence.store(sequence + 2, std::memory_order_release);
+
+		// Drain the ring, reserved up front so a burst of events never allocates mid frame
+		if (frameEvents.capacity() < EVENT_RING_SIZE) {
+			frameEvents.reserve(EVENT_RING_SIZE);
+		}
+		frameEvents.clear();
+
+		u32 head = ringHead.load(std::memory_order_relaxed);
+		u32 tail = ringTail.load(std::memory_order_acquire);
+		frameStartNs = NowNs();
+		frameEventAgeSum = 0;
+		frameOldestEventNs = frameStartNs;
+
+		for (u32 i = head; i != tail; i++) {
+			const InputEvent& event = eventRing[i & EVENT_RING_MASK];
+			frameEvents.push_back(event);
+
+			frameEventAgeSum += frameStartNs - std::min(event.timeNs, frameStartNs);
+			frameOldestEventNs = std::min(frameOldestEventNs, event.timeNs);
+		}
+
+		ringHead.store(tail, std::memory_order_release);
+		frameLatencyPending = true;
+	}
+
+	void Input::FrameSubmitted() {
+		if (!frameLatencyPending) {
+			return;
+		}
+
+		frameLatencyPending = false;
+		Smooth(stats.eventsPerFrame, (f64)frameEvents.size());
+
+		// Frames without input say nothing about latency
+		if (frameEvents.empty()) {
+			return;
+		}
+
+		f64 sinceFrameStartMs = (NowNs() - frameStartNs) / 1000000.0;
+		Smooth(stats.latencyMs, sinceFrameStartMs + (f64)frameEventAgeSum / frameEvents.size() / 1000000.0);
+		Smooth(stats.worstLatencyMs, sinceFrameStartMs + (frameStartNs - frameOldestEventNs) / 1000000.0);
+	}
+
+	InputStats Input::Stats() {
+		InputStats result = stats;
+		result.droppedEvents = droppedEvents.load(std::memory_order_relaxed);
+		return result;
+	}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "pch.h"
+#include <span>
+#include "Core.h"
+
+union SDL_Event;
+
+namespace rwd {
+
+	// Keys are SDL scancodes, e.g. SDL_SCANCODE_W, so they follow the key's position rather than the layout
+	const u32 INPUT_KEY_COUNT = 512;
+	const u32 INPUT_KEY_WORDS = INPUT_KEY_COUNT / 64;
+
+	enum class MouseButton : u8 {
+		Left,
+		Middle,
+		Right,
+		X1,
+		X2,
+	};
+
+	enum class InputEventType : u8 {
+		KeyDown,
+		KeyUp,
+		ButtonDown,
+		ButtonUp,
+		MouseMotion,
+		MouseWheel,
+	};
+
+	struct InputEvent {
+		u64 timeNs;          // When SDL received it, in nanoseconds on a steady clock
+		InputEventType type;
+		u32 code;            // Scancode or MouseButton
+		i32 x, y;            // Cursor position, or the scroll amount for the wheel
+		i32 deltaX, deltaY;  // Motion since the previous motion event
+	};
+
+	// The state of the keyboard and mouse as of the start of a frame. Pressed and released are edges
+	// since the previous frame, so a key tapped between two frames is pressed and released in the same one.
+	struct InputSnapshot {
+		u64 keysDown[INPUT_KEY_WORDS] = { };
+		u64 keysPressed[INPUT_KEY_WORDS] = { };
+		u64 keysReleased[INPUT_KEY_WORDS] = { };
+
+		u32 buttonsDown = 0;
+		u32 buttonsPressed = 0;
+		u32 buttonsReleased = 0;
+
+		i32 mouseX = 0, mouseY = 0;
+		i32 mouseDeltaX = 0, mouseDeltaY = 0;
+		i32 wheelX = 0, wheelY = 0;
+
+		u64 frame = 0;
+	};
+
+	// Smoothed over roughly the last second
+	struct InputStats {
+		f64 latencyMs = 0.0;      // SDL receiving an event to the frame it went into being submitted, on average
+		f64 worstLatencyMs = 0.0; // The same for the oldest event of each frame
+		f64 eventsPerFrame = 0.0;
+		u32 droppedEvents = 0;    // Events that didn't fit the ring, their state changes still apply
+	};
+
+	// Keyboard and mouse state, sampled once per frame.
+	//
+	// Whichever thread pumps window events feeds SDL events in, updating the live state as they
+	// arrive and appending them to a lock-free ring. BeginFrame takes the live state as the frame's
+	// snapshot and drains the ring, so every query during a frame sees the same input.
+	//
+	// The queries are a single atomic load and can be called from any thread. Snapshot copies the
+	// whole frame consistently.
+	//
+	// The pressed and released edges, deltas and wheel are per frame, not per tick. A frame can run
+	// several ticks or none, so OnTick would see one press several times or not at all. Ticks should
+	// only use the held state (IsKeyDown, IsButtonDown, MousePosition), or take edges in OnRender
+	// and hand them to the simulation themselves.
+	class RWD_API Input {
+	public:
+		static bool IsKeyDown(u32 key);
+		static bool WasKeyPressed(u32 key);
+		static bool WasKeyReleased(u32 key);
+
+		static bool IsButtonDown(MouseButton button);
+		static bool WasButtonPressed(MouseButton button);
+		static bool WasButtonReleased(MouseButton button);
+
+		static void MousePosition(i32& x, i32& y);
+		static void MouseDelta(i32& x, i32& y);
+		static void WheelDelta(i32& x, i32& y);
+
+		static InputSnapshot Snapshot();
+
+		// Every event of the frame in the order they arrived, for input that needs more than one
+		// sample per frame. Only valid on the thread running frames, until the next BeginFrame.
+		static std::span<const InputEvent> FrameEvents();
+
+		// Feeds in an event, from the thread pumping window events. Others are ignored.
+		static void ProcessEvent(const SDL_Event& event);
+
+		// Called by the app on the thread running frames
+		static void BeginFrame();
+		static void FrameSubmitted();
+
+		// On the thread running frames
+		static InputStats Stats();
+	};
+
+}
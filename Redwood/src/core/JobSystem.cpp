@@ -0,0 +1,138 @@
+#include "pch.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include "Log.h"
+#include "JobSystem.h"
+
+namespace rwd {
+
+	struct Job {
+		JobSystem::JobFn fn;
+		std::atomic<u32>* pending;
+	};
+
+	static std::vector<std::thread> workers;
+	static std::deque<Job> jobQueue;
+	static std::mutex queueMutex;
+	static std::condition_variable queueCondition;
+	static bool running = false;
+
+	static bool TryPopJob(Job& job) {
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (jobQueue.empty()) {
+			return false;
+		}
+
+		job = std::move(jobQueue.front());
+		jobQueue.pop_front();
+		return true;
+	}
+
+	static void RunJob(Job& job) {
+		job.fn();
+		job.pending->fetch_sub(1, std::memory_order_release);
+	}
+
+	static void WorkerLoop() {
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, [] { return !jobQueue.empty() || !running; });
+
+				if (!running && jobQueue.empty()) {
+					return;
+				}
+
+				job = std::move(jobQueue.front());
+				jobQueue.pop_front();
+			}
+
+			RunJob(job);
+		}
+	}
+
+	void JobSystem::Init(u32 threadCount) {
+		RWD_ASSERT(!running, "Job system has already been initialized");
+
+		if (threadCount == 0) {
+			u32 hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		running = true;
+		workers.reserve(threadCount);
+		for (u32 i = 0; i < threadCount; i++) {
+			workers.emplace_back(WorkerLoop);
+		}
+
+		RWD_LOG_INFO("Job system started with {0} worker threads", threadCount);
+	}
+
+	void JobSystem::Shutdown() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			running = false;
+		}
+		queueCondition.notify_all();
+
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+	}
+
+	u32 JobSystem::ThreadCount() {
+		return (u32)workers.size();
+	}
+
+	void JobSystem::Execute(JobCounter& counter, JobFn job) {
+		counter.mPending.fetch_add(1, std::memory_order_relaxed);
+
+		// Without any workers we just run the job inline so callers never deadlock
+		if (workers.empty()) {
+			Job inlineJob { std::move(job), &counter.mPending };
+			RunJob(inlineJob);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			jobQueue.push_back({ std::move(job), &counter.mPending });
+		}
+		queueCondition.notify_one();
+	}
+
+	void JobSystem::Dispatch(JobCounter& counter, u32 jobCount, u32 groupSize, const DispatchFn& job) {
+		if (jobCount == 0 || groupSize == 0) {
+			return;
+		}
+
+		u32 groupCount = (jobCount + groupSize - 1) / groupSize;
+
+		for (u32 groupIndex = 0; groupIndex < groupCount; groupIndex++) {
+			Execute(counter, [groupIndex, groupSize, jobCount, job] {
+				u32 begin = groupIndex * groupSize;
+				u32 end = std::min(begin + groupSize, jobCount);
+
+				for (u32 i = begin; i < end; i++) {
+					job(JobArgs { .jobIndex = i, .groupIndex = groupIndex });
+				}
+			});
+		}
+	}
+
+	void JobSystem::Wait(const JobCounter& counter) {
+		while (counter.IsBusy()) {
+			Job job;
+			if (TryPopJob(job)) {
+				RunJob(job);
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "pch.h"
+#include <atomic>
+#include "core/Core.h"
+
+namespace rwd {
+
+	struct JobArgs {
+		u32 jobIndex;   // Index of the job within the whole dispatch
+		u32 groupIndex; // Index of the group the job was batched into
+	};
+
+	// Counts outstanding jobs so callers can wait on a specific batch of work
+	// instead of the whole job system
+	class JobCounter {
+	public:
+		bool IsBusy() const { return mPending.load(std::memory_order_acquire) > 0; }
+	private:
+		friend class JobSystem;
+		std::atomic<u32> mPending { 0 };
+	};
+
+	class JobSystem {
+	public:
+		using JobFn = std::function<void()>;
+		using DispatchFn = std::function<void(JobArgs)>;
+
+		// A thread count of 0 uses one worker per hardware thread minus the main thread
+		static void Init(u32 threadCount = 0);
+		static void Shutdown();
+
+		static u32 ThreadCount();
+
+		// Queue a single job
+		static void Execute(JobCounter& counter, JobFn job);
+
+		// Split jobCount invocations of job into groups of groupSize and run them on the workers
+		static void Dispatch(JobCounter& counter, u32 jobCount, u32 groupSize, const DispatchFn& job);
+
+		// Blocks until every job tracked by the counter has finished.
+		// The calling thread helps drain the queue while it waits.
+		static void Wait(const JobCounter& counter);
+	};
+
+}
@@ -0,0 +1,152 @@
+#include "pch.h"
+#include "Log.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+namespace rwd {
+
+	MappedFile::MappedFile(const std::string& filepath) {
+		Open(filepath);
+	}
+
+	MappedFile::~MappedFile() {
+		Close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			Close();
+			std::swap(mData, other.mData);
+			std::swap(mSize, other.mSize);
+			std::swap(mIsOpen, other.mIsOpen);
+#ifdef _WIN32
+			std::swap(mFileHandle, other.mFileHandle);
+			std::swap(mMappingHandle, other.mMappingHandle);
+#endif
+		}
+		return *this;
+	}
+
+	bool MappedFile::Open(const std::string& filepath) {
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, 
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE) {
+			RWD_LOG_ERROR("Failed to open file {0}", filepath);
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+
+		// Zero sized files can't be mapped, but they are still valid files
+		if (fileSize.QuadPart == 0) {
+			CloseHandle(file);
+			mIsOpen = true;
+			return true;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+		if (view == nullptr) {
+			RWD_LOG_ERROR("Failed to memory map file {0}", filepath);
+			if (mapping) CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		mFileHandle = file;
+		mMappingHandle = mapping;
+		mData = (const u8*)view;
+		mSize = (size_t)fileSize.QuadPart;
+		mIsOpen = true;
+#else
+		int fd = open(filepath.c_str(), O_RDONLY);
+
+		if (fd < 0) {
+			RWD_LOG_ERROR("Failed to open file {0}", filepath);
+			return false;
+		}
+
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0) {
+			RWD_LOG_ERROR("Failed to read the size of file {0}", filepath);
+			close(fd);
+			return false;
+		}
+
+		if (fileStat.st_size == 0) {
+			close(fd);
+			mIsOpen = true;
+			return true;
+		}
+
+		void* view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		// The mapping keeps its own reference to the file
+		close(fd);
+
+		if (view == MAP_FAILED) {
+			RWD_LOG_ERROR("Failed to memory map file {0}", filepath);
+			return false;
+		}
+
+		// Assets are read front to back when uploading, so let the kernel read ahead aggressively
+		madvise(view, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+		madvise(view, (size_t)fileStat.st_size, MADV_WILLNEED);
+
+		mData = (const u8*)view;
+		mSize = (size_t)fileStat.st_size;
+		mIsOpen = true;
+#endif
+
+		return true;
+	}
+
+	void MappedFile::Close() {
+#ifdef _WIN32
+		if (mData) UnmapViewOfFile(mData);
+		if (mMappingHandle) CloseHandle(mMappingHandle);
+		if (mFileHandle) CloseHandle(mFileHandle);
+		mMappingHandle = nullptr;
+		mFileHandle = nullptr;
+#else
+		if (mData) munmap((void*)mData, mSize);
+#endif
+
+		mData = nullptr;
+		mSize = 0;
+		mIsOpen = false;
+	}
+
+	bool MappedFile::IsOpen() const {
+		return mIsOpen;
+	}
+
+	const u8* MappedFile::Data() const {
+		return mData;
+	}
+
+	size_t MappedFile::Size() const {
+		return mSize;
+	}
+
+}
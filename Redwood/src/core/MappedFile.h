@@ -0,0 +1,37 @@
+#pragma once
+#include "pch.h"
+#include "Core.h"
+
+namespace rwd {
+
+	// Read only memory mapping of a whole file. 
+	// Pages are faulted in by the OS on first access, so opening a file costs no reads or copies.
+	class RWD_API MappedFile {
+	public:
+		MappedFile() = default;
+		MappedFile(const std::string& filepath);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		bool Open(const std::string& filepath);
+		void Close();
+
+		bool IsOpen() const;
+		const u8* Data() const;
+		size_t Size() const;
+	private:
+		const u8* mData = nullptr;
+		size_t mSize = 0;
+		bool mIsOpen = false;
+
+#ifdef _WIN32
+		void* mFileHandle = nullptr;
+		void* mMappingHandle = nullptr;
+#endif
+	};
+
+}
@@ -0,0 +1,336 @@
+#include "pch.h"
+#include "lz4.h"
+#include "zstd.h"
+#include "Log.h"
+#include "Hash.h"
+#include "JobSystem.h"
+#include "AsyncIO.h"
+#include "PackFile.h"
+
+namespace rwd {
+
+	// Zstd levels above ~19 get very slow for little gain, packs are built offline but not THAT offline
+	const i32 PACK_ZSTD_LEVEL = 15;
+
+	static size_t CompressBound(PackCodec codec, size_t size) {
+		switch (codec) {
+			case(PackCodec::LZ4):  return (size_t)LZ4_compressBound((i32)size);
+			case(PackCodec::Zstd): return ZSTD_compressBound(size);
+			default:               return size;
+		}
+	}
+
+	// Returns the compressed size, or 0 if the codec failed
+	static size_t CompressBlock(PackCodec codec, const u8* src, size_t srcSize, u8* dst, size_t dstCapacity) {
+		switch (codec) {
+			case(PackCodec::LZ4): {
+				i32 result = LZ4_compress_default(src, dst, (i32)srcSize, (i32)dstCapacity);
+				return result > 0 ? (size_t)result : 0;
+			}
+			case(PackCodec::Zstd): {
+				size_t result = ZSTD_compress(dst, dstCapacity, src, srcSize, PACK_ZSTD_LEVEL);
+				return ZSTD_isError(result) ? 0 : result;
+			}
+			default:
+				return 0;
+		}
+	}
+
+	static bool DecompressBlock(PackCodec codec, const u8* src, size_t srcSize, u8* dst, size_t dstSize) {
+		// Blocks which didn't compress are stored raw
+		if (srcSize == dstSize) {
+			memcpy(dst, src, dstSize);
+			return true;
+		}
+
+		switch (codec) {
+			case(PackCodec::LZ4):
+				return LZ4_decompress_safe(src, dst, (i32)srcSize, (i32)dstSize) == (i32)dstSize;
+			case(PackCodec::Zstd):
+				return ZSTD_decompress(dst, dstSize, src, srcSize) == dstSize;
+			default:
+				return false;
+		}
+	}
+
+	// Rounded up without adding first so it can't wrap on a corrupt size
+	static u64 BlockCount(u64 size) {
+		return size / PACK_BLOCK_SIZE + (size % PACK_BLOCK_SIZE != 0 ? 1 : 0);
+	}
+
+	static bool IsKnownCodec(PackCodec codec) {
+		return codec == PackCodec::None || codec == PackCodec::LZ4 || codec == PackCodec::Zstd;
+	}
+
+	// Checks that an entry's block table and blocks lie within the file, so Read can trust them
+	static bool ValidateEntryData(const PackEntry& entry, const u8* data, u64 size) {
+		if (!IsKnownCodec(entry.codec) || entry.blockCount != BlockCount(entry.size)) {
+			return false;
+		}
+
+		if (entry.dataOffset > size || sizeof(u32) * (u64)entry.blockCount > size - entry.dataOffset) {
+			return false;
+		}
+
+		const u32* blockSizes = (const u32*)(data + entry.dataOffset);
+		u64 offset = entry.dataOffset + sizeof(u32) * entry.blockCount;
+
+		for (u32 i = 0; i < entry.blockCount; i++) {
+			// Blocks that don't compress are stored raw, so none is ever larger than its uncompressed size
+			u64 uncompressedSize = std::min<u64>(PACK_BLOCK_SIZE, entry.size - (u64)i * PACK_BLOCK_SIZE);
+			if (blockSizes[i] > uncompressedSize || blockSizes[i] > size - offset) {
+				return false;
+			}
+			offset += blockSizes[i];
+		}
+
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Pack File
+	//
+	//-------------------------------------------------------------------------
+
+	bool PackFile::Open(const std::string& filepath) {
+		if (!mFile.Open(filepath)) {
+			return false;
+		}
+
+		mFilepath = filepath;
+		const u8* data = mFile.Data();
+		const size_t size = mFile.Size();
+
+		if (size < sizeof(PackHeader)) {
+			RWD_LOG_ERROR("Pack file {0} is too small to contain a header", filepath);
+			return false;
+		}
+
+		mHeader = (const PackHeader*)data;
+
+		if (mHeader->magic != PACK_FILE_MAGIC || mHeader->version != PACK_FILE_VERSION || mHeader->blockSize != PACK_BLOCK_SIZE) {
+			RWD_LOG_ERROR("Pack file {0} has an unsupported header", filepath);
+			return false;
+		}
+
+		if (mHeader->tocOffset > size || sizeof(PackEntry) * (u64)mHeader->entryCount > size - mHeader->tocOffset || mHeader->stringsOffset > size) {
+			RWD_LOG_ERROR("Pack file {0} table of contents is truncated", filepath);
+			return false;
+		}
+
+		// The strings run to the end of the file, every path has to lie within them
+		const PackEntry* entries = (const PackEntry*)(data + mHeader->tocOffset);
+		const u64 stringsSize = size - mHeader->stringsOffset;
+		for (u32 i = 0; i < mHeader->entryCount; i++) {
+			if (entries[i].pathOffset > stringsSize || entries[i].pathLength > stringsSize - entries[i].pathOffset) {
+				RWD_LOG_ERROR("Pack file {0} entry {1} has a path outside the string table", filepath, i);
+				return false;
+			}
+
+			if (!ValidateEntryData(entries[i], data, size)) {
+				RWD_LOG_ERROR("Pack file {0} entry {1} has an invalid codec, block table or data range", filepath, i);
+				return false;
+			}
+		}
+
+		mEntries = entries;
+		mStrings = (const char*)(data + mHeader->stringsOffset);
+
+		RWD_LOG_INFO("Opened pack {0} with {1} files", filepath, mHeader->entryCount);
+		return true;
+	}
+
+	const PackEntry* PackFile::Find(std::string_view path) const {
+		if (!mEntries) {
+			return nullptr;
+		}
+
+		const u64 hash = HashString(path);
+		const PackEntry* end = mEntries + mHeader->entryCount;
+
+		const PackEntry* entry = std::lower_bound(mEntries, end, hash, [] (const PackEntry& entry, u64 hash) {
+			return entry.pathHash < hash;
+		});
+
+		// Compare the actual paths in case of a hash collision
+		for (; entry != end && entry->pathHash == hash; entry++) {
+			if (EntryPath(*entry) == path) {
+				return entry;
+			}
+		}
+
+		return nullptr;
+	}
+
+	std::string_view PackFile::EntryPath(const PackEntry& entry) const {
+		return std::string_view(mStrings + entry.pathOffset, entry.pathLength);
+	}
+
+	bool PackFile::Read(const PackEntry& entry, IoBuffer& buffer) const {
+		// Open has already checked the block table and data lie within the file
+		buffer = IoBuffer((size_t)entry.size);
+		if (!buffer.Data()) {
+			RWD_LOG_ERROR("Failed to allocate {0} bytes for pack entry {1}", entry.size, EntryPath(entry));
+			return false;
+		}
+
+		const u8* data = mFile.Data();
+		const u32* blockSizes = (const u32*)(data + entry.dataOffset);
+
+		// Prefix sum the block sizes to find where each block starts
+		std::vector<u64> blockOffsets(entry.blockCount);
+		u64 offset = entry.dataOffset + sizeof(u32) * entry.blockCount;
+
+		for (u32 i = 0; i < entry.blockCount; i++) {
+			blockOffsets[i] = offset;
+			offset += blockSizes[i];
+		}
+
+		std::atomic<bool> success = true;
+
+		JobCounter counter;
+		JobSystem::Dispatch(counter, entry.blockCount, 1, [&] (JobArgs args) {
+			u64 uncompressedOffset = (u64)args.jobIndex * PACK_BLOCK_SIZE;
+			size_t uncompressedSize = (size_t)std::min<u64>(PACK_BLOCK_SIZE, entry.size - uncompressedOffset);
+
+			bool decompressed = DecompressBlock(entry.codec, data + blockOffsets[args.jobIndex], blockSizes[args.jobIndex],
+				buffer.Data() + uncompressedOffset, uncompressedSize);
+
+			if (!decompressed) {
+				success = false;
+			}
+		});
+		JobSystem::Wait(counter);
+
+		if (!success) {
+			RWD_LOG_ERROR("Failed to decompress pack entry {0}", EntryPath(entry));
+		}
+
+		return success;
+	}
+
+	const std::string& PackFile::Filepath() const {
+		return mFilepath;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Pack Writer
+	//
+	//-------------------------------------------------------------------------
+
+	void PackWriter::AddFile(const std::string& path, std::vector<u8> contents, PackCodec codec) {
+		mFiles.push_back(PendingFile { .path = path, .contents = std::move(contents), .codec = codec });
+	}
+
+	bool PackWriter::Write(const std::string& filepath) {
+		struct CompressedBlock {
+			std::vector<u8> data;
+		};
+
+		// Flatten every block of every file into one list so compression balances across workers
+		struct BlockRef {
+			u32 fileIndex;
+			u32 blockIndex;
+		};
+
+		std::vector<std::vector<CompressedBlock>> fileBlocks(mFiles.size());
+		std::vector<BlockRef> blocks;
+
+		for (u32 f = 0; f < mFiles.size(); f++) {
+			u32 blockCount = (u32)BlockCount(mFiles[f].contents.size());
+			fileBlocks[f].resize(blockCount);
+
+			for (u32 b = 0; b < blockCount; b++) {
+				blocks.push_back(BlockRef { f, b });
+			}
+		}
+
+		JobCounter counter;
+		JobSystem::Dispatch(counter, (u32)blocks.size(), 4, [&] (JobArgs args) {
+			const BlockRef& ref = blocks[args.jobIndex];
+			const PendingFile& file = mFiles[ref.fileIndex];
+
+			size_t offset = (size_t)ref.blockIndex * PACK_BLOCK_SIZE;
+			size_t size = std::min((size_t)PACK_BLOCK_SIZE, file.contents.size() - offset);
+			const u8* src = file.contents.data() + offset;
+
+			std::vector<u8>& dst = fileBlocks[ref.fileIndex][ref.blockIndex].data;
+			dst.resize(CompressBound(file.codec, size));
+
+			size_t compressedSize = CompressBlock(file.codec, src, size, dst.data(), dst.size());
+
+			// Store the block raw when compression doesn't actually save anything
+			if (compressedSize == 0 || compressedSize >= size) {
+				dst.assign(src, src + size);
+			} else {
+				dst.resize(compressedSize);
+			}
+		});
+		JobSystem::Wait(counter);
+
+		std::ofstream out(filepath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) {
+			RWD_LOG_ERROR("Failed to open {0} for writing", filepath);
+			return false;
+		}
+
+		// Reserve space for the header, it gets written last once we know the offsets
+		PackHeader header { };
+		out.write((const char*)&header, sizeof(header));
+
+		std::vector<PackEntry> entries(mFiles.size());
+		std::string strings;
+
+		for (u32 f = 0; f < mFiles.size(); f++) {
+			const PendingFile& file = mFiles[f];
+
+			entries[f] = PackEntry {
+				.pathHash = HashString(file.path),
+				.dataOffset = (u64)out.tellp(),
+				.size = file.contents.size(),
+				.pathOffset = (u32)strings.size(),
+				.pathLength = (u32)file.path.size(),
+				.codec = file.codec,
+				.blockCount = (u32)fileBlocks[f].size(),
+			};
+			strings += file.path;
+
+			for (const CompressedBlock& block : fileBlocks[f]) {
+				u32 blockSize = (u32)block.data.size();
+				out.write((const char*)&blockSize, sizeof(blockSize));
+			}
+
+			for (const CompressedBlock& block : fileBlocks[f]) {
+				out.write((const char*)block.data.data(), block.data.size());
+			}
+		}
+
+		std::sort(entries.begin(), entries.end(), [] (const PackEntry& lhs, const PackEntry& rhs) {
+			return lhs.pathHash < rhs.pathHash;
+		});
+
+		// Keep the table of contents aligned so it can be read in place from the mapping
+		const char padding[alignof(PackEntry)] = { };
+		out.write(padding, (alignof(PackEntry) - (u64)out.tellp() % alignof(PackEntry)) % alignof(PackEntry));
+
+		header = PackHeader {
+			.magic = PACK_FILE_MAGIC,
+			.version = PACK_FILE_VERSION,
+			.entryCount = (u32)entries.size(),
+			.blockSize = PACK_BLOCK_SIZE,
+			.tocOffset = (u64)out.tellp(),
+			.stringsOffset = (u64)out.tellp() + sizeof(PackEntry) * entries.size(),
+		};
+
+		out.write((const char*)entries.data(), sizeof(PackEntry) * entries.size());
+		out.write(strings.data(), strings.size());
+
+		out.seekp(0);
+		out.write((const char*)&header, sizeof(header));
+
+		return out.good();
+	}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "pch.h"
+#include "Core.h"
+#include "MappedFile.h"
+
+namespace rwd {
+
+	class IoBuffer;
+
+	//-------------------------------------------------------------------------
+	//
+	// Pack File Format (.rwdpak)
+	//
+	// [PackHeader][file data...][PackEntry * entryCount][path strings]
+	//
+	// Each file is split into independent PACK_BLOCK_SIZE blocks which are compressed
+	// separately, so a file's blocks can be decompressed in parallel. A file's data starts
+	// with a u32 table holding the compressed size of every block, followed by the blocks.
+	// A block whose compressed size equals its uncompressed size is stored raw.
+	//
+	// The table of contents is sorted by path hash so lookups are a binary search.
+	//
+	//-------------------------------------------------------------------------
+
+	const u32 PACK_FILE_MAGIC = 0x4B505752; // "RWPK"
+	const u32 PACK_FILE_VERSION = 1;
+	const u32 PACK_BLOCK_SIZE = 64 * 1024;
+
+	enum class PackCodec : u32 {
+		None = 0,
+		LZ4  = 1, // Fast to decompress, for data loaded on the critical path
+		Zstd = 2, // Better ratio, for bulky data where disk bandwidth dominates
+	};
+
+	struct PackHeader {
+		u32 magic;
+		u32 version;
+		u32 entryCount;
+		u32 blockSize;
+		u64 tocOffset;
+		u64 stringsOffset;
+	};
+
+	struct PackEntry {
+		u64 pathHash;
+		u64 dataOffset;
+		u64 size;
+		u32 pathOffset; // From stringsOffset
+		u32 pathLength;
+		PackCodec codec;
+		u32 blockCount;
+	};
+
+	static_assert(sizeof(PackHeader) == 32, "Pack header layout changed");
+	static_assert(sizeof(PackEntry) == 40, "Pack entry layout changed");
+
+	class RWD_API PackFile {
+	public:
+		bool Open(const std::string& filepath);
+
+		// Paths are expected to already be normalized (see Vfs::NormalizePath)
+		const PackEntry* Find(std::string_view path) const;
+		std::string_view EntryPath(const PackEntry& entry) const;
+
+		// Decompresses every block of the entry in parallel on the job system
+		bool Read(const PackEntry& entry, IoBuffer& buffer) const;
+
+		const std::string& Filepath() const;
+	private:
+		MappedFile mFile;
+		std::string mFilepath;
+		const PackHeader* mHeader = nullptr;
+		const PackEntry* mEntries = nullptr;
+		const char* mStrings = nullptr;
+	};
+
+	class RWD_API PackWriter {
+	public:
+		void AddFile(const std::string& path, std::vector<u8> contents, PackCodec codec = PackCodec::LZ4);
+
+		// Compresses every file's blocks in parallel and writes the pack out
+		bool Write(const std::string& filepath);
+	private:
+		struct PendingFile {
+			std::string path;
+			std::vector<u8> contents;
+			PackCodec codec;
+		};
+
+		std::vector<PendingFile> mFiles;
+	};
+
+}
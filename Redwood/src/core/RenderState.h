@@ -0,0 +1,30 @@
+#pragma once
+#include "pch.h"
+#include "Core.h"
+#include "Math.h"
+
+namespace rwd {
+
+	// What a tick hands to rendering, filled by OnPublish and read by OnRender. OnRender gets the
+	// last two published states and interpolates between them, so it never reads the world itself.
+	// States are reused, so once a few ticks in the vectors stop allocating.
+	struct RenderState {
+		u64 tick = 0;
+
+		// When the tick was due, in seconds since Run started
+		f64 time = 0.0;
+
+		// Transforms of whatever the app draws, indexed however it likes. The same index in the
+		// previous and current state is the same object.
+		std::vector<Vec3> positions;
+		std::vector<Quat> rotations;
+		std::vector<Vec3> scales;
+
+		void Clear() {
+			positions.clear();
+			rotations.clear();
+			scales.clear();
+		}
+	};
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "pch.h"
+#include <atomic>
+#include "Core.h"
+
+namespace rwd {
+
+	// Hands the newest simulation state to rendering without either side waiting on the other.
+	//
+	// There are four slots: the one the simulation is writing, the newest published one, and the
+	// two the renderer holds so it can interpolate from the previous tick to the current one.
+	// Publishing and acquiring are one atomic exchange each, and a renderer slower than the
+	// simulation simply skips the states it didn't get to.
+	//
+	// Publish from one thread and acquire from one thread, which may be the same thread.
+	template<typename T>
+	class RenderStateBuffer {
+	public:
+		// The slot to fill before publishing. Holds whatever state was published three or more
+		// publishes ago, so overwrite all of it.
+		T& WriteState() { return mSlots[mWriteSlot].state; }
+
+		void Publish(u64 tick) {
+			mSlots[mWriteSlot].tick = tick;
+			u32 previous = mReady.exchange(mWriteSlot | FRESH, std::memory_order_acq_rel);
+			mWriteSlot = previous & SLOT_MASK;
+		}
+
+		// Takes the newest published state if there is one, the current state becomes the previous.
+		// Returns false when nothing was published since the last call.
+		bool Acquire() {
+			if ((mReady.load(std::memory_order_relaxed) & FRESH) == 0) {
+				return false;
+			}
+
+			// Hand back the oldest slot, the writer gets it on its next publish
+			u32 newest = mReady.exchange(mPreviousSlot, std::memory_order_acq_rel);
+			mPreviousSlot = mCurrentSlot;
+			mCurrentSlot = newest & SLOT_MASK;
+			return true;
+		}
+
+		const T& Previous() const { return mSlots[mPreviousSlot].state; }
+		const T& Current() const { return mSlots[mCurrentSlot].state; }
+		u64 CurrentTick() const { return mSlots[mCurrentSlot].tick; }
+	private:
+		static const u32 SLOT_MASK = 3;
+		static const u32 FRESH = 4;
+
+		// Own cache lines so the two threads don't contend over neighbouring slots
+		struct alignas(64) Slot {
+			T state { };
+			u64 tick = 0;
+		};
+
+		Slot mSlots[4];
+		std::atomic<u32> mReady { 1 };
+
+		u32 mWriteSlot = 0;
+		u32 mCurrentSlot = 2;
+		u32 mPreviousSlot = 3;
+	};
+
+}
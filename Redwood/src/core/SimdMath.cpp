@@ -0,0 +1,976 @@
+#include "pch.h"
+#include <cstddef>
+#include <cstring>
+#include "glm/gtc/quaternion.hpp"
+#include "SimdMath.h"
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+	#define RWD_SIMD_NEON
+	#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(_M_X64)
+	#define RWD_SIMD_X64
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+// GCC and Clang only let a function use the instructions it's compiled for, so the wider paths are
+// compiled for their instruction set one function at a time and the whole engine keeps running on
+// CPUs without them. MSVC accepts the intrinsics anywhere.
+#if defined(RWD_SIMD_X64) && (defined(__GNUC__) || defined(__clang__))
+	#define RWD_TARGET_SSE4 __attribute__((target("sse4.1")))
+	#define RWD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+	#define RWD_TARGET_SSE4
+	#define RWD_TARGET_AVX2
+#endif
+
+namespace rwd {
+
+	// The kernels read and write glm types as plain float arrays
+	static_assert(sizeof(Vec3) == 3 * sizeof(f32), "Vec3 has to be tightly packed");
+	static_assert(sizeof(Mat4) == 16 * sizeof(f32), "Mat4 has to be tightly packed");
+	static_assert(sizeof(Quat) == 4 * sizeof(f32), "Quat has to be tightly packed");
+
+	// GLM_FORCE_QUAT_DATA_WXYZ moves w to the front, so loads that deinterleave quaternions by
+	// memory order have to know which register ends up holding which component
+	static const bool QUAT_W_LAST = offsetof(Quat, w) == 3 * sizeof(f32);
+
+	static const f32* Floats(const Mat4& matrix) { return (const f32*)&matrix; }
+	static f32* Floats(Mat4& matrix) { return (f32*)&matrix; }
+
+	//-------------------------------------------------------------------------
+	// Scalar, the reference the other paths match and what finishes their remainders
+	//-------------------------------------------------------------------------
+
+	static void MulMat4Scalar(const Mat4* a, const Mat4* b, Mat4* out, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			const f32* pa = Floats(a[i]);
+			const f32* pb = Floats(b[i]);
+
+			f32 result[16];
+			for (u32 column = 0; column < 4; column++) {
+				for (u32 row = 0; row < 4; row++) {
+					result[column * 4 + row] = pa[row] * pb[column * 4]
+						+ pa[4 + row] * pb[column * 4 + 1]
+						+ pa[8 + row] * pb[column * 4 + 2]
+						+ pa[12 + row] * pb[column * 4 + 3];
+				}
+			}
+
+			memcpy(Floats(out[i]), result, sizeof(result));
+		}
+	}
+
+	static void TransformPointsScalar(const Mat4& matrix, const Vec3* points, Vec3* out, size_t count) {
+		const f32* m = Floats(matrix);
+
+		for (size_t i = 0; i < count; i++) {
+			Vec3 p = points[i];
+			out[i] = Vec3(m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+				m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+				m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14]);
+		}
+	}
+
+	static void TransformPointsSoAScalar(const Mat4& matrix, const f32* x, const f32* y, const f32* z,
+		f32* outX, f32* outY, f32* outZ, size_t count) {
+		const f32* m = Floats(matrix);
+
+		for (size_t i = 0; i < count; i++) {
+			f32 px = x[i], py = y[i], pz = z[i];
+			outX[i] = m[0] * px + m[4] * py + m[8] * pz + m[12];
+			outY[i] = m[1] * px + m[5] * py + m[9] * pz + m[13];
+			outZ[i] = m[2] * px + m[6] * py + m[10] * pz + m[14];
+		}
+	}
+
+	static size_t CullSpheresScalar(const Frustum& frustum, const SphereBoundsSoA& spheres, size_t begin, size_t count,
+		u32* visible, size_t visibleCount) {
+		for (size_t i = begin; i < count; i++) {
+			bool inside = true;
+			for (const Vec4& plane : frustum.planes) {
+				f32 distance = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+				inside &= distance >= -spheres.radius[i];
+			}
+
+			visible[visibleCount] = (u32)i;
+			visibleCount += inside;
+		}
+
+		return visibleCount;
+	}
+
+	static size_t CullAabbsScalar(const Frustum& frustum, const AabbBoundsSoA& boxes, size_t begin, size_t count,
+		u32* visible, size_t visibleCount) {
+		for (size_t i = begin; i < count; i++) {
+			bool inside = true;
+			for (const Vec4& plane : frustum.planes) {
+				f32 distance = plane.x * boxes.centerX[i] + plane.y * boxes.centerY[i] + plane.z * boxes.centerZ[i] + plane.w;
+				f32 extent = std::abs(plane.x) * boxes.extentX[i] + std::abs(plane.y) * boxes.extentY[i] + std::abs(plane.z) * boxes.extentZ[i];
+				inside &= distance >= -extent;
+			}
+
+			visible[visibleCount] = (u32)i;
+			visibleCount += inside;
+		}
+
+		return visibleCount;
+	}
+
+	static void ComposeTransformsScalar(const Quat* rotations, const Vec3* positions, const Vec3* scales, Mat4* out, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			const Quat& q = rotations[i];
+			f32 xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+			f32 xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+			f32 wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+			const Vec3& s = scales[i];
+			const Vec3& p = positions[i];
+
+			f32 m[16] = {
+				(1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x, 2.0f * (xz - wy) * s.x, 0.0f,
+				2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz + wx) * s.y, 0.0f,
+				2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z, (1.0f - 2.0f * (xx + yy)) * s.z, 0.0f,
+				p.x, p.y, p.z, 1.0f,
+			};
+
+			memcpy(Floats(out[i]), m, sizeof(m));
+		}
+	}
+
+#if defined(RWD_SIMD_X64)
+
+	//-------------------------------------------------------------------------
+	// SSE4.1, 4 objects at a time
+	//-------------------------------------------------------------------------
+
+	RWD_TARGET_SSE4 static void MulMat4Sse4(const Mat4* a, const Mat4* b, Mat4* out, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			const f32* pa = Floats(a[i]);
+			const f32* pb = Floats(b[i]);
+
+			__m128 a0 = _mm_loadu_ps(pa);
+			__m128 a1 = _mm_loadu_ps(pa + 4);
+			__m128 a2 = _mm_loadu_ps(pa + 8);
+			__m128 a3 = _mm_loadu_ps(pa + 12);
+
+			// Each result column is a's columns weighted by the matching column of b
+			__m128 columns[4];
+			for (u32 c = 0; c < 4; c++) {
+				__m128 column = _mm_mul_ps(a0, _mm_set1_ps(pb[c * 4]));
+				column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(pb[c * 4 + 1])));
+				column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(pb[c * 4 + 2])));
+				column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(pb[c * 4 + 3])));
+				columns[c] = column;
+			}
+
+			// Stored last so out can alias a or b
+			f32* po = Floats(out[i]);
+			for (u32 c = 0; c < 4; c++) {
+				_mm_storeu_ps(po + c * 4, columns[c]);
+			}
+		}
+	}
+
+	RWD_TARGET_SSE4 static void TransformPointsSse4(const Mat4& matrix, const Vec3* points, Vec3* out, size_t count) {
+		const f32* m = Floats(matrix);
+		__m128 c0 = _mm_loadu_ps(m);
+		__m128 c1 = _mm_loadu_ps(m + 4);
+		__m128 c2 = _mm_loadu_ps(m + 8);
+		__m128 c3 = _mm_loadu_ps(m + 12);
+
+		for (size_t i = 0; i < count; i++) {
+			const Vec3& p = points[i];
+			__m128 result = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)), c3);
+			result = _mm_add_ps(result, _mm_mul_ps(c1, _mm_set1_ps(p.y)));
+			result = _mm_add_ps(result, _mm_mul_ps(c2, _mm_set1_ps(p.z)));
+
+			// Exactly 12 bytes, a 16 byte store would clobber the next point when transforming in place
+			_mm_storel_pi((__m64*)&out[i], result);
+			_mm_store_ss((f32*)&out[i] + 2, _mm_movehl_ps(result, result));
+		}
+	}
+
+	RWD_TARGET_SSE4 static void TransformPointsSoASse4(const Mat4& matrix, const f32* x, const f32* y, const f32* z,
+		f32* outX, f32* outY, f32* outZ, size_t count) {
+		const f32* m = Floats(matrix);
+		__m128 m00 = _mm_set1_ps(m[0]), m01 = _mm_set1_ps(m[1]), m02 = _mm_set1_ps(m[2]);
+		__m128 m10 = _mm_set1_ps(m[4]), m11 = _mm_set1_ps(m[5]), m12 = _mm_set1_ps(m[6]);
+		__m128 m20 = _mm_set1_ps(m[8]), m21 = _mm_set1_ps(m[9]), m22 = _mm_set1_ps(m[10]);
+		__m128 m30 = _mm_set1_ps(m[12]), m31 = _mm_set1_ps(m[13]), m32 = _mm_set1_ps(m[14]);
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 px = _mm_loadu_ps(x + i);
+			__m128 py = _mm_loadu_ps(y + i);
+			__m128 pz = _mm_loadu_ps(z + i);
+
+			__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m10, py)), _mm_add_ps(_mm_mul_ps(m20, pz), m30));
+			__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, px), _mm_mul_ps(m11, py)), _mm_add_ps(_mm_mul_ps(m21, pz), m31));
+			__m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, px), _mm_mul_ps(m12, py)), _mm_add_ps(_mm_mul_ps(m22, pz), m32));
+
+			_mm_storeu_ps(outX + i, rx);
+			_mm_storeu_ps(outY + i, ry);
+			_mm_storeu_ps(outZ + i, rz);
+		}
+
+		TransformPointsSoAScalar(matrix, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+	}
+
+	// Appends the lanes set in mask, branch free since visibility is close to random
+	static size_t AppendVisible(u32 mask, u32 lanes, size_t first, u32* visible, size_t visibleCount) {
+		for (u32 lane = 0; lane < lanes; lane++) {
+			visible[visibleCount] = (u32)(first + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+
+		return visibleCount;
+	}
+
+	RWD_TARGET_SSE4 static size_t CullSpheresSse4(const Frustum& frustum, const SphereBoundsSoA& spheres, size_t count, u32* visible) {
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (u32 p = 0; p < 6; p++) {
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+
+		size_t visibleCount = 0;
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 x = _mm_loadu_ps(spheres.x + i);
+			__m128 y = _mm_loadu_ps(spheres.y + i);
+			__m128 z = _mm_loadu_ps(spheres.z + i);
+			__m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(spheres.radius + i), signBit);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (u32 p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+					_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			visibleCount = AppendVisible((u32)_mm_movemask_ps(inside), 4, i, visible, visibleCount);
+		}
+
+		return CullSpheresScalar(frustum, spheres, i, count, visible, visibleCount);
+	}
+
+	RWD_TARGET_SSE4 static size_t CullAabbsSse4(const Frustum& frustum, const AabbBoundsSoA& boxes, size_t count, u32* visible) {
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		__m128 absX[6], absY[6], absZ[6];
+		for (u32 p = 0; p < 6; p++) {
+			const Vec4& plane = frustum.planes[p];
+			planeX[p] = _mm_set1_ps(plane.x);
+			planeY[p] = _mm_set1_ps(plane.y);
+			planeZ[p] = _mm_set1_ps(plane.z);
+			planeW[p] = _mm_set1_ps(plane.w);
+			absX[p] = _mm_set1_ps(std::abs(plane.x));
+			absY[p] = _mm_set1_ps(std::abs(plane.y));
+			absZ[p] = _mm_set1_ps(std::abs(plane.z));
+		}
+
+		size_t visibleCount = 0;
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 cx = _mm_loadu_ps(boxes.centerX + i);
+			__m128 cy = _mm_loadu_ps(boxes.centerY + i);
+			__m128 cz = _mm_loadu_ps(boxes.centerZ + i);
+			__m128 ex = _mm_loadu_ps(boxes.extentX + i);
+			__m128 ey = _mm_loadu_ps(boxes.extentY + i);
+			__m128 ez = _mm_loadu_ps(boxes.extentZ + i);
+
+			// The box is outside a plane when its center is further behind it than the box's
+			// extent projected onto the plane normal
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (u32 p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+					_mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+				__m128 extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, extent), _mm_setzero_ps()));
+			}
+
+			visibleCount = AppendVisible((u32)_mm_movemask_ps(inside), 4, i, visible, visibleCount);
+		}
+
+		return CullAabbsScalar(frustum, boxes, i, count, visible, visibleCount);
+	}
+
+	// Rotation and scale of 4 transforms with one component of each per register, columns c0 c1 c2
+	struct ComposeLanes4 {
+		__m128 c0[3], c1[3], c2[3];
+	};
+
+	RWD_TARGET_SSE4 static void ComposeRotationScale4(__m128 x, __m128 y, __m128 z, __m128 w,
+		__m128 sx, __m128 sy, __m128 sz, ComposeLanes4& lanes) {
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		lanes.c0[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		lanes.c0[1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		lanes.c0[2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+
+		lanes.c1[0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		lanes.c1[1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		lanes.c1[2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+
+		lanes.c2[0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		lanes.c2[1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		lanes.c2[2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+	}
+
+	// Transposes one column of 4 matrices from lanes back into each matrix
+	RWD_TARGET_SSE4 static void StoreColumn4(Mat4* out, u32 column, __m128 r0, __m128 r1, __m128 r2, __m128 r3) {
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(Floats(out[0]) + column * 4, r0);
+		_mm_storeu_ps(Floats(out[1]) + column * 4, r1);
+		_mm_storeu_ps(Floats(out[2]) + column * 4, r2);
+		_mm_storeu_ps(Floats(out[3]) + column * 4, r3);
+	}
+
+	// Loads 4 quaternions transposed into x, y, z and w registers
+	RWD_TARGET_SSE4 static void LoadQuats4(const Quat* rotations, __m128& x, __m128& y, __m128& z, __m128& w) {
+		__m128 r0 = _mm_loadu_ps((const f32*)&rotations[0]);
+		__m128 r1 = _mm_loadu_ps((const f32*)&rotations[1]);
+		__m128 r2 = _mm_loadu_ps((const f32*)&rotations[2]);
+		__m128 r3 = _mm_loadu_ps((const f32*)&rotations[3]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		if (QUAT_W_LAST) {
+			x = r0; y = r1; z = r2; w = r3;
+		} else {
+			w = r0; x = r1; y = r2; z = r3;
+		}
+	}
+
+	RWD_TARGET_SSE4 static void StoreTransforms4(const ComposeLanes4& lanes, const Vec3* positions, Mat4* out) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		__m128 px = _mm_setr_ps(positions[0].x, positions[1].x, positions[2].x, positions[3].x);
+		__m128 py = _mm_setr_ps(positions[0].y, positions[1].y, positions[2].y, positions[3].y);
+		__m128 pz = _mm_setr_ps(positions[0].z, positions[1].z, positions[2].z, positions[3].z);
+
+		StoreColumn4(out, 0, lanes.c0[0], lanes.c0[1], lanes.c0[2], zero);
+		StoreColumn4(out, 1, lanes.c1[0], lanes.c1[1], lanes.c1[2], zero);
+		StoreColumn4(out, 2, lanes.c2[0], lanes.c2[1], lanes.c2[2], zero);
+		StoreColumn4(out, 3, px, py, pz, one);
+	}
+
+	RWD_TARGET_SSE4 static void ComposeTransformsSse4(const Quat* rotations, const Vec3* positions, const Vec3* scales, Mat4* out, size_t count) {
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 x, y, z, w;
+			LoadQuats4(rotations + i, x, y, z, w);
+
+			const Vec3* s = scales + i;
+			__m128 sx = _mm_setr_ps(s[0].x, s[1].x, s[2].x, s[3].x);
+			__m128 sy = _mm_setr_ps(s[0].y, s[1].y, s[2].y, s[3].y);
+			__m128 sz = _mm_setr_ps(s[0].z, s[1].z, s[2].z, s[3].z);
+
+			ComposeLanes4 lanes;
+			ComposeRotationScale4(x, y, z, w, sx, sy, sz, lanes);
+			StoreTransforms4(lanes, positions + i, out + i);
+		}
+
+		ComposeTransformsScalar(rotations + i, positions + i, scales + i, out + i, count - i);
+	}
+
+	//-------------------------------------------------------------------------
+	// AVX2 + FMA, 8 objects at a time
+	//-------------------------------------------------------------------------
+
+	RWD_TARGET_AVX2 static void MulMat4Avx2(const Mat4* a, const Mat4* b, Mat4* out, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			const f32* pa = Floats(a[i]);
+			const f32* pb = Floats(b[i]);
+
+			// a's columns repeated in both halves, so one register computes two result columns
+			__m256 a0 = _mm256_broadcast_ps((const __m128*)pa);
+			__m256 a1 = _mm256_broadcast_ps((const __m128*)(pa + 4));
+			__m256 a2 = _mm256_broadcast_ps((const __m128*)(pa + 8));
+			__m256 a3 = _mm256_broadcast_ps((const __m128*)(pa + 12));
+
+			__m256 b01 = _mm256_loadu_ps(pb);
+			__m256 b23 = _mm256_loadu_ps(pb + 8);
+
+			// Shuffling within each half broadcasts one element of each of the two b columns
+			__m256 r01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, 0x00));
+			r01 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b01, b01, 0x55), r01);
+			r01 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b01, b01, 0xAA), r01);
+			r01 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b01, b01, 0xFF), r01);
+
+			__m256 r23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b23, b23, 0x00));
+			r23 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b23, b23, 0x55), r23);
+			r23 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b23, b23, 0xAA), r23);
+			r23 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b23, b23, 0xFF), r23);
+
+			f32* po = Floats(out[i]);
+			_mm256_storeu_ps(po, r01);
+			_mm256_storeu_ps(po + 8, r23);
+		}
+	}
+
+	RWD_TARGET_AVX2 static void TransformPointsSoAAvx2(const Mat4& matrix, const f32* x, const f32* y, const f32* z,
+		f32* outX, f32* outY, f32* outZ, size_t count) {
+		const f32* m = Floats(matrix);
+		__m256 m00 = _mm256_set1_ps(m[0]), m01 = _mm256_set1_ps(m[1]), m02 = _mm256_set1_ps(m[2]);
+		__m256 m10 = _mm256_set1_ps(m[4]), m11 = _mm256_set1_ps(m[5]), m12 = _mm256_set1_ps(m[6]);
+		__m256 m20 = _mm256_set1_ps(m[8]), m21 = _mm256_set1_ps(m[9]), m22 = _mm256_set1_ps(m[10]);
+		__m256 m30 = _mm256_set1_ps(m[12]), m31 = _mm256_set1_ps(m[13]), m32 = _mm256_set1_ps(m[14]);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 px = _mm256_loadu_ps(x + i);
+			__m256 py = _mm256_loadu_ps(y + i);
+			__m256 pz = _mm256_loadu_ps(z + i);
+
+			_mm256_storeu_ps(outX + i, _mm256_fmadd_ps(m00, px, _mm256_fmadd_ps(m10, py, _mm256_fmadd_ps(m20, pz, m30))));
+			_mm256_storeu_ps(outY + i, _mm256_fmadd_ps(m01, px, _mm256_fmadd_ps(m11, py, _mm256_fmadd_ps(m21, pz, m31))));
+			_mm256_storeu_ps(outZ + i, _mm256_fmadd_ps(m02, px, _mm256_fmadd_ps(m12, py, _mm256_fmadd_ps(m22, pz, m32))));
+		}
+
+		TransformPointsSoAScalar(matrix, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+	}
+
+	RWD_TARGET_AVX2 static size_t CullSpheresAvx2(const Frustum& frustum, const SphereBoundsSoA& spheres, size_t count, u32* visible) {
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (u32 p = 0; p < 6; p++) {
+			planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+		size_t visibleCount = 0;
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 x = _mm256_loadu_ps(spheres.x + i);
+			__m256 y = _mm256_loadu_ps(spheres.y + i);
+			__m256 z = _mm256_loadu_ps(spheres.z + i);
+			__m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(spheres.radius + i), signBit);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (u32 p = 0; p < 6; p++) {
+				__m256 distance = _mm256_fmadd_ps(planeX[p], x, _mm256_fmadd_ps(planeY[p], y, _mm256_fmadd_ps(planeZ[p], z, planeW[p])));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+			}
+
+			visibleCount = AppendVisible((u32)_mm256_movemask_ps(inside), 8, i, visible, visibleCount);
+		}
+
+		return CullSpheresScalar(frustum, spheres, i, count, visible, visibleCount);
+	}
+
+	RWD_TARGET_AVX2 static size_t CullAabbsAvx2(const Frustum& frustum, const AabbBoundsSoA& boxes, size_t count, u32* visible) {
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+		__m256 absX[6], absY[6], absZ[6];
+		for (u32 p = 0; p < 6; p++) {
+			const Vec4& plane = frustum.planes[p];
+			planeX[p] = _mm256_set1_ps(plane.x);
+			planeY[p] = _mm256_set1_ps(plane.y);
+			planeZ[p] = _mm256_set1_ps(plane.z);
+			planeW[p] = _mm256_set1_ps(plane.w);
+			absX[p] = _mm256_set1_ps(std::abs(plane.x));
+			absY[p] = _mm256_set1_ps(std::abs(plane.y));
+			absZ[p] = _mm256_set1_ps(std::abs(plane.z));
+		}
+
+		size_t visibleCount = 0;
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 cx = _mm256_loadu_ps(boxes.centerX + i);
+			__m256 cy = _mm256_loadu_ps(boxes.centerY + i);
+			__m256 cz = _mm256_loadu_ps(boxes.centerZ + i);
+			__m256 ex = _mm256_loadu_ps(boxes.extentX + i);
+			__m256 ey = _mm256_loadu_ps(boxes.extentY + i);
+			__m256 ez = _mm256_loadu_ps(boxes.extentZ + i);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (u32 p = 0; p < 6; p++) {
+				__m256 distance = _mm256_fmadd_ps(planeX[p], cx, _mm256_fmadd_ps(planeY[p], cy, _mm256_fmadd_ps(planeZ[p], cz, planeW[p])));
+				__m256 reach = _mm256_fmadd_ps(absX[p], ex, _mm256_fmadd_ps(absY[p], ey, _mm256_fmadd_ps(absZ[p], ez, distance)));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(reach, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+
+			visibleCount = AppendVisible((u32)_mm256_movemask_ps(inside), 8, i, visible, visibleCount);
+		}
+
+		return CullAabbsScalar(frustum, boxes, i, count, visible, visibleCount);
+	}
+
+	// Transposes the 4x4 blocks in the low and high halves of the registers independently
+	RWD_TARGET_AVX2 static void TransposeHalves(__m256& r0, __m256& r1, __m256& r2, __m256& r3) {
+		__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+		__m256 t1 = _mm256_unpacklo_ps(r2, r3);
+		__m256 t2 = _mm256_unpackhi_ps(r0, r1);
+		__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+
+		r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+		r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+		r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	// Transposes one column of 8 matrices from lanes back into each matrix. Lane i of the
+	// transposed registers' low halves is matrix i, the high halves hold matrices 4 to 7.
+	RWD_TARGET_AVX2 static void StoreColumn8(Mat4* out, u32 column, __m256 r0, __m256 r1, __m256 r2, __m256 r3) {
+		TransposeHalves(r0, r1, r2, r3);
+
+		__m256 rows[4] = { r0, r1, r2, r3 };
+		for (u32 i = 0; i < 4; i++) {
+			_mm_storeu_ps(Floats(out[i]) + column * 4, _mm256_castps256_ps128(rows[i]));
+			_mm_storeu_ps(Floats(out[i + 4]) + column * 4, _mm256_extractf128_ps(rows[i], 1));
+		}
+	}
+
+	RWD_TARGET_AVX2 static void ComposeTransformsAvx2(const Quat* rotations, const Vec3* positions, const Vec3* scales, Mat4* out, size_t count) {
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			// Quaternions i and i + 4 share a register, so transposing the halves leaves
+			// each component of all 8 in order
+			const f32* q = (const f32*)(rotations + i);
+			__m256 r0 = _mm256_set_m128(_mm_loadu_ps(q + 16), _mm_loadu_ps(q));
+			__m256 r1 = _mm256_set_m128(_mm_loadu_ps(q + 20), _mm_loadu_ps(q + 4));
+			__m256 r2 = _mm256_set_m128(_mm_loadu_ps(q + 24), _mm_loadu_ps(q + 8));
+			__m256 r3 = _mm256_set_m128(_mm_loadu_ps(q + 28), _mm_loadu_ps(q + 12));
+			TransposeHalves(r0, r1, r2, r3);
+
+			__m256 x = QUAT_W_LAST ? r0 : r1;
+			__m256 y = QUAT_W_LAST ? r1 : r2;
+			__m256 z = QUAT_W_LAST ? r2 : r3;
+			__m256 w = QUAT_W_LAST ? r3 : r0;
+
+			const Vec3* s = scales + i;
+			__m256 sx = _mm256_setr_ps(s[0].x, s[1].x, s[2].x, s[3].x, s[4].x, s[5].x, s[6].x, s[7].x);
+			__m256 sy = _mm256_setr_ps(s[0].y, s[1].y, s[2].y, s[3].y, s[4].y, s[5].y, s[6].y, s[7].y);
+			__m256 sz = _mm256_setr_ps(s[0].z, s[1].z, s[2].z, s[3].z, s[4].z, s[5].z, s[6].z, s[7].z);
+
+			const Vec3* p = positions + i;
+			__m256 px = _mm256_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x, p[4].x, p[5].x, p[6].x, p[7].x);
+			__m256 py = _mm256_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y, p[4].y, p[5].y, p[6].y, p[7].y);
+			__m256 pz = _mm256_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z, p[4].z, p[5].z, p[6].z, p[7].z);
+
+			__m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+			__m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+			__m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+			__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+			StoreColumn8(out + i, 0,
+				_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx),
+				_mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+				_mm256_mul_ps(_mm256_sub_ps(xz, wy), sx), zero);
+
+			StoreColumn8(out + i, 1,
+				_mm256_mul_ps(_mm256_sub_ps(xy, wz), sy),
+				_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy),
+				_mm256_mul_ps(_mm256_add_ps(yz, wx), sy), zero);
+
+			StoreColumn8(out + i, 2,
+				_mm256_mul_ps(_mm256_add_ps(xz, wy), sz),
+				_mm256_mul_ps(_mm256_sub_ps(yz, wx), sz),
+				_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz), zero);
+
+			StoreColumn8(out + i, 3, px, py, pz, one);
+		}
+
+		ComposeTransformsScalar(rotations + i, positions + i, scales + i, out + i, count - i);
+	}
+
+#elif defined(RWD_SIMD_NEON)
+
+	//-------------------------------------------------------------------------
+	// NEON, 4 objects at a time
+	//-------------------------------------------------------------------------
+
+	static void MulMat4Neon(const Mat4* a, const Mat4* b, Mat4* out, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			const f32* pa = Floats(a[i]);
+			const f32* pb = Floats(b[i]);
+
+			float32x4_t a0 = vld1q_f32(pa);
+			float32x4_t a1 = vld1q_f32(pa + 4);
+			float32x4_t a2 = vld1q_f32(pa + 8);
+			float32x4_t a3 = vld1q_f32(pa + 12);
+
+			float32x4_t columns[4];
+			for (u32 c = 0; c < 4; c++) {
+				float32x4_t b = vld1q_f32(pb + c * 4);
+				float32x4_t column = vmulq_laneq_f32(a0, b, 0);
+				column = vfmaq_laneq_f32(column, a1, b, 1);
+				column = vfmaq_laneq_f32(column, a2, b, 2);
+				column = vfmaq_laneq_f32(column, a3, b, 3);
+				columns[c] = column;
+			}
+
+			f32* po = Floats(out[i]);
+			for (u32 c = 0; c < 4; c++) {
+				vst1q_f32(po + c * 4, columns[c]);
+			}
+		}
+	}
+
+	static void TransformPointsNeon(const Mat4& matrix, const Vec3* points, Vec3* out, size_t count) {
+		const f32* m = Floats(matrix);
+		float32x4_t c0 = vld1q_f32(m);
+		float32x4_t c1 = vld1q_f32(m + 4);
+		float32x4_t c2 = vld1q_f32(m + 8);
+		float32x4_t c3 = vld1q_f32(m + 12);
+
+		for (size_t i = 0; i < count; i++) {
+			const Vec3& p = points[i];
+			float32x4_t result = vfmaq_n_f32(c3, c0, p.x);
+			result = vfmaq_n_f32(result, c1, p.y);
+			result = vfmaq_n_f32(result, c2, p.z);
+
+			// Exactly 12 bytes, so transforming in place works
+			vst1_f32((f32*)&out[i], vget_low_f32(result));
+			vst1q_lane_f32((f32*)&out[i] + 2, result, 2);
+		}
+	}
+
+	static void TransformPointsSoANeon(const Mat4& matrix, const f32* x, const f32* y, const f32* z,
+		f32* outX, f32* outY, f32* outZ, size_t count) {
+		const f32* m = Floats(matrix);
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			float32x4_t px = vld1q_f32(x + i);
+			float32x4_t py = vld1q_f32(y + i);
+			float32x4_t pz = vld1q_f32(z + i);
+
+			vst1q_f32(outX + i, vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(vdupq_n_f32(m[12]), px, m[0]), py, m[4]), pz, m[8]));
+			vst1q_f32(outY + i, vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(vdupq_n_f32(m[13]), px, m[1]), py, m[5]), pz, m[9]));
+			vst1q_f32(outZ + i, vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(vdupq_n_f32(m[14]), px, m[2]), py, m[6]), pz, m[10]));
+		}
+
+		TransformPointsSoAScalar(matrix, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+	}
+
+	// NEON has no movemask, each lane is weighted by its bit and summed
+	static u32 LaneMask(uint32x4_t inside) {
+		static const u32 laneBits[4] = { 1, 2, 4, 8 };
+		return vaddvq_u32(vandq_u32(inside, vld1q_u32(laneBits)));
+	}
+
+	static size_t AppendVisible(u32 mask, size_t first, u32* visible, size_t visibleCount) {
+		for (u32 lane = 0; lane < 4; lane++) {
+			visible[visibleCount] = (u32)(first + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+
+		return visibleCount;
+	}
+
+	static size_t CullSpheresNeon(const Frustum& frustum, const SphereBoundsSoA& spheres, size_t count, u32* visible) {
+		size_t visibleCount = 0;
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			float32x4_t x = vld1q_f32(spheres.x + i);
+			float32x4_t y = vld1q_f32(spheres.y + i);
+			float32x4_t z = vld1q_f32(spheres.z + i);
+			float32x4_t negativeRadius = vnegq_f32(vld1q_f32(spheres.radius + i));
+
+			uint32x4_t inside = vdupq_n_u32(~0u);
+			for (const Vec4& plane : frustum.planes) {
+				float32x4_t distance = vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(vdupq_n_f32(plane.w), x, plane.x), y, plane.y), z, plane.z);
+				inside = vandq_u32(inside, vcgeq_f32(distance, negativeRadius));
+			}
+
+			visibleCount = AppendVisible(LaneMask(inside), i, visible, visibleCount);
+		}
+
+		return CullSpheresScalar(frustum, spheres, i, count, visible, visibleCount);
+	}
+
+	static size_t CullAabbsNeon(const Frustum& frustum, const AabbBoundsSoA& boxes, size_t count, u32* visible) {
+		size_t visibleCount = 0;
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			float32x4_t cx = vld1q_f32(boxes.centerX + i);
+			float32x4_t cy = vld1q_f32(boxes.centerY + i);
+			float32x4_t cz = vld1q_f32(boxes.centerZ + i);
+			float32x4_t ex = vld1q_f32(boxes.extentX + i);
+			float32x4_t ey = vld1q_f32(boxes.extentY + i);
+			float32x4_t ez = vld1q_f32(boxes.extentZ + i);
+
+			uint32x4_t inside = vdupq_n_u32(~0u);
+			for (const Vec4& plane : frustum.planes) {
+				float32x4_t reach = vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(vdupq_n_f32(plane.w), cx, plane.x), cy, plane.y), cz, plane.z);
+				reach = vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(reach, ex, std::abs(plane.x)), ey, std::abs(plane.y)), ez, std::abs(plane.z));
+				inside = vandq_u32(inside, vcgezq_f32(reach));
+			}
+
+			visibleCount = AppendVisible(LaneMask(inside), i, visible, visibleCount);
+		}
+
+		return CullAabbsScalar(frustum, boxes, i, count, visible, visibleCount);
+	}
+
+	static void Transpose4(float32x4_t& r0, float32x4_t& r1, float32x4_t& r2, float32x4_t& r3) {
+		float32x4x2_t t01 = vtrnq_f32(r0, r1);
+		float32x4x2_t t23 = vtrnq_f32(r2, r3);
+		r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+		r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+		r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+		r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+	}
+
+	static void StoreColumn4(Mat4* out, u32 column, float32x4_t r0, float32x4_t r1, float32x4_t r2, float32x4_t r3) {
+		Transpose4(r0, r1, r2, r3);
+		vst1q_f32(Floats(out[0]) + column * 4, r0);
+		vst1q_f32(Floats(out[1]) + column * 4, r1);
+		vst1q_f32(Floats(out[2]) + column * 4, r2);
+		vst1q_f32(Floats(out[3]) + column * 4, r3);
+	}
+
+	static void ComposeTransformsNeon(const Quat* rotations, const Vec3* positions, const Vec3* scales, Mat4* out, size_t count) {
+		const float32x4_t zero = vdupq_n_f32(0.0f);
+		const float32x4_t one = vdupq_n_f32(1.0f);
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			// Deinterleaves 4 quaternions into one register per component, and the same for the vectors
+			float32x4x4_t q = vld4q_f32((const f32*)(rotations + i));
+			float32x4_t x = QUAT_W_LAST ? q.val[0] : q.val[1];
+			float32x4_t y = QUAT_W_LAST ? q.val[1] : q.val[2];
+			float32x4_t z = QUAT_W_LAST ? q.val[2] : q.val[3];
+			float32x4_t w = QUAT_W_LAST ? q.val[3] : q.val[0];
+
+			float32x4x3_t s = vld3q_f32((const f32*)(scales + i));
+			float32x4x3_t p = vld3q_f32((const f32*)(positions + i));
+
+			float32x4_t x2 = vaddq_f32(x, x), y2 = vaddq_f32(y, y), z2 = vaddq_f32(z, z);
+			float32x4_t xx = vmulq_f32(x, x2), yy = vmulq_f32(y, y2), zz = vmulq_f32(z, z2);
+			float32x4_t xy = vmulq_f32(x, y2), xz = vmulq_f32(x, z2), yz = vmulq_f32(y, z2);
+			float32x4_t wx = vmulq_f32(w, x2), wy = vmulq_f32(w, y2), wz = vmulq_f32(w, z2);
+
+			StoreColumn4(out + i, 0,
+				vmulq_f32(vsubq_f32(one, vaddq_f32(yy, zz)), s.val[0]),
+				vmulq_f32(vaddq_f32(xy, wz), s.val[0]),
+				vmulq_f32(vsubq_f32(xz, wy), s.val[0]), zero);
+
+			StoreColumn4(out + i, 1,
+				vmulq_f32(vsubq_f32(xy, wz), s.val[1]),
+				vmulq_f32(vsubq_f32(one, vaddq_f32(xx, zz)), s.val[1]),
+				vmulq_f32(vaddq_f32(yz, wx), s.val[1]), zero);
+
+			StoreColumn4(out + i, 2,
+				vmulq_f32(vaddq_f32(xz, wy), s.val[2]),
+				vmulq_f32(vsubq_f32(yz, wx), s.val[2]),
+				vmulq_f32(vsubq_f32(one, vaddq_f32(xx, yy)), s.val[2]), zero);
+
+			StoreColumn4(out + i, 3, p.val[0], p.val[1], p.val[2], one);
+		}
+
+		ComposeTransformsScalar(rotations + i, positions + i, scales + i, out + i, count - i);
+	}
+
+#endif
+
+	//-------------------------------------------------------------------------
+	// Dispatch
+	//-------------------------------------------------------------------------
+
+	static size_t CullSpheresScalarAll(const Frustum& frustum, const SphereBoundsSoA& spheres, size_t count, u32* visible) {
+		return CullSpheresScalar(frustum, spheres, 0, count, visible, 0);
+	}
+
+	static size_t CullAabbsScalarAll(const Frustum& frustum, const AabbBoundsSoA& boxes, size_t count, u32* visible) {
+		return CullAabbsScalar(frustum, boxes, 0, count, visible, 0);
+	}
+
+	struct SimdKernels {
+		SimdLevel level;
+		void (*mulMat4)(const Mat4*, const Mat4*, Mat4*, size_t);
+		void (*transformPoints)(const Mat4&, const Vec3*, Vec3*, size_t);
+		void (*transformPointsSoA)(const Mat4&, const f32*, const f32*, const f32*, f32*, f32*, f32*, size_t);
+		size_t (*cullSpheres)(const Frustum&, const SphereBoundsSoA&, size_t, u32*);
+		size_t (*cullAabbs)(const Frustum&, const AabbBoundsSoA&, size_t, u32*);
+		void (*composeTransforms)(const Quat*, const Vec3*, const Vec3*, Mat4*, size_t);
+	};
+
+	static SimdLevel DetectSimdLevel() {
+#if defined(RWD_SIMD_NEON)
+		return SimdLevel::Neon;
+#elif defined(RWD_SIMD_X64)
+	#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		bool fma = (info[2] & (1 << 12)) != 0;
+
+		// AVX needs the OS to save the upper halves of the registers on context switches
+		bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0 && fma && osSavesYmm;
+	#else
+		// Also checks that the OS saves the AVX registers
+		__builtin_cpu_init();
+		bool sse41 = __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	#endif
+
+		if (avx2) {
+			return SimdLevel::Avx2;
+		}
+
+		return sse41 ? SimdLevel::Sse4 : SimdLevel::Scalar;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	static SimdKernels KernelsFor(SimdLevel level) {
+		SimdKernels kernels {
+			.level = SimdLevel::Scalar,
+			.mulMat4 = MulMat4Scalar,
+			.transformPoints = TransformPointsScalar,
+			.transformPointsSoA = TransformPointsSoAScalar,
+			.cullSpheres = CullSpheresScalarAll,
+			.cullAabbs = CullAabbsScalarAll,
+			.composeTransforms = ComposeTransformsScalar,
+		};
+
+#if defined(RWD_SIMD_X64)
+		if (level == SimdLevel::Sse4 || level == SimdLevel::Avx2) {
+			kernels = SimdKernels {
+				.level = SimdLevel::Sse4,
+				.mulMat4 = MulMat4Sse4,
+				.transformPoints = TransformPointsSse4,
+				.transformPointsSoA = TransformPointsSoASse4,
+				.cullSpheres = CullSpheresSse4,
+				.cullAabbs = CullAabbsSse4,
+				.composeTransforms = ComposeTransformsSse4,
+			};
+		}
+
+		// Points stored as Vec3 arrays gain nothing from 8 lanes, the 4 wide version stays
+		if (level == SimdLevel::Avx2) {
+			kernels.level = SimdLevel::Avx2;
+			kernels.mulMat4 = MulMat4Avx2;
+			kernels.transformPointsSoA = TransformPointsSoAAvx2;
+			kernels.cullSpheres = CullSpheresAvx2;
+			kernels.cullAabbs = CullAabbsAvx2;
+			kernels.composeTransforms = ComposeTransformsAvx2;
+		}
+#elif defined(RWD_SIMD_NEON)
+		if (level == SimdLevel::Neon) {
+			kernels = SimdKernels {
+				.level = SimdLevel::Neon,
+				.mulMat4 = MulMat4Neon,
+				.transformPoints = TransformPointsNeon,
+				.transformPointsSoA = TransformPointsSoANeon,
+				.cullSpheres = CullSpheresNeon,
+				.cullAabbs = CullAabbsNeon,
+				.composeTransforms = ComposeTransformsNeon,
+			};
+		}
+#endif
+
+		return kernels;
+	}
+
+	static const SimdLevel supportedLevel = DetectSimdLevel();
+	static SimdKernels kernels = KernelsFor(supportedLevel);
+
+	SimdLevel ActiveSimdLevel() {
+		return kernels.level;
+	}
+
+	const char* SimdLevelName(SimdLevel level) {
+		switch (level) {
+			case(SimdLevel::Scalar): return "Scalar";
+			case(SimdLevel::Sse4):   return "SSE4.1";
+			case(SimdLevel::Avx2):   return "AVX2";
+			case(SimdLevel::Neon):   return "NEON";
+		}
+
+		return "Unknown";
+	}
+
+	void ForceSimdLevel(SimdLevel level) {
+		bool supported = level == SimdLevel::Scalar || level == supportedLevel
+			|| (level == SimdLevel::Sse4 && supportedLevel == SimdLevel::Avx2);
+
+		kernels = KernelsFor(supported ? level : supportedLevel);
+	}
+
+	//-------------------------------------------------------------------------
+
+	static Vec4 NormalizePlane(f32 x, f32 y, f32 z, f32 w) {
+		f32 length = std::sqrt(x * x + y * y + z * z);
+		return Vec4(x / length, y / length, z / length, w / length);
+	}
+
+	Frustum Frustum::FromViewProjection(const Mat4& viewProjection) {
+		// Gribb and Hartmann, every plane is the last row of the matrix plus or minus one of the others
+		const f32* m = Floats(viewProjection);
+		auto plane = [m] (u32 row, f32 sign) {
+			return NormalizePlane(m[3] + sign * m[row], m[7] + sign * m[4 + row], m[11] + sign * m[8 + row], m[15] + sign * m[12 + row]);
+		};
+
+		Frustum frustum;
+		frustum.planes[0] = plane(0, 1.0f);  // Left
+		frustum.planes[1] = plane(0, -1.0f); // Right
+		frustum.planes[2] = plane(1, 1.0f);  // Bottom
+		frustum.planes[3] = plane(1, -1.0f); // Top
+		frustum.planes[5] = plane(2, -1.0f); // Far
+
+#ifdef GLM_FORCE_DEPTH_ZERO_TO_ONE
+		// Clip space depth starts at 0, so the near plane is the third row on its own
+		frustum.planes[4] = NormalizePlane(m[2], m[6], m[10], m[14]);
+#else
+		frustum.planes[4] = plane(2, 1.0f);
+#endif
+
+		return frustum;
+	}
+
+	void MulMat4(const Mat4* a, const Mat4* b, Mat4* out, size_t count) {
+		kernels.mulMat4(a, b, out, count);
+	}
+
+	Mat4 MulMat4(const Mat4& a, const Mat4& b) {
+		Mat4 result;
+		kernels.mulMat4(&a, &b, &result, 1);
+		return result;
+	}
+
+	void TransformPoints(const Mat4& matrix, const Vec3* points, Vec3* out, size_t count) {
+		kernels.transformPoints(matrix, points, out, count);
+	}
+
+	void TransformPointsSoA(const Mat4& matrix, const f32* x, const f32* y, const f32* z,
+		f32* outX, f32* outY, f32* outZ, size_t count) {
+		kernels.transformPointsSoA(matrix, x, y, z, outX, outY, outZ, count);
+	}
+
+	size_t CullSpheres(const Frustum& frustum, const SphereBoundsSoA& spheres, size_t count, u32* visible) {
+		return kernels.cullSpheres(frustum, spheres, count, visible);
+	}
+
+	size_t CullAabbs(const Frustum& frustum, const AabbBoundsSoA& boxes, size_t count, u32* visible) {
+		return kernels.cullAabbs(frustum, boxes, count, visible);
+	}
+
+	void ComposeTransforms(const Quat* rotations, const Vec3* positions, const Vec3* scales, Mat4* out, size_t count) {
+		kernels.composeTransforms(rotations, positions, scales, out, count);
+	}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "pch.h"
+#include "Core.h"
+#include "Math.h"
+
+namespace rwd {
+
+	// Batch math on arrays of objects, the per object work of transforms and culling.
+	//
+	// On x64 the widest path the CPU supports is picked at startup, AVX2 + FMA for 8 objects at a
+	// time, SSE4.1 for 4, falling back to scalar code. ARM64 always has NEON, so it's chosen at
+	// compile time. The arrays don't have to be aligned and any count works, the remainder
+	// that doesn't fill a register is finished with scalar code.
+	enum class SimdLevel {
+		Scalar,
+		Sse4,
+		Avx2,
+		Neon,
+	};
+
+	RWD_API SimdLevel ActiveSimdLevel();
+	RWD_API const char* SimdLevelName(SimdLevel level);
+
+	// Restricts the batch functions to a narrower path, for benchmarking and checking the paths
+	// against each other. Levels the CPU doesn't support fall back to the best one it does.
+	RWD_API void ForceSimdLevel(SimdLevel level);
+
+	// Planes point inwards and are normalized, a point is inside when dot(plane.xyz, p) + plane.w >= 0
+	struct Frustum {
+		Vec4 planes[6];
+
+		RWD_API static Frustum FromViewProjection(const Mat4& viewProjection);
+	};
+
+	// Bounds stored as one array per component, so a register loads the same component of 4 or 8 objects
+	struct SphereBoundsSoA {
+		const f32* x;
+		const f32* y;
+		const f32* z;
+		const f32* radius;
+	};
+
+	struct AabbBoundsSoA {
+		const f32* centerX;
+		const f32* centerY;
+		const f32* centerZ;
+		const f32* extentX;
+		const f32* extentY;
+		const f32* extentZ;
+	};
+
+	// out[i] = a[i] * b[i], out may alias either input
+	RWD_API void MulMat4(const Mat4* a, const Mat4* b, Mat4* out, size_t count);
+	RWD_API Mat4 MulMat4(const Mat4& a, const Mat4& b);
+
+	// out[i] = (matrix * vec4(points[i], 1)).xyz, no perspective divide
+	RWD_API void TransformPoints(const Mat4& matrix, const Vec3* points, Vec3* out, size_t count);
+	RWD_API void TransformPointsSoA(const Mat4& matrix, const f32* x, const f32* y, const f32* z,
+		f32* outX, f32* outY, f32* outZ, size_t count);
+
+	// Writes the indices of the objects that intersect the frustum, in order, and returns how many there are.
+	// visible needs room for count indices.
+	RWD_API size_t CullSpheres(const Frustum& frustum, const SphereBoundsSoA& spheres, size_t count, u32* visible);
+	RWD_API size_t CullAabbs(const Frustum& frustum, const AabbBoundsSoA& boxes, size_t count, u32* visible);
+
+	// Builds translation * rotation * scale matrices, the same result as glm::translate, glm::mat4_cast
+	// and glm::scale. Rotations have to be normalized.
+	RWD_API void ComposeTransforms(const Quat* rotations, const Vec3* positions, const Vec3* scales, Mat4* out, size_t count);
+
+}
@@ -4,7 +4,7 @@
 
 namespace rwd {
 
-	class System {
+	class RWD_API System {
 	public:
 		static void ReadFile(const std::string& filepath, std::vector<u8>& contents);
 	};
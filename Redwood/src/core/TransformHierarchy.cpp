@@ -0,0 +1,320 @@
+#include "pch.h"
+#include <atomic>
+#include <cstring>
+#include "Log.h"
+#include "JobSystem.h"
+#include "SimdMath.h"
+#include "TransformHierarchy.h"
+
+namespace rwd {
+
+	// Levels smaller than this update on the calling thread, bigger ones are split into jobs
+	const u32 PARALLEL_LEVEL_THRESHOLD = 4096;
+	const u32 NODES_PER_JOB = 1024;
+
+	TransformHandle TransformHierarchy::Create(TransformHandle parent, const Vec3& position, const Quat& rotation, const Vec3& scale) {
+		u32 parentNode = NO_PARENT;
+		if (parent.IsValid()) {
+			RWD_ASSERT(IsAlive(parent), "Parent transform has been destroyed");
+			parentNode = Node(parent);
+		}
+
+		u32 slot;
+		if (!mFreeSlots.empty()) {
+			slot = mFreeSlots.back();
+			mFreeSlots.pop_back();
+		} else {
+			slot = (u32)mSlots.size();
+			mSlots.emplace_back();
+		}
+
+		const u32 node = Count();
+		const u32 depth = parentNode == NO_PARENT ? 0 : mDepths[parentNode] + 1;
+
+		mSlots[slot].node = node;
+		mPositions.push_back(position);
+		mRotations.push_back(rotation);
+		mScales.push_back(scale);
+		mWorld.emplace_back(1.0f);
+		mParents.push_back(parentNode);
+		mDepths.push_back(depth);
+		mNodeSlots.push_back(slot);
+		mDirty.push_back(0);
+		mDestroyed.push_back(0);
+
+		// Appending keeps the order sorted when the node goes in the deepest level or starts a new one
+		if (!mOrderDirty) {
+			if (depth + 1 == LevelCount()) {
+				mLevelStarts.back() = node + 1;
+			} else if (depth == LevelCount()) {
+				mLevelStarts.push_back(node + 1);
+			} else {
+				mOrderDirty = true;
+			}
+		}
+
+		MarkDirty(node);
+		return TransformHandle { slot, mSlots[slot].generation };
+	}
+
+	void TransformHierarchy::Destroy(TransformHandle handle) {
+		if (!IsAlive(handle)) {
+			return;
+		}
+
+		// The node and its descendants are dropped by the next Rebuild
+		u32 node = Node(handle);
+		mDestroyed[node] = 1;
+		mNodeSlots[node] = NO_SLOT;
+		mOrderDirty = true;
+
+		FreeSlot(handle.index);
+	}
+
+	bool TransformHierarchy::IsAlive(TransformHandle handle) const {
+		return handle.IsValid() && handle.index < mSlots.size() && mSlots[handle.index].generation == handle.generation;
+	}
+
+	void TransformHierarchy::SetParent(TransformHandle handle, TransformHandle parent) {
+		u32 node = Node(handle);
+		u32 parentNode = parent.IsValid() ? Node(parent) : NO_PARENT;
+
+		for (u32 ancestor = parentNode; ancestor != NO_PARENT; ancestor = mParents[ancestor]) {
+			RWD_ASSERT(ancestor != node, "A transform can't be parented to itself or its descendants");
+		}
+
+		mParents[node] = parentNode;
+		mOrderDirty = true;
+		MarkDirty(node);
+	}
+
+	void TransformHierarchy::SetLocal(TransformHandle handle, const Vec3& position, const Quat& rotation, const Vec3& scale) {
+		u32 node = Node(handle);
+		mPositions[node] = position;
+		mRotations[node] = rotation;
+		mScales[node] = scale;
+		MarkDirty(node);
+	}
+
+	void TransformHierarchy::SetPosition(TransformHandle handle, const Vec3& position) {
+		u32 node = Node(handle);
+		mPositions[node] = position;
+		MarkDirty(node);
+	}
+
+	void TransformHierarchy::SetRotation(TransformHandle handle, const Quat& rotation) {
+		u32 node = Node(handle);
+		mRotations[node] = rotation;
+		MarkDirty(node);
+	}
+
+	void TransformHierarchy::SetScale(TransformHandle handle, const Vec3& scale) {
+		u32 node = Node(handle);
+		mScales[node] = scale;
+		MarkDirty(node);
+	}
+
+	u32 TransformHierarchy::Node(TransformHandle handle) const {
+		RWD_ASSERT(IsAlive(handle), "Transform handle {0} is stale", handle.index);
+		return mSlots[handle.index].node;
+	}
+
+	void TransformHierarchy::MarkDirty(u32 node) {
+		mDirty[node] = 1;
+		mMinDirtyDepth = mAnyDirty ? std::min(mMinDirtyDepth, mDepths[node]) : mDepths[node];
+		mAnyDirty = true;
+	}
+
+	void TransformHierarchy::FreeSlot(u32 slot) {
+		// Generation 0 marks invalid handles, skip it when wrapping around
+		u32& generation = mSlots[slot].generation;
+		generation = generation + 1 == 0 ? 1 : generation + 1;
+		mFreeSlots.push_back(slot);
+	}
+
+	void TransformHierarchy::Rebuild() {
+		const u32 count = Count();
+		const u32 UNKNOWN = ~0u;
+
+		// Depths and whether an ancestor was destroyed, resolved top down by walking up to the
+		// nearest node already resolved. Each node is resolved once.
+		std::vector<u32> depths(count, UNKNOWN);
+		std::vector<u8> dropped(count, 0);
+		std::vector<u32> stack;
+
+		for (u32 i = 0; i < count; i++) {
+			u32 ancestor = i;
+			while (ancestor != NO_PARENT && depths[ancestor] == UNKNOWN) {
+				stack.push_back(ancestor);
+				ancestor = mParents[ancestor];
+			}
+
+			u32 depth = ancestor == NO_PARENT ? 0 : depths[ancestor] + 1;
+			bool drop = ancestor != NO_PARENT && dropped[ancestor];
+
+			while (!stack.empty()) {
+				u32 node = stack.back();
+				stack.pop_back();
+
+				drop = drop || mDestroyed[node];
+				depths[node] = depth++;
+				dropped[node] = drop;
+			}
+		}
+
+		// Counting sort by depth, stable so siblings keep their relative order
+		std::vector<u32> levelStarts { 0 };
+		for (u32 i = 0; i < count; i++) {
+			if (dropped[i]) {
+				continue;
+			}
+
+			if (depths[i] + 2 > levelStarts.size()) {
+				levelStarts.resize(depths[i] + 2, 0);
+			}
+			levelStarts[depths[i] + 1]++;
+		}
+
+		for (size_t level = 1; level < levelStarts.size(); level++) {
+			levelStarts[level] += levelStarts[level - 1];
+		}
+
+		std::vector<u32> newIndices(count, NO_PARENT);
+		std::vector<u32> next(levelStarts.begin(), levelStarts.end() - 1);
+		for (u32 i = 0; i < count; i++) {
+			if (dropped[i]) {
+				// Descendants of a destroyed node still hold their slots
+				if (mNodeSlots[i] != NO_SLOT) {
+					FreeSlot(mNodeSlots[i]);
+				}
+				continue;
+			}
+
+			newIndices[i] = next[depths[i]]++;
+		}
+
+		const u32 newCount = levelStarts.back();
+		std::vector<Vec3> positions(newCount);
+		std::vector<Quat> rotations(newCount);
+		std::vector<Vec3> scales(newCount);
+		std::vector<Mat4> world(newCount);
+		std::vector<u32> parents(newCount);
+		std::vector<u32> newDepths(newCount);
+		std::vector<u32> nodeSlots(newCount);
+		std::vector<u8> dirty(newCount);
+
+		for (u32 i = 0; i < count; i++) {
+			u32 node = newIndices[i];
+			if (node == NO_PARENT) {
+				continue;
+			}
+
+			positions[node] = mPositions[i];
+			rotations[node] = mRotations[i];
+			scales[node] = mScales[i];
+			world[node] = mWorld[i];
+			parents[node] = mParents[i] == NO_PARENT ? NO_PARENT : newIndices[mParents[i]];
+			newDepths[node] = depths[i];
+			nodeSlots[node] = mNodeSlots[i];
+			dirty[node] = mDirty[i];
+
+			mSlots[mNodeSlots[i]].node = node;
+		}
+
+		mPositions.swap(positions);
+		mRotations.swap(rotations);
+		mScales.swap(scales);
+		mWorld.swap(world);
+		mParents.swap(parents);
+		mDepths.swap(newDepths);
+		mNodeSlots.swap(nodeSlots);
+		mDirty.swap(dirty);
+		mDestroyed.assign(newCount, 0);
+		mLevelStarts.swap(levelStarts);
+
+		// Dirty depths were recorded before the move, reparented nodes may have changed level
+		mMinDirtyDepth = 0;
+		mOrderDirty = false;
+	}
+
+	u32 TransformHierarchy::UpdateRange(u32 begin, u32 end) {
+		u32 updated = 0;
+		u32 i = begin;
+
+		while (i < end) {
+			// Find the next run of nodes that need recomputing, so the local matrices can be built
+			// a whole register's worth at a time
+			auto needsUpdate = [this] (u32 node) {
+				return mDirty[node] || (mParents[node] != NO_PARENT && mDirty[mParents[node]]);
+			};
+
+			while (i < end && !needsUpdate(i)) {
+				i++;
+			}
+
+			u32 runBegin = i;
+			while (i < end && needsUpdate(i)) {
+				i++;
+			}
+
+			if (runBegin == i) {
+				break;
+			}
+
+			ComposeTransforms(&mRotations[runBegin], &mPositions[runBegin], &mScales[runBegin], &mWorld[runBegin], i - runBegin);
+
+			// Parents are a level up and already final. Flag the node so its children follow.
+			for (u32 node = runBegin; node < i; node++) {
+				if (mParents[node] != NO_PARENT) {
+					mWorld[node] = MulMat4(mWorld[mParents[node]], mWorld[node]);
+				}
+				mDirty[node] = 1;
+			}
+
+			updated += i - runBegin;
+		}
+
+		return updated;
+	}
+
+	void TransformHierarchy::Update() {
+		if (mOrderDirty) {
+			Rebuild();
+		}
+
+		mLastUpdateCount = 0;
+		if (!mAnyDirty) {
+			return;
+		}
+
+		std::atomic<u32> updated { 0 };
+
+		for (u32 level = mMinDirtyDepth; level < LevelCount(); level++) {
+			const u32 begin = mLevelStarts[level];
+			const u32 end = mLevelStarts[level + 1];
+
+			if (end - begin < PARALLEL_LEVEL_THRESHOLD) {
+				updated.fetch_add(UpdateRange(begin, end), std::memory_order_relaxed);
+				continue;
+			}
+
+			JobCounter counter;
+			u32 jobCount = (end - begin + NODES_PER_JOB - 1) / NODES_PER_JOB;
+			JobSystem::Dispatch(counter, jobCount, 1, [this, &updated, begin, end] (JobArgs args) {
+				u32 jobBegin = begin + args.jobIndex * NODES_PER_JOB;
+				u32 jobEnd = std::min(jobBegin + NODES_PER_JOB, end);
+				updated.fetch_add(UpdateRange(jobBegin, jobEnd), std::memory_order_relaxed);
+			});
+			JobSystem::Wait(counter);
+		}
+
+		std::fill(mDirty.begin() + mLevelStarts[mMinDirtyDepth], mDirty.end(), 0);
+		mAnyDirty = false;
+		mLastUpdateCount = updated.load(std::memory_order_relaxed);
+	}
+
+	void TransformHierarchy::CopyWorldMatrices(Mat4* dst) const {
+		memcpy(dst, mWorld.data(), mWorld.size() * sizeof(Mat4));
+	}
+
+}
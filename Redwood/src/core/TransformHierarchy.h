@@ -0,0 +1,110 @@
+#pragma once
+#include "pch.h"
+#include "Core.h"
+#include "Math.h"
+
+namespace rwd {
+
+	// Generational handle, the generation changes when the slot is reused
+	struct TransformHandle {
+		u32 index = 0;
+		u32 generation = 0;
+
+		bool IsValid() const { return generation != 0; }
+		bool operator==(const TransformHandle& other) const = default;
+	};
+
+	// Parent child transforms stored as flat arrays sorted by depth.
+	//
+	// Roots come first, then their children, then grandchildren, so each level only depends on
+	// the one before it and can be split over the job system once the previous level is done.
+	// Setting a local transform marks the node dirty, and Update only recomputes world matrices
+	// of dirty nodes and their descendants. When nothing changed Update returns immediately.
+	//
+	// The world matrices are stored in node order, ready to copy into an instance buffer as is.
+	// A node's position in that order is its InstanceIndex, which changes when nodes are created,
+	// destroyed or reparented, so look it up after Update.
+	//
+	// Not thread safe, modify and update from one thread.
+	class RWD_API TransformHierarchy {
+	public:
+		TransformHandle Create(TransformHandle parent = { }, const Vec3& position = Vec3(0.0f),
+			const Quat& rotation = Quat(1.0f, 0.0f, 0.0f, 0.0f), const Vec3& scale = Vec3(1.0f));
+
+		// Destroys the node's children with it
+		void Destroy(TransformHandle handle);
+		bool IsAlive(TransformHandle handle) const;
+
+		// An invalid parent makes the node a root. The parent can't be the node or one of its descendants.
+		void SetParent(TransformHandle handle, TransformHandle parent);
+
+		void SetLocal(TransformHandle handle, const Vec3& position, const Quat& rotation, const Vec3& scale);
+		void SetPosition(TransformHandle handle, const Vec3& position);
+		void SetRotation(TransformHandle handle, const Quat& rotation);
+		void SetScale(TransformHandle handle, const Vec3& scale);
+
+		const Vec3& Position(TransformHandle handle) const { return mPositions[Node(handle)]; }
+		const Quat& Rotation(TransformHandle handle) const { return mRotations[Node(handle)]; }
+		const Vec3& Scale(TransformHandle handle) const { return mScales[Node(handle)]; }
+
+		// As of the last Update
+		const Mat4& WorldMatrix(TransformHandle handle) const { return mWorld[Node(handle)]; }
+		u32 InstanceIndex(TransformHandle handle) const { return Node(handle); }
+
+		// Re-sorts the nodes after structural changes, then recomputes the dirty subtrees level by level
+		void Update();
+
+		// Copies every world matrix in instance order, dst needs room for Count() matrices.
+		// Meant for a persistently mapped buffer, e.g. a TransientBuffer's mapped pointer.
+		void CopyWorldMatrices(Mat4* dst) const;
+
+		u32 Count() const { return (u32)mWorld.size(); }
+		u32 LevelCount() const { return (u32)mLevelStarts.size() - 1; }
+
+		// World matrices the last Update recomputed
+		u32 LastUpdateCount() const { return mLastUpdateCount; }
+	private:
+		static const u32 NO_PARENT = ~0u;
+		static const u32 NO_SLOT = ~0u;
+
+		struct Slot {
+			u32 node = 0;
+			u32 generation = 1;
+		};
+
+		u32 Node(TransformHandle handle) const;
+		void MarkDirty(u32 node);
+		void FreeSlot(u32 slot);
+
+		// Drops destroyed subtrees, recomputes depths and stably sorts the nodes by depth
+		void Rebuild();
+
+		// Recomputes the nodes in [begin, end) that are dirty or have a dirty parent, returns how many did
+		u32 UpdateRange(u32 begin, u32 end);
+	private:
+		std::vector<Slot> mSlots;
+		std::vector<u32> mFreeSlots;
+
+		// Indexed by node
+		std::vector<Vec3> mPositions;
+		std::vector<Quat> mRotations;
+		std::vector<Vec3> mScales;
+		std::vector<Mat4> mWorld;
+		std::vector<u32> mParents;
+		std::vector<u32> mDepths;
+		std::vector<u32> mNodeSlots;
+		std::vector<u8> mDirty;
+		std::vector<u8> mDestroyed;
+
+		// Nodes of depth d are [mLevelStarts[d], mLevelStarts[d + 1])
+		std::vector<u32> mLevelStarts { 0 };
+
+		bool mOrderDirty = false;
+		bool mAnyDirty = false;
+
+		// Levels above the shallowest dirty node are skipped entirely
+		u32 mMinDirtyDepth = 0;
+		u32 mLastUpdateCount = 0;
+	};
+
+}
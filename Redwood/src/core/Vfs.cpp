@@ -0,0 +1,226 @@
+#include "pch.h"
+#include <filesystem>
+#include <shared_mutex>
+#include "Log.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "PackFile.h"
+#include "Vfs.h"
+
+namespace rwd {
+
+	struct VfsMount {
+		std::string mountPoint;
+
+		// Exactly one of these is used
+		std::string directory;
+		Scope<PackFile> pack;
+	};
+
+	static std::vector<VfsMount> mounts;
+	static std::shared_mutex mountsMutex;
+	static JobCounter packReadsCounter;
+
+	// Strips the mount point from the path, returns false if the path isn't under it
+	static bool RelativeToMount(const VfsMount& mount, const std::string& path, std::string& relative) {
+		if (mount.mountPoint.empty()) {
+			relative = path;
+			return true;
+		}
+
+		if (path.size() <= mount.mountPoint.size() || path.compare(0, mount.mountPoint.size(), mount.mountPoint) != 0 
+			|| path[mount.mountPoint.size()] != '/') 
+		{
+			return false;
+		}
+
+		relative = path.substr(mount.mountPoint.size() + 1);
+		return true;
+	}
+
+	std::string Vfs::NormalizePath(std::string_view path) {
+		std::string normalized(path);
+		std::replace(normalized.begin(), normalized.end(), '\\', '/');
+
+		size_t start = 0;
+		while (true) {
+			if (normalized.compare(start, 2, "./") == 0) {
+				start += 2;
+			} else if (start < normalized.size() && normalized[start] == '/') {
+				start += 1;
+			} else {
+				break;
+			}
+		}
+
+		while (normalized.size() > start && normalized.back() == '/') {
+			normalized.pop_back();
+		}
+
+		return normalized.substr(start);
+	}
+
+	bool Vfs::Mount(const std::string& source, const std::string& mountPoint) {
+		VfsMount mount;
+		mount.mountPoint = NormalizePath(mountPoint);
+
+		if (std::filesystem::is_directory(source)) {
+			mount.directory = source;
+		} 
+		else {
+			mount.pack = MakeScope<PackFile>();
+			if (!mount.pack->Open(source)) {
+				RWD_LOG_ERROR("Failed to mount {0}", source);
+				return false;
+			}
+		}
+
+		RWD_LOG_INFO("Mounted {0} at '{1}'", source, mount.mountPoint);
+
+		std::unique_lock lock(mountsMutex);
+		mounts.push_back(std::move(mount));
+		return true;
+	}
+
+	void Vfs::UnmountAll() {
+		// Packed reads reference the mapped pack files, so let them finish first
+		JobSystem::Wait(packReadsCounter);
+
+		std::unique_lock lock(mountsMutex);
+		mounts.clear();
+	}
+
+	bool Vfs::Exists(const std::string& path) {
+		std::string normalized = NormalizePath(path);
+		std::string relative;
+
+		std::shared_lock lock(mountsMutex);
+		for (auto mount = mounts.rbegin(); mount != mounts.rend(); mount++) {
+			if (!RelativeToMount(*mount, normalized, relative)) {
+				continue;
+			}
+
+			if (mount->pack ? mount->pack->Find(relative) != nullptr : std::filesystem::exists(mount->directory + "/" + relative)) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	std::string Vfs::LoosePath(const std::string& path) {
+		std::string normalized = NormalizePath(path);
+		std::string relative;
+
+		std::shared_lock lock(mountsMutex);
+		for (auto mount = mounts.rbegin(); mount != mounts.rend(); mount++) {
+			if (!RelativeToMount(*mount, normalized, relative)) {
+				continue;
+			}
+
+			// A packed copy overrides the loose files mounted before it
+			if (mount->pack) {
+				if (mount->pack->Find(relative) != nullptr) {
+					return "";
+				}
+				continue;
+			}
+
+			std::string filepath = mount->directory + "/" + relative;
+			if (std::filesystem::exists(filepath)) {
+				return filepath;
+			}
+		}
+
+		return "";
+	}
+
+	void Vfs::ReadFile(const std::string& path, AsyncIO::ReadCallback callback) {
+		std::string normalized = NormalizePath(path);
+		std::string relative;
+
+		std::shared_lock lock(mountsMutex);
+
+		// Walk the mounts newest first so later mounts override earlier ones
+		for (auto mount = mounts.rbegin(); mount != mounts.rend(); mount++) {
+			if (!RelativeToMount(*mount, normalized, relative)) {
+				continue;
+			}
+
+			if (!mount->pack) {
+				std::string filepath = mount->directory + "/" + relative;
+				if (std::filesystem::exists(filepath)) {
+					AsyncIO::ReadFile(filepath, std::move(callback));
+					return;
+				}
+				continue;
+			}
+
+			const PackEntry* entry = mount->pack->Find(relative);
+			if (!entry) {
+				continue;
+			}
+
+			const PackFile* pack = mount->pack.get();
+			JobSystem::Execute(packReadsCounter, [callback = std::move(callback), pack, entry, normalized] {
+				ReadResult result;
+				result.filepath = normalized;
+				result.success = pack->Read(*entry, result.buffer);
+				callback(std::move(result));
+			});
+
+			return;
+		}
+
+		RWD_LOG_ERROR("File {0} was not found in any mount", normalized);
+		callback(ReadResult { .filepath = normalized, .success = false });
+	}
+
+	ReadResult Vfs::ReadFileNow(const std::string& path) {
+		ReadResult result { .filepath = NormalizePath(path) };
+		std::string relative;
+
+		std::shared_lock lock(mountsMutex);
+		for (auto mount = mounts.rbegin(); mount != mounts.rend(); mount++) {
+			if (!RelativeToMount(*mount, result.filepath, relative)) {
+				continue;
+			}
+
+			if (!mount->pack) {
+				MappedFile file;
+				if (!std::filesystem::exists(mount->directory + "/" + relative) || !file.Open(mount->directory + "/" + relative)) {
+					continue;
+				}
+
+				result.buffer = IoBuffer(file.Size());
+				result.success = result.buffer.Data() != nullptr;
+				if (result.success && file.Size() > 0) {
+					memcpy(result.buffer.Data(), file.Data(), file.Size());
+				}
+				return result;
+			}
+
+			// Decompressing waits on its blocks by running jobs, so it's fine from a worker
+			const PackEntry* entry = mount->pack->Find(relative);
+			if (entry) {
+				result.success = mount->pack->Read(*entry, result.buffer);
+				return result;
+			}
+		}
+
+		RWD_LOG_ERROR("File {0} was not found in any mount", result.filepath);
+		return result;
+	}
+
+	std::future<ReadResult> Vfs::ReadFile(const std::string& path) {
+		Ref<std::promise<ReadResult>> promise = MakeRef<std::promise<ReadResult>>();
+		std::future<ReadResult> future = promise->get_future();
+
+		ReadFile(path, [promise] (ReadResult&& result) {
+			promise->set_value(std::move(result));
+		});
+
+		return future;
+	}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "pch.h"
+#include <future>
+#include "Core.h"
+#include "AsyncIO.h"
+
+namespace rwd {
+
+	// Virtual file system which resolves engine paths against a stack of mounts.
+	//
+	// A mount is either a loose directory or a .rwdpak pack file, attached at a mount point
+	// such as "shaders". Mounts added later take precedence, so mounting the loose source
+	// directories after the packs lets edited files override their packed copies during development.
+	//
+	// Mounting is expected to happen up front, reads are safe from any thread.
+	class RWD_API Vfs {
+	public:
+		static bool Mount(const std::string& source, const std::string& mountPoint = "");
+		static void UnmountAll();
+
+		static bool Exists(const std::string& path);
+
+		// Where the path resolves to on disk, empty when it's packed or not found. For tools that
+		// work on the files themselves, like watching them for changes.
+		static std::string LoosePath(const std::string& path);
+
+		// Loose files are read through AsyncIO, packed files are decompressed on the job system.
+		// The callback runs on an I/O or worker thread.
+		static void ReadFile(const std::string& path, AsyncIO::ReadCallback callback);
+		static std::future<ReadResult> ReadFile(const std::string& path);
+
+		// Reads on the calling thread. For jobs, which would deadlock the workers if they waited on
+		// a read that is itself queued on the job system.
+		static ReadResult ReadFileNow(const std::string& path);
+
+		// Converts to forward slashes and strips leading "./" and "/" so paths hash consistently
+		static std::string NormalizePath(std::string_view path);
+	};
+
+}
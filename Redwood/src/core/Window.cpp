@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "SDL.h"
 #include "Events.h"
+#include "Input.h"
 #include "renderer/OpenGL/OpenGLContext.h"
 #include "renderer/Vulkan/VulkanContext.h"
 #include "Window.h"
@@ -22,38 +23,57 @@ namespace rwd {
 	void Window::Update() {
 		SDL_Event sdlEvent;
 		while (SDL_PollEvent(&sdlEvent)) {
-			switch (sdlEvent.type) {
-				case(SDL_QUIT):
-					windowCloseEventHandler.Dispatch(WindowCloseEvent());
-					return;
-
-				case(SDL_WINDOWEVENT): {
-					switch (sdlEvent.window.event) {
-						case(SDL_WINDOWEVENT_RESIZED): {
-							int newWidth = sdlEvent.window.data1;
-							int newHeight = sdlEvent.window.data2;
-
-							mContext->ResizeRenderingSurface(newWidth, newHeight);
-
-							WindowResizeEvent e {
-								.width = newWidth,
-								.height = newHeight,
-							};
-							windowResizeEventHandler.Dispatch(e);
-							break;
-						}
+			if (!ProcessEvent(sdlEvent)) {
+				return;
+			}
+		}
+
+		mContext->SwapBuffers();
+	}
+
+	void Window::WaitEvents(u32 timeoutMs) {
+		SDL_Event sdlEvent;
+		if (SDL_WaitEventTimeout(&sdlEvent, (i32)timeoutMs) && !ProcessEvent(sdlEvent)) {
+			return;
+		}
+
+		Update();
+	}
+
+	bool Window::ProcessEvent(const SDL_Event& sdlEvent) {
+		switch (sdlEvent.type) {
+			case(SDL_QUIT):
+				windowCloseEvents.Post(WindowCloseEvent { });
+				return false;
+
+			case(SDL_WINDOWEVENT): {
+				switch (sdlEvent.window.event) {
+					case(SDL_WINDOWEVENT_RESIZED): {
+						int newWidth = sdlEvent.window.data1;
+						int newHeight = sdlEvent.window.data2;
+
+						mContext->ResizeRenderingSurface(newWidth, newHeight);
+
+						WindowResizeEvent e {
+							.width = newWidth,
+							.height = newHeight,
+						};
+						windowResizeEvents.Post(e);
+						break;
 					}
-					break;
 				}
+				break;
+			}
 
-				case(SDL_KEYDOWN):case(SDL_KEYUP): {
-					//Input::ProcessKeyboardEvent(sdlEvent.key);
-					break;
-				}
+			case(SDL_KEYDOWN):case(SDL_KEYUP):
+			case(SDL_MOUSEBUTTONDOWN):case(SDL_MOUSEBUTTONUP):
+			case(SDL_MOUSEMOTION):case(SDL_MOUSEWHEEL): {
+				Input::ProcessEvent(sdlEvent);
+				break;
 			}
 		}
 
-		mContext->SwapBuffers();
+		return true;
 	}
 
 	Window* Window::Create() {
@@ -2,6 +2,7 @@
 #include "Core.h"
 
 struct SDL_Window;
+union SDL_Event;
 
 namespace rwd {
 
@@ -18,7 +19,14 @@ namespace rwd {
 		void SetTitle(const char* title) const;
 		void SetResolution(i32 x, i32 y) const;
 	private:
+		// Handles every pending event, from the thread that created the window
 		void Update();
+
+		// Sleeps until an event arrives or the timeout passes, then handles the pending events
+		void WaitEvents(u32 timeoutMs);
+
+		// False once the window is asked to close
+		bool ProcessEvent(const SDL_Event& sdlEvent);
 		static Window* Create();
 	private:
 		SDL_Window* mSdlWindow;
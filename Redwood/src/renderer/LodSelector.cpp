@@ -0,0 +1,59 @@
+#include "pch.h"
+#include "core/JobSystem.h"
+#include "Mesh.h"
+#include "LodSelector.h"
+
+namespace rwd {
+
+	// Number of instances each job selects LODs for, small enough to balance 
+	// across workers but large enough to amortize the job overhead
+	const u32 LOD_SELECTION_BATCH_SIZE = 256;
+
+	f32 LodSelector::ComputeProjectionScale(f32 viewportHeight, f32 verticalFovRadians) {
+		return viewportHeight / (2.0f * std::tan(verticalFovRadians * 0.5f));
+	}
+
+	u32 LodSelector::SelectLod(const LodInstance& instance, const LodView& view, u32 currentLod) {
+		const std::vector<MeshLod>& lods = instance.mesh->mLods;
+		const u32 lastLod = (u32)lods.size() - 1;
+
+		// Use the distance to the closest point of the bounding sphere so large objects
+		// don't drop detail while the camera is right next to them
+		f32 distance = glm::distance(view.cameraPosition, instance.center) - instance.radius;
+		distance = std::max(distance, view.nearPlane);
+
+		f32 pixelsPerUnit = view.projectionScale * instance.scale / distance;
+		auto ProjectedError = [&] (u32 lod) { return lods[lod].error * pixelsPerUnit; };
+
+		const f32 refineThreshold = view.errorThresholdPixels * (1.0f + view.hysteresis);
+		const f32 coarsenThreshold = view.errorThresholdPixels * (1.0f - view.hysteresis);
+
+		u32 lod = std::min(currentLod, lastLod);
+
+		// Refine until the error fits, LOD 0 has no error so this always terminates
+		if (ProjectedError(lod) > refineThreshold) {
+			while (lod > 0 && ProjectedError(lod) > view.errorThresholdPixels) {
+				lod--;
+			}
+			return lod;
+		}
+
+		// Coarsen only while the next LOD is comfortably under the threshold
+		while (lod < lastLod && ProjectedError(lod + 1) <= coarsenThreshold) {
+			lod++;
+		}
+
+		return lod;
+	}
+
+	void LodSelector::SelectLods(const LodView& view, const std::vector<LodInstance>& instances, std::vector<u32>& lods) {
+		lods.resize(instances.size(), 0);
+
+		JobCounter counter;
+		JobSystem::Dispatch(counter, (u32)instances.size(), LOD_SELECTION_BATCH_SIZE, [&] (JobArgs args) {
+			lods[args.jobIndex] = SelectLod(instances[args.jobIndex], view, lods[args.jobIndex]);
+		});
+		JobSystem::Wait(counter);
+	}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "pch.h"
+#include "core/Core.h"
+#include "core/Math.h"
+
+namespace rwd {
+
+	class Mesh;
+
+	struct LodView {
+		Vec3 cameraPosition;
+
+		// Converts an object space error at distance 1 into pixels, 
+		// computed as viewportHeight / (2 * tan(verticalFov / 2))
+		f32 projectionScale;
+
+		f32 nearPlane = 0.1f;
+
+		// The largest on screen deviation in pixels we accept before switching to a finer LOD
+		f32 errorThresholdPixels = 1.0f;
+
+		// Fraction of the threshold used as a dead zone around LOD transitions,
+		// which stops instances sitting right at the boundary from popping back and forth
+		f32 hysteresis = 0.15f;
+	};
+
+	struct LodInstance {
+		const Mesh* mesh;
+
+		// World space bounding sphere and uniform scale of the instance
+		Vec3 center;
+		f32 radius;
+		f32 scale;
+	};
+
+	class LodSelector {
+	public:
+		static f32 ComputeProjectionScale(f32 viewportHeight, f32 verticalFovRadians);
+
+		// Picks the coarsest LOD whose projected error stays under the view's threshold,
+		// starting from the instance's current LOD to apply hysteresis
+		static u32 SelectLod(const LodInstance& instance, const LodView& view, u32 currentLod);
+
+		// Selects LODs for every instance in parallel on the job system.
+		// lods holds the current LOD of each instance and is updated in place.
+		static void SelectLods(const LodView& view, const std::vector<LodInstance>& instances, std::vector<u32>& lods);
+	};
+
+}
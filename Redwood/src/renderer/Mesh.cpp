@@ -1,13 +1,68 @@
 #include "pch.h"
+#include <cfloat>
+#include "core/Log.h"
 #include "Buffer.h"
 #include "OpenGL/OpenGLBuffer.h"
+#include "MeshSimplifier.h"
 #include "Mesh.h"
 
 namespace rwd {
 
-	Mesh::Mesh(std::vector<f32> verts, std::vector<u32> indices) {
-		mVerts = verts;
-		mIndices = indices;
+	Mesh::Mesh(std::vector<f32> verts, std::vector<u32> indices, u32 vertexStride)
+		: mVerts(std::move(verts)), mIndices(std::move(indices)), mVertexStride(vertexStride)
+	{
+		// The full detail mesh is always LOD 0
+		mLods.push_back(MeshLod { .indexOffset = 0, .indexCount = (u32)mIndices.size(), .error = 0.0f });
+
+		// Compute a bounding sphere from the center of the AABB, 
+		// which is good enough for LOD selection and culling
+		Vec3 boundsMin(FLT_MAX);
+		Vec3 boundsMax(-FLT_MAX);
+
+		for (size_t i = 0; i + 2 < mVerts.size(); i += mVertexStride) {
+			Vec3 pos(mVerts[i], mVerts[i + 1], mVerts[i + 2]);
+			boundsMin = glm::min(boundsMin, pos);
+			boundsMax = glm::max(boundsMax, pos);
+		}
+
+		mBoundsCenter = mVerts.empty() ? Vec3(0.0f) : (boundsMin + boundsMax) * 0.5f;
+		mBoundsRadius = 0.0f;
+
+		for (size_t i = 0; i + 2 < mVerts.size(); i += mVertexStride) {
+			Vec3 pos(mVerts[i], mVerts[i + 1], mVerts[i + 2]);
+			mBoundsRadius = std::max(mBoundsRadius, glm::distance(pos, mBoundsCenter));
+		}
+	}
+
+	void Mesh::GenerateLods(u32 maxLodCount, f32 reductionPerLod) {
+		RWD_ASSERT(mLods.size() == 1, "LODs have already been generated for this mesh");
+
+		const MeshLod& baseLod = mLods[0];
+		std::vector<u32> lodIndices(mIndices.begin() + baseLod.indexOffset, 
+			mIndices.begin() + baseLod.indexOffset + baseLod.indexCount);
+
+		for (u32 lod = 1; lod < maxLodCount; lod++) {
+			// Keep the index count a multiple of 3 so we always target whole triangles
+			size_t targetIndexCount = (size_t)(lodIndices.size() * reductionPerLod) / 3 * 3;
+
+			// Simplify from the previous LOD rather than LOD 0, 
+			// which is much cheaper and gives near identical results
+			SimplifyResult result = MeshSimplifier::Simplify(mVerts.data(), VertexCount(), mVertexStride, 
+				lodIndices, targetIndexCount);
+
+			// Stop once the simplifier can't make meaningful progress, 
+			// another LOD would just waste index buffer space
+			if (result.indices.empty() || result.indices.size() > lodIndices.size() * 0.9f) {
+				break;
+			}
+
+			// Errors are relative to the previous LOD, so summing them gives a conservative bound to LOD 0
+			f32 error = mLods.back().error + result.error;
+			mLods.push_back(MeshLod { .indexOffset = (u32)mIndices.size(), .indexCount = (u32)result.indices.size(), .error = error });
+			mIndices.insert(mIndices.end(), result.indices.begin(), result.indices.end());
+
+			lodIndices = std::move(result.indices);
+		}
 	}
 
 	size_t Mesh::VertexBufferSize() const {
@@ -18,4 +73,12 @@ namespace rwd {
 		return sizeof(mIndices[0]) * mIndices.size();
 	}
 
+	u32 Mesh::VertexCount() const {
+		return (u32)(mVerts.size() / mVertexStride);
+	}
+
+	u32 Mesh::LodCount() const {
+		return (u32)mLods.size();
+	}
+
 }
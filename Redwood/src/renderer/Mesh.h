@@ -1,20 +1,45 @@
 #pragma once
 #include "pch.h"
 #include "core/Core.h"
+#include "core/Math.h"
 
 namespace rwd {
 
-	class Mesh {
+	// A contiguous range of the mesh's index buffer which renders the mesh at a given level of detail.
+	// Every LOD shares the same vertex buffer, so switching LODs only changes the index range drawn.
+	struct MeshLod {
+		u32 indexOffset;
+		u32 indexCount;
+
+		// Maximum geometric deviation from LOD 0 in object space units
+		f32 error;
+	};
+
+	class RWD_API Mesh {
 	public:
-		Mesh(std::vector<f32> verts, std::vector<u32> indices);
+		// vertexStride is the number of floats per vertex, the first three of which must be the position.
+		// The vectors are taken by value so callers can std::move their data in without a copy.
+		Mesh(std::vector<f32> verts, std::vector<u32> indices, u32 vertexStride = 3);
+
+		// Simplifies LOD 0 into a chain of coarser LODs which are appended to the index buffer
+		void GenerateLods(u32 maxLodCount = 5, f32 reductionPerLod = 0.5f);
 
 		size_t VertexBufferSize() const;
 		size_t IndexBufferSize() const;
 
+		u32 VertexCount() const;
+		u32 LodCount() const;
+
 	public:
 		std::vector<f32> mVerts;
 		std::vector<u32> mIndices;
+		std::vector<MeshLod> mLods;
+
+		u32 mVertexStride;
+
+		// Object space bounding sphere, used for LOD selection and culling
+		Vec3 mBoundsCenter;
+		f32 mBoundsRadius;
 	};
 
 }
-
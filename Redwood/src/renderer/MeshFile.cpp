@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "core/Log.h"
+#include "core/MappedFile.h"
+#include "MeshFile.h"
+
+namespace rwd {
+
+	static u64 AlignUp(u64 value, u64 alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Read has checked this fits within the vertex section, so it can't overflow
+	size_t MeshFileView::VertexBufferSize() const {
+		return (size_t)((u64)metadata->vertexCount * metadata->vertexStride * sizeof(f32));
+	}
+
+	size_t MeshFileView::IndexBufferSize() const {
+		return sizeof(u32) * metadata->indexCount;
+	}
+
+	bool MeshFile::Write(const Mesh& mesh, const std::string& filepath) {
+		MeshFileMetadata metadata {
+			.vertexCount = mesh.VertexCount(),
+			.vertexStride = mesh.mVertexStride,
+			.indexCount = (u32)mesh.mIndices.size(),
+			.lodCount = mesh.LodCount(),
+			.boundsCenter = { mesh.mBoundsCenter.x, mesh.mBoundsCenter.y, mesh.mBoundsCenter.z },
+			.boundsRadius = mesh.mBoundsRadius,
+		};
+
+		struct SectionData {
+			MeshFileSectionType type;
+			const void* data;
+			u64 size;
+		};
+
+		SectionData sections[] = {
+			{ MeshFileSectionType::Metadata, &metadata, sizeof(metadata) },
+			{ MeshFileSectionType::Vertices, mesh.mVerts.data(), mesh.VertexBufferSize() },
+			{ MeshFileSectionType::Indices, mesh.mIndices.data(), mesh.IndexBufferSize() },
+			{ MeshFileSectionType::Lods, mesh.mLods.data(), sizeof(MeshLod) * mesh.mLods.size() },
+		};
+
+		const u32 sectionCount = (u32)std::size(sections);
+
+		MeshFileHeader header {
+			.magic = MESH_FILE_MAGIC,
+			.version = MESH_FILE_VERSION,
+			.sectionCount = sectionCount,
+			.flags = 0,
+		};
+
+		// Lay out the section data after the header and section table
+		std::vector<MeshFileSection> table(sectionCount);
+		u64 offset = sizeof(MeshFileHeader) + sizeof(MeshFileSection) * sectionCount;
+
+		for (u32 i = 0; i < sectionCount; i++) {
+			offset = AlignUp(offset, MESH_FILE_SECTION_ALIGNMENT);
+			table[i] = MeshFileSection { .type = sections[i].type, .reserved = 0, .offset = offset, .size = sections[i].size };
+			offset += sections[i].size;
+		}
+
+		std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			RWD_LOG_ERROR("Failed to open {0} for writing", filepath);
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)table.data(), sizeof(MeshFileSection) * table.size());
+
+		const char padding[MESH_FILE_SECTION_ALIGNMENT] = { };
+		for (u32 i = 0; i < sectionCount; i++) {
+			u64 position = (u64)file.tellp();
+			file.write(padding, table[i].offset - position);
+			file.write((const char*)sections[i].data, sections[i].size);
+		}
+
+		return file.good();
+	}
+
+	bool MeshFile::Read(const u8* data, size_t size, MeshFileView& view) {
+		view = MeshFileView { };
+
+		if (data == nullptr || size < sizeof(MeshFileHeader)) {
+			RWD_LOG_ERROR("Mesh file is too small to contain a header");
+			return false;
+		}
+
+		const MeshFileHeader* header = (const MeshFileHeader*)data;
+
+		if (header->magic != MESH_FILE_MAGIC) {
+			RWD_LOG_ERROR("Mesh file has an invalid magic number");
+			return false;
+		}
+
+		if (header->version != MESH_FILE_VERSION) {
+			RWD_LOG_ERROR("Mesh file version {0} is not supported, expected {1}", header->version, MESH_FILE_VERSION);
+			return false;
+		}
+
+		if (size < sizeof(MeshFileHeader) + sizeof(MeshFileSection) * (u64)header->sectionCount) {
+			RWD_LOG_ERROR("Mesh file section table is truncated");
+			return false;
+		}
+
+		const MeshFileSection* table = (const MeshFileSection*)(data + sizeof(MeshFileHeader));
+		u64 sectionSizes[(u32)MeshFileSectionType::Meshlets] = { };
+
+		for (u32 i = 0; i < header->sectionCount; i++) {
+			const MeshFileSection& section = table[i];
+
+			// Checked without adding the two, a crafted offset and size could wrap
+			if (section.offset > size || section.size > size - section.offset || section.offset % MESH_FILE_SECTION_ALIGNMENT != 0) {
+				RWD_LOG_ERROR("Mesh file section {0} is out of bounds or misaligned", i);
+				return false;
+			}
+
+			const u8* sectionData = data + section.offset;
+
+			if (section.type < MeshFileSectionType::Meshlets) {
+				sectionSizes[(u32)section.type] = section.size;
+			}
+
+			switch (section.type) {
+				case(MeshFileSectionType::Metadata): view.metadata = (const MeshFileMetadata*)sectionData; break;
+				case(MeshFileSectionType::Vertices): view.verts = (const f32*)sectionData; break;
+				case(MeshFileSectionType::Indices):  view.indices = (const u32*)sectionData; break;
+				case(MeshFileSectionType::Lods):     view.lods = (const MeshLod*)sectionData; break;
+
+				// Unknown sections are skipped so older readers can load newer files with optional data
+				default: break;
+			}
+		}
+
+		if (!view.metadata || !view.verts || !view.indices || !view.lods) {
+			RWD_LOG_ERROR("Mesh file is missing a required section");
+			view = MeshFileView { };
+			return false;
+		}
+
+		// Make sure the counts in the metadata can't send readers past the end of a section. The vertex
+		// count and stride are checked by dividing, multiplied out they could overflow.
+		const MeshFileMetadata& metadata = *view.metadata;
+		bool sizesValid = sectionSizes[(u32)MeshFileSectionType::Metadata] >= sizeof(MeshFileMetadata)
+			&& metadata.vertexStride > 0
+			&& metadata.vertexCount <= (sectionSizes[(u32)MeshFileSectionType::Vertices] / sizeof(f32)) / metadata.vertexStride
+			&& sectionSizes[(u32)MeshFileSectionType::Indices] >= (u64)metadata.indexCount * sizeof(u32)
+			&& sectionSizes[(u32)MeshFileSectionType::Lods] >= (u64)metadata.lodCount * sizeof(MeshLod);
+
+		if (!sizesValid) {
+			RWD_LOG_ERROR("Mesh file sections are smaller than its metadata describes");
+			view = MeshFileView { };
+			return false;
+		}
+
+		for (u32 i = 0; i < metadata.lodCount; i++) {
+			const MeshLod& lod = view.lods[i];
+			if (lod.indexOffset > metadata.indexCount || lod.indexCount > metadata.indexCount - lod.indexOffset) {
+				RWD_LOG_ERROR("Mesh file LOD {0} is outside of the index data", i);
+				view = MeshFileView { };
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool MeshFile::Read(const MappedFile& file, MeshFileView& view) {
+		return Read(file.Data(), file.Size(), view);
+	}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "pch.h"
+#include "core/Core.h"
+#include "Mesh.h"
+
+namespace rwd {
+
+	class MappedFile;
+
+	//-------------------------------------------------------------------------
+	//
+	// Binary Mesh Format (.rwdmesh)
+	//
+	// [MeshFileHeader][MeshFileSection * sectionCount][section data...]
+	//
+	// Every section starts on a MESH_FILE_SECTION_ALIGNMENT boundary so the data
+	// can be used straight out of a memory mapping without any parsing or copying.
+	// All values are little endian.
+	//
+	//-------------------------------------------------------------------------
+
+	const u32 MESH_FILE_MAGIC = 0x4D445752; // "RWDM"
+	const u32 MESH_FILE_VERSION = 1;
+	const u32 MESH_FILE_SECTION_ALIGNMENT = 64;
+
+	enum class MeshFileSectionType : u32 {
+		Metadata = 0, // MeshFileMetadata
+		Vertices = 1, // f32 * vertexCount * vertexStride
+		Indices  = 2, // u32 * indexCount, containing every LOD back to back
+		Lods     = 3, // MeshLod * lodCount
+		Meshlets = 4, // Reserved for meshlet data, readers skip it until meshlets are supported
+	};
+
+	struct MeshFileHeader {
+		u32 magic;
+		u32 version;
+		u32 sectionCount;
+		u32 flags;
+	};
+
+	struct MeshFileSection {
+		MeshFileSectionType type;
+		u32 reserved;
+		u64 offset; // From the start of the file
+		u64 size;   // In bytes
+	};
+
+	struct MeshFileMetadata {
+		u32 vertexCount;
+		u32 vertexStride; // In floats
+		u32 indexCount;
+		u32 lodCount;
+		f32 boundsCenter[3];
+		f32 boundsRadius;
+	};
+
+	static_assert(sizeof(MeshFileHeader) == 16, "Mesh file header layout changed");
+	static_assert(sizeof(MeshFileSection) == 24, "Mesh file section layout changed");
+	static_assert(sizeof(MeshLod) == 12, "MeshLod layout is part of the mesh file format");
+
+	// Non owning view of a mesh stored in a .rwdmesh file. 
+	// The pointers reference the file's memory and are valid as long as the file stays open.
+	struct MeshFileView {
+		const MeshFileMetadata* metadata = nullptr;
+		const f32* verts = nullptr;
+		const u32* indices = nullptr;
+		const MeshLod* lods = nullptr;
+
+		size_t VertexBufferSize() const;
+		size_t IndexBufferSize() const;
+	};
+
+	class RWD_API MeshFile {
+	public:
+		static bool Write(const Mesh& mesh, const std::string& filepath);
+
+		// Validates the header and section table and points the view at the section data
+		static bool Read(const u8* data, size_t size, MeshFileView& view);
+		static bool Read(const MappedFile& file, MeshFileView& view);
+	};
+
+}
@@ -0,0 +1,273 @@
+#include "pch.h"
+#include "core/Math.h"
+#include "MeshSimplifier.h"
+
+namespace rwd {
+
+	// Symmetric 4x4 matrix measuring the sum of squared distances to a set of planes.
+	// Planes are weighted by the area of the triangle they came from so large triangles
+	// dominate the error, and the weight is tracked to turn the sum back into a distance.
+	struct Quadric {
+		f64 a2, ab, ac, ad;
+		f64     b2, bc, bd;
+		f64         c2, cd;
+		f64             d2;
+		f64 weight;
+
+		static Quadric FromPlane(f64 a, f64 b, f64 c, f64 d, f64 w) {
+			return Quadric {
+				a * a * w, a * b * w, a * c * w, a * d * w,
+				           b * b * w, b * c * w, b * d * w,
+				                      c * c * w, c * d * w,
+				                                 d * d * w,
+				w,
+			};
+		}
+
+		Quadric& operator+=(const Quadric& q) {
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+			weight += q.weight;
+			return *this;
+		}
+
+		// Returns the weighted squared distance from p to the planes
+		f64 Evaluate(const Vec3& p) const {
+			f64 x = p.x, y = p.y, z = p.z;
+			f64 error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+			          + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+			          + c2 * z * z + 2.0 * cd * z
+			          + d2;
+
+			// Floating point error can push the result slightly negative
+			return std::max(error, 0.0);
+		}
+	};
+
+	struct Collapse {
+		f64 cost;
+		u32 from;
+		u32 to;
+	};
+
+	SimplifyResult MeshSimplifier::Simplify(const f32* verts, u32 vertexCount, u32 vertexStride,
+		const std::vector<u32>& indices, size_t targetIndexCount, f32 maxError)
+	{
+		auto Position = [verts, vertexStride] (u32 vertex) {
+			const f32* v = verts + (size_t)vertex * vertexStride;
+			return Vec3(v[0], v[1], v[2]);
+		};
+
+		std::vector<u32> result = indices;
+		f64 maxErrorSquared = (f64)maxError * (f64)maxError;
+		f64 resultErrorSquared = 0.0;
+
+		// Accumulate the plane of every triangle into the quadrics of its vertices
+		std::vector<Quadric> quadrics(vertexCount, Quadric { });
+		for (size_t i = 0; i + 2 < result.size(); i += 3) {
+			Vec3 p0 = Position(result[i]);
+			Vec3 p1 = Position(result[i + 1]);
+			Vec3 p2 = Position(result[i + 2]);
+
+			Vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			f32 doubleArea = glm::length(normal);
+			if (doubleArea <= 0.0f) {
+				continue;
+			}
+
+			normal /= doubleArea;
+			Quadric q = Quadric::FromPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0), doubleArea * 0.5f);
+
+			quadrics[result[i]] += q;
+			quadrics[result[i + 1]] += q;
+			quadrics[result[i + 2]] += q;
+		}
+
+		std::vector<u32> remap(vertexCount);
+		std::vector<u32> adjacencyOffsets(vertexCount + 1);
+		std::vector<u32> adjacency;
+		std::vector<u64> edges;
+		std::vector<Collapse> collapses;
+		std::vector<bool> locked(vertexCount);
+		std::vector<bool> touched(vertexCount);
+
+		// Every pass collapses a set of independent edges, cheapest first,
+		// then rebuilds the index buffer and repeats until we hit the target
+		while (result.size() > targetIndexCount) {
+			const u32 triangleCount = (u32)(result.size() / 3);
+
+			// Build vertex -> triangle adjacency so we can check collapses for flipped triangles
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (u32 index : result) {
+				adjacencyOffsets[index + 1]++;
+			}
+			for (u32 v = 0; v < vertexCount; v++) {
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+
+			adjacency.resize(result.size());
+			{
+				std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (u32 t = 0; t < triangleCount; t++) {
+					for (u32 k = 0; k < 3; k++) {
+						adjacency[fill[result[t * 3 + k]]++] = t;
+					}
+				}
+			}
+
+			// Gather the unique edges, an edge only used by one triangle is on the border of
+			// the mesh (or a UV / normal seam) and its vertices are locked to preserve the silhouette
+			edges.clear();
+			for (u32 t = 0; t < triangleCount; t++) {
+				for (u32 k = 0; k < 3; k++) {
+					u32 a = result[t * 3 + k];
+					u32 b = result[t * 3 + (k + 1) % 3];
+					edges.push_back(((u64)std::min(a, b) << 32) | std::max(a, b));
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+
+			std::fill(locked.begin(), locked.end(), false);
+			for (size_t i = 0; i < edges.size(); ) {
+				size_t run = 1;
+				while (i + run < edges.size() && edges[i + run] == edges[i]) {
+					run++;
+				}
+
+				if (run == 1) {
+					locked[(u32)(edges[i] >> 32)] = true;
+					locked[(u32)(edges[i] & 0xFFFFFFFF)] = true;
+				}
+
+				i += run;
+			}
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+			// Price every edge in its cheapest allowed direction
+			collapses.clear();
+			for (u64 edge : edges) {
+				u32 a = (u32)(edge >> 32);
+				u32 b = (u32)(edge & 0xFFFFFFFF);
+
+				Quadric q = quadrics[a];
+				q += quadrics[b];
+				f64 invWeight = q.weight > 0.0 ? 1.0 / q.weight : 0.0;
+
+				f64 costAToB = locked[a] ? DBL_MAX : q.Evaluate(Position(b)) * invWeight;
+				f64 costBToA = locked[b] ? DBL_MAX : q.Evaluate(Position(a)) * invWeight;
+
+				if (costAToB == DBL_MAX && costBToA == DBL_MAX) {
+					continue;
+				}
+
+				if (costAToB <= costBToA) {
+					collapses.push_back(Collapse { costAToB, a, b });
+				} else {
+					collapses.push_back(Collapse { costBToA, b, a });
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [] (const Collapse& lhs, const Collapse& rhs) {
+				return lhs.cost < rhs.cost;
+			});
+
+			// Checks that moving 'from' onto 'to' doesn't flip any of the triangles that survive the collapse
+			auto CollapseFlipsTriangles = [&] (u32 from, u32 to) {
+				Vec3 target = Position(to);
+
+				for (u32 i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; i++) {
+					const u32* tri = &result[adjacency[i] * 3];
+					if (tri[0] == to || tri[1] == to || tri[2] == to) {
+						continue;
+					}
+
+					Vec3 p[3] = { Position(tri[0]), Position(tri[1]), Position(tri[2]) };
+					Vec3 oldNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+					for (u32 k = 0; k < 3; k++) {
+						if (tri[k] == from) p[k] = target;
+					}
+					Vec3 newNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+					if (glm::dot(oldNormal, newNormal) <= 0.0f) {
+						return true;
+					}
+				}
+
+				return false;
+			};
+
+			for (u32 v = 0; v < vertexCount; v++) {
+				remap[v] = v;
+			}
+			std::fill(touched.begin(), touched.end(), false);
+
+			const size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+			size_t trianglesRemoved = 0;
+			u32 collapseCount = 0;
+
+			for (const Collapse& collapse : collapses) {
+				if (collapse.cost > maxErrorSquared) {
+					break;
+				}
+
+				// Only collapse edges whose neighbourhood hasn't changed yet this pass,
+				// otherwise the flip test and cost would be based on stale topology
+				if (touched[collapse.from] || touched[collapse.to]) {
+					continue;
+				}
+
+				if (CollapseFlipsTriangles(collapse.from, collapse.to)) {
+					continue;
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to] += quadrics[collapse.from];
+				resultErrorSquared = std::max(resultErrorSquared, collapse.cost);
+				collapseCount++;
+
+				for (u32 i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1]; i++) {
+					const u32* tri = &result[adjacency[i] * 3];
+					touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+
+					if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+						trianglesRemoved++;
+					}
+				}
+
+				if (trianglesRemoved >= trianglesToRemove) {
+					break;
+				}
+			}
+
+			if (collapseCount == 0) {
+				break;
+			}
+
+			// Apply the collapses and drop triangles which became degenerate
+			size_t writeIndex = 0;
+			for (size_t i = 0; i < result.size(); i += 3) {
+				u32 a = remap[result[i]];
+				u32 b = remap[result[i + 1]];
+				u32 c = remap[result[i + 2]];
+
+				if (a == b || b == c || a == c) {
+					continue;
+				}
+
+				result[writeIndex++] = a;
+				result[writeIndex++] = b;
+				result[writeIndex++] = c;
+			}
+			result.resize(writeIndex);
+		}
+
+		return SimplifyResult {
+			.indices = std::move(result),
+			.error = (f32)std::sqrt(resultErrorSquared),
+		};
+	}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "pch.h"
+#include <cfloat>
+#include "core/Core.h"
+
+namespace rwd {
+
+	struct SimplifyResult {
+		std::vector<u32> indices;
+
+		// Maximum geometric deviation introduced by the simplification in object space units
+		f32 error;
+	};
+
+	// Mesh simplification using quadric error metrics (Garland & Heckbert).
+	// 
+	// Edges are collapsed onto one of their existing endpoints rather than an optimal new position,
+	// so the simplified mesh only needs a new index buffer and can keep sharing the original vertices.
+	// This is what lets every LOD of a mesh live in one vertex buffer.
+	class MeshSimplifier {
+	public:
+		// verts is a tightly packed array of vertexCount vertices, each vertexStride floats wide 
+		// with the position in the first three floats
+		static SimplifyResult Simplify(const f32* verts, u32 vertexCount, u32 vertexStride, 
+			const std::vector<u32>& indices, size_t targetIndexCount, f32 maxError = FLT_MAX);
+	};
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "pch.h"
+#include "core/Core.h"
+#include "renderer/Vulkan/VulkanRenderer.h"
+
+namespace rwd {
+
+	// Everything rendering needs from a frame, built by OnRender and handed to the thread that draws it.
+	// Packets are reused, so once a few frames in the vectors stop allocating.
+	struct RenderPacket {
+		u64 frame = 0;
+		f64 alpha = 0.0;
+
+		// Pushed to the renderer's draw queue in order, build the keys with DrawSortKey
+		std::vector<u64> drawKeys;
+		std::vector<VulkanDrawCommand> draws;
+
+		void Draw(u64 sortKey, const VulkanDrawCommand& command) {
+			drawKeys.push_back(sortKey);
+			draws.push_back(command);
+		}
+
+		void Clear() {
+			drawKeys.clear();
+			draws.clear();
+		}
+	};
+
+}
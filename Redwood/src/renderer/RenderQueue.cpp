@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "core/JobSystem.h"
+#include "RenderQueue.h"
+
+namespace rwd {
+
+	const u32 RADIX_BITS = 8;
+	const u32 RADIX_BUCKETS = 1 << RADIX_BITS;
+	const u32 RADIX_PASSES = 64 / RADIX_BITS;
+
+	// Below this many draws a single thread sorts faster than the jobs can be handed out,
+	// and each job gets at least this many so the per chunk histograms stay worth it
+	const size_t PARALLEL_SORT_THRESHOLD = 16384;
+	const size_t MIN_ENTRIES_PER_SORT_JOB = 4096;
+
+	static u64 Field(u32 value, u32 bits) {
+		return (u64)value & ((1ull << bits) - 1);
+	}
+
+	u64 MakeSortKey(u32 layer, u32 pipeline, u32 material, u32 mesh, f32 depth, SortOrder order) {
+		const u32 maxDepth = (1u << SORT_KEY_DEPTH_BITS) - 1;
+		u32 quantizedDepth = (u32)(std::clamp(depth, 0.0f, 1.0f) * maxDepth);
+
+		u64 state = Field(pipeline, SORT_KEY_PIPELINE_BITS);
+		state = (state << SORT_KEY_MATERIAL_BITS) | Field(material, SORT_KEY_MATERIAL_BITS);
+		state = (state << SORT_KEY_MESH_BITS) | Field(mesh, SORT_KEY_MESH_BITS);
+
+		u64 key = Field(layer, SORT_KEY_LAYER_BITS);
+		if (order == SortOrder::FrontToBack) {
+			key = (key << (SORT_KEY_PIPELINE_BITS + SORT_KEY_MATERIAL_BITS + SORT_KEY_MESH_BITS)) | state;
+			key = (key << SORT_KEY_DEPTH_BITS) | quantizedDepth;
+		} else {
+			key = (key << SORT_KEY_DEPTH_BITS) | (maxDepth - quantizedDepth);
+			key = (key << (SORT_KEY_PIPELINE_BITS + SORT_KEY_MATERIAL_BITS + SORT_KEY_MESH_BITS)) | state;
+		}
+
+		return key;
+	}
+
+	// Runs fn for every chunk, on the job system when there's more than one
+	template<typename Fn>
+	static void ForEachChunk(u32 chunkCount, const Fn& fn) {
+		if (chunkCount == 1) {
+			fn(0);
+			return;
+		}
+
+		JobCounter counter;
+		JobSystem::Dispatch(counter, chunkCount, 1, [&fn] (JobArgs args) {
+			fn(args.jobIndex);
+		});
+		JobSystem::Wait(counter);
+	}
+
+	void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch) {
+		const size_t count = entries.size();
+		if (count < 2) {
+			return;
+		}
+
+		scratch.resize(count);
+
+		u32 chunkCount = 1;
+		if (count >= PARALLEL_SORT_THRESHOLD) {
+			chunkCount = (u32)std::min((size_t)JobSystem::ThreadCount() + 1, count / MIN_ENTRIES_PER_SORT_JOB);
+		}
+
+		const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+		// Each chunk counts its own digits, then turns the counts into the offsets it scatters to
+		std::vector<u32> histograms((size_t)chunkCount * RADIX_BUCKETS);
+
+		SortEntry* src = entries.data();
+		SortEntry* dst = scratch.data();
+
+		for (u32 pass = 0; pass < RADIX_PASSES; pass++) {
+			const u32 shift = pass * RADIX_BITS;
+
+			ForEachChunk(chunkCount, [&] (u32 chunk) {
+				u32* histogram = &histograms[(size_t)chunk * RADIX_BUCKETS];
+				std::fill(histogram, histogram + RADIX_BUCKETS, 0);
+
+				const size_t end = std::min((chunk + 1) * chunkSize, count);
+				for (size_t i = chunk * chunkSize; i < end; i++) {
+					histogram[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++;
+				}
+			});
+
+			// When every key has the same digit the pass wouldn't move anything. Common for
+			// the layer bits and for fields most draws share.
+			const u32 firstDigit = (u32)(src[0].key >> shift) & (RADIX_BUCKETS - 1);
+			size_t firstDigitCount = 0;
+			for (u32 chunk = 0; chunk < chunkCount; chunk++) {
+				firstDigitCount += histograms[(size_t)chunk * RADIX_BUCKETS + firstDigit];
+			}
+
+			if (firstDigitCount == count) {
+				continue;
+			}
+
+			// Offsets run through the buckets in order and through the chunks within each bucket,
+			// so equal digits keep their relative order and the sort stays stable
+			u32 offset = 0;
+			for (u32 bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+				for (u32 chunk = 0; chunk < chunkCount; chunk++) {
+					u32& slot = histograms[(size_t)chunk * RADIX_BUCKETS + bucket];
+					u32 bucketCount = slot;
+					slot = offset;
+					offset += bucketCount;
+				}
+			}
+
+			ForEachChunk(chunkCount, [&] (u32 chunk) {
+				u32* offsets = &histograms[(size_t)chunk * RADIX_BUCKETS];
+
+				const size_t end = std::min((chunk + 1) * chunkSize, count);
+				for (size_t i = chunk * chunkSize; i < end; i++) {
+					dst[offsets[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+				}
+			});
+
+			std::swap(src, dst);
+		}
+
+		// An odd number of passes leaves the result in scratch
+		if (src != entries.data()) {
+			entries.swap(scratch);
+		}
+	}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "pch.h"
+#include "core/Core.h"
+
+namespace rwd {
+
+	// Draws are ordered by a 64 bit key so that sorting groups draws sharing state together.
+	// From the most significant bits down an opaque key is
+	//
+	//   layer (4) | pipeline (12) | material (16) | mesh (16) | depth (16)
+	//
+	// so pipelines change least often, then materials, then meshes, and draws with identical
+	// state go front to back to make the most of early depth testing. Blended draws have to
+	// go back to front regardless of state, so their depth moves up next to the layer, inverted.
+	enum class SortOrder {
+		FrontToBack,
+		BackToFront,
+	};
+
+	const u32 SORT_KEY_LAYER_BITS = 4;
+	const u32 SORT_KEY_PIPELINE_BITS = 12;
+	const u32 SORT_KEY_MATERIAL_BITS = 16;
+	const u32 SORT_KEY_MESH_BITS = 16;
+	const u32 SORT_KEY_DEPTH_BITS = 16;
+
+	// Fields wider than their bits are truncated. Depth is view depth normalized to 0-1.
+	u64 MakeSortKey(u32 layer, u32 pipeline, u32 material, u32 mesh, f32 depth, SortOrder order = SortOrder::FrontToBack);
+
+	struct SortEntry {
+		u64 key;
+		u32 index;
+	};
+
+	// Stable LSD radix sort on the keys, 8 bits a pass. Large inputs are split over the job system,
+	// and passes over digits every key shares are skipped. scratch is resized as needed.
+	void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
+
+	// What walking the sorted queue cost, filled in by the backend each frame
+	struct RenderQueueStats {
+		u32 draws = 0;
+		u32 pipelineBinds = 0;
+		u32 descriptorSetBinds = 0;
+		u32 vertexBufferBinds = 0;
+		u32 indexBufferBinds = 0;
+	};
+
+	// A frame's draws for one backend. Commands are stored as pushed and only the keys are sorted,
+	// so commands of any size cost the same to sort. Not thread safe, push from one thread.
+	template<typename Command>
+	class RenderQueue {
+	public:
+		void Push(u64 key, const Command& command) {
+			mEntries.push_back(SortEntry { .key = key, .index = (u32)mCommands.size() });
+			mCommands.push_back(command);
+		}
+
+		void Sort() {
+			RadixSort(mEntries, mScratch);
+		}
+
+		// Visits the commands in key order, call Sort first
+		template<typename Fn>
+		void ForEach(Fn&& fn) const {
+			for (const SortEntry& entry : mEntries) {
+				fn(mCommands[entry.index]);
+			}
+		}
+
+		// Keeps the capacity, so a steady scene stops allocating after the first few frames
+		void Clear() {
+			mEntries.clear();
+			mCommands.clear();
+		}
+
+		size_t Size() const { return mEntries.size(); }
+	private:
+		std::vector<SortEntry> mEntries;
+		std::vector<SortEntry> mScratch;
+		std::vector<Command> mCommands;
+	};
+
+}
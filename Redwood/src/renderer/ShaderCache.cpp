@@ -0,0 +1,286 @@
+#include "pch.h"
+#include <algorithm>
+#include <filesystem>
+#include "core/Log.h"
+#include "core/Hash.h"
+#include "ShaderCache.h"
+
+namespace rwd {
+
+	u64 ShaderPermutation::Key() const {
+		std::vector<std::string> sorted = defines;
+		std::sort(sorted.begin(), sorted.end());
+
+		// Separated so "A" "BC" and "AB" "C" differ
+		u64 hash = HashString(path);
+		for (const std::string& define : sorted) {
+			hash = HashString(define, HashBytes("\n", 1, hash));
+		}
+
+		return HashBytes(&features, sizeof(features), hash);
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Shader Cache
+	//
+	//-------------------------------------------------------------------------
+
+	void ShaderCache::Open(const std::string& filepath) {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		mFilepath = filepath;
+		mBlobs.clear();
+		mPermutations.clear();
+		mDirty = false;
+		mFile.Close();
+
+		if (std::filesystem::exists(filepath) && mFile.Open(filepath)) {
+			Load();
+		}
+	}
+
+	// Called with the lock held and the file mapped
+	void ShaderCache::Load() {
+		const u8* data = mFile.Data();
+		const size_t size = mFile.Size();
+		const ShaderCacheHeader* header = (const ShaderCacheHeader*)data;
+
+		if (size < sizeof(ShaderCacheHeader) || header->magic != SHADER_CACHE_MAGIC || header->version != SHADER_CACHE_VERSION) {
+			RWD_LOG_WARN("Shader cache {0} is from another version, starting an empty one", mFilepath);
+			return;
+		}
+
+		// Checked without adding offsets and sizes, a corrupt file could wrap them
+		if (header->blobsOffset > size || sizeof(ShaderCacheBlob) * (u64)header->blobCount > size - header->blobsOffset ||
+			header->permutationsOffset > size || sizeof(ShaderCachePermutation) * (u64)header->permutationCount > size - header->permutationsOffset)
+		{
+			RWD_LOG_WARN("Shader cache {0} is truncated, starting an empty one", mFilepath);
+			return;
+		}
+
+		// The index is read in place, so it has to be aligned within the mapping
+		if (header->blobsOffset % alignof(ShaderCacheBlob) != 0 || header->permutationsOffset % alignof(ShaderCachePermutation) != 0) {
+			RWD_LOG_WARN("Shader cache {0} has a misaligned index, starting an empty one", mFilepath);
+			return;
+		}
+
+		memcpy(mIdentifierAlgorithm, header->identifierAlgorithm, sizeof(mIdentifierAlgorithm));
+
+		const ShaderCacheBlob* blobs = (const ShaderCacheBlob*)(data + header->blobsOffset);
+		for (u32 i = 0; i < header->blobCount; i++) {
+			const ShaderCacheBlob& entry = blobs[i];
+			if (entry.offset > size || entry.size > size - entry.offset || entry.offset % sizeof(u32) != 0 || entry.size % sizeof(u32) != 0 ||
+				entry.identifierSize > SHADER_IDENTIFIER_MAX_SIZE)
+			{
+				continue;
+			}
+
+			Blob& blob = mBlobs[entry.hash];
+			blob.spirv = std::span<const u32>((const u32*)(data + entry.offset), entry.size / sizeof(u32));
+			blob.identifierSize = entry.identifierSize;
+			memcpy(blob.identifier, entry.identifier, entry.identifierSize);
+		}
+
+		const ShaderCachePermutation* permutations = (const ShaderCachePermutation*)(data + header->permutationsOffset);
+		for (u32 i = 0; i < header->permutationCount; i++) {
+			mPermutations[permutations[i].key] = Permutation { .sourceHash = permutations[i].sourceHash, .blobHash = permutations[i].blobHash };
+		}
+
+		RWD_LOG_INFO("Opened shader cache {0} with {1} permutations of {2} shaders", mFilepath, mPermutations.size(), mBlobs.size());
+	}
+
+	bool ShaderCache::Save() {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		if (!mDirty || mFilepath.empty()) {
+			return true;
+		}
+
+		std::string tempPath = mFilepath + ".tmp";
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) {
+			RWD_LOG_ERROR("Failed to open {0} for writing", tempPath);
+			return false;
+		}
+
+		// Reserve space for the header, it gets written last once we know the offsets
+		ShaderCacheHeader header { };
+		out.write((const char*)&header, sizeof(header));
+
+		std::vector<ShaderCacheBlob> blobs;
+		blobs.reserve(mBlobs.size());
+
+		for (const auto& [hash, blob] : mBlobs) {
+			ShaderCacheBlob entry {
+				.hash = hash,
+				.offset = (u64)out.tellp(),
+				.size = (u32)blob.spirv.size_bytes(),
+				.identifierSize = blob.identifierSize,
+			};
+			memcpy(entry.identifier, blob.identifier, sizeof(entry.identifier));
+			blobs.push_back(entry);
+
+			out.write((const char*)blob.spirv.data(), blob.spirv.size_bytes());
+		}
+
+		std::vector<ShaderCachePermutation> permutations;
+		permutations.reserve(mPermutations.size());
+
+		for (const auto& [key, permutation] : mPermutations) {
+			permutations.push_back(ShaderCachePermutation { .key = key, .sourceHash = permutation.sourceHash, .blobHash = permutation.blobHash });
+		}
+
+		// Keep the index aligned so it can be read in place from the mapping
+		const char padding[alignof(ShaderCacheBlob)] = { };
+		out.write(padding, (alignof(ShaderCacheBlob) - (u64)out.tellp() % alignof(ShaderCacheBlob)) % alignof(ShaderCacheBlob));
+
+		header = ShaderCacheHeader {
+			.magic = SHADER_CACHE_MAGIC,
+			.version = SHADER_CACHE_VERSION,
+			.blobCount = (u32)blobs.size(),
+			.permutationCount = (u32)permutations.size(),
+			.blobsOffset = (u64)out.tellp(),
+			.permutationsOffset = (u64)out.tellp() + sizeof(ShaderCacheBlob) * blobs.size(),
+		};
+		memcpy(header.identifierAlgorithm, mIdentifierAlgorithm, sizeof(mIdentifierAlgorithm));
+
+		out.write((const char*)blobs.data(), sizeof(ShaderCacheBlob) * blobs.size());
+		out.write((const char*)permutations.data(), sizeof(ShaderCachePermutation) * permutations.size());
+
+		out.seekp(0);
+		out.write((const char*)&header, sizeof(header));
+		out.close();
+
+		if (!out.good()) {
+			RWD_LOG_ERROR("Failed to write shader cache {0}", tempPath);
+			return false;
+		}
+
+		// The mapping has to go before the file can be replaced on Windows. Blobs read from it are
+		// copied out first, so nothing is lost if the replace fails.
+		for (auto& [hash, blob] : mBlobs) {
+			if (blob.ownedSpirv.empty()) {
+				blob.ownedSpirv.assign(blob.spirv.begin(), blob.spirv.end());
+				blob.spirv = blob.ownedSpirv;
+			}
+		}
+		mFile.Close();
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, mFilepath, error);
+		if (error) {
+			RWD_LOG_ERROR("Failed to replace shader cache {0}: {1}", mFilepath, error.message());
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+
+		// Everything is on disk now, so the copies can go in favour of the new mapping
+		mDirty = false;
+		if (mFile.Open(mFilepath)) {
+			mBlobs.clear();
+			mPermutations.clear();
+			Load();
+		}
+
+		return true;
+	}
+
+	bool ShaderCache::Find(u64 key, u64 sourceHash, u64& blobHash) const {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto permutation = mPermutations.find(key);
+		if (permutation == mPermutations.end() || (sourceHash != 0 && permutation->second.sourceHash != sourceHash)) {
+			return false;
+		}
+
+		if (mBlobs.find(permutation->second.blobHash) == mBlobs.end()) {
+			return false;
+		}
+
+		blobHash = permutation->second.blobHash;
+		return true;
+	}
+
+	u64 ShaderCache::Add(u64 key, u64 sourceHash, std::span<const u32> spirv) {
+		u64 blobHash = HashBytes(spirv.data(), spirv.size_bytes());
+
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto [blob, added] = mBlobs.try_emplace(blobHash);
+		if (added) {
+			blob->second.ownedSpirv.assign(spirv.begin(), spirv.end());
+			blob->second.spirv = blob->second.ownedSpirv;
+		}
+
+		mPermutations[key] = Permutation { .sourceHash = sourceHash, .blobHash = blobHash };
+		mDirty = true;
+		return blobHash;
+	}
+
+	std::span<const u32> ShaderCache::Spirv(u64 blobHash) const {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto blob = mBlobs.find(blobHash);
+		return blob != mBlobs.end() ? blob->second.spirv : std::span<const u32>();
+	}
+
+	void ShaderCache::SetIdentifierAlgorithm(std::span<const u8> algorithm) {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		u8 newAlgorithm[SHADER_IDENTIFIER_ALGORITHM_SIZE] = { };
+		memcpy(newAlgorithm, algorithm.data(), std::min(algorithm.size(), sizeof(newAlgorithm)));
+
+		if (memcmp(newAlgorithm, mIdentifierAlgorithm, sizeof(newAlgorithm)) == 0) {
+			return;
+		}
+
+		memcpy(mIdentifierAlgorithm, newAlgorithm, sizeof(newAlgorithm));
+		for (auto& [hash, blob] : mBlobs) {
+			blob.identifierSize = 0;
+		}
+		mDirty = true;
+	}
+
+	bool ShaderCache::HasIdentifier(u64 blobHash) const {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto blob = mBlobs.find(blobHash);
+		return blob != mBlobs.end() && blob->second.identifierSize > 0;
+	}
+
+	std::span<const u8> ShaderCache::Identifier(u64 blobHash) const {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto blob = mBlobs.find(blobHash);
+		if (blob == mBlobs.end()) {
+			return { };
+		}
+
+		return std::span<const u8>(blob->second.identifier, blob->second.identifierSize);
+	}
+
+	void ShaderCache::SetIdentifier(u64 blobHash, std::span<const u8> identifier) {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto blob = mBlobs.find(blobHash);
+		if (blob == mBlobs.end() || identifier.size() > SHADER_IDENTIFIER_MAX_SIZE) {
+			return;
+		}
+
+		memcpy(blob->second.identifier, identifier.data(), identifier.size());
+		blob->second.identifierSize = (u32)identifier.size();
+		mDirty = true;
+	}
+
+	u32 ShaderCache::BlobCount() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return (u32)mBlobs.size();
+	}
+
+	u32 ShaderCache::PermutationCount() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return (u32)mPermutations.size();
+	}
+
+}
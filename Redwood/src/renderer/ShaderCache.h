@@ -0,0 +1,125 @@
+#pragma once
+#include "pch.h"
+#include <mutex>
+#include <span>
+#include "core/Core.h"
+#include "core/MappedFile.h"
+
+namespace rwd {
+
+	//-------------------------------------------------------------------------
+	//
+	// Shader Cache Format (.rwdshc)
+	//
+	// [ShaderCacheHeader][SPIR-V...][ShaderCacheBlob * blobCount][ShaderCachePermutation * permutationCount]
+	//
+	// SPIR-V is stored once per distinct binary, keyed by the hash of its contents, so permutations
+	// compiling to the same code share it. Each permutation maps to the blob it compiled to, along
+	// with the hash of the source it was compiled from so an edited source is compiled again.
+	//
+	// Blobs can carry the driver's identifier for their module (VK_EXT_shader_module_identifier),
+	// only valid for the identifier algorithm in the header.
+	//
+	//-------------------------------------------------------------------------
+
+	const u32 SHADER_CACHE_MAGIC = 0x43535752; // "RWSC"
+	const u32 SHADER_CACHE_VERSION = 1;
+	const u32 SHADER_IDENTIFIER_MAX_SIZE = 32;
+	const u32 SHADER_IDENTIFIER_ALGORITHM_SIZE = 16;
+
+	struct ShaderCacheHeader {
+		u32 magic;
+		u32 version;
+		u32 blobCount;
+		u32 permutationCount;
+		u64 blobsOffset;
+		u64 permutationsOffset;
+		u8 identifierAlgorithm[SHADER_IDENTIFIER_ALGORITHM_SIZE];
+	};
+
+	struct ShaderCacheBlob {
+		u64 hash;
+		u64 offset;
+		u32 size;
+		u32 identifierSize;
+		u8 identifier[SHADER_IDENTIFIER_MAX_SIZE];
+	};
+
+	struct ShaderCachePermutation {
+		u64 key;
+		u64 sourceHash;
+		u64 blobHash;
+	};
+
+	static_assert(sizeof(ShaderCacheHeader) == 48, "Shader cache header layout changed");
+	static_assert(sizeof(ShaderCacheBlob) == 56, "Shader cache blob layout changed");
+	static_assert(sizeof(ShaderCachePermutation) == 24, "Shader cache permutation layout changed");
+
+	// One compiled variant of a shader source. Defines are "NAME" or "NAME=VALUE" and their order
+	// doesn't matter. Features reach the shader as RWD_FEATURES, for bits a source tests with #if.
+	struct ShaderPermutation {
+		std::string path;
+		std::vector<std::string> defines;
+		u64 features = 0;
+
+		u64 Key() const;
+	};
+
+	// Compiled SPIR-V of every shader permutation seen, kept across runs in a single file.
+	//
+	// Opening only reads the index, SPIR-V is read from a mapping of the file as it's asked for.
+	// Additions are kept in memory until Save writes the whole cache out again. Everything but
+	// Open and Save is safe from any thread.
+	class RWD_API ShaderCache {
+	public:
+		// A missing or unreadable file starts an empty cache
+		void Open(const std::string& filepath);
+
+		// Writes to a temporary file which then replaces the cache, so an interrupted save loses
+		// nothing. Invalidates the spans returned by Spirv.
+		bool Save();
+
+		// Finds the blob the permutation compiled to. A source hash of 0 accepts whatever was
+		// compiled, for sources that aren't shipped.
+		bool Find(u64 key, u64 sourceHash, u64& blobHash) const;
+
+		// Returns the blob's hash
+		u64 Add(u64 key, u64 sourceHash, std::span<const u32> spirv);
+
+		// Empty if the blob isn't cached
+		std::span<const u32> Spirv(u64 blobHash) const;
+
+		// Identifiers made by another algorithm are dropped when it's set
+		void SetIdentifierAlgorithm(std::span<const u8> algorithm);
+		bool HasIdentifier(u64 blobHash) const;
+		std::span<const u8> Identifier(u64 blobHash) const;
+		void SetIdentifier(u64 blobHash, std::span<const u8> identifier);
+
+		u32 BlobCount() const;
+		u32 PermutationCount() const;
+	private:
+		struct Blob {
+			std::span<const u32> spirv;
+			std::vector<u32> ownedSpirv; // Added this run, otherwise spirv points into the mapping
+			u32 identifierSize = 0;
+			u8 identifier[SHADER_IDENTIFIER_MAX_SIZE] = { };
+		};
+
+		struct Permutation {
+			u64 sourceHash;
+			u64 blobHash;
+		};
+
+		void Load();
+	private:
+		std::string mFilepath;
+		MappedFile mFile;
+		mutable std::mutex mMutex;
+
+		std::unordered_map<u64, Blob> mBlobs;
+		std::unordered_map<u64, Permutation> mPermutations;
+		u8 mIdentifierAlgorithm[SHADER_IDENTIFIER_ALGORITHM_SIZE] = { };
+		bool mDirty = false;
+	};
+
+}
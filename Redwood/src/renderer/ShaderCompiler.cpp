@@ -0,0 +1,116 @@
+#include "pch.h"
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include "core/Hash.h"
+#include "ShaderCompiler.h"
+
+#ifdef RWD_SHADERC
+	#include "shaderc/shaderc.h"
+#endif
+
+namespace rwd {
+
+	static bool ReadFileContents(const std::string& filepath, std::string& contents) {
+		std::ifstream file(filepath, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+
+		std::stringstream stream;
+		stream << file.rdbuf();
+		contents = stream.str();
+		return true;
+	}
+
+#ifdef RWD_SHADERC
+
+	static bool StageFromPath(const std::string& filepath, shaderc_shader_kind& kind) {
+		std::string extension = std::filesystem::path(filepath).extension().string();
+
+		if (extension == ".vert") {
+			kind = shaderc_vertex_shader;
+		} else if (extension == ".frag") {
+			kind = shaderc_fragment_shader;
+		} else if (extension == ".comp") {
+			kind = shaderc_compute_shader;
+		} else {
+			return false;
+		}
+
+		return true;
+	}
+
+	bool CompileGlsl(const std::string& filepath, std::vector<u32>& spirv, std::string& errors, const std::vector<std::string>& defines) {
+		// The compiler can be shared by threads compiling at the same time
+		static shaderc_compiler_t compiler = shaderc_compiler_initialize();
+
+		shaderc_shader_kind kind;
+		if (!StageFromPath(filepath, kind)) {
+			errors = "Unknown shader stage for " + filepath;
+			return false;
+		}
+
+		std::string source;
+		if (!ReadFileContents(filepath, source)) {
+			errors = "Failed to read " + filepath;
+			return false;
+		}
+
+		shaderc_compile_options_t options = shaderc_compile_options_initialize();
+		for (const std::string& define : defines) {
+			size_t equals = std::min(define.find('='), define.size());
+			const char* value = equals < define.size() ? define.data() + equals + 1 : nullptr;
+			shaderc_compile_options_add_macro_definition(options, define.data(), equals, value, value ? define.size() - equals - 1 : 0);
+		}
+
+		shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler, source.data(), source.size(), 
+			kind, filepath.c_str(), "main", options);
+		shaderc_compile_options_release(options);
+
+		bool success = shaderc_result_get_compilation_status(result) == shaderc_compilation_status_success;
+		if (success) {
+			const u32* words = (const u32*)shaderc_result_get_bytes(result);
+			spirv.assign(words, words + shaderc_result_get_length(result) / sizeof(u32));
+		} else {
+			errors = shaderc_result_get_error_message(result);
+		}
+
+		shaderc_result_release(result);
+		return success;
+	}
+
+#else
+
+	bool CompileGlsl(const std::string& filepath, std::vector<u32>& spirv, std::string& errors, const std::vector<std::string>& defines) {
+		// Output names unique to each compile, the same file may be compiling on another thread
+		static std::atomic<u32> compileCount { 0 };
+		std::string name = "rwd_" + std::to_string(HashString(filepath)) + "_" + std::to_string(compileCount.fetch_add(1));
+		std::filesystem::path outputPath = std::filesystem::temp_directory_path() / (name + ".spv");
+		std::filesystem::path logPath = std::filesystem::temp_directory_path() / (name + ".log");
+
+		std::string command = "glslc \"" + filepath + "\" -o \"" + outputPath.string() + "\"";
+		for (const std::string& define : defines) {
+			command += " \"-D" + define + "\"";
+		}
+		command += " 2> \"" + logPath.string() + "\"";
+		bool success = std::system(command.c_str()) == 0;
+
+		std::string output;
+		if (success && ReadFileContents(outputPath.string(), output) && output.size() % sizeof(u32) == 0) {
+			spirv.resize(output.size() / sizeof(u32));
+			memcpy(spirv.data(), output.data(), output.size());
+		} else {
+			success = false;
+			ReadFileContents(logPath.string(), errors);
+		}
+
+		std::error_code error;
+		std::filesystem::remove(outputPath, error);
+		std::filesystem::remove(logPath, error);
+		return success;
+	}
+
+#endif
+
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "pch.h"
+#include "core/Core.h"
+
+namespace rwd {
+
+	// Compiles a GLSL file to SPIR-V for Vulkan, the stage comes from the extension (.vert, .frag, .comp).
+	// Safe to call from several threads at once, so compiles can run as jobs.
+	//
+	// Built with RWD_SHADERC the compiler is shaderc, linked into the engine. Otherwise it runs glslc,
+	// which ships with the Vulkan SDK and has to be on the PATH. On failure errors holds the
+	// compiler's messages. Defines are "NAME" or "NAME=VALUE", as with -D.
+	RWD_API bool CompileGlsl(const std::string& filepath, std::vector<u32>& spirv, std::string& errors,
+		const std::vector<std::string>& defines = { });
+
+}
@@ -0,0 +1,732 @@
+#include "pch.h"
+#include <cmath>
+#include <numeric>
+#include <atomic>
+#include "zstd.h"
+#include "core/Log.h"
+#include "core/JobSystem.h"
+#include "TextureFile.h"
+
+namespace rwd {
+
+	static const TextureFormatInfo sFormatInfos[] = {
+		{ "Unknown",       1, 1, 0,  false, false },
+		{ "RGBA8",         1, 1, 4,  false, false },
+		{ "RGBA8_SRGB",    1, 1, 4,  false, true  },
+		{ "BGRA8",         1, 1, 4,  false, false },
+		{ "BGRA8_SRGB",    1, 1, 4,  false, true  },
+		{ "RGBA16F",       1, 1, 8,  false, false },
+		{ "BC1",           4, 4, 8,  true,  false },
+		{ "BC1_SRGB",      4, 4, 8,  true,  true  },
+		{ "BC2",           4, 4, 16, true,  false },
+		{ "BC2_SRGB",      4, 4, 16, true,  true  },
+		{ "BC3",           4, 4, 16, true,  false },
+		{ "BC3_SRGB",      4, 4, 16, true,  true  },
+		{ "BC4",           4, 4, 8,  true,  false },
+		{ "BC5",           4, 4, 16, true,  false },
+		{ "BC6H",          4, 4, 16, true,  false },
+		{ "BC7",           4, 4, 16, true,  false },
+		{ "BC7_SRGB",      4, 4, 16, true,  true  },
+		{ "ASTC_4x4",      4, 4, 16, true,  false },
+		{ "ASTC_4x4_SRGB", 4, 4, 16, true,  true  },
+		{ "ASTC_6x6",      6, 6, 16, true,  false },
+		{ "ASTC_6x6_SRGB", 6, 6, 16, true,  true  },
+		{ "ASTC_8x8",      8, 8, 16, true,  false },
+		{ "ASTC_8x8_SRGB", 8, 8, 16, true,  true  },
+	};
+
+	static_assert(std::size(sFormatInfos) == (size_t)TextureFormat::Count, "Every texture format needs an info entry");
+
+	const TextureFormatInfo& GetTextureFormatInfo(TextureFormat format) {
+		return sFormatInfos[(u32)format < (u32)TextureFormat::Count ? (u32)format : 0];
+	}
+
+	size_t TextureMipSize(TextureFormat format, u32 width, u32 height) {
+		const TextureFormatInfo& info = GetTextureFormatInfo(format);
+		size_t blocksWide = (width + info.blockWidth - 1) / info.blockWidth;
+		size_t blocksHigh = (height + info.blockHeight - 1) / info.blockHeight;
+		return blocksWide * blocksHigh * info.bytesPerBlock;
+	}
+
+	size_t TextureMipChainSize(TextureFormat format, u32 width, u32 height, u32 firstMip, u32 mipCount) {
+		size_t size = 0;
+		for (u32 mip = firstMip; mip < mipCount; mip++) {
+			size += TextureMipSize(format, TextureMipDimension(width, mip), TextureMipDimension(height, mip));
+		}
+		return size;
+	}
+
+	// Picks the first mip to read so that nothing larger than maxSize is loaded, always keeping the last mip
+	static u32 FirstMipForMaxSize(u32 width, u32 height, u32 mipCount, u32 maxSize) {
+		u32 mip = 0;
+		while (mip + 1 < mipCount && std::max(TextureMipDimension(width, mip), TextureMipDimension(height, mip)) > maxSize) {
+			mip++;
+		}
+		return mip;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// KTX2
+	//
+	//-------------------------------------------------------------------------
+
+	static const u8 KTX2_IDENTIFIER[12] = {
+		(u8)0xAB, 'K', 'T', 'X', ' ', '2', '0', (u8)0xBB, '\r', '\n', (u8)0x1A, '\n'
+	};
+
+	const u32 KTX2_SUPERCOMPRESSION_NONE = 0;
+	const u32 KTX2_SUPERCOMPRESSION_ZSTD = 2;
+	const i32 TEXTURE_ZSTD_LEVEL = 18;
+
+	struct Ktx2Header {
+		u8 identifier[12];
+		u32 vkFormat;
+		u32 typeSize;
+		u32 pixelWidth;
+		u32 pixelHeight;
+		u32 pixelDepth;
+		u32 layerCount;
+		u32 faceCount;
+		u32 levelCount;
+		u32 supercompressionScheme;
+		u32 dfdByteOffset;
+		u32 dfdByteLength;
+		u32 kvdByteOffset;
+		u32 kvdByteLength;
+		u64 sgdByteOffset;
+		u64 sgdByteLength;
+	};
+
+	struct Ktx2Level {
+		u64 byteOffset;
+		u64 byteLength;
+		u64 uncompressedByteLength;
+	};
+
+	static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout is fixed by the spec");
+	static_assert(sizeof(Ktx2Level) == 24, "KTX2 level index layout is fixed by the spec");
+
+	// KTX2 stores the VkFormat value directly, these are the ones we know how to upload
+	static const std::pair<u32, TextureFormat> sKtx2Formats[] = {
+		{ 37,  TextureFormat::RGBA8 },         // VK_FORMAT_R8G8B8A8_UNORM
+		{ 43,  TextureFormat::RGBA8_SRGB },    // VK_FORMAT_R8G8B8A8_SRGB
+		{ 44,  TextureFormat::BGRA8 },         // VK_FORMAT_B8G8R8A8_UNORM
+		{ 50,  TextureFormat::BGRA8_SRGB },    // VK_FORMAT_B8G8R8A8_SRGB
+		{ 97,  TextureFormat::RGBA16F },       // VK_FORMAT_R16G16B16A16_SFLOAT
+		{ 133, TextureFormat::BC1 },           // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+		{ 134, TextureFormat::BC1_SRGB },      // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+		{ 135, TextureFormat::BC2 },           // VK_FORMAT_BC2_UNORM_BLOCK
+		{ 136, TextureFormat::BC2_SRGB },      // VK_FORMAT_BC2_SRGB_BLOCK
+		{ 137, TextureFormat::BC3 },           // VK_FORMAT_BC3_UNORM_BLOCK
+		{ 138, TextureFormat::BC3_SRGB },      // VK_FORMAT_BC3_SRGB_BLOCK
+		{ 139, TextureFormat::BC4 },           // VK_FORMAT_BC4_UNORM_BLOCK
+		{ 141, TextureFormat::BC5 },           // VK_FORMAT_BC5_UNORM_BLOCK
+		{ 143, TextureFormat::BC6H },          // VK_FORMAT_BC6H_UFLOAT_BLOCK
+		{ 145, TextureFormat::BC7 },           // VK_FORMAT_BC7_UNORM_BLOCK
+		{ 146, TextureFormat::BC7_SRGB },      // VK_FORMAT_BC7_SRGB_BLOCK
+		{ 157, TextureFormat::ASTC_4x4 },      // VK_FORMAT_ASTC_4x4_UNORM_BLOCK
+		{ 158, TextureFormat::ASTC_4x4_SRGB }, // VK_FORMAT_ASTC_4x4_SRGB_BLOCK
+		{ 165, TextureFormat::ASTC_6x6 },      // VK_FORMAT_ASTC_6x6_UNORM_BLOCK
+		{ 166, TextureFormat::ASTC_6x6_SRGB }, // VK_FORMAT_ASTC_6x6_SRGB_BLOCK
+		{ 171, TextureFormat::ASTC_8x8 },      // VK_FORMAT_ASTC_8x8_UNORM_BLOCK
+		{ 172, TextureFormat::ASTC_8x8_SRGB }, // VK_FORMAT_ASTC_8x8_SRGB_BLOCK
+	};
+
+	static bool ReadKtx2(const u8* data, size_t size, TextureData& texture, u32 maxSize) {
+		if (size < sizeof(Ktx2Header)) {
+			RWD_LOG_ERROR("KTX2 file is too small to contain a header");
+			return false;
+		}
+
+		const Ktx2Header* header = (const Ktx2Header*)data;
+
+		if (header->pixelHeight == 0 || header->pixelDepth > 1 || header->layerCount > 1 || header->faceCount != 1) {
+			RWD_LOG_ERROR("Only 2D KTX2 textures are supported");
+			return false;
+		}
+
+		if (header->pixelWidth == 0) {
+			RWD_LOG_ERROR("KTX2 texture has a width of 0");
+			return false;
+		}
+
+		if (header->supercompressionScheme != KTX2_SUPERCOMPRESSION_NONE && header->supercompressionScheme != KTX2_SUPERCOMPRESSION_ZSTD) {
+			RWD_LOG_ERROR("KTX2 supercompression scheme {0} is not supported", header->supercompressionScheme);
+			return false;
+		}
+
+		for (const auto& [vkFormat, format] : sKtx2Formats) {
+			if (vkFormat == header->vkFormat) {
+				texture.format = format;
+			}
+		}
+
+		if (texture.format == TextureFormat::Unknown) {
+			RWD_LOG_ERROR("KTX2 format {0} is not supported", header->vkFormat);
+			return false;
+		}
+
+		// A level count of 0 means the file only has the base level and wants mips generated on load
+		const u32 levelCount = std::max(1u, header->levelCount);
+		texture.generateMips = header->levelCount == 0;
+
+		if (levelCount > TEXTURE_MAX_MIPS || sizeof(Ktx2Header) + sizeof(Ktx2Level) * levelCount > size) {
+			RWD_LOG_ERROR("KTX2 level index is invalid");
+			return false;
+		}
+
+		texture.width = header->pixelWidth;
+		texture.height = header->pixelHeight;
+		texture.mipCount = levelCount;
+		texture.firstMip = FirstMipForMaxSize(texture.width, texture.height, levelCount, maxSize);
+
+		const Ktx2Level* levels = (const Ktx2Level*)(data + sizeof(Ktx2Header));
+		const bool zstd = header->supercompressionScheme == KTX2_SUPERCOMPRESSION_ZSTD;
+		size_t decodedSize = 0;
+
+		for (u32 mip = texture.firstMip; mip < levelCount; mip++) {
+			const Ktx2Level& level = levels[mip];
+			TextureMip& textureMip = texture.mips[mip];
+
+			textureMip.width = TextureMipDimension(texture.width, mip);
+			textureMip.height = TextureMipDimension(texture.height, mip);
+			textureMip.size = TextureMipSize(texture.format, textureMip.width, textureMip.height);
+
+			const u64 storedSize = zstd ? level.uncompressedByteLength : level.byteLength;
+			// Checked without adding the two, a crafted offset and length could wrap
+			if (level.byteOffset > size || level.byteLength > size - level.byteOffset || storedSize < textureMip.size) {
+				RWD_LOG_ERROR("KTX2 level {0} is out of bounds or too small", mip);
+				return false;
+			}
+
+			if (zstd) {
+				decodedSize += textureMip.size;
+			} else {
+				textureMip.data = data + level.byteOffset;
+			}
+		}
+
+		if (!zstd) {
+			return true;
+		}
+
+		// Levels are compressed independently, so inflate them in parallel
+		texture.decoded.resize(decodedSize);
+
+		size_t offset = 0;
+		for (u32 mip = texture.firstMip; mip < levelCount; mip++) {
+			texture.mips[mip].data = texture.decoded.data() + offset;
+			offset += texture.mips[mip].size;
+		}
+
+		std::atomic<bool> success = true;
+
+		JobCounter counter;
+		JobSystem::Dispatch(counter, levelCount - texture.firstMip, 1, [&] (JobArgs args) {
+			u32 mip = texture.firstMip + args.jobIndex;
+			const Ktx2Level& level = levels[mip];
+
+			size_t result = ZSTD_decompress((void*)texture.mips[mip].data, texture.mips[mip].size,
+				data + level.byteOffset, (size_t)level.byteLength);
+
+			if (ZSTD_isError(result) || result != texture.mips[mip].size) {
+				success = false;
+			}
+		});
+		JobSystem::Wait(counter);
+
+		if (!success) {
+			RWD_LOG_ERROR("Failed to decompress KTX2 levels");
+		}
+
+		return success;
+	}
+
+	// Builds the basic data format descriptor KTX2 requires, describing how the texel blocks are laid out
+	static std::vector<u32> BuildKtx2Dfd(TextureFormat format) {
+		const TextureFormatInfo& info = GetTextureFormatInfo(format);
+
+		const u32 CHANNEL_R = 0, CHANNEL_G = 1, CHANNEL_B = 2, CHANNEL_A = 15;
+		const u32 QUALIFIER_LINEAR = 0x10, QUALIFIER_SIGNED = 0x40, QUALIFIER_FLOAT = 0x80;
+		const u32 FLOAT_ONE = 0x3F800000, FLOAT_MINUS_ONE = 0xBF800000;
+
+		struct Sample {
+			u32 bitOffset;
+			u32 bitLength;
+			u32 channelType;
+			u32 lower;
+			u32 upper;
+		};
+
+		u32 colorModel = 0;
+		std::vector<Sample> samples;
+
+		switch (format) {
+			case(TextureFormat::RGBA8):
+			case(TextureFormat::RGBA8_SRGB):
+			case(TextureFormat::BGRA8):
+			case(TextureFormat::BGRA8_SRGB): {
+				bool bgra = format == TextureFormat::BGRA8 || format == TextureFormat::BGRA8_SRGB;
+				u32 alphaType = CHANNEL_A | (info.srgb ? QUALIFIER_LINEAR : 0);
+				colorModel = 1; // RGBSDA
+				samples = {
+					{ 0,  8, bgra ? CHANNEL_B : CHANNEL_R, 0, 255 },
+					{ 8,  8, CHANNEL_G, 0, 255 },
+					{ 16, 8, bgra ? CHANNEL_R : CHANNEL_B, 0, 255 },
+					{ 24, 8, alphaType, 0, 255 },
+				};
+				break;
+			}
+			case(TextureFormat::RGBA16F): {
+				u32 qualifiers = QUALIFIER_FLOAT | QUALIFIER_SIGNED;
+				colorModel = 1;
+				samples = {
+					{ 0,  16, CHANNEL_R | qualifiers, FLOAT_MINUS_ONE, FLOAT_ONE },
+					{ 16, 16, CHANNEL_G | qualifiers, FLOAT_MINUS_ONE, FLOAT_ONE },
+					{ 32, 16, CHANNEL_B | qualifiers, FLOAT_MINUS_ONE, FLOAT_ONE },
+					{ 48, 16, CHANNEL_A | qualifiers, FLOAT_MINUS_ONE, FLOAT_ONE },
+				};
+				break;
+			}
+			case(TextureFormat::BC1):
+			case(TextureFormat::BC1_SRGB):
+				colorModel = 128;
+				samples = { { 0, 64, CHANNEL_R, 0, UINT32_MAX }, { 0, 64, CHANNEL_A, 0, UINT32_MAX } };
+				break;
+			case(TextureFormat::BC2):
+			case(TextureFormat::BC2_SRGB):
+			case(TextureFormat::BC3):
+			case(TextureFormat::BC3_SRGB): {
+				bool bc2 = format == TextureFormat::BC2 || format == TextureFormat::BC2_SRGB;
+				colorModel = bc2 ? 129 : 130;
+				samples = { { 0, 64, CHANNEL_A | (info.srgb ? QUALIFIER_LINEAR : 0), 0, UINT32_MAX }, { 64, 64, CHANNEL_R, 0, UINT32_MAX } };
+				break;
+			}
+			case(TextureFormat::BC4):
+				colorModel = 131;
+				samples = { { 0, 64, CHANNEL_R, 0, UINT32_MAX } };
+				break;
+			case(TextureFormat::BC5):
+				colorModel = 132;
+				samples = { { 0, 64, CHANNEL_R, 0, UINT32_MAX }, { 64, 64, CHANNEL_G, 0, UINT32_MAX } };
+				break;
+			case(TextureFormat::BC6H):
+				colorModel = 133;
+				samples = { { 0, 128, CHANNEL_R | QUALIFIER_FLOAT, 0, FLOAT_ONE } };
+				break;
+			case(TextureFormat::BC7):
+			case(TextureFormat::BC7_SRGB):
+				colorModel = 134;
+				samples = { { 0, 128, CHANNEL_R, 0, UINT32_MAX } };
+				break;
+			default:
+				// ASTC
+				colorModel = 162;
+				samples = { { 0, 128, CHANNEL_R, 0, UINT32_MAX } };
+				break;
+		}
+
+		const u32 blockSize = 24 + 16 * (u32)samples.size();
+		const u32 transferFunction = info.srgb ? 2 : 1;
+		const u32 colorPrimaries = 1; // BT.709
+
+		std::vector<u32> dfd = {
+			4 + blockSize,
+			0, // Khronos vendor, basic descriptor type
+			2 | (blockSize << 16),
+			colorModel | (colorPrimaries << 8) | (transferFunction << 16),
+			(info.blockWidth - 1) | ((info.blockHeight - 1) << 8),
+			info.bytesPerBlock,
+			0,
+		};
+
+		for (const Sample& sample : samples) {
+			dfd.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channelType << 24));
+			dfd.push_back(0);
+			dfd.push_back(sample.lower);
+			dfd.push_back(sample.upper);
+		}
+
+		return dfd;
+	}
+
+	bool TextureFile::WriteKtx2(const std::string& filepath, TextureFormat format, u32 width, u32 height,
+		const std::vector<std::vector<u8>>& mips, bool zstd)
+	{
+		u32 vkFormat = 0;
+		for (const auto& [ktxFormat, textureFormat] : sKtx2Formats) {
+			if (textureFormat == format) {
+				vkFormat = ktxFormat;
+			}
+		}
+
+		if (vkFormat == 0 || mips.empty() || mips.size() > TEXTURE_MAX_MIPS) {
+			RWD_LOG_ERROR("Can't write {0} as KTX2, unsupported format or mip count", filepath);
+			return false;
+		}
+
+		const TextureFormatInfo& info = GetTextureFormatInfo(format);
+		const u32 levelCount = (u32)mips.size();
+
+		std::vector<std::vector<u8>> compressed(zstd ? levelCount : 0);
+		if (zstd) {
+			JobCounter counter;
+			JobSystem::Dispatch(counter, levelCount, 1, [&] (JobArgs args) {
+				const std::vector<u8>& src = mips[args.jobIndex];
+				std::vector<u8>& dst = compressed[args.jobIndex];
+
+				dst.resize(ZSTD_compressBound(src.size()));
+				size_t result = ZSTD_compress(dst.data(), dst.size(), src.data(), src.size(), TEXTURE_ZSTD_LEVEL);
+				dst.resize(ZSTD_isError(result) ? 0 : result);
+			});
+			JobSystem::Wait(counter);
+
+			for (const std::vector<u8>& level : compressed) {
+				if (level.empty()) {
+					RWD_LOG_ERROR("Failed to compress the levels of {0}", filepath);
+					return false;
+				}
+			}
+		}
+
+		std::vector<u32> dfd = BuildKtx2Dfd(format);
+
+		// Uncompressed levels have to be aligned to both the texel block size and 4 bytes
+		const u64 alignment = zstd ? 1 : std::lcm((u64)info.bytesPerBlock, 4ull);
+		auto alignUp = [alignment] (u64 value) { return (value + alignment - 1) / alignment * alignment; };
+
+		Ktx2Header header { };
+		memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+		header.vkFormat = vkFormat;
+		header.typeSize = info.compressed ? 1 : (format == TextureFormat::RGBA16F ? 2 : 1);
+		header.pixelWidth = width;
+		header.pixelHeight = height;
+		header.pixelDepth = 0;
+		header.layerCount = 0;
+		header.faceCount = 1;
+		header.levelCount = levelCount;
+		header.supercompressionScheme = zstd ? KTX2_SUPERCOMPRESSION_ZSTD : KTX2_SUPERCOMPRESSION_NONE;
+		header.dfdByteOffset = (u32)(sizeof(Ktx2Header) + sizeof(Ktx2Level) * levelCount);
+		header.dfdByteLength = (u32)(sizeof(u32) * dfd.size());
+
+		// The spec stores the smallest level first so a truncated download still has usable mips
+		std::vector<Ktx2Level> levels(levelCount);
+		u64 offset = header.dfdByteOffset + header.dfdByteLength;
+
+		for (i32 mip = (i32)levelCount - 1; mip >= 0; mip--) {
+			offset = alignUp(offset);
+			levels[mip] = Ktx2Level {
+				.byteOffset = offset,
+				.byteLength = zstd ? compressed[mip].size() : mips[mip].size(),
+				.uncompressedByteLength = mips[mip].size(),
+			};
+			offset += levels[mip].byteLength;
+		}
+
+		std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			RWD_LOG_ERROR("Failed to open {0} for writing", filepath);
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)levels.data(), sizeof(Ktx2Level) * levels.size());
+		file.write((const char*)dfd.data(), sizeof(u32) * dfd.size());
+
+		const char padding[16] = { };
+		for (i32 mip = (i32)levelCount - 1; mip >= 0; mip--) {
+			file.write(padding, levels[mip].byteOffset - (u64)file.tellp());
+
+			const std::vector<u8>& level = zstd ? compressed[mip] : mips[mip];
+			file.write(level.data(), level.size());
+		}
+
+		return file.good();
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// DDS
+	//
+	//-------------------------------------------------------------------------
+
+	constexpr u32 MakeFourCC(char a, char b, char c, char d) {
+		return (u32)(unsigned char)a | ((u32)(unsigned char)b << 8) | ((u32)(unsigned char)c << 16) | ((u32)(unsigned char)d << 24);
+	}
+
+	const u32 DDS_MAGIC = MakeFourCC('D', 'D', 'S', ' ');
+	const u32 DDS_FLAG_MIPMAPCOUNT = 0x20000;
+	const u32 DDS_PIXEL_FOURCC = 0x4;
+	const u32 DDS_PIXEL_RGB = 0x40;
+	const u32 DDS_CAPS2_CUBEMAP = 0x200;
+	const u32 DDS_CAPS2_VOLUME = 0x200000;
+	const u32 DDS_DIMENSION_TEXTURE2D = 3;
+
+	struct DdsPixelFormat {
+		u32 size;
+		u32 flags;
+		u32 fourCC;
+		u32 rgbBitCount;
+		u32 rMask;
+		u32 gMask;
+		u32 bMask;
+		u32 aMask;
+	};
+
+	struct DdsHeader {
+		u32 size;
+		u32 flags;
+		u32 height;
+		u32 width;
+		u32 pitchOrLinearSize;
+		u32 depth;
+		u32 mipMapCount;
+		u32 reserved1[11];
+		DdsPixelFormat pixelFormat;
+		u32 caps;
+		u32 caps2;
+		u32 caps3;
+		u32 caps4;
+		u32 reserved2;
+	};
+
+	struct DdsHeaderDx10 {
+		u32 dxgiFormat;
+		u32 resourceDimension;
+		u32 miscFlag;
+		u32 arraySize;
+		u32 miscFlags2;
+	};
+
+	static_assert(sizeof(DdsHeader) == 124, "DDS header layout is fixed");
+	static_assert(sizeof(DdsHeaderDx10) == 20, "DDS DX10 header layout is fixed");
+
+	static const std::pair<u32, TextureFormat> sDxgiFormats[] = {
+		{ 10, TextureFormat::RGBA16F },    // DXGI_FORMAT_R16G16B16A16_FLOAT
+		{ 28, TextureFormat::RGBA8 },      // DXGI_FORMAT_R8G8B8A8_UNORM
+		{ 29, TextureFormat::RGBA8_SRGB }, // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+		{ 71, TextureFormat::BC1 },        // DXGI_FORMAT_BC1_UNORM
+		{ 72, TextureFormat::BC1_SRGB },   // DXGI_FORMAT_BC1_UNORM_SRGB
+		{ 74, TextureFormat::BC2 },        // DXGI_FORMAT_BC2_UNORM
+		{ 75, TextureFormat::BC2_SRGB },   // DXGI_FORMAT_BC2_UNORM_SRGB
+		{ 77, TextureFormat::BC3 },        // DXGI_FORMAT_BC3_UNORM
+		{ 78, TextureFormat::BC3_SRGB },   // DXGI_FORMAT_BC3_UNORM_SRGB
+		{ 80, TextureFormat::BC4 },        // DXGI_FORMAT_BC4_UNORM
+		{ 83, TextureFormat::BC5 },        // DXGI_FORMAT_BC5_UNORM
+		{ 87, TextureFormat::BGRA8 },      // DXGI_FORMAT_B8G8R8A8_UNORM
+		{ 91, TextureFormat::BGRA8_SRGB }, // DXGI_FORMAT_B8G8R8A8_UNORM_SRGB
+		{ 95, TextureFormat::BC6H },       // DXGI_FORMAT_BC6H_UF16
+		{ 98, TextureFormat::BC7 },        // DXGI_FORMAT_BC7_UNORM
+		{ 99, TextureFormat::BC7_SRGB },   // DXGI_FORMAT_BC7_UNORM_SRGB
+	};
+
+	static TextureFormat DdsLegacyFormat(const DdsPixelFormat& pixelFormat) {
+		if (pixelFormat.flags & DDS_PIXEL_FOURCC) {
+			switch (pixelFormat.fourCC) {
+				case(MakeFourCC('D', 'X', 'T', '1')): return TextureFormat::BC1;
+				case(MakeFourCC('D', 'X', 'T', '2')):
+				case(MakeFourCC('D', 'X', 'T', '3')): return TextureFormat::BC2;
+				case(MakeFourCC('D', 'X', 'T', '4')):
+				case(MakeFourCC('D', 'X', 'T', '5')): return TextureFormat::BC3;
+				case(MakeFourCC('A', 'T', 'I', '1')):
+				case(MakeFourCC('B', 'C', '4', 'U')): return TextureFormat::BC4;
+				case(MakeFourCC('A', 'T', 'I', '2')):
+				case(MakeFourCC('B', 'C', '5', 'U')): return TextureFormat::BC5;
+				default:                              return TextureFormat::Unknown;
+			}
+		}
+
+		if ((pixelFormat.flags & DDS_PIXEL_RGB) && pixelFormat.rgbBitCount == 32) {
+			if (pixelFormat.rMask == 0x000000FF && pixelFormat.gMask == 0x0000FF00 && pixelFormat.bMask == 0x00FF0000) {
+				return TextureFormat::RGBA8;
+			}
+			if (pixelFormat.rMask == 0x00FF0000 && pixelFormat.gMask == 0x0000FF00 && pixelFormat.bMask == 0x000000FF) {
+				return TextureFormat::BGRA8;
+			}
+		}
+
+		return TextureFormat::Unknown;
+	}
+
+	static bool ReadDds(const u8* data, size_t size, TextureData& texture, u32 maxSize) {
+		if (size < sizeof(u32) + sizeof(DdsHeader)) {
+			RWD_LOG_ERROR("DDS file is too small to contain a header");
+			return false;
+		}
+
+		const DdsHeader* header = (const DdsHeader*)(data + sizeof(u32));
+		size_t dataOffset = sizeof(u32) + sizeof(DdsHeader);
+
+		if (header->size != sizeof(DdsHeader) || (header->caps2 & (DDS_CAPS2_CUBEMAP | DDS_CAPS2_VOLUME))) {
+			RWD_LOG_ERROR("Only 2D DDS textures are supported");
+			return false;
+		}
+
+		if (header->width == 0 || header->height == 0) {
+			RWD_LOG_ERROR("DDS texture has a width or height of 0");
+			return false;
+		}
+
+		if (header->pixelFormat.flags & DDS_PIXEL_FOURCC && header->pixelFormat.fourCC == MakeFourCC('D', 'X', '1', '0')) {
+			if (size < dataOffset + sizeof(DdsHeaderDx10)) {
+				RWD_LOG_ERROR("DDS file is too small to contain a DX10 header");
+				return false;
+			}
+
+			const DdsHeaderDx10* dx10 = (const DdsHeaderDx10*)(data + dataOffset);
+			dataOffset += sizeof(DdsHeaderDx10);
+
+			if (dx10->resourceDimension != DDS_DIMENSION_TEXTURE2D || dx10->arraySize > 1) {
+				RWD_LOG_ERROR("Only 2D DDS textures are supported");
+				return false;
+			}
+
+			for (const auto& [dxgiFormat, format] : sDxgiFormats) {
+				if (dxgiFormat == dx10->dxgiFormat) {
+					texture.format = format;
+				}
+			}
+		} else {
+			texture.format = DdsLegacyFormat(header->pixelFormat);
+		}
+
+		if (texture.format == TextureFormat::Unknown) {
+			RWD_LOG_ERROR("DDS pixel format is not supported");
+			return false;
+		}
+
+		const u32 mipCount = (header->flags & DDS_FLAG_MIPMAPCOUNT) ? std::max(1u, header->mipMapCount) : 1;
+		if (mipCount > TEXTURE_MAX_MIPS) {
+			RWD_LOG_ERROR("DDS file has too many mips");
+			return false;
+		}
+
+		texture.width = header->width;
+		texture.height = header->height;
+		texture.mipCount = mipCount;
+		texture.firstMip = FirstMipForMaxSize(texture.width, texture.height, mipCount, maxSize);
+
+		// DDS mips are packed back to back, largest first
+		size_t offset = dataOffset;
+		for (u32 mip = 0; mip < mipCount; mip++) {
+			u32 width = TextureMipDimension(texture.width, mip);
+			u32 height = TextureMipDimension(texture.height, mip);
+			size_t mipSize = TextureMipSize(texture.format, width, height);
+
+			if (mipSize > size - offset) {
+				RWD_LOG_ERROR("DDS mip {0} is out of bounds", mip);
+				return false;
+			}
+
+			if (mip >= texture.firstMip) {
+				texture.mips[mip] = TextureMip { .data = data + offset, .size = mipSize, .width = width, .height = height };
+			}
+
+			offset += mipSize;
+		}
+
+		return true;
+	}
+
+	bool TextureFile::Read(const u8* data, size_t size, TextureData& texture, u32 maxSize) {
+		texture = TextureData { };
+
+		if (data == nullptr || size < sizeof(u32)) {
+			RWD_LOG_ERROR("Texture file is empty");
+			return false;
+		}
+
+		if (size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) {
+			return ReadKtx2(data, size, texture, maxSize);
+		}
+
+		u32 magic;
+		memcpy(&magic, data, sizeof(magic));
+
+		if (magic == DDS_MAGIC) {
+			return ReadDds(data, size, texture, maxSize);
+		}
+
+		RWD_LOG_ERROR("Texture file is neither KTX2 nor DDS");
+		return false;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Mip Generation
+	//
+	//-------------------------------------------------------------------------
+
+	static f32 SrgbToLinear(f32 value) {
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	static f32 LinearToSrgb(f32 value) {
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	std::vector<std::vector<u8>> TextureFile::GenerateMips(const u8* pixels, u32 width, u32 height, bool srgb) {
+		std::vector<std::vector<u8>> mips;
+		mips.emplace_back(pixels, pixels + (size_t)width * height * 4);
+
+		// Decoding sRGB with pow for every texel is slow, there are only 256 possible inputs
+		f32 toLinear[256];
+		for (u32 i = 0; i < 256; i++) {
+			toLinear[i] = srgb ? SrgbToLinear(i / 255.0f) : i / 255.0f;
+		}
+
+		while ((width > 1 || height > 1) && mips.size() < TEXTURE_MAX_MIPS) {
+			const std::vector<u8>& src = mips.back();
+			const u32 srcWidth = width;
+			const u32 srcHeight = height;
+
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+
+			std::vector<u8> dst((size_t)width * height * 4);
+
+			// Each row is independent so spread them across the workers
+			JobCounter counter;
+			JobSystem::Dispatch(counter, height, 16, [&] (JobArgs args) {
+				u32 y = args.jobIndex;
+				u32 y0 = std::min(y * 2, srcHeight - 1);
+				u32 y1 = std::min(y * 2 + 1, srcHeight - 1);
+
+				for (u32 x = 0; x < width; x++) {
+					u32 x0 = std::min(x * 2, srcWidth - 1);
+					u32 x1 = std::min(x * 2 + 1, srcWidth - 1);
+
+					const unsigned char* texels[] = {
+						(const unsigned char*)&src[((size_t)y0 * srcWidth + x0) * 4],
+						(const unsigned char*)&src[((size_t)y0 * srcWidth + x1) * 4],
+						(const unsigned char*)&src[((size_t)y1 * srcWidth + x0) * 4],
+						(const unsigned char*)&src[((size_t)y1 * srcWidth + x1) * 4],
+					};
+
+					u8* out = &dst[((size_t)y * width + x) * 4];
+
+					for (u32 channel = 0; channel < 4; channel++) {
+						// Alpha is always linear
+						bool linear = channel == 3 || !srgb;
+						f32 sum = 0.0f;
+
+						for (const unsigned char* texel : texels) {
+							sum += linear ? texel[channel] / 255.0f : toLinear[texel[channel]];
+						}
+
+						f32 average = sum * 0.25f;
+						f32 encoded = linear ? average : LinearToSrgb(average);
+						out[channel] = (u8)(u32)(std::clamp(encoded, 0.0f, 1.0f) * 255.0f + 0.5f);
+					}
+				}
+			});
+			JobSystem::Wait(counter);
+
+			mips.push_back(std::move(dst));
+		}
+
+		return mips;
+	}
+
+}
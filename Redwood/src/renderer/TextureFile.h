@@ -0,0 +1,117 @@
+#pragma once
+#include "pch.h"
+#include "core/Core.h"
+
+namespace rwd {
+
+	//-------------------------------------------------------------------------
+	//
+	// Texture Files (.ktx2 / .dds)
+	//
+	// Both containers are read in place, every mip points straight into the file's memory
+	// so block compressed payloads go to the GPU without ever being touched on the CPU.
+	// The one exception is Zstd supercompressed KTX2, whose levels are inflated into
+	// TextureData::decoded. BasisLZ / UASTC transcoding is not supported.
+	//
+	// Only 2D textures are handled, array layers, cube faces and depth slices are rejected.
+	//
+	//-------------------------------------------------------------------------
+
+	const u32 TEXTURE_MAX_MIPS = 16;
+
+	enum class TextureFormat : u32 {
+		Unknown = 0,
+
+		RGBA8,
+		RGBA8_SRGB,
+		BGRA8,
+		BGRA8_SRGB,
+		RGBA16F,
+
+		BC1,       // RGB + 1 bit alpha, 4 bpp
+		BC1_SRGB,
+		BC2,       // RGB + explicit 4 bit alpha, 8 bpp
+		BC2_SRGB,
+		BC3,       // RGB + interpolated alpha, 8 bpp
+		BC3_SRGB,
+		BC4,       // Single channel, 4 bpp
+		BC5,       // Two channels, 8 bpp, for normal maps
+		BC6H,      // HDR RGB, 8 bpp
+		BC7,       // High quality RGBA, 8 bpp
+		BC7_SRGB,
+
+		ASTC_4x4,  // 8 bpp
+		ASTC_4x4_SRGB,
+		ASTC_6x6,  // 3.56 bpp
+		ASTC_6x6_SRGB,
+		ASTC_8x8,  // 2 bpp
+		ASTC_8x8_SRGB,
+
+		Count,
+	};
+
+	struct TextureFormatInfo {
+		const char* name;
+		u32 blockWidth;
+		u32 blockHeight;
+		u32 bytesPerBlock;
+		bool compressed;
+		bool srgb;
+	};
+
+	RWD_API const TextureFormatInfo& GetTextureFormatInfo(TextureFormat format);
+
+	// Size in bytes of a single mip, block compressed formats round up to whole blocks
+	RWD_API size_t TextureMipSize(TextureFormat format, u32 width, u32 height);
+
+	// Size in bytes of mips [firstMip, mipCount) of a texture whose largest mip is width x height
+	RWD_API size_t TextureMipChainSize(TextureFormat format, u32 width, u32 height, u32 firstMip, u32 mipCount);
+
+	inline u32 TextureMipDimension(u32 size, u32 mip) {
+		return std::max(1u, size >> mip);
+	}
+
+	struct TextureMip {
+		const u8* data = nullptr;
+		size_t size = 0;
+		u32 width = 0;
+		u32 height = 0;
+	};
+
+	struct TextureData {
+		TextureFormat format = TextureFormat::Unknown;
+		u32 width = 0;
+		u32 height = 0;
+		u32 mipCount = 0;
+
+		// First mip that was actually read, the mips before it were skipped and are left null
+		u32 firstMip = 0;
+
+		// The file has a single level and asks for the rest of the chain to be generated at load time
+		bool generateMips = false;
+
+		TextureMip mips[TEXTURE_MAX_MIPS];
+
+		// Backing storage for levels that had to be decompressed
+		std::vector<u8> decoded;
+	};
+
+	class RWD_API TextureFile {
+	public:
+		// Detects the container from its magic number. The mip pointers reference `data` (or
+		// texture.decoded) so the file contents have to outlive the TextureData.
+		//
+		// Mips whose larger dimension is over maxSize are skipped, which lets a streamed
+		// texture load only its low resolution tail without decompressing the rest.
+		static bool Read(const u8* data, size_t size, TextureData& texture, u32 maxSize = UINT32_MAX);
+
+		// Writes a KTX2 file, mips are ordered largest first. Zstd supercompresses every level.
+		static bool WriteKtx2(const std::string& filepath, TextureFormat format, u32 width, u32 height,
+			const std::vector<std::vector<u8>>& mips, bool zstd);
+
+		// Box filters an RGBA8 image down to 1x1, returning every level including the original.
+		// sRGB images are filtered in linear space so the smaller mips don't darken.
+		static std::vector<std::vector<u8>> GenerateMips(const u8* pixels, u32 width, u32 height, bool srgb);
+	};
+
+}
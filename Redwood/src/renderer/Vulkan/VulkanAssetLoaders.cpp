@@ -0,0 +1,149 @@
+#include "pch.h"
+#include "core/Log.h"
+#include "VulkanRenderer.h"
+#include "VulkanTextureStreamer.h"
+#include "VulkanAssetLoaders.h"
+
+namespace rwd {
+
+	//-------------------------------------------------------------------------
+	//
+	// Mesh Loader
+	//
+	//-------------------------------------------------------------------------
+
+	VulkanMeshLoader::VulkanMeshLoader(VulkanRenderer* renderer)
+		: mRenderer(renderer) { }
+
+	Scope<Asset> VulkanMeshLoader::Decode(const std::string& path, IoBuffer& contents) {
+		Scope<MeshAsset> asset = MakeScope<MeshAsset>();
+
+		// The view points into the buffer, so keep the buffer with the asset until it's uploaded
+		asset->mFileContents = std::move(contents);
+		if (!MeshFile::Read(asset->mFileContents.Data(), asset->mFileContents.Size(), asset->mView)) {
+			return nullptr;
+		}
+
+		const MeshFileMetadata& metadata = *asset->mView.metadata;
+		std::copy(std::begin(metadata.boundsCenter), std::end(metadata.boundsCenter), asset->mBoundsCenter);
+		asset->mBoundsRadius = metadata.boundsRadius;
+
+		return asset;
+	}
+
+	bool VulkanMeshLoader::Upload(Asset& asset) {
+		MeshAsset& meshAsset = static_cast<MeshAsset&>(asset);
+
+		meshAsset.mMesh = mRenderer->CreateVulkanMesh(meshAsset.mView);
+		meshAsset.mMemorySize = meshAsset.mMesh.VertexBufferSize() + meshAsset.mMesh.IndexBufferSize();
+
+		// The CPU copy isn't needed once the data is on the GPU
+		meshAsset.mFileContents = IoBuffer();
+		meshAsset.mView = MeshFileView { };
+
+		return true;
+	}
+
+	void VulkanMeshLoader::Unload(Asset& asset) {
+		mRenderer->DestroyVulkanMesh(static_cast<MeshAsset&>(asset).mMesh);
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Shader Loader
+	//
+	//-------------------------------------------------------------------------
+
+	VulkanShaderLoader::VulkanShaderLoader(VkDevice device)
+		: mDevice(device) { }
+
+	Scope<Asset> VulkanShaderLoader::Decode(const std::string& path, IoBuffer& contents) {
+		if (contents.Size() == 0 || contents.Size() % sizeof(u32) != 0) {
+			RWD_LOG_ERROR("Shader {0} is not valid SPIR-V", path);
+			return nullptr;
+		}
+
+		Scope<ShaderAsset> asset = MakeScope<ShaderAsset>();
+		asset->mCode = std::move(contents);
+		return asset;
+	}
+
+	bool VulkanShaderLoader::Upload(Asset& asset) {
+		ShaderAsset& shaderAsset = static_cast<ShaderAsset&>(asset);
+
+		VkShaderModuleCreateInfo createInfo { };
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = shaderAsset.mCode.Size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(shaderAsset.mCode.Data());
+
+		if (vkCreateShaderModule(mDevice, &createInfo, nullptr, &shaderAsset.mModule) != VK_SUCCESS) {
+			return false;
+		}
+
+		shaderAsset.mMemorySize = shaderAsset.mCode.Size();
+		shaderAsset.mCode = IoBuffer();
+		return true;
+	}
+
+	void VulkanShaderLoader::Unload(Asset& asset) {
+		vkDestroyShaderModule(mDevice, static_cast<ShaderAsset&>(asset).mModule, nullptr);
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Texture Loader
+	//
+	//-------------------------------------------------------------------------
+
+	VulkanTextureLoader::VulkanTextureLoader(VulkanRenderer* renderer, VulkanTextureStreamer* streamer)
+		: mRenderer(renderer), mStreamer(streamer) { }
+
+	Scope<Asset> VulkanTextureLoader::Decode(const std::string& path, IoBuffer& contents) {
+		Scope<TextureAsset> asset = MakeScope<TextureAsset>();
+		asset->mPath = path;
+
+		// The mips point into the buffer, so it stays with the asset until the upload
+		asset->mFileContents = std::move(contents);
+
+		u32 maxSize = mStreamer ? TEXTURE_STREAMING_TAIL_SIZE : UINT32_MAX;
+		if (!TextureFile::Read(asset->mFileContents.Data(), asset->mFileContents.Size(), asset->mData, maxSize)) {
+			RWD_LOG_ERROR("Failed to read texture {0}", path);
+			return nullptr;
+		}
+
+		return asset;
+	}
+
+	bool VulkanTextureLoader::Upload(Asset& asset) {
+		TextureAsset& textureAsset = static_cast<TextureAsset&>(asset);
+
+		bool created = textureAsset.mTexture.Create(*mRenderer, textureAsset.mData);
+
+		textureAsset.mFileContents = IoBuffer();
+		textureAsset.mData = TextureData { };
+
+		if (!created) {
+			return false;
+		}
+
+		// Only the tail counts against the asset budget, the streamer accounts for the mips it brings in
+		textureAsset.mMemorySize = textureAsset.mTexture.MemorySize();
+
+		if (mStreamer && textureAsset.mTexture.FirstResidentMip() > 0) {
+			mStreamer->Register(textureAsset);
+		}
+
+		return true;
+	}
+
+	void VulkanTextureLoader::Unload(Asset& asset) {
+		TextureAsset& textureAsset = static_cast<TextureAsset&>(asset);
+
+		if (mStreamer) {
+			mStreamer->Unregister(textureAsset);
+		}
+
+		mRenderer->DestroyVulkanTexture(textureAsset.mTexture);
+	}
+
+}
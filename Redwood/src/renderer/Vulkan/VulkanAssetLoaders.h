@@ -0,0 +1,102 @@
+#pragma once
+#include "core/AssetManager.h"
+#include "core/AsyncIO.h"
+#include "renderer/MeshFile.h"
+#include "renderer/TextureFile.h"
+#include "VulkanBuffer.h"
+#include "VulkanTexture.h"
+
+namespace rwd {
+
+	class VulkanRenderer;
+	class VulkanTextureStreamer;
+
+	class MeshAsset : public Asset {
+	public:
+		static const AssetType Type = AssetType::Mesh;
+
+		VulkanMesh mMesh;
+		f32 mBoundsCenter[3];
+		f32 mBoundsRadius;
+	private:
+		friend class VulkanMeshLoader;
+
+		// Only alive between decoding and uploading
+		IoBuffer mFileContents;
+		MeshFileView mView;
+	};
+
+	class ShaderAsset : public Asset {
+	public:
+		static const AssetType Type = AssetType::Shader;
+
+		VkShaderModule mModule = VK_NULL_HANDLE;
+	private:
+		friend class VulkanShaderLoader;
+
+		IoBuffer mCode;
+	};
+
+	class TextureAsset : public Asset {
+	public:
+		static const AssetType Type = AssetType::Texture;
+
+		// Streaming feedback, safe to call from any thread. screenSize is how many pixels the texture
+		// covers along its larger axis, the largest request since the streamer last ran wins.
+		void RequestScreenSize(f32 screenSize);
+
+		VulkanTexture mTexture;
+	private:
+		friend class VulkanTextureLoader;
+		friend class VulkanTextureStreamer;
+
+		std::string mPath;
+
+		// Only alive between decoding and uploading
+		IoBuffer mFileContents;
+		TextureData mData;
+
+		// Smallest mip requested since the streamer last looked, UINT32_MAX when nobody asked
+		std::atomic<u32> mRequestedMip = UINT32_MAX;
+		u32 mStreamingId = 0;
+	};
+
+	// Loads .rwdmesh files, the file's sections are uploaded straight from the read buffer
+	class VulkanMeshLoader : public AssetLoader {
+	public:
+		VulkanMeshLoader(VulkanRenderer* renderer);
+
+		Scope<Asset> Decode(const std::string& path, IoBuffer& contents) override;
+		bool Upload(Asset& asset) override;
+		void Unload(Asset& asset) override;
+	private:
+		VulkanRenderer* mRenderer;
+	};
+
+	// Loads compiled SPIR-V into shader modules
+	class VulkanShaderLoader : public AssetLoader {
+	public:
+		VulkanShaderLoader(VkDevice device);
+
+		Scope<Asset> Decode(const std::string& path, IoBuffer& contents) override;
+		bool Upload(Asset& asset) override;
+		void Unload(Asset& asset) override;
+	private:
+		VkDevice mDevice;
+	};
+
+	// Loads .ktx2 and .dds files. With a streamer only the mips up to TEXTURE_STREAMING_TAIL_SIZE
+	// are loaded, the streamer brings in the rest when they're actually visible.
+	class VulkanTextureLoader : public AssetLoader {
+	public:
+		VulkanTextureLoader(VulkanRenderer* renderer, VulkanTextureStreamer* streamer = nullptr);
+
+		Scope<Asset> Decode(const std::string& path, IoBuffer& contents) override;
+		bool Upload(Asset& asset) override;
+		void Unload(Asset& asset) override;
+	private:
+		VulkanRenderer* mRenderer;
+		VulkanTextureStreamer* mStreamer;
+	};
+
+}
@@ -1,11 +1,12 @@
 #include "pch.h"
 #include "core/Log.h"
+#include "VulkanMemoryGovernor.h"
 #include "VulkanBuffer.h"
 
 namespace rwd {
 
-	static void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage, 
-		VkBuffer& buffer, VmaAllocation& bufferMemory, VkDevice device, VmaAllocator allocator) 
+	static void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage, MemoryPool pool, MemoryTag tag,
+		VkBuffer& buffer, VmaAllocation& bufferMemory, VmaAllocator allocator, VulkanMemoryPools& pools) 
 	{
 		VkBufferCreateInfo bufferInfo { };
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -13,19 +14,18 @@ namespace rwd {
 		bufferInfo.usage = bufferUsage;
 		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-		VmaAllocationCreateInfo allocInfo { };
-		allocInfo.usage = memoryUsage;
-
-		VkResult result = vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer, &bufferMemory, nullptr);
+		VkResult result = pools.CreateBuffer(pool, bufferInfo, memoryUsage, buffer, bufferMemory);
 
 		RWD_ASSERT(result == VK_SUCCESS, "Failed to create Vulkan buffer");
+		TrackAllocation(allocator, bufferMemory, tag);
 	}
 
-	VulkanVertexBuffer::VulkanVertexBuffer(void* verts, u32 size, VkDevice device, VmaAllocator allocator) {
+	VulkanVertexBuffer::VulkanVertexBuffer(const void* verts, u32 size, VmaAllocator allocator, VulkanMemoryPools& pools) {
 		mSize = size;
 
 		VkBufferUsageFlags stagingUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		CreateBuffer(size, stagingUsage, VMA_MEMORY_USAGE_CPU_TO_GPU, mStagingBuffer, mStagingBufferMemory, device, allocator);
+		CreateBuffer(size, stagingUsage, VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryPool::Streaming, MemoryTag::Staging,
+			mStagingBuffer, mStagingBufferMemory, allocator, pools);
 
 		void* data;
 		vmaMapMemory(allocator, mStagingBufferMemory, &data);
@@ -33,17 +33,16 @@ namespace rwd {
 		vmaUnmapMemory(allocator, mStagingBufferMemory);
 
 		VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-		CreateBuffer(size, vertexUsage, VMA_MEMORY_USAGE_GPU_ONLY, mBuffer, mBufferMemory, device, allocator);
+		CreateBuffer(size, vertexUsage, VMA_MEMORY_USAGE_GPU_ONLY, MemoryPool::Geometry, MemoryTag::Geometry,
+			mBuffer, mBufferMemory, allocator, pools);
 	}
 
-	void VulkanVertexBuffer::FreeBuffer(VkDevice device, VmaAllocator allocator) {
-		vmaFreeMemory(allocator, mBufferMemory);
-		vkDestroyBuffer(device, mBuffer, nullptr);
+	void VulkanVertexBuffer::RetireBuffer(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage) {
+		deletionQueue.RetireBuffer(usage, mBuffer, mBufferMemory);
 	}
 
-	void VulkanVertexBuffer::FreeStagingBuffer(VkDevice device, VmaAllocator allocator) {
-		vkDestroyBuffer(device, mStagingBuffer, nullptr);
-		vmaFreeMemory(allocator, mStagingBufferMemory);
+	void VulkanVertexBuffer::RetireStagingBuffer(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage) {
+		deletionQueue.RetireBuffer(usage, mStagingBuffer, mStagingBufferMemory);
 	}
 
 	void VulkanVertexBuffer::Bind() const {
@@ -72,11 +71,12 @@ namespace rwd {
 	//
 	//-------------------------------------------------------------------------
 
-	VulkanIndexBuffer::VulkanIndexBuffer(void* indices, u32 size, VkDevice device, VmaAllocator allocator) {
+	VulkanIndexBuffer::VulkanIndexBuffer(const void* indices, u32 size, VmaAllocator allocator, VulkanMemoryPools& pools) {
 		mSize = size;
 
 		VkBufferUsageFlags stagingUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		CreateBuffer(size, stagingUsage, VMA_MEMORY_USAGE_CPU_TO_GPU, mStagingBuffer, mStagingBufferMemory, device, allocator);
+		CreateBuffer(size, stagingUsage, VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryPool::Streaming, MemoryTag::Staging,
+			mStagingBuffer, mStagingBufferMemory, allocator, pools);
 
 		void* data;
 		vmaMapMemory(allocator, mStagingBufferMemory, &data);
@@ -84,17 +84,16 @@ namespace rwd {
 		vmaUnmapMemory(allocator, mStagingBufferMemory);
 
 		VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-		CreateBuffer(size, vertexUsage, VMA_MEMORY_USAGE_GPU_ONLY, mBuffer, mBufferMemory, device, allocator);
+		CreateBuffer(size, vertexUsage, VMA_MEMORY_USAGE_GPU_ONLY, MemoryPool::Geometry, MemoryTag::Geometry,
+			mBuffer, mBufferMemory, allocator, pools);
 	}
 
-	void VulkanIndexBuffer::FreeBuffer(VkDevice device, VmaAllocator allocator) {
-		vmaFreeMemory(allocator, mBufferMemory);
-		vkDestroyBuffer(device, mBuffer, nullptr);
+	void VulkanIndexBuffer::RetireBuffer(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage) {
+		deletionQueue.RetireBuffer(usage, mBuffer, mBufferMemory);
 	}
 
-	void VulkanIndexBuffer::FreeStagingBuffer(VkDevice device, VmaAllocator allocator) {
-		vkDestroyBuffer(device, mStagingBuffer, nullptr);
-		vmaFreeMemory(allocator, mStagingBufferMemory);
+	void VulkanIndexBuffer::RetireStagingBuffer(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage) {
+		deletionQueue.RetireBuffer(usage, mStagingBuffer, mStagingBufferMemory);
 	}
 
 	void VulkanIndexBuffer::Bind() const {
@@ -134,6 +133,11 @@ namespace rwd {
 	void VulkanMesh::Bind() const {
 	}
 
+	void VulkanMesh::Retire(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage) {
+		mVertexBuffer.RetireBuffer(deletionQueue, usage);
+		mIndexBuffer.RetireBuffer(deletionQueue, usage);
+	}
+
 	void VulkanMesh::SetVertexBuffer(VulkanVertexBuffer vertexBuffer) {
 		mVertexBuffer = vertexBuffer;
 	}
@@ -142,6 +146,10 @@ namespace rwd {
 		mIndexBuffer = indexBuffer;
 	}
 
+	void VulkanMesh::SetLods(const std::vector<MeshLod>& lods) {
+		mLods = lods;
+	}
+
 	size_t VulkanMesh::VertexBufferSize() const {
 		return mVertexBuffer.Size();
 	}
@@ -166,4 +174,13 @@ namespace rwd {
 		return mIndexBuffer.StagingBuffer();
 	}
 
+	const MeshLod& VulkanMesh::Lod(u32 lod) const {
+		RWD_ASSERT(lod < mLods.size(), "Mesh LOD {0} is out of range", lod);
+		return mLods[lod];
+	}
+
+	u32 VulkanMesh::LodCount() const {
+		return (u32)mLods.size();
+	}
+
 }
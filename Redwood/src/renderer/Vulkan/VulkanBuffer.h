@@ -1,17 +1,21 @@
 #pragma once
 #include "vulkan/vulkan.hpp"
 #include "VulkanContext.h"
+#include "VulkanMemoryPools.h"
+#include "VulkanDeletionQueue.h"
 #include "renderer/Buffer.h"
+#include "renderer/Mesh.h"
 
 namespace rwd {
 
 	class VulkanVertexBuffer : public VertexBuffer {
 	public:
 		VulkanVertexBuffer() = default;
-		VulkanVertexBuffer(void* verts, u32 size, VkDevice device, VmaAllocator allocator);
+		VulkanVertexBuffer(const void* verts, u32 size, VmaAllocator allocator, VulkanMemoryPools& pools);
 
-		void FreeBuffer(VkDevice device, VmaAllocator allocator);
-		void FreeStagingBuffer(VkDevice device, VmaAllocator allocator);
+		// Hands the buffer to the deletion queue, freed once the GPU has passed usage
+		void RetireBuffer(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage);
+		void RetireStagingBuffer(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage);
 
 		void Bind() const override;
 		void BufferData(const u8* bytes) override;
@@ -32,10 +36,11 @@ namespace rwd {
 	class VulkanIndexBuffer : public IndexBuffer {
 	public:
 		VulkanIndexBuffer() = default;
-		VulkanIndexBuffer(void* indices, u32 size, VkDevice device, VmaAllocator allocator);
+		VulkanIndexBuffer(const void* indices, u32 size, VmaAllocator allocator, VulkanMemoryPools& pools);
 
-		void FreeBuffer(VkDevice device, VmaAllocator allocator);
-		void FreeStagingBuffer(VkDevice device, VmaAllocator allocator);
+		// Hands the buffer to the deletion queue, freed once the GPU has passed usage
+		void RetireBuffer(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage);
+		void RetireStagingBuffer(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage);
 
 		void Bind() const override;
 		void BufferData(const u8* bytes) override;
@@ -59,8 +64,11 @@ namespace rwd {
 		~VulkanMesh();
 		void Bind() const;
 
+		void Retire(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage);
+
 		void SetVertexBuffer(VulkanVertexBuffer vertexBuffer);
 		void SetIndexBuffer(VulkanIndexBuffer indexBuffer);
+		void SetLods(const std::vector<MeshLod>& lods);
 
 		size_t VertexBufferSize() const;
 		size_t IndexBufferSize() const;
@@ -70,9 +78,14 @@ namespace rwd {
 
 		VkBuffer IndexBuffer() const;
 		VkBuffer IndexStagingBuffer() const;
+
+		// Index range to pass as firstIndex / indexCount when drawing the given LOD
+		const MeshLod& Lod(u32 lod) const;
+		u32 LodCount() const;
 	private:
 		VulkanVertexBuffer mVertexBuffer;
 		VulkanIndexBuffer mIndexBuffer;
+		std::vector<MeshLod> mLods;
 	};
 
 }
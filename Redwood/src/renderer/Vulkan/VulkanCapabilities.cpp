@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "core/Log.h"
+#include "VulkanCapabilities.h"
+
+namespace rwd {
+
+	static bool HasExtension(const std::vector<VkExtensionProperties>& extensions, const char* name) {
+		for (const VkExtensionProperties& extension : extensions) {
+			if (strcmp(extension.extensionName, name) == 0) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Links feature structs into a pNext chain in the order they're added
+	class FeatureChain {
+	public:
+		FeatureChain(void** head) : mNext(head) { }
+
+		template<typename T>
+		void Add(T& features) {
+			*mNext = &features;
+			mNext = &features.pNext;
+		}
+	private:
+		void** mNext;
+	};
+
+	// Vulkan 1.3 promoted dynamic rendering and synchronization2, older devices expose them as KHR extensions
+	static bool HasVulkan13(const VulkanCapabilities& capabilities) {
+		return capabilities.apiVersion >= VK_API_VERSION_1_3;
+	}
+
+	VulkanCapabilities QueryCapabilities(VkPhysicalDevice device) {
+		VulkanCapabilities capabilities;
+
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties(device, &props);
+
+		capabilities.deviceName = props.deviceName;
+		capabilities.deviceType = props.deviceType;
+		capabilities.apiVersion = props.apiVersion;
+		capabilities.maxSamplerAnisotropy = props.limits.maxSamplerAnisotropy;
+
+		VkPhysicalDeviceMemoryProperties memoryProps;
+		vkGetPhysicalDeviceMemoryProperties(device, &memoryProps);
+
+		for (u32 i = 0; i < memoryProps.memoryHeapCount; i++) {
+			if (memoryProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+				capabilities.deviceLocalMemory = std::max(capabilities.deviceLocalMemory, (u64)memoryProps.memoryHeaps[i].size);
+			}
+		}
+
+		u32 extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+		capabilities.swapchain = HasExtension(extensions, VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+		capabilities.memoryBudget = HasExtension(extensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		bool meshShaderExtension = HasExtension(extensions, VK_EXT_MESH_SHADER_EXTENSION_NAME);
+		bool dynamicRenderingExtension = HasExtension(extensions, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		bool synchronization2Extension = HasExtension(extensions, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+		bool shaderModuleIdentifierExtension = HasVulkan13(capabilities) && HasExtension(extensions, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+
+		// Feature structs may only be chained for what the device actually has
+		VkPhysicalDeviceMeshShaderFeaturesEXT meshShader { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT };
+		VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shaderModuleIdentifier { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT };
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR };
+		VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR };
+		VkPhysicalDeviceVulkan13Features features13 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
+		VkPhysicalDeviceVulkan12Features features12 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+		VkPhysicalDeviceFeatures2 features2 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+
+		if (props.apiVersion >= VK_API_VERSION_1_2) {
+			FeatureChain chain(&features2.pNext);
+			chain.Add(features12);
+
+			if (HasVulkan13(capabilities)) {
+				chain.Add(features13);
+			} else {
+				if (dynamicRenderingExtension) chain.Add(dynamicRendering);
+				if (synchronization2Extension) chain.Add(synchronization2);
+			}
+
+			if (meshShaderExtension) chain.Add(meshShader);
+			if (shaderModuleIdentifierExtension) chain.Add(shaderModuleIdentifier);
+
+			vkGetPhysicalDeviceFeatures2(device, &features2);
+		} else {
+			vkGetPhysicalDeviceFeatures(device, &features2.features);
+		}
+
+		const VkPhysicalDeviceFeatures& features = features2.features;
+		capabilities.samplerAnisotropy = features.samplerAnisotropy;
+		capabilities.textureCompressionBC = features.textureCompressionBC;
+		capabilities.textureCompressionASTC = features.textureCompressionASTC_LDR;
+		capabilities.multiDrawIndirect = features.multiDrawIndirect;
+
+		capabilities.timelineSemaphores = features12.timelineSemaphore;
+		capabilities.drawIndirectCount = features12.drawIndirectCount;
+		capabilities.descriptorIndexing = features12.descriptorIndexing
+			&& features12.runtimeDescriptorArray
+			&& features12.descriptorBindingPartiallyBound
+			&& features12.descriptorBindingVariableDescriptorCount
+			&& features12.descriptorBindingSampledImageUpdateAfterBind
+			&& features12.shaderSampledImageArrayNonUniformIndexing;
+
+		if (HasVulkan13(capabilities)) {
+			capabilities.dynamicRendering = features13.dynamicRendering;
+			capabilities.synchronization2 = features13.synchronization2;
+		} else {
+			capabilities.dynamicRendering = dynamicRenderingExtension && dynamicRendering.dynamicRendering;
+			capabilities.synchronization2 = synchronization2Extension && synchronization2.synchronization2;
+		}
+
+		capabilities.meshShaders = meshShaderExtension && meshShader.meshShader && meshShader.taskShader;
+
+		// Failing instead of compiling comes from pipeline creation cache control, core in 1.3
+		capabilities.shaderModuleIdentifier = shaderModuleIdentifierExtension && shaderModuleIdentifier.shaderModuleIdentifier
+			&& features13.pipelineCreationCacheControl;
+
+		if (capabilities.shaderModuleIdentifier) {
+			VkPhysicalDeviceShaderModuleIdentifierPropertiesEXT identifierProps { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_PROPERTIES_EXT };
+			VkPhysicalDeviceProperties2 props2 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &identifierProps };
+			vkGetPhysicalDeviceProperties2(device, &props2);
+
+			memcpy(capabilities.shaderModuleIdentifierAlgorithm, identifierProps.shaderModuleIdentifierAlgorithmUUID, VK_UUID_SIZE);
+		}
+
+		return capabilities;
+	}
+
+	u32 ScoreCapabilities(const VulkanCapabilities& capabilities) {
+		u32 score = 0;
+
+		switch (capabilities.deviceType) {
+			case(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU):   score += 10000; break;
+			case(VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU): score += 5000; break;
+			case(VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU):    score += 1000; break;
+			case(VK_PHYSICAL_DEVICE_TYPE_CPU):            score += 100; break;
+			default: break;
+		}
+
+		// A point per 64 MiB, capped at 32 GiB so memory can't outweigh the device type
+		score += (u32)(std::min(capabilities.deviceLocalMemory, (u64)32 << 30) >> 26);
+
+		if (capabilities.asyncCompute)       score += 300;
+		if (capabilities.descriptorIndexing) score += 200;
+		if (capabilities.drawIndirectCount)  score += 150;
+		if (capabilities.meshShaders)        score += 150;
+		if (capabilities.dynamicRendering)   score += 100;
+		if (capabilities.memoryBudget)       score += 100;
+		if (capabilities.multiDrawIndirect)  score += 50;
+		if (capabilities.samplerAnisotropy)  score += 50;
+
+		return score;
+	}
+
+	std::vector<const char*> EnabledDeviceExtensions(const VulkanCapabilities& capabilities) {
+		std::vector<const char*> extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+
+		if (capabilities.memoryBudget) {
+			extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+
+		if (capabilities.meshShaders) {
+			extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+		}
+
+		if (capabilities.shaderModuleIdentifier) {
+			extensions.push_back(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+		}
+
+		if (!HasVulkan13(capabilities)) {
+			if (capabilities.dynamicRendering) extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+			if (capabilities.synchronization2) extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+		}
+
+		return extensions;
+	}
+
+	VulkanDeviceFeatures::VulkanDeviceFeatures(const VulkanCapabilities& capabilities) {
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.features.samplerAnisotropy = capabilities.samplerAnisotropy;
+		features2.features.textureCompressionBC = capabilities.textureCompressionBC;
+		features2.features.textureCompressionASTC_LDR = capabilities.textureCompressionASTC;
+		features2.features.multiDrawIndirect = capabilities.multiDrawIndirect;
+
+		FeatureChain chain(&features2.pNext);
+
+		features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		features12.timelineSemaphore = capabilities.timelineSemaphores;
+		features12.drawIndirectCount = capabilities.drawIndirectCount;
+
+		if (capabilities.descriptorIndexing) {
+			features12.descriptorIndexing = VK_TRUE;
+			features12.runtimeDescriptorArray = VK_TRUE;
+			features12.descriptorBindingPartiallyBound = VK_TRUE;
+			features12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		}
+
+		chain.Add(features12);
+
+		features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		dynamicRenderingKHR.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+		synchronization2KHR.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+		if (HasVulkan13(capabilities)) {
+			features13.dynamicRendering = capabilities.dynamicRendering;
+			features13.synchronization2 = capabilities.synchronization2;
+			features13.pipelineCreationCacheControl = capabilities.shaderModuleIdentifier;
+			chain.Add(features13);
+		} else {
+			if (capabilities.dynamicRendering) {
+				dynamicRenderingKHR.dynamicRendering = VK_TRUE;
+				chain.Add(dynamicRenderingKHR);
+			}
+
+			if (capabilities.synchronization2) {
+				synchronization2KHR.synchronization2 = VK_TRUE;
+				chain.Add(synchronization2KHR);
+			}
+		}
+
+		meshShader.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+		if (capabilities.meshShaders) {
+			meshShader.meshShader = VK_TRUE;
+			meshShader.taskShader = VK_TRUE;
+			chain.Add(meshShader);
+		}
+
+		shaderModuleIdentifier.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT;
+		if (capabilities.shaderModuleIdentifier) {
+			shaderModuleIdentifier.shaderModuleIdentifier = VK_TRUE;
+			chain.Add(shaderModuleIdentifier);
+		}
+	}
+
+	void LogCapabilities(const VulkanCapabilities& capabilities) {
+		RWD_LOG("  Vulkan {0}.{1}, {2} MiB device local", VK_API_VERSION_MAJOR(capabilities.apiVersion),
+			VK_API_VERSION_MINOR(capabilities.apiVersion), capabilities.deviceLocalMemory >> 20);
+		RWD_LOG("  Timeline semaphores: {0}, descriptor indexing: {1}, draw indirect count: {2}, mesh shaders: {3}",
+			capabilities.timelineSemaphores, capabilities.descriptorIndexing, capabilities.drawIndirectCount, capabilities.meshShaders);
+		RWD_LOG("  Dynamic rendering: {0}, synchronization2: {1}, shader module identifiers: {2}", capabilities.dynamicRendering,
+			capabilities.synchronization2, capabilities.shaderModuleIdentifier);
+		RWD_LOG("  Memory budget: {0}, async compute: {1}, anisotropy: {2}x, BC: {3}, ASTC: {4}",
+			capabilities.memoryBudget, capabilities.asyncCompute, capabilities.samplerAnisotropy ? capabilities.maxSamplerAnisotropy : 1.0f,
+			capabilities.textureCompressionBC, capabilities.textureCompressionASTC);
+	}
+
+}
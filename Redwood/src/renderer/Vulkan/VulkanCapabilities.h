@@ -0,0 +1,80 @@
+#pragma once
+#include "pch.h"
+#include "vulkan/vulkan.h"
+#include "core/Core.h"
+
+namespace rwd {
+
+	// What a physical device can do, gathered once at selection time. The device is created with
+	// exactly these features enabled and the renderer checks them to pick its fast paths.
+	struct VulkanCapabilities {
+		std::string deviceName;
+		VkPhysicalDeviceType deviceType = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+		u32 apiVersion = 0;
+
+		// Size of the largest device local heap
+		u64 deviceLocalMemory = 0;
+
+		// Core features
+		bool samplerAnisotropy = false;
+		f32 maxSamplerAnisotropy = 1.0f;
+		bool textureCompressionBC = false;
+		bool textureCompressionASTC = false;
+		bool multiDrawIndirect = false;
+
+		// Vulkan 1.2 features
+		bool timelineSemaphores = false;
+		bool drawIndirectCount = false;
+
+		// Bindless textures: partially bound, variable count, update after bind arrays of
+		// sampled images indexed with non uniform indices
+		bool descriptorIndexing = false;
+
+		// Vulkan 1.3 features, or VK_KHR_dynamic_rendering and VK_KHR_synchronization2 on 1.2 devices
+		bool dynamicRendering = false;
+		bool synchronization2 = false;
+
+		// Extensions
+		bool swapchain = false;    // VK_KHR_swapchain, required
+		bool memoryBudget = false; // VK_EXT_memory_budget
+		bool meshShaders = false;  // VK_EXT_mesh_shader, task and mesh stages
+
+		// VK_EXT_shader_module_identifier, on Vulkan 1.3 devices where pipeline creation can be told
+		// to fail rather than compile. Identifiers are only comparable within the same algorithm.
+		bool shaderModuleIdentifier = false;
+		u8 shaderModuleIdentifierAlgorithm[VK_UUID_SIZE] = { };
+
+		// Filled in by the context once queue families are known
+		bool asyncCompute = false;
+	};
+
+	// Reads the device's properties, features and extensions
+	VulkanCapabilities QueryCapabilities(VkPhysicalDevice device);
+
+	// Higher is better. Device type weighs the most, then memory, queue layout and optional features.
+	u32 ScoreCapabilities(const VulkanCapabilities& capabilities);
+
+	// Extensions to create the device with, the required ones plus the optional ones it supports
+	std::vector<const char*> EnabledDeviceExtensions(const VulkanCapabilities& capabilities);
+
+	// Feature structs for VkDeviceCreateInfo::pNext, turning on what the capabilities report.
+	// The structs point at each other, so this can't be copied.
+	struct VulkanDeviceFeatures {
+		VkPhysicalDeviceFeatures2 features2 { };
+		VkPhysicalDeviceVulkan12Features features12 { };
+		VkPhysicalDeviceVulkan13Features features13 { };
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingKHR { };
+		VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2KHR { };
+		VkPhysicalDeviceMeshShaderFeaturesEXT meshShader { };
+		VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shaderModuleIdentifier { };
+
+		VulkanDeviceFeatures(const VulkanCapabilities& capabilities);
+		VulkanDeviceFeatures(const VulkanDeviceFeatures&) = delete;
+		VulkanDeviceFeatures& operator=(const VulkanDeviceFeatures&) = delete;
+
+		const void* Chain() const { return &features2; }
+	};
+
+	void LogCapabilities(const VulkanCapabilities& capabilities);
+
+}
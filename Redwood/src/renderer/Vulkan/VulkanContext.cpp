@@ -11,10 +11,6 @@ namespace rwd {
 		"VK_LAYER_KHRONOS_validation",
 	};
 
-	const std::vector<const char*> deviceExtensions = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-	};
-
 	VulkanContext::VulkanContext(SDL_Window* sdlWindow)
 		: Context(sdlWindow), mRecreateSwapChain(false)
 	{
@@ -43,9 +39,9 @@ namespace rwd {
 	}
 
 	void VulkanContext::ResizeRenderingSurface(const u32 width, const u32 height) {
-		mRecreateSwapChain = true;
 		mWindowWidth = width;
 		mWindowHeight = height;
+		mRecreateSwapChain.store(true, std::memory_order_release);
 	}
 
 	void VulkanContext::CreateVulkanInstance() {
@@ -56,7 +52,8 @@ namespace rwd {
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_1;
+		// The highest version the engine uses, devices still only need 1.2
+		appInfo.apiVersion = VK_API_VERSION_1_3;
 
 		VkInstanceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -140,53 +137,49 @@ namespace rwd {
 		std::vector<VkPhysicalDevice> devices(deviceCount);
 		vkEnumeratePhysicalDevices(mInstance, &deviceCount, devices.data());
 
-		for (const auto& device : devices) {
-
-			VkPhysicalDeviceProperties props;
-			vkGetPhysicalDeviceProperties(device, &props);
+		// Every device that meets the hard requirements is scored, the best one wins
+		u32 bestScore = 0;
 
-			VkPhysicalDeviceFeatures features;
-			vkGetPhysicalDeviceFeatures(device, &features);
-
-			bool isDedicatedGpu = props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
-			bool hasGeometryShader = features.geometryShader;
+		for (const auto& device : devices) {
+			VulkanCapabilities capabilities = QueryCapabilities(device);
 
 			QueueFamilyIndices indices = FindQueueFamilies(device);
-			bool supportsQueueFamilies = indices.IsComplete();
-
-			bool supportsExtensions = false;
-			{
-				u32 extensionCount;
-				vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-
-				std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-				vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
-
-				std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
-				for (const auto& extension : availableExtensions) {
-					requiredExtensions.erase(extension.extensionName);
+			capabilities.asyncCompute = indices.IsComplete() && indices.computeFamily.value() != indices.graphicsFamily.value();
+
+			const char* rejection = nullptr;
+			if (!indices.IsComplete()) {
+				rejection = "no graphics or present queue";
+			} else if (!capabilities.swapchain) {
+				rejection = "no swapchain support";
+			} else if (!capabilities.timelineSemaphores) {
+				// Frame and upload synchronization is built on them
+				rejection = "no Vulkan 1.2 timeline semaphores";
+			} else {
+				SwapChainSupportDetails details = QuerySwapChainSupport(device);
+				if (details.formats.empty() || details.presentModes.empty()) {
+					rejection = "no usable swapchain formats or present modes";
 				}
-
-				supportsExtensions = requiredExtensions.empty();
 			}
 
-			bool swapChainAdequate = false;
-			{
-				if (supportsExtensions) {
-					SwapChainSupportDetails details = QuerySwapChainSupport(device);
-					swapChainAdequate = !details.formats.empty() && !details.presentModes.empty();
-				}
+			if (rejection != nullptr) {
+				RWD_LOG_WARN("Skipping Vulkan device '{0}', {1}", capabilities.deviceName, rejection);
+				continue;
 			}
 
-			if (isDedicatedGpu && hasGeometryShader && supportsQueueFamilies && supportsExtensions && swapChainAdequate) {
+			u32 score = ScoreCapabilities(capabilities);
+			RWD_LOG("Vulkan device '{0}' scored {1}", capabilities.deviceName, score);
+
+			if (mPhysicalDevice == VK_NULL_HANDLE || score > bestScore) {
 				mPhysicalDevice = device;
-				RWD_LOG("Chosen Vulkan device '{0}'", props.deviceName);
-				break;
+				mCapabilities = capabilities;
+				bestScore = score;
 			}
 		}
 
-		RWD_ASSERT(mPhysicalDevice != VK_NULL_HANDLE, "Failed to choose Vulkan device");
+		RWD_ASSERT(mPhysicalDevice != VK_NULL_HANDLE, "No Vulkan device has graphics and present queues, a swapchain and timeline semaphores");
+
+		RWD_LOG("Chosen Vulkan device '{0}'", mCapabilities.deviceName);
+		LogCapabilities(mCapabilities);
 	}
 
 	void VulkanContext::CreateLogicalDevice() {
@@ -200,6 +193,7 @@ namespace rwd {
 			std::set<u32> uniqueQueueFamilies = { 
 				queueIndices.graphicsFamily.value(), 
 				queueIndices.presentFamily.value(), 
+				queueIndices.computeFamily.value(),
 			};
 
 			for (const u32 queueFamilyIndex : uniqueQueueFamilies) {
@@ -217,23 +211,24 @@ namespace rwd {
 			}
 		}
 
-		// Now we need to specify the device features we want to use 
-		VkPhysicalDeviceFeatures deviceFeatures { };
-		{
-
-		}
+		// Turn on exactly what the device was found to support
+		VulkanDeviceFeatures deviceFeatures(mCapabilities);
+		std::vector<const char*> enabledExtensions = EnabledDeviceExtensions(mCapabilities);
 
 		// Create our device info struct and enable extensions / validation layers 
 		VkDeviceCreateInfo createInfo { };
 		{
 			createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+			createInfo.pNext = deviceFeatures.Chain();
 			createInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
 			createInfo.pQueueCreateInfos = queueCreateInfos.data();
-			createInfo.pEnabledFeatures = &deviceFeatures;
+
+			// Core features are passed in the VkPhysicalDeviceFeatures2 at the head of the chain
+			createInfo.pEnabledFeatures = nullptr;
 
 			// Specify the device specific extensions
-			createInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
-			createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+			createInfo.enabledExtensionCount = (uint32_t)enabledExtensions.size();
+			createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 			// Specify the device specific validation layers
 			//  
@@ -264,7 +259,9 @@ namespace rwd {
 		{
 			vkGetDeviceQueue(mDevice, queueIndices.graphicsFamily.value(), 0, &mGraphicsQueue);
 			vkGetDeviceQueue(mDevice, queueIndices.presentFamily.value(), 0, &mPresentQueue);
+			vkGetDeviceQueue(mDevice, queueIndices.computeFamily.value(), 0, &mComputeQueue);
 		}
+
 	}
 
 	QueueFamilyIndices VulkanContext::FindQueueFamilies(VkPhysicalDevice device) {
@@ -297,6 +294,20 @@ namespace rwd {
 			i++;
 		}
 
+		// Compute only families are what the hardware schedules alongside graphics,
+		// a compute queue from the graphics family would just be time sliced with it
+		for (u32 family = 0; family < queueFamilyCount; family++) {
+			VkQueueFlags flags = queueFamilies[family].queueFlags;
+			if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+				indices.computeFamily = family;
+				break;
+			}
+		}
+
+		if (!indices.computeFamily.has_value()) {
+			indices.computeFamily = indices.graphicsFamily;
+		}
+
 		return indices;
 	}
 
@@ -1,9 +1,11 @@
 #pragma once
+#include <atomic>
 #include <optional>
 #include "vulkan/vulkan.h"
 #include "vk_mem_alloc.h"
 #include "core/Core.h"
 #include "renderer/Context.h"
+#include "VulkanCapabilities.h"
 
 namespace rwd {
 
@@ -13,6 +15,9 @@ namespace rwd {
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
 
+		// A compute only family when the device has one, otherwise the graphics family
+		std::optional<uint32_t> computeFamily;
+
 		inline bool IsComplete() {
 			return graphicsFamily.has_value() && presentFamily.has_value();
 		}
@@ -54,11 +59,16 @@ namespace rwd {
 
 		VkQueue mGraphicsQueue;
 		VkQueue mPresentQueue;
+		VkQueue mComputeQueue;
 
 		u32 mWindowWidth;
 		u32 mWindowHeight;
 
-		bool mRecreateSwapChain;
+		// Set by the thread handling window events, taken by the one drawing frames
+		std::atomic<bool> mRecreateSwapChain;
+
+		// What the chosen device supports, and was created with
+		VulkanCapabilities mCapabilities;
 	};
 
 }
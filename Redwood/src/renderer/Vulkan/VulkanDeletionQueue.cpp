@@ -0,0 +1,105 @@
+#include "pch.h"
+#include "VulkanMemoryGovernor.h"
+#include "VulkanDeletionQueue.h"
+
+namespace rwd {
+
+	void VulkanDeletionQueue::Init(VkDevice device, VmaAllocator allocator) {
+		mDevice = device;
+		mAllocator = allocator;
+	}
+
+	void VulkanDeletionQueue::RetireBuffer(const TimelineUsage& usage, VkBuffer buffer, VmaAllocation allocation) {
+		mRetired.push_back(Retired { .type = ResourceType::Buffer, .usage = usage, .buffer = buffer, .allocation = allocation });
+	}
+
+	void VulkanDeletionQueue::RetireImage(const TimelineUsage& usage, VkImage image, VmaAllocation allocation) {
+		mRetired.push_back(Retired { .type = ResourceType::Image, .usage = usage, .image = image, .allocation = allocation });
+	}
+
+	void VulkanDeletionQueue::RetireImageView(const TimelineUsage& usage, VkImageView view) {
+		mRetired.push_back(Retired { .type = ResourceType::ImageView, .usage = usage, .view = view });
+	}
+
+	void VulkanDeletionQueue::RetirePipeline(const TimelineUsage& usage, VkPipeline pipeline) {
+		mRetired.push_back(Retired { .type = ResourceType::Pipeline, .usage = usage, .pipeline = pipeline });
+	}
+
+	void VulkanDeletionQueue::RetireFramebuffer(const TimelineUsage& usage, VkFramebuffer framebuffer) {
+		mRetired.push_back(Retired { .type = ResourceType::Framebuffer, .usage = usage, .framebuffer = framebuffer });
+	}
+
+	void VulkanDeletionQueue::RetireDescriptorSet(const TimelineUsage& usage, VkDescriptorPool pool, VkDescriptorSet set) {
+		mRetired.push_back(Retired { .type = ResourceType::DescriptorSet, .usage = usage, .descriptorPool = pool, .descriptorSet = set });
+	}
+
+	void VulkanDeletionQueue::RetireCommandBuffer(const TimelineUsage& usage, VkCommandPool pool, VkCommandBuffer commandBuffer) {
+		mRetired.push_back(Retired { .type = ResourceType::CommandBuffer, .usage = usage, .commandPool = pool, .commandBuffer = commandBuffer });
+	}
+
+	void VulkanDeletionQueue::Collect(VulkanTimeline* timelines) {
+		auto complete = [timelines] (const Retired& retired) {
+			for (u32 queue = 0; queue < (u32)QueueType::Count; queue++) {
+				if (!timelines[queue].IsComplete(retired.usage.values[queue])) {
+					return false;
+				}
+			}
+
+			return true;
+		};
+
+		// Keeps the survivors in retirement order
+		size_t kept = 0;
+		for (size_t i = 0; i < mRetired.size(); i++) {
+			if (complete(mRetired[i])) {
+				Destroy(mRetired[i]);
+			} else {
+				mRetired[kept++] = mRetired[i];
+			}
+		}
+
+		mRetired.resize(kept);
+	}
+
+	void VulkanDeletionQueue::Flush() {
+		for (const Retired& retired : mRetired) {
+			Destroy(retired);
+		}
+
+		mRetired.clear();
+	}
+
+	size_t VulkanDeletionQueue::Size() const {
+		return mRetired.size();
+	}
+
+	void VulkanDeletionQueue::Destroy(const Retired& retired) {
+		switch (retired.type) {
+			case(ResourceType::Buffer):
+				UntrackAllocation(mAllocator, retired.allocation);
+				vmaDestroyBuffer(mAllocator, retired.buffer, retired.allocation);
+				break;
+			case(ResourceType::Image):
+				UntrackAllocation(mAllocator, retired.allocation);
+				vmaDestroyImage(mAllocator, retired.image, retired.allocation);
+				break;
+			case(ResourceType::ImageView):
+				vkDestroyImageView(mDevice, retired.view, nullptr);
+				break;
+			case(ResourceType::Pipeline):
+				vkDestroyPipeline(mDevice, retired.pipeline, nullptr);
+				break;
+			case(ResourceType::Framebuffer):
+				vkDestroyFramebuffer(mDevice, retired.framebuffer, nullptr);
+				break;
+			case(ResourceType::DescriptorSet):
+				// The pool has to have been created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+				vkFreeDescriptorSets(mDevice, retired.descriptorPool, 1, &retired.descriptorSet);
+				break;
+			case(ResourceType::CommandBuffer):
+				vkFreeCommandBuffers(mDevice, retired.commandPool, 1, &retired.commandBuffer);
+				break;
+		}
+	}
+
+}
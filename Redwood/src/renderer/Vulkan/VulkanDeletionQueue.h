@@ -0,0 +1,69 @@
+#pragma once
+#include "pch.h"
+#include "vulkan/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "core/Core.h"
+#include "VulkanTimeline.h"
+
+namespace rwd {
+
+	// Resources the GPU may still be using, freed once it has passed the timeline values they were retired with.
+	//
+	// Retiring with everything submitted so far (VulkanRenderer::InFlight) is always safe, so destroying a
+	// resource mid session never has to stall the CPU on the device. Collect runs once per frame, resources
+	// are freed in the order they were retired which keeps the linear staging pool wrapping cleanly.
+	class VulkanDeletionQueue {
+	public:
+		void Init(VkDevice device, VmaAllocator allocator);
+
+		void RetireBuffer(const TimelineUsage& usage, VkBuffer buffer, VmaAllocation allocation);
+		void RetireImage(const TimelineUsage& usage, VkImage image, VmaAllocation allocation);
+		void RetireImageView(const TimelineUsage& usage, VkImageView view);
+		void RetirePipeline(const TimelineUsage& usage, VkPipeline pipeline);
+		void RetireFramebuffer(const TimelineUsage& usage, VkFramebuffer framebuffer);
+		void RetireDescriptorSet(const TimelineUsage& usage, VkDescriptorPool pool, VkDescriptorSet set);
+		void RetireCommandBuffer(const TimelineUsage& usage, VkCommandPool pool, VkCommandBuffer commandBuffer);
+
+		// Frees everything the timelines (indexed by QueueType) have passed
+		void Collect(VulkanTimeline* timelines);
+
+		// Frees everything regardless, the device has to be idle
+		void Flush();
+
+		size_t Size() const;
+	private:
+		enum class ResourceType : u32 {
+			Buffer,
+			Image,
+			ImageView,
+			Pipeline,
+			Framebuffer,
+			DescriptorSet,
+			CommandBuffer,
+		};
+
+		// Only the handles matching type are set
+		struct Retired {
+			ResourceType type;
+			TimelineUsage usage;
+
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkImage image = VK_NULL_HANDLE;
+			VmaAllocation allocation = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		};
+
+		void Destroy(const Retired& retired);
+	private:
+		VkDevice mDevice = VK_NULL_HANDLE;
+		VmaAllocator mAllocator = VK_NULL_HANDLE;
+		std::vector<Retired> mRetired;
+	};
+
+}
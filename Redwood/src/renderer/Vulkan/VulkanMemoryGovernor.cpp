@@ -0,0 +1,212 @@
+#include "pch.h"
+#include <atomic>
+#include "core/Log.h"
+#include "VulkanMemoryGovernor.h"
+
+namespace rwd {
+
+	// Allocations are made from loaders, streamers and the renderer alike, so the per tag totals are global
+	static std::atomic<u64> sTagBytes[(u32)MemoryTag::Count];
+	static std::atomic<u32> sTagCounts[(u32)MemoryTag::Count];
+
+	const char* MemoryTagName(MemoryTag tag) {
+		switch (tag) {
+			case(MemoryTag::Geometry):      return "Geometry";
+			case(MemoryTag::Textures):      return "Textures";
+			case(MemoryTag::Staging):       return "Staging";
+			case(MemoryTag::RenderTargets): return "RenderTargets";
+			case(MemoryTag::Other):         return "Other";
+			default:                        return "Unknown";
+		}
+	}
+
+	void TrackAllocation(VmaAllocator allocator, VmaAllocation allocation, MemoryTag tag) {
+		// The tag is stored off by one so untracked allocations (null user data) can be told apart
+		vmaSetAllocationUserData(allocator, allocation, (void*)(uintptr_t)((u32)tag + 1));
+		vmaSetAllocationName(allocator, allocation, MemoryTagName(tag));
+
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo(allocator, allocation, &info);
+
+		sTagBytes[(u32)tag] += info.size;
+		sTagCounts[(u32)tag]++;
+	}
+
+	void UntrackAllocation(VmaAllocator allocator, VmaAllocation allocation) {
+		if (allocation == VK_NULL_HANDLE) {
+			return;
+		}
+
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo(allocator, allocation, &info);
+
+		uintptr_t userData = (uintptr_t)info.pUserData;
+		if (userData == 0 || userData > (uintptr_t)MemoryTag::Count) {
+			return;
+		}
+
+		u32 tag = (u32)userData - 1;
+		sTagBytes[tag] -= info.size;
+		sTagCounts[tag]--;
+	}
+
+	void VulkanMemoryGovernor::Init(VmaAllocator allocator, const MemoryGovernorSettings& settings) {
+		mAllocator = allocator;
+		mSettings = settings;
+
+		const VkPhysicalDeviceMemoryProperties* memoryProperties;
+		vmaGetMemoryProperties(mAllocator, &memoryProperties);
+
+		mHeaps.resize(memoryProperties->memoryHeapCount);
+		for (u32 i = 0; i < memoryProperties->memoryHeapCount; i++) {
+			mHeaps[i].deviceLocal = memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+		}
+
+		Update();
+		LogBudgets();
+	}
+
+	void VulkanMemoryGovernor::Update() {
+		// VMA only refreshes the budgets from VK_EXT_memory_budget when the frame index changes
+		vmaSetCurrentFrameIndex(mAllocator, ++mFrame);
+
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+		vmaGetHeapBudgets(mAllocator, budgets);
+
+		f32 worstRatio = 0.0f;
+		u32 worstHeap = 0;
+
+		for (u32 i = 0; i < mHeaps.size(); i++) {
+			HeapBudget& heap = mHeaps[i];
+			heap.usage = budgets[i].usage;
+			heap.budget = budgets[i].budget;
+			heap.blockBytes = budgets[i].statistics.blockBytes;
+			heap.allocationBytes = budgets[i].statistics.allocationBytes;
+
+			if (heap.deviceLocal && heap.UsageRatio() > worstRatio) {
+				worstRatio = heap.UsageRatio();
+				worstHeap = i;
+			}
+		}
+
+		MemoryPressure pressure = MemoryPressure::Normal;
+		if (worstRatio >= mSettings.criticalThreshold) {
+			pressure = MemoryPressure::Critical;
+		} else if (worstRatio >= mSettings.elevatedThreshold) {
+			pressure = MemoryPressure::Elevated;
+		}
+
+		if (pressure != mPressure) {
+			const char* names[] = { "normal", "elevated", "critical" };
+			RWD_LOG_WARN("Memory pressure is {0}, heap {1} at {2:.1f}% of its budget", names[(u32)pressure], worstHeap, worstRatio * 100.0f);
+			mPressure = pressure;
+		}
+
+		// Step the bias by one at a time and wait between steps, dropping detail takes a few frames to show in the budget
+		i32 lodBias = mLodBias;
+		if (mFrame - mLastBiasFrame >= mSettings.biasStepFrames) {
+			if (pressure != MemoryPressure::Normal && lodBias < mSettings.maxLodBias) {
+				lodBias++;
+			} else if (worstRatio < mSettings.relaxedThreshold && lodBias > 0) {
+				lodBias--;
+			}
+		}
+
+		if (lodBias != mLodBias) {
+			RWD_LOG_INFO("Memory governor LOD bias {0} -> {1}", mLodBias, lodBias);
+			mLodBias = lodBias;
+			mLastBiasFrame = mFrame;
+
+			for (const LodBiasCallback& callback : mLodBiasCallbacks) {
+				callback(mLodBias);
+			}
+		}
+
+		if (pressure == MemoryPressure::Critical) {
+			const HeapBudget& heap = mHeaps[worstHeap];
+			u64 target = (u64)(heap.budget * (f64)mSettings.elevatedThreshold);
+			u64 bytesToFree = heap.usage > target ? heap.usage - target : 0;
+
+			for (const EvictCallback& callback : mEvictCallbacks) {
+				callback(bytesToFree);
+			}
+		}
+	}
+
+	void VulkanMemoryGovernor::AddLodBiasCallback(LodBiasCallback callback) {
+		mLodBiasCallbacks.push_back(std::move(callback));
+	}
+
+	void VulkanMemoryGovernor::AddEvictCallback(EvictCallback callback) {
+		mEvictCallbacks.push_back(std::move(callback));
+	}
+
+	u32 VulkanMemoryGovernor::HeapCount() const {
+		return (u32)mHeaps.size();
+	}
+
+	const HeapBudget& VulkanMemoryGovernor::Heap(u32 heapIndex) const {
+		return mHeaps[heapIndex];
+	}
+
+	u64 VulkanMemoryGovernor::TagUsage(MemoryTag tag) const {
+		return sTagBytes[(u32)tag].load();
+	}
+
+	u32 VulkanMemoryGovernor::TagAllocationCount(MemoryTag tag) const {
+		return sTagCounts[(u32)tag].load();
+	}
+
+	MemoryPressure VulkanMemoryGovernor::Pressure() const {
+		return mPressure;
+	}
+
+	i32 VulkanMemoryGovernor::LodBias() const {
+		return mLodBias;
+	}
+
+	std::string VulkanMemoryGovernor::BuildStatsJson(bool detailedMap) const {
+		char* stats = nullptr;
+		vmaBuildStatsString(mAllocator, &stats, detailedMap ? VK_TRUE : VK_FALSE);
+
+		std::string json = stats ? stats : "";
+		vmaFreeStatsString(mAllocator, stats);
+		return json;
+	}
+
+	bool VulkanMemoryGovernor::WriteStatsJson(const std::string& filepath, bool detailedMap) const {
+		std::ofstream file(filepath, std::ios::trunc);
+		if (!file.is_open()) {
+			RWD_LOG_ERROR("Failed to open {0} for writing", filepath);
+			return false;
+		}
+
+		file << BuildStatsJson(detailedMap);
+		RWD_LOG_INFO("Wrote GPU memory stats to {0}", filepath);
+		return file.good();
+	}
+
+	void VulkanMemoryGovernor::ReportAllocationFailure(const char* description) {
+		RWD_LOG_ERROR("GPU allocation failed: {0}", description);
+		LogBudgets();
+
+		// Only the first failure is interesting, the rest are usually fallout from it
+		if (!mDumpedFailure) {
+			mDumpedFailure = true;
+			WriteStatsJson("GpuMemoryFailure.json");
+		}
+	}
+
+	void VulkanMemoryGovernor::LogBudgets() const {
+		for (u32 i = 0; i < mHeaps.size(); i++) {
+			const HeapBudget& heap = mHeaps[i];
+			RWD_LOG_INFO("Heap {0}{1}: {2} / {3} MiB used, {4} MiB in VMA blocks", i, heap.deviceLocal ? " (device local)" : "",
+				heap.usage >> 20, heap.budget >> 20, heap.blockBytes >> 20);
+		}
+
+		for (u32 tag = 0; tag < (u32)MemoryTag::Count; tag++) {
+			RWD_LOG_INFO("  {0}: {1} MiB in {2} allocations", MemoryTagName((MemoryTag)tag), sTagBytes[tag].load() >> 20, sTagCounts[tag].load());
+		}
+	}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "pch.h"
+#include "vulkan/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "core/Core.h"
+
+namespace rwd {
+
+	// What an allocation is used for, so memory can be broken down further than VMA's per heap numbers
+	enum class MemoryTag : u32 {
+		Geometry,
+		Textures,
+		Staging,
+		RenderTargets,
+		Other,
+		Count,
+	};
+
+	const char* MemoryTagName(MemoryTag tag);
+
+	// Names the allocation after its tag so it can be identified in the stats dump, and counts it against the tag
+	void TrackAllocation(VmaAllocator allocator, VmaAllocation allocation, MemoryTag tag);
+
+	// Has to be called before the allocation is freed
+	void UntrackAllocation(VmaAllocator allocator, VmaAllocation allocation);
+
+	enum class MemoryPressure : u32 {
+		Normal,
+		Elevated, // Quality is being traded for memory through the LOD bias
+		Critical, // Evicting, the next step is VK_ERROR_OUT_OF_DEVICE_MEMORY
+	};
+
+	struct HeapBudget {
+		// Bytes the process uses from the heap, including allocations made outside of VMA
+		u64 usage = 0;
+
+		// Bytes the OS is willing to give us. Going over it risks paging or out of memory errors.
+		// Without VK_EXT_memory_budget this is only an estimate (80% of the heap size).
+		u64 budget = 0;
+
+		u64 blockBytes = 0;      // Held by VMA in VkDeviceMemory blocks
+		u64 allocationBytes = 0; // Occupied by allocations inside those blocks
+		bool deviceLocal = false;
+
+		f32 UsageRatio() const { return budget ? (f32)usage / (f32)budget : 0.0f; }
+	};
+
+	struct MemoryGovernorSettings {
+		f32 elevatedThreshold = 0.85f; // Fraction of the budget where the LOD bias starts going up
+		f32 criticalThreshold = 0.95f; // Fraction of the budget where eviction starts
+		f32 relaxedThreshold = 0.70f;  // Fraction of the budget the LOD bias starts coming back down under
+
+		// Frames between LOD bias steps, giving each step time to show up in the budget
+		u32 biasStepFrames = 30;
+		i32 maxLodBias = 4;
+	};
+
+	// Watches the VMA heap budgets and steps in before the device runs out of memory.
+	//
+	// Pressure is judged on the device local heap closest to its budget. Elevated pressure raises a
+	// LOD bias one step at a time so systems can drop detail (texture mips, mesh LODs), critical pressure
+	// asks the eviction callbacks to free enough to get back under the elevated threshold.
+	class VulkanMemoryGovernor {
+	public:
+		using LodBiasCallback = std::function<void(i32 lodBias)>;
+		using EvictCallback = std::function<void(u64 bytesToFree)>;
+
+		void Init(VmaAllocator allocator, const MemoryGovernorSettings& settings = { });
+
+		// Polls the budgets and runs the callbacks, call once per frame
+		void Update();
+
+		void AddLodBiasCallback(LodBiasCallback callback);
+		void AddEvictCallback(EvictCallback callback);
+
+		u32 HeapCount() const;
+		const HeapBudget& Heap(u32 heapIndex) const;
+
+		u64 TagUsage(MemoryTag tag) const;
+		u32 TagAllocationCount(MemoryTag tag) const;
+
+		MemoryPressure Pressure() const;
+		i32 LodBias() const;
+
+		// VMA's JSON statistics, the detailed map lists every allocation along with its tag name
+		std::string BuildStatsJson(bool detailedMap = true) const;
+		bool WriteStatsJson(const std::string& filepath, bool detailedMap = true) const;
+
+		// Logs the budgets and dumps the stats once, call when an allocation fails
+		void ReportAllocationFailure(const char* description);
+
+		void LogBudgets() const;
+	private:
+		VmaAllocator mAllocator = VK_NULL_HANDLE;
+		MemoryGovernorSettings mSettings;
+
+		std::vector<HeapBudget> mHeaps;
+		MemoryPressure mPressure = MemoryPressure::Normal;
+		i32 mLodBias = 0;
+
+		u32 mFrame = 0;
+		u32 mLastBiasFrame = 0;
+		bool mDumpedFailure = false;
+
+		std::vector<LodBiasCallback> mLodBiasCallbacks;
+		std::vector<EvictCallback> mEvictCallbacks;
+	};
+
+}
@@ -0,0 +1,242 @@
+#include "pch.h"
+#include "core/Log.h"
+#include "VulkanMemoryGovernor.h"
+#include "VulkanMemoryPools.h"
+
+namespace rwd {
+
+	const char* MemoryPoolName(MemoryPool pool) {
+		switch (pool) {
+			case(MemoryPool::Transient): return "Transient";
+			case(MemoryPool::Streaming): return "Streaming";
+			case(MemoryPool::Geometry):  return "Geometry";
+			case(MemoryPool::Textures):  return "Textures";
+			default:                     return "Unknown";
+		}
+	}
+
+	void VulkanMemoryPools::Init(VmaAllocator allocator, const MemoryPoolSettings& settings) {
+		mAllocator = allocator;
+		mSettings = settings;
+
+		// A pool is tied to a single memory type, found here from a representative resource.
+		// Resources that turn out to need a different type fall back to the default allocation.
+		VmaAllocationCreateInfo hostVisible { };
+		hostVisible.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+
+		VmaAllocationCreateInfo deviceLocal { };
+		deviceLocal.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		u32 memoryType;
+
+		VkBufferCreateInfo transientInfo {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = 65536,
+			.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+				| VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		};
+
+		if (vmaFindMemoryTypeIndexForBufferInfo(mAllocator, &transientInfo, &hostVisible, &memoryType) == VK_SUCCESS) {
+			CreatePool(MemoryPool::Transient, memoryType, mSettings.transientSize, true);
+		}
+
+		VkBufferCreateInfo streamingInfo {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = 65536,
+			.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		};
+
+		if (vmaFindMemoryTypeIndexForBufferInfo(mAllocator, &streamingInfo, &hostVisible, &memoryType) == VK_SUCCESS) {
+			CreatePool(MemoryPool::Streaming, memoryType, mSettings.streamingSize, true);
+		}
+
+		VkBufferCreateInfo geometryInfo {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = 65536,
+			.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		};
+
+		if (vmaFindMemoryTypeIndexForBufferInfo(mAllocator, &geometryInfo, &deviceLocal, &memoryType) == VK_SUCCESS) {
+			CreatePool(MemoryPool::Geometry, memoryType, mSettings.geometryBlockSize, false);
+		}
+
+		VkImageCreateInfo textureInfo {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = VK_FORMAT_R8G8B8A8_UNORM,
+			.extent = { 1024, 1024, 1 },
+			.mipLevels = 11,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		};
+
+		if (vmaFindMemoryTypeIndexForImageInfo(mAllocator, &textureInfo, &deviceLocal, &memoryType) == VK_SUCCESS) {
+			CreatePool(MemoryPool::Textures, memoryType, mSettings.textureBlockSize, false);
+		}
+	}
+
+	VkResult VulkanMemoryPools::CreatePool(MemoryPool pool, u32 memoryTypeIndex, VkDeviceSize blockSize, bool linear) {
+		VmaPoolCreateInfo poolInfo { };
+		poolInfo.memoryTypeIndex = memoryTypeIndex;
+		poolInfo.blockSize = blockSize;
+
+		if (linear) {
+			// The linear algorithm only wraps around like a ring buffer when the pool is a single block
+			poolInfo.flags = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT;
+			poolInfo.minBlockCount = 1;
+			poolInfo.maxBlockCount = 1;
+		}
+
+		VkResult result = vmaCreatePool(mAllocator, &poolInfo, &mPools[(u32)pool]);
+		if (result != VK_SUCCESS) {
+			RWD_LOG_WARN("Failed to create the {0} memory pool, its resources will use the default allocation", MemoryPoolName(pool));
+			mPools[(u32)pool] = VK_NULL_HANDLE;
+			return result;
+		}
+
+		vmaSetPoolName(mAllocator, mPools[(u32)pool], MemoryPoolName(pool));
+		return result;
+	}
+
+	void VulkanMemoryPools::Deinit() {
+		for (u32 frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++) {
+			BeginFrame(frame);
+		}
+
+		// Every allocation made from a pool has to be freed before it's destroyed
+		for (VmaPool& pool : mPools) {
+			if (pool != VK_NULL_HANDLE) {
+				vmaDestroyPool(mAllocator, pool);
+				pool = VK_NULL_HANDLE;
+			}
+		}
+	}
+
+	VkResult VulkanMemoryPools::CreateBuffer(MemoryPool pool, const VkBufferCreateInfo& bufferInfo, VmaMemoryUsage usage,
+		VkBuffer& buffer, VmaAllocation& allocation, VmaAllocationCreateFlags flags, VmaAllocationInfo* allocationInfo)
+	{
+		VmaAllocationCreateInfo allocInfo { };
+		allocInfo.usage = usage;
+		allocInfo.flags = flags;
+
+		if (mPools[(u32)pool] != VK_NULL_HANDLE) {
+			allocInfo.pool = mPools[(u32)pool];
+			if (vmaCreateBuffer(mAllocator, &bufferInfo, &allocInfo, &buffer, &allocation, allocationInfo) == VK_SUCCESS) {
+				return VK_SUCCESS;
+			}
+
+			allocInfo.pool = VK_NULL_HANDLE;
+		}
+
+		return vmaCreateBuffer(mAllocator, &bufferInfo, &allocInfo, &buffer, &allocation, allocationInfo);
+	}
+
+	VkResult VulkanMemoryPools::CreateImage(MemoryPool pool, const VkImageCreateInfo& imageInfo, VkImage& image, VmaAllocation& allocation) {
+		VmaAllocationCreateInfo allocInfo { };
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		if (mPools[(u32)pool] != VK_NULL_HANDLE) {
+			allocInfo.pool = mPools[(u32)pool];
+			if (vmaCreateImage(mAllocator, &imageInfo, &allocInfo, &image, &allocation, nullptr) == VK_SUCCESS) {
+				return VK_SUCCESS;
+			}
+
+			allocInfo.pool = VK_NULL_HANDLE;
+		}
+
+		return vmaCreateImage(mAllocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
+	}
+
+	VkResult VulkanMemoryPools::CreateRenderTarget(const VkImageCreateInfo& imageInfo, VkImage& image, VmaAllocation& allocation) {
+		VmaAllocatorInfo allocatorInfo;
+		vmaGetAllocatorInfo(mAllocator, &allocatorInfo);
+
+		// The size is only known once the image exists, so it's created first and its memory bound after
+		VkResult result = vkCreateImage(allocatorInfo.device, &imageInfo, nullptr, &image);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(allocatorInfo.device, image, &requirements);
+
+		VmaAllocationCreateInfo allocInfo { };
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		if (requirements.size >= mSettings.dedicatedThreshold) {
+			allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+		}
+
+		result = vmaAllocateMemoryForImage(mAllocator, image, &allocInfo, &allocation, nullptr);
+		if (result == VK_SUCCESS) {
+			result = vmaBindImageMemory(mAllocator, allocation, image);
+		}
+
+		if (result != VK_SUCCESS) {
+			vmaDestroyImage(mAllocator, image, allocation);
+			image = VK_NULL_HANDLE;
+			allocation = VK_NULL_HANDLE;
+		}
+
+		return result;
+	}
+
+	void VulkanMemoryPools::BeginFrame(u32 frameIndex) {
+		mFrame = frameIndex;
+
+		// Freed in the order they were made, so the linear pool reclaims the space like a ring buffer
+		for (const TransientBuffer& transient : mTransientBuffers[frameIndex]) {
+			UntrackAllocation(mAllocator, transient.allocation);
+			vmaDestroyBuffer(mAllocator, transient.buffer, transient.allocation);
+		}
+
+		mTransientBuffers[frameIndex].clear();
+	}
+
+	TransientBuffer VulkanMemoryPools::CreateTransientBuffer(VkDeviceSize size, VkBufferUsageFlags usage) {
+		VkBufferCreateInfo bufferInfo {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = size,
+			.usage = usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		};
+
+		TransientBuffer transient;
+		VmaAllocationInfo allocationInfo;
+
+		VkResult result = CreateBuffer(MemoryPool::Transient, bufferInfo, VMA_MEMORY_USAGE_CPU_TO_GPU,
+			transient.buffer, transient.allocation, VMA_ALLOCATION_CREATE_MAPPED_BIT, &allocationInfo);
+
+		if (result != VK_SUCCESS) {
+			RWD_LOG_ERROR("Failed to create a {0} byte transient buffer", size);
+			return TransientBuffer { };
+		}
+
+		TrackAllocation(mAllocator, transient.allocation, MemoryTag::Other);
+		transient.mapped = allocationInfo.pMappedData;
+		transient.size = size;
+
+		mTransientBuffers[mFrame].push_back(transient);
+		return transient;
+	}
+
+	VmaPool VulkanMemoryPools::Pool(MemoryPool pool) const {
+		return mPools[(u32)pool];
+	}
+
+	VmaStatistics VulkanMemoryPools::PoolStatistics(MemoryPool pool) const {
+		VmaStatistics statistics { };
+		if (mPools[(u32)pool] != VK_NULL_HANDLE) {
+			vmaGetPoolStatistics(mAllocator, mPools[(u32)pool], &statistics);
+		}
+
+		return statistics;
+	}
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "pch.h"
+#include "vulkan/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "core/Core.h"
+#include "VulkanContext.h"
+
+namespace rwd {
+
+	enum class MemoryPool : u32 {
+		Transient, // Linear, per frame buffers released once the frame is done on the GPU
+		Streaming, // Linear ring buffer for staging uploads, freed in the order they were made
+		Geometry,  // Blocks of device local vertex and index buffers
+		Textures,  // Blocks of device local sampled images
+		Count,
+	};
+
+	const char* MemoryPoolName(MemoryPool pool);
+
+	struct MemoryPoolSettings {
+		VkDeviceSize transientSize = 16ull * 1024 * 1024;
+		VkDeviceSize streamingSize = 64ull * 1024 * 1024;
+		VkDeviceSize geometryBlockSize = 64ull * 1024 * 1024;
+		VkDeviceSize textureBlockSize = 128ull * 1024 * 1024;
+
+		// Render targets at least this big get their own VkDeviceMemory, anything smaller is suballocated
+		VkDeviceSize dedicatedThreshold = 8ull * 1024 * 1024;
+	};
+
+	struct TransientBuffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VmaAllocation allocation = VK_NULL_HANDLE;
+		void* mapped = nullptr; // Persistently mapped, write to it directly
+		VkDeviceSize size = 0;
+	};
+
+	// The renderer's VmaPools.
+	//
+	// VMA's default allocation puts everything in the same blocks, so short lived staging buffers end up
+	// scattered between long lived meshes and textures and the blocks never empty out. Splitting resources
+	// by lifetime keeps the long lived pools dense, and the short lived ones use the linear algorithm which
+	// makes allocation a pointer bump.
+	//
+	// A pool can be full, or not fit a resource's memory requirements, so Create* fall back to VMA's
+	// default allocation rather than fail.
+	class VulkanMemoryPools {
+	public:
+		void Init(VmaAllocator allocator, const MemoryPoolSettings& settings = { });
+		void Deinit();
+
+		VkResult CreateBuffer(MemoryPool pool, const VkBufferCreateInfo& bufferInfo, VmaMemoryUsage usage,
+			VkBuffer& buffer, VmaAllocation& allocation, VmaAllocationCreateFlags flags = 0, VmaAllocationInfo* allocationInfo = nullptr);
+		VkResult CreateImage(MemoryPool pool, const VkImageCreateInfo& imageInfo, VkImage& image, VmaAllocation& allocation);
+
+		// Large render targets get a dedicated allocation, which drivers can place and compress better
+		VkResult CreateRenderTarget(const VkImageCreateInfo& imageInfo, VkImage& image, VmaAllocation& allocation);
+
+		// Frees the transient buffers of the frame slot about to be reused, call once its fence has signalled
+		void BeginFrame(u32 frameIndex);
+
+		// Host visible buffer that is freed automatically once the current frame has finished on the GPU
+		TransientBuffer CreateTransientBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+
+		VmaPool Pool(MemoryPool pool) const;
+		VmaStatistics PoolStatistics(MemoryPool pool) const;
+	private:
+		VkResult CreatePool(MemoryPool pool, u32 memoryTypeIndex, VkDeviceSize blockSize, bool linear);
+	private:
+		VmaAllocator mAllocator = VK_NULL_HANDLE;
+		MemoryPoolSettings mSettings;
+		VmaPool mPools[(u32)MemoryPool::Count] = { };
+
+		u32 mFrame = 0;
+		std::vector<TransientBuffer> mTransientBuffers[MAX_FRAMES_IN_FLIGHT];
+	};
+
+}
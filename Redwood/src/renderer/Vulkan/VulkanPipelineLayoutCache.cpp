@@ -0,0 +1,176 @@
+#include "pch.h"
+#include <algorithm>
+#include "core/Log.h"
+#include "core/Hash.h"
+#include "VulkanPipelineLayoutCache.h"
+
+namespace rwd {
+
+	void VulkanPipelineLayoutCache::Init(VkDevice device) {
+		mDevice = device;
+	}
+
+	void VulkanPipelineLayoutCache::Deinit() {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		for (const auto& [key, layout] : mLayouts) {
+			vkDestroyPipelineLayout(mDevice, layout, nullptr);
+		}
+
+		for (const auto& [key, setLayout] : mSetLayouts) {
+			vkDestroyDescriptorSetLayout(mDevice, setLayout, nullptr);
+		}
+
+		mReflections.clear();
+		mSetLayouts.clear();
+		mLayouts.clear();
+		mLayoutSets.clear();
+	}
+
+	const ShaderReflection* VulkanPipelineLayoutCache::Reflect(u64 hash, std::span<const u32> code) {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			auto existing = mReflections.find(hash);
+			if (existing != mReflections.end()) {
+				return &existing->second;
+			}
+		}
+
+		// Reflected outside the lock, racing only means the same shader is reflected twice
+		ShaderReflection reflection;
+		if (!ReflectSpirv(code, reflection)) {
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		return &mReflections.try_emplace(hash, std::move(reflection)).first->second;
+	}
+
+	VkPipelineLayout VulkanPipelineLayoutCache::Layout(std::span<const ShaderReflection* const> stages) {
+		// Bindings declared by several stages are visible to all of them, and the push constants
+		// are a single range covering every stage's block
+		std::vector<ShaderDescriptorBinding> bindings;
+		VkPushConstantRange pushConstants { .stageFlags = 0, .offset = ~0u, .size = 0 };
+		u32 pushConstantEnd = 0;
+
+		for (const ShaderReflection* stage : stages) {
+			for (const ShaderDescriptorBinding& binding : stage->bindings) {
+				auto existing = std::find_if(bindings.begin(), bindings.end(), [&] (const ShaderDescriptorBinding& other) {
+					return other.set == binding.set && other.binding == binding.binding;
+				});
+
+				if (existing == bindings.end()) {
+					bindings.push_back(binding);
+				} else if (existing->type != binding.type || existing->count != binding.count) {
+					RWD_LOG_ERROR("Shader stages disagree on the descriptor at set {0} binding {1}", binding.set, binding.binding);
+					return VK_NULL_HANDLE;
+				} else {
+					existing->stages |= binding.stages;
+				}
+			}
+
+			if (stage->pushConstantSize > 0) {
+				pushConstants.stageFlags |= stage->stage;
+				pushConstants.offset = std::min(pushConstants.offset, stage->pushConstantOffset);
+				pushConstantEnd = std::max(pushConstantEnd, stage->pushConstantOffset + stage->pushConstantSize);
+			}
+		}
+
+		if (pushConstants.stageFlags != 0) {
+			pushConstants.size = pushConstantEnd - pushConstants.offset;
+		} else {
+			pushConstants.offset = 0;
+		}
+
+		std::sort(bindings.begin(), bindings.end(), [] (const ShaderDescriptorBinding& a, const ShaderDescriptorBinding& b) {
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		});
+
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		// Sets between the ones the shaders use still need a layout, they get an empty one
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		u32 setCount = bindings.empty() ? 0 : bindings.back().set + 1;
+		auto first = bindings.begin();
+		for (u32 set = 0; set < setCount; set++) {
+			auto last = std::find_if(first, bindings.end(), [set] (const ShaderDescriptorBinding& binding) { return binding.set != set; });
+			setLayouts.push_back(CreateSetLayout(std::span<const ShaderDescriptorBinding>(first, last)));
+			first = last;
+		}
+
+		u64 key = HashBytes(setLayouts.data(), setLayouts.size() * sizeof(VkDescriptorSetLayout));
+		key = HashBytes(&pushConstants, sizeof(pushConstants), key);
+
+		auto existing = mLayouts.find(key);
+		if (existing != mLayouts.end()) {
+			return existing->second;
+		}
+
+		VkPipelineLayoutCreateInfo layoutInfo {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = (u32)setLayouts.size(),
+			.pSetLayouts = setLayouts.data(),
+			.pushConstantRangeCount = pushConstants.size > 0 ? 1u : 0u,
+			.pPushConstantRanges = &pushConstants,
+		};
+
+		VkPipelineLayout layout;
+		VkResult result = vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &layout);
+
+		RWD_ASSERT(result == VK_SUCCESS, "Failed to create Vulkan pipeline layout");
+
+		mLayouts[key] = layout;
+		mLayoutSets[layout] = std::move(setLayouts);
+		return layout;
+	}
+
+	VkDescriptorSetLayout VulkanPipelineLayoutCache::SetLayout(VkPipelineLayout layout, u32 set) const {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto sets = mLayoutSets.find(layout);
+		if (sets == mLayoutSets.end() || set >= sets->second.size()) {
+			return VK_NULL_HANDLE;
+		}
+
+		return sets->second[set];
+	}
+
+	// Called with the lock held
+	VkDescriptorSetLayout VulkanPipelineLayoutCache::CreateSetLayout(std::span<const ShaderDescriptorBinding> bindings) {
+		std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+		layoutBindings.reserve(bindings.size());
+
+		for (const ShaderDescriptorBinding& binding : bindings) {
+			layoutBindings.push_back(VkDescriptorSetLayoutBinding {
+				.binding = binding.binding,
+				.descriptorType = binding.type,
+				.descriptorCount = binding.count,
+				.stageFlags = binding.stages,
+				.pImmutableSamplers = nullptr,
+			});
+		}
+
+		// Keyed without the set number, the same bindings at another set share the layout
+		u64 key = HashBytes(layoutBindings.data(), layoutBindings.size() * sizeof(VkDescriptorSetLayoutBinding));
+
+		auto existing = mSetLayouts.find(key);
+		if (existing != mSetLayouts.end()) {
+			return existing->second;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = (u32)layoutBindings.size(),
+			.pBindings = layoutBindings.data(),
+		};
+
+		VkDescriptorSetLayout setLayout;
+		VkResult result = vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &setLayout);
+
+		RWD_ASSERT(result == VK_SUCCESS, "Failed to create Vulkan descriptor set layout");
+
+		mSetLayouts[key] = setLayout;
+		return setLayout;
+	}
+
+}
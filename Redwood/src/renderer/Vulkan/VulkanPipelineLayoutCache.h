@@ -0,0 +1,47 @@
+#pragma once
+#include "pch.h"
+#include <mutex>
+#include <span>
+#include "vulkan/vulkan.h"
+#include "core/Core.h"
+#include "VulkanShaderReflection.h"
+
+namespace rwd {
+
+	// Reflections of the shaders pipelines are built from, and the layouts made from them.
+	//
+	// Shaders are reflected the first time their code is seen and kept by the hash of the code,
+	// so rebuilding a pipeline doesn't reflect again unless a shader actually changed. Descriptor set
+	// layouts and pipeline layouts are kept by the hash of what they describe, so pipelines whose
+	// shaders declare the same bindings and push constants share one layout. Descriptor sets bound
+	// for one of them stay valid for the rest.
+	//
+	// Everything is safe from any thread, pipelines are built on workers during hot reload.
+	// Layouts live until Deinit, pipelines and draws can hold on to them freely.
+	class VulkanPipelineLayoutCache {
+	public:
+		void Init(VkDevice device);
+		void Deinit();
+
+		// Null if the code isn't valid SPIR-V. The hash is of the code, the code is only read the first time.
+		const ShaderReflection* Reflect(u64 hash, std::span<const u32> code);
+
+		// The layout for the bindings and push constants of all the stages together. Null if two
+		// stages declare the same binding with different types.
+		VkPipelineLayout Layout(std::span<const ShaderReflection* const> stages);
+
+		// Null past the layout's last set
+		VkDescriptorSetLayout SetLayout(VkPipelineLayout layout, u32 set) const;
+	private:
+		VkDescriptorSetLayout CreateSetLayout(std::span<const ShaderDescriptorBinding> bindings);
+	private:
+		VkDevice mDevice = VK_NULL_HANDLE;
+		mutable std::mutex mMutex;
+
+		std::unordered_map<u64, ShaderReflection> mReflections;
+		std::unordered_map<u64, VkDescriptorSetLayout> mSetLayouts;
+		std::unordered_map<u64, VkPipelineLayout> mLayouts;
+		std::unordered_map<VkPipelineLayout, std::vector<VkDescriptorSetLayout>> mLayoutSets;
+	};
+
+}
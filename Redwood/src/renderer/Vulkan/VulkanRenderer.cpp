@@ -1,40 +1,22 @@
 #include "pch.h"
+#include <filesystem>
 #include "core/Log.h"
 #include "core/Math.h"
 #include "core/System.h"
+#include "core/Hash.h"
+#include "core/Vfs.h"
+#include "renderer/MeshFile.h"
+#include "renderer/ShaderCompiler.h"
 #include "VulkanShader.h"
 #include "VulkanBuffer.h"
 #include "VulkanRenderer.h"
 
 namespace rwd {
 
+	// Packed in the order of the test shader's input locations, which is how its vertex input is laid out
 	struct Vertex {
 		Vec2 pos;
 		Vec3 color;
-
-		static VkVertexInputBindingDescription getBindingDescription() {
-			VkVertexInputBindingDescription bindingDescription{};
-			bindingDescription.binding = 0;
-			bindingDescription.stride = sizeof(Vertex);
-			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-			return bindingDescription;
-		}
-
-		static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
-			std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-
-			attributeDescriptions[0].binding = 0;
-			attributeDescriptions[0].location = 0;
-			attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-			attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-			attributeDescriptions[1].binding = 0;
-			attributeDescriptions[1].location = 1;
-			attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-			return attributeDescriptions;
-		}
 	};
 
 	const std::vector<Vertex> vertices = {
@@ -48,8 +30,9 @@ namespace rwd {
 		0, 1, 2, 2, 3, 0
 	};
 
-	static VulkanVertexBuffer vertexBuffer;
-	static VulkanIndexBuffer indexBuffer;
+	// Frame packets are built up to two frames ahead of the one drawing, so draws can hold a destroyed
+	// resource for the frame drawing when it's destroyed and the two after
+	const u32 QUEUED_FRAMES_RETIRE_DELAY = 3;
 
 	void VulkanRenderer::Init(Ref<VulkanContext> context) {
 		mSwapChainExtent = VkExtent2D(context->mWindowWidth, context->mWindowHeight);
@@ -57,38 +40,75 @@ namespace rwd {
 		mCurFrame = 0;
 
 		VmaAllocatorCreateInfo allocatorCreateInfo { };
-		allocatorCreateInfo.flags = VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
-		allocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_1;
+		// Without the extension VMA estimates the budget from the heap sizes and its own allocations
+		allocatorCreateInfo.flags = mContext->mCapabilities.memoryBudget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0;
+		allocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_2;
 		allocatorCreateInfo.physicalDevice = mContext->mPhysicalDevice;
 		allocatorCreateInfo.device = mContext->mDevice;
 		allocatorCreateInfo.instance = mContext->mInstance;
 
 		vmaCreateAllocator(&allocatorCreateInfo, &mAllocator);
+		mMemoryGovernor.Init(mAllocator);
+		mMemoryPools.Init(mAllocator);
+		mDeletionQueue.Init(mContext->mDevice, mAllocator);
+
+		const VulkanCapabilities& capabilities = mContext->mCapabilities;
+		mDynamicRendering = capabilities.dynamicRendering && capabilities.synchronization2;
+		RWD_LOG("Vulkan renderer using {0}", mDynamicRendering ? "dynamic rendering" : "render passes");
+
+		if (mDynamicRendering) {
+			LoadDynamicRenderingFunctions();
+		}
 
 		CreateSwapChain();
 		CreateSwapChainImageViews();
-		CreateRenderPass();
 
-		VulkanShader temp("../Redwood/src/vert.spv", "../Redwood/src/frag.spv");
-		mPipelines.push_back(CreatePipelineForShader(temp));
-		CreateFrameBuffers();
+		mRenderPass = VK_NULL_HANDLE;
+		if (!mDynamicRendering) {
+			CreateRenderPass();
+		}
+
+		mLayoutCache.Init(mContext->mDevice);
+		mModuleCache.Init(mContext->mDevice);
+		OpenShaderCaches();
+		CreatePipeline(VulkanPipelineDesc { .vertexShader = "shaders/vert.spv", .fragmentShader = "shaders/frag.spv" });
+
+		if (!mDynamicRendering) {
+			CreateFrameBuffers();
+		}
 		CreateCommandPool();
 		CreateCommandBuffers();
 		CreateSyncObjects();
 
-		vertexBuffer = VulkanVertexBuffer((void*)vertices.data(), sizeof(Vertex) * vertices.size(), mContext->mDevice, mAllocator);
-		indexBuffer = VulkanIndexBuffer((void*)indices.data(), sizeof(uint16_t) * indices.size(), mContext->mDevice, mAllocator);
-		VulkanMesh mesh;
-		mesh.SetVertexBuffer(vertexBuffer);
-		mesh.SetIndexBuffer(indexBuffer);
-		CopyMeshToGpu(mesh);
+		MeshLod quadLod { .indexOffset = 0, .indexCount = (u32)indices.size(), .error = 0.0f };
+		mQuadMesh = CreateVulkanMesh(vertices.data(), sizeof(Vertex) * vertices.size(), 
+			indices.data(), sizeof(uint16_t) * indices.size(), { quadLod });
 	}
 
 	void VulkanRenderer::Deinit() {
 		// Wait for operations on the GPU to finish
 		vkDeviceWaitIdle(mContext->mDevice);
 
+		// Rebuilt pipelines not swapped in yet were never used. Their shader modules go with the module cache.
+		JobSystem::Wait(mShaderReloadCounter);
+		for (const ReloadedPipeline& reloaded : mReloadedPipelines) {
+			vkDestroyPipeline(mContext->mDevice, reloaded.pipeline, nullptr);
+		}
+
+		// No more frames are coming, everything waiting on them can go
+		DestroyVulkanMesh(mQuadMesh);
+		for (const DeferredRetire& deferred : mDeferredRetires) {
+			deferred.retire(InFlight());
+		}
+		mDeferredRetires.clear();
+		mDeletionQueue.Flush();
+		mMemoryPools.Deinit();
 		vmaDestroyAllocator(mAllocator);
+
+		for (const auto& [key, sampler] : mSamplers) {
+			vkDestroySampler(mContext->mDevice, sampler, nullptr);
+		}
+
 		DestroySwapChain();
 
 		for (const VkPipeline pipeline : mPipelines) {
@@ -98,24 +118,50 @@ namespace rwd {
 		for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			vkDestroySemaphore(mContext->mDevice, mImageAvailableSemaphores[i], nullptr);
 			vkDestroySemaphore(mContext->mDevice, mRenderFinishedSemaphores[i], nullptr);
-			vkDestroyFence(mContext->mDevice, mInFlightFences[i], nullptr);
+		}
+
+		for (VulkanTimeline& timeline : mTimelines) {
+			timeline.Free(mContext->mDevice);
 		}
 
 		vkDestroyCommandPool(mContext->mDevice, mCommandPool, nullptr);
-		vkDestroyPipelineLayout(mContext->mDevice, mPipelineLayout, nullptr);
+		vkDestroyCommandPool(mContext->mDevice, mComputeCommandPool, nullptr);
+		mModuleCache.Deinit();
+		SaveShaderCaches();
+		mLayoutCache.Deinit();
 		vkDestroyRenderPass(mContext->mDevice, mRenderPass, nullptr);
 	}
 
 	void VulkanRenderer::DrawMesh(Mesh& mesh, Shader& shader) {
 		u32 shaderId = shader.Id();
 
+		{
+			std::shared_lock lock(mPipelinesMutex);
+			if (shaderId < mPipelines.size() && mPipelines[shaderId] != VK_NULL_HANDLE) {
+				return;
+			}
+		}
+
+		// Built without the lock, CreatePipeline can append from another thread meanwhile
+		BuiltPipeline built = CreatePipelineForShader(shader);
+
+		std::unique_lock lock(mPipelinesMutex);
 		if (mPipelines.size() <= shaderId) {
 			mPipelines.resize(shaderId * 2, VK_NULL_HANDLE);
+			mPipelineLayouts.resize(shaderId * 2, VK_NULL_HANDLE);
+			mPipelineModules.resize(shaderId * 2);
 		}
 
-		if (mPipelines[shaderId] == VK_NULL_HANDLE) {
-			mPipelines[shaderId] = CreatePipelineForShader(shader);
+		// Another thread drawing the same shader got there first
+		if (mPipelines[shaderId] != VK_NULL_HANDLE) {
+			vkDestroyPipeline(mContext->mDevice, built.pipeline, nullptr);
+			ReleaseShaderModules(built.modules);
+			return;
 		}
+
+		mPipelines[shaderId] = built.pipeline;
+		mPipelineLayouts[shaderId] = built.layout;
+		mPipelineModules[shaderId] = std::move(built.modules);
 	}
 
 	void VulkanRenderer::SetClearColor() {
@@ -127,16 +173,39 @@ namespace rwd {
 	}
 
 	void VulkanRenderer::DrawFrame() {
-		// Wait for previous frame to finish rendering
-		vkWaitForFences(mContext->mDevice, 1, &mInFlightFences[mCurFrame], VK_TRUE, UINT64_MAX);
+		VulkanTimeline& graphics = mTimelines[(u32)QueueType::Graphics];
+		VulkanTimeline& transfer = mTimelines[(u32)QueueType::Transfer];
+
+		// Wait for the frame that last used this slot to finish rendering
+		graphics.Wait(mFrameValues[mCurFrame]);
+
+		// The GPU is done with this frame slot, so its transient buffers can go,
+		// along with anything retired that every queue has since moved past
+		mMemoryPools.BeginFrame(mCurFrame);
+		mDeletionQueue.Collect(mTimelines);
+		mMemoryGovernor.Update();
+		UpdateShaderHotReload();
 
-		if (mContext->mRecreateSwapChain) {
+		// Cleared before recreating, a resize arriving meanwhile recreates it again next frame
+		if (mContext->mRecreateSwapChain.exchange(false, std::memory_order_acquire)) {
 			RecreateSwapChain();
-			mContext->mRecreateSwapChain = false;
+
+			// The frame is skipped, so are its draws
+			mDrawQueue.Clear();
 			return;
 		}
 
-		vkResetFences(mContext->mDevice, 1, &mInFlightFences[mCurFrame]);
+		// The test quad goes through the queue like any other draw
+		VulkanDrawCommand quadDraw {
+			.pipeline = Pipeline(0),
+			.layout = PipelineLayout(0),
+			.vertexBuffer = mQuadMesh.VertexBuffer(),
+			.indexBuffer = mQuadMesh.IndexBuffer(),
+			.indexType = VK_INDEX_TYPE_UINT16,
+			.indexCount = (u32)indices.size(),
+		};
+
+		Draw(DrawSortKey(quadDraw, 0, 0.0f), quadDraw);
 
 		// Grab the next image from our swap chain
 		u32 imageIndex;
@@ -150,29 +219,55 @@ namespace rwd {
 		// so were specifying the stage of the graphics pipeline that writes to the color attachment. 
 		// That means that theoretically the implementation can already start executing our vertex shader 
 		// and such while the image is not yet available.
-		VkSemaphore waitSemaphores[] = { mImageAvailableSemaphores[mCurFrame]};
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		//
+		// Uploads go through the transfer timeline, so the frame also waits on any still in flight,
+		// as well as on whatever compute work it was told to wait for.
+		std::vector<VkSemaphore> waitSemaphores = { mImageAvailableSemaphores[mCurFrame], transfer.Semaphore() };
+		std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+
+		// Values for binary semaphores are ignored
+		std::vector<u64> waitValues = { 0, transfer.LastSubmitted() };
+
+		for (const TimelineWait& wait : mFrameWaits) {
+			waitSemaphores.push_back(mTimelines[(u32)wait.point.queue].Semaphore());
+			waitStages.push_back(wait.stages);
+			waitValues.push_back(wait.point.value);
+		}
+
+		mFrameWaits.clear();
 
-		VkSemaphore signalSemaphores[] = { mRenderFinishedSemaphores[mCurFrame] };
+		// The binary semaphore goes first, presenting only waits on it
+		mFrameValues[mCurFrame] = graphics.Advance();
+		VkSemaphore signalSemaphores[] = { mRenderFinishedSemaphores[mCurFrame], graphics.Semaphore() };
+		u64 signalValues[] = { 0, mFrameValues[mCurFrame] };
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo {
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.waitSemaphoreValueCount = (u32)waitValues.size(),
+			.pWaitSemaphoreValues = waitValues.data(),
+			.signalSemaphoreValueCount = 2,
+			.pSignalSemaphoreValues = signalValues,
+		};
 
 		VkSubmitInfo submitInfo {
 			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &timelineInfo,
 
 			// Set what pipeline stages we pause and wait for before continuing 
-			.waitSemaphoreCount = 1,
-			.pWaitSemaphores = waitSemaphores,
-			.pWaitDstStageMask = waitStages,
+			.waitSemaphoreCount = (u32)waitSemaphores.size(),
+			.pWaitSemaphores = waitSemaphores.data(),
+			.pWaitDstStageMask = waitStages.data(),
 
 			// Specify command buffer
 			.commandBufferCount = 1,
 			.pCommandBuffers = &mCommandBuffers[mCurFrame],
 
 			// Define what semaphores to signal when done
-			.signalSemaphoreCount = 1,
+			.signalSemaphoreCount = 2,
 			.pSignalSemaphores = signalSemaphores,
 		};
 
-		vkQueueSubmit(mContext->mGraphicsQueue, 1, &submitInfo, mInFlightFences[mCurFrame]);
+		vkQueueSubmit(mContext->mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
 
 		VkSwapchainKHR swapChains[] = { mSwapChain };
 		VkPresentInfoKHR presentInfo {
@@ -187,18 +282,33 @@ namespace rwd {
 		vkQueuePresentKHR(mContext->mPresentQueue, &presentInfo);
 		
 		mCurFrame = (mCurFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		UpdateDeferredRetires();
 	}
 
-	VkPipeline VulkanRenderer::CreatePipelineForShader(Shader& shader) {
+	// Goes through the desc path, which has the code to reflect the layout from
+	VulkanRenderer::BuiltPipeline VulkanRenderer::CreatePipelineForShader(Shader& shader) {
 		VulkanShader* vulkanShader = reinterpret_cast<VulkanShader*>(&shader);
-		vulkanShader->CreateShaderModules(mContext->mDevice);
+		VulkanPipelineDesc desc { .vertexShader = vulkanShader->VertexFile(), .fragmentShader = vulkanShader->FragmentFile() };
 
+		BuiltPipeline built = BuildPipeline(desc, mSwapChainImageFormat);
+		RWD_ASSERT(built.pipeline != VK_NULL_HANDLE, "Failed to build pipeline for {0} and {1}", desc.vertexShader, desc.fragmentShader);
+
+		return built;
+	}
+
+	// Only reads the renderer's state, so pipelines can be built on worker threads. A stage without a
+	// module is built from its identifier, and VK_NULL_HANDLE is returned if the driver would have to
+	// compile it.
+	VkPipeline VulkanRenderer::BuildPipeline(const VkShaderModule (&modules)[2], const VkPipelineShaderStageModuleIdentifierCreateInfoEXT (&identifiers)[2],
+		const ShaderReflection& vertexReflection, VkPipelineLayout layout, VkFormat colorFormat)
+	{
 		// Specify pipeline stage for vertex shader
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo { 
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext = modules[0] == VK_NULL_HANDLE ? &identifiers[0] : nullptr,
 			.stage = VK_SHADER_STAGE_VERTEX_BIT,
 			// Set which shader module this stage is going to use
-			.module = vulkanShader->VertexModule(),
+			.module = modules[0],
 			// Specify the shader's entry point by name
 			.pName = "main",
 		};
@@ -206,23 +316,41 @@ namespace rwd {
 		// Specify pipeline stage for fragment shader
 		VkPipelineShaderStageCreateInfo fragShaderStageInfo { 
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext = modules[1] == VK_NULL_HANDLE ? &identifiers[1] : nullptr,
 			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
 			// Set which shader module this stage is going to use
-			.module = vulkanShader->FragmentModule(),
+			.module = modules[1],
 			// Specify the shader's entry point by name
 			.pName = "main",
 		};
 
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-		// Describe the format of the data being passed into the vertex shader
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		// Describe the format of the data being passed into the vertex shader. The inputs it declares
+		// come from a single interleaved buffer, packed in location order.
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+		u32 stride = 0;
+		for (const ShaderVertexInput& input : vertexReflection.vertexInputs) {
+			attributeDescriptions.push_back(VkVertexInputAttributeDescription {
+				.location = input.location,
+				.binding = 0,
+				.format = input.format,
+				.offset = stride,
+			});
+			stride += input.size;
+		}
+
+		VkVertexInputBindingDescription bindingDescription {
+			.binding = 0,
+			.stride = stride,
+			.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+		};
+
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo { 
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-			.vertexBindingDescriptionCount = 1,
+			.vertexBindingDescriptionCount = stride > 0 ? 1u : 0u,
 			.pVertexBindingDescriptions = &bindingDescription,
-			.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size(),
+			.vertexAttributeDescriptionCount = (u32)attributeDescriptions.size(),
 			.pVertexAttributeDescriptions = attributeDescriptions.data(),
 		};
 
@@ -335,21 +463,23 @@ namespace rwd {
 			.blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}, // Optional
 		};
 
-		// Define the uniform values for our shaders
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-			.setLayoutCount = 0, // Optional
-			.pSetLayouts = nullptr, // Optional
-			.pushConstantRangeCount = 0, // Optional
-			.pPushConstantRanges = nullptr, // Optional
+		// With dynamic rendering the pipeline is created against the attachment formats instead of a render pass
+		VkPipelineRenderingCreateInfoKHR renderingInfo {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+			.colorAttachmentCount = 1,
+			.pColorAttachmentFormats = &colorFormat,
+			.depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+			.stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
 		};
 
-		VkResult result = vkCreatePipelineLayout(mContext->mDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayout);
-
-		RWD_ASSERT(result == VK_SUCCESS, "Failed to create Vulkan pipeline layout");
+		bool fromIdentifiers = modules[0] == VK_NULL_HANDLE || modules[1] == VK_NULL_HANDLE;
 
 		VkGraphicsPipelineCreateInfo pipelineInfo {
 			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.pNext = mDynamicRendering ? &renderingInfo : nullptr,
+
+			// Only the driver's pipeline caches can turn identifiers into a pipeline
+			.flags = fromIdentifiers ? (VkPipelineCreateFlags)VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT : 0u,
 
 			// Define shader stages (Vertex and Fragment)
 			.stageCount = 2,
@@ -365,22 +495,365 @@ namespace rwd {
 			.pColorBlendState = &colorBlending,
 			.pDynamicState = &dynamicState,
 
-			// Pipeline layout (Uniforms)
-			.layout = mPipelineLayout,
+			// Pipeline layout (Uniforms), reflected from the shaders
+			.layout = layout,
 
-			// Render pass
+			// Render pass, null with dynamic rendering
 			.renderPass = mRenderPass,
 			.subpass = 0,
 		};
 
-		VkPipeline newPipeline;
-		result = vkCreateGraphicsPipelines(mContext->mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline);
+		VkPipeline newPipeline = VK_NULL_HANDLE;
+		VkResult result = vkCreateGraphicsPipelines(mContext->mDevice, mPipelineCache, 1, &pipelineInfo, nullptr, &newPipeline);
+
+		RWD_ASSERT(result == VK_SUCCESS || (fromIdentifiers && result == VK_PIPELINE_COMPILE_REQUIRED), "Failed to create Vulkan graphics pipeline");
+
+		return result == VK_SUCCESS ? newPipeline : VK_NULL_HANDLE;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Pipelines and Shader Hot Reload
+	//
+	//-------------------------------------------------------------------------
+
+	// Relative to the working directory, written as the renderer shuts down
+	const char* const SHADER_CACHE_PATH = "shadercache.rwdshc";
+	const char* const PIPELINE_CACHE_PATH = "pipelinecache.bin";
+
+	u32 VulkanRenderer::CreatePipeline(const VulkanPipelineDesc& desc) {
+		BuiltPipeline built = BuildPipeline(desc, mSwapChainImageFormat);
+		RWD_ASSERT(built.pipeline != VK_NULL_HANDLE, "Failed to build pipeline for {0} and {1}", desc.vertexShader, desc.fragmentShader);
+
+		std::unique_lock lock(mPipelinesMutex);
+		u32 index = (u32)mPipelines.size();
+		mPipelines.push_back(built.pipeline);
+		mPipelineLayouts.push_back(built.layout);
+		mPipelineModules.push_back(std::move(built.modules));
+		mPipelineDescs[index] = desc;
+		lock.unlock();
+
+		if (mShaderWatcher) {
+			WatchShaders(desc);
+		}
+
+		return index;
+	}
+
+	VkPipeline VulkanRenderer::Pipeline(u32 index) const {
+		std::shared_lock lock(mPipelinesMutex);
+		return mPipelines[index];
+	}
+
+	VkPipelineLayout VulkanRenderer::PipelineLayout(u32 index) const {
+		std::shared_lock lock(mPipelinesMutex);
+		return mPipelineLayouts[index];
+	}
+
+	VkDescriptorSetLayout VulkanRenderer::DescriptorSetLayout(u32 index, u32 set) const {
+		return mLayoutCache.SetLayout(PipelineLayout(index), set);
+	}
+
+	bool VulkanRenderer::ResolveShader(const ShaderPermutation& permutation, u64& hash) {
+		u64 key = permutation.Key();
+
+		{
+			std::lock_guard<std::mutex> lock(mResolvedShadersMutex);
+			auto resolved = mResolvedShaders.find(key);
+			if (resolved != mResolvedShaders.end()) {
+				hash = resolved->second;
+				return true;
+			}
+		}
+
+		// SPIR-V files are their own source. Without the source, e.g. GLSL that isn't shipped,
+		// whatever was compiled into the cache is used.
+		// Read on this thread, rebuilds run as jobs and waiting on a read queued behind them could deadlock
+		ReadResult read = Vfs::ReadFileNow(permutation.path);
+		u64 sourceHash = read.success ? HashBytes(read.buffer.Data(), read.buffer.Size()) : 0;
+
+		if (!mShaderCache.Find(key, sourceHash, hash)) {
+			std::vector<u32> code;
+
+			if (std::filesystem::path(permutation.path).extension() == ".spv") {
+				if (!read.success) {
+					RWD_LOG_ERROR("Failed to read shader {0}", permutation.path);
+					return false;
+				}
+
+				if (read.buffer.Size() == 0 || read.buffer.Size() % sizeof(u32) != 0) {
+					RWD_LOG_ERROR("Shader {0} is not valid SPIR-V", permutation.path);
+					return false;
+				}
+
+				code.resize(read.buffer.Size() / sizeof(u32));
+				memcpy(code.data(), read.buffer.Data(), read.buffer.Size());
+			} else {
+				// The compiler works on files, so GLSL has to be loose rather than packed
+				std::string filepath = Vfs::LoosePath(permutation.path);
+				if (filepath.empty()) {
+					RWD_LOG_ERROR("Shader {0} is not in the shader cache and its source was not found in a loose mount", permutation.path);
+					return false;
+				}
+
+				std::vector<std::string> defines = permutation.defines;
+				defines.push_back("RWD_FEATURES=" + std::to_string(permutation.features));
+
+				std::string errors;
+				if (!CompileGlsl(filepath, code, errors, defines)) {
+					RWD_LOG_ERROR("Failed to compile {0}:\n{1}", permutation.path, errors);
+					return false;
+				}
+			}
+
+			hash = mShaderCache.Add(key, sourceHash, code);
+		}
+
+		std::lock_guard<std::mutex> lock(mResolvedShadersMutex);
+		mResolvedShaders[key] = hash;
+		return true;
+	}
+
+	VkShaderModule VulkanRenderer::AcquireShaderModule(u64 hash) {
+		VkShaderModule module = mModuleCache.Acquire(hash, mShaderCache.Spirv(hash));
+
+		// Keep the module's identifier, so pipelines the driver has cached can skip the module next time
+		if (module != VK_NULL_HANDLE && mGetShaderModuleIdentifier && !mShaderCache.HasIdentifier(hash)) {
+			VkShaderModuleIdentifierEXT identifier { .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT };
+			mGetShaderModuleIdentifier(mContext->mDevice, module, &identifier);
+			mShaderCache.SetIdentifier(hash, std::span<const u8>(identifier.identifier, identifier.identifierSize));
+		}
+
+		return module;
+	}
+
+	void VulkanRenderer::ReleaseShaderModules(const std::vector<u64>& modules) {
+		for (u64 hash : modules) {
+			mModuleCache.Release(hash);
+		}
+	}
+
+	VulkanRenderer::BuiltPipeline VulkanRenderer::BuildPipeline(const VulkanPipelineDesc& desc, VkFormat colorFormat) {
+		BuiltPipeline built;
+
+		ShaderPermutation permutations[] = {
+			ShaderPermutation { .path = desc.vertexShader, .defines = desc.defines, .features = desc.features },
+			ShaderPermutation { .path = desc.fragmentShader, .defines = desc.defines, .features = desc.features },
+		};
+
+		u64 hashes[2];
+		const ShaderReflection* reflections[2];
+		for (u32 i = 0; i < 2; i++) {
+			if (!ResolveShader(permutations[i], hashes[i])) {
+				return built;
+			}
+
+			reflections[i] = mLayoutCache.Reflect(hashes[i], mShaderCache.Spirv(hashes[i]));
+			if (!reflections[i]) {
+				RWD_LOG_ERROR("Failed to reflect {0}, a vertex input may have a type with no vertex format", permutations[i].path);
+				return built;
+			}
+		}
+
+		built.layout = mLayoutCache.Layout(reflections);
+		if (built.layout == VK_NULL_HANDLE) {
+			RWD_LOG_ERROR("Failed to create a pipeline layout for {0} and {1}", desc.vertexShader, desc.fragmentShader);
+			return built;
+		}
+
+		// Stages whose module no pipeline holds go by their identifier when there is one, which
+		// only works if the driver has the pipeline cached. If it doesn't the modules are made after all.
+		VkShaderModule modules[2] = { };
+		VkPipelineShaderStageModuleIdentifierCreateInfoEXT identifiers[2] = { };
+
+		for (u32 i = 0; i < 2; i++) {
+			std::span<const u8> identifier = mGetShaderModuleIdentifier ? mShaderCache.Identifier(hashes[i]) : std::span<const u8>();
+			identifiers[i] = VkPipelineShaderStageModuleIdentifierCreateInfoEXT {
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT,
+				.identifierSize = (u32)identifier.size(),
+				.pIdentifier = identifier.data(),
+			};
+
+			if (identifier.empty() || mModuleCache.Find(hashes[i]) != VK_NULL_HANDLE) {
+				modules[i] = AcquireShaderModule(hashes[i]);
+				if (modules[i] == VK_NULL_HANDLE) {
+					RWD_LOG_ERROR("Failed to create the shader module for {0}", permutations[i].path);
+					ReleaseShaderModules(built.modules);
+					built.modules.clear();
+					return built;
+				}
+				built.modules.push_back(hashes[i]);
+			}
+		}
+
+		built.pipeline = BuildPipeline(modules, identifiers, *reflections[0], built.layout, colorFormat);
 
-		RWD_ASSERT(result == VK_SUCCESS, "Failed to create Vulkan graphics pipeline");
+		if (built.pipeline == VK_NULL_HANDLE && (modules[0] == VK_NULL_HANDLE || modules[1] == VK_NULL_HANDLE)) {
+			for (u32 i = 0; i < 2; i++) {
+				if (modules[i] == VK_NULL_HANDLE && (modules[i] = AcquireShaderModule(hashes[i])) != VK_NULL_HANDLE) {
+					built.modules.push_back(hashes[i]);
+				}
+			}
 
-		vulkanShader->FreeShaderModules(mContext->mDevice);
+			if (modules[0] != VK_NULL_HANDLE && modules[1] != VK_NULL_HANDLE) {
+				built.pipeline = BuildPipeline(modules, identifiers, *reflections[0], built.layout, colorFormat);
+			}
+		}
 
-		return newPipeline;
+		if (built.pipeline == VK_NULL_HANDLE) {
+			RWD_LOG_ERROR("Failed to create a pipeline for {0} and {1}", desc.vertexShader, desc.fragmentShader);
+			ReleaseShaderModules(built.modules);
+			built.modules.clear();
+		}
+
+		return built;
+	}
+
+	void VulkanRenderer::OpenShaderCaches() {
+		const VulkanCapabilities& capabilities = mContext->mCapabilities;
+		VkDevice device = mContext->mDevice;
+
+		mShaderCache.Open(SHADER_CACHE_PATH);
+
+		if (capabilities.shaderModuleIdentifier) {
+			mShaderCache.SetIdentifierAlgorithm(capabilities.shaderModuleIdentifierAlgorithm);
+			mGetShaderModuleIdentifier = (PFN_vkGetShaderModuleIdentifierEXT)vkGetDeviceProcAddr(device, "vkGetShaderModuleIdentifierEXT");
+		}
+
+		// The driver checks the data came from the same driver and device, and ignores it otherwise
+		std::vector<char> data;
+		std::ifstream file(PIPELINE_CACHE_PATH, std::ios::binary);
+		if (file) {
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+			.initialDataSize = data.size(),
+			.pInitialData = data.data(),
+		};
+
+		VkResult result = vkCreatePipelineCache(device, &cacheInfo, nullptr, &mPipelineCache);
+
+		RWD_ASSERT(result == VK_SUCCESS, "Failed to create Vulkan pipeline cache");
+	}
+
+	void VulkanRenderer::SaveShaderCaches() {
+		VkDevice device = mContext->mDevice;
+
+		mShaderCache.Save();
+
+		size_t size = 0;
+		vkGetPipelineCacheData(device, mPipelineCache, &size, nullptr);
+
+		std::vector<char> data(size);
+		if (size > 0 && vkGetPipelineCacheData(device, mPipelineCache, &size, data.data()) == VK_SUCCESS) {
+			std::ofstream file(PIPELINE_CACHE_PATH, std::ios::binary | std::ios::trunc);
+			file.write(data.data(), size);
+
+			if (!file.good()) {
+				RWD_LOG_ERROR("Failed to write pipeline cache {0}", PIPELINE_CACHE_PATH);
+			}
+		}
+
+		vkDestroyPipelineCache(device, mPipelineCache, nullptr);
+	}
+
+	void VulkanRenderer::EnableShaderHotReload() {
+		if (mShaderWatcher) {
+			return;
+		}
+
+		mShaderWatcher = MakeScope<FileWatcher>();
+
+		std::shared_lock lock(mPipelinesMutex);
+		for (const auto& [index, desc] : mPipelineDescs) {
+			WatchShaders(desc);
+		}
+	}
+
+	void VulkanRenderer::WatchShaders(const VulkanPipelineDesc& desc) {
+		for (const std::string* shader : { &desc.vertexShader, &desc.fragmentShader }) {
+			std::string filepath = Vfs::LoosePath(*shader);
+			if (!filepath.empty()) {
+				mShaderWatcher->Watch(filepath);
+			}
+		}
+	}
+
+	void VulkanRenderer::UpdateShaderHotReload() {
+		if (!mShaderWatcher) {
+			return;
+		}
+
+		// Swap in the pipelines rebuilt since the last frame
+		std::vector<ReloadedPipeline> reloaded;
+		{
+			std::lock_guard<std::mutex> lock(mReloadedMutex);
+			reloaded.swap(mReloadedPipelines);
+		}
+
+		for (ReloadedPipeline& pipeline : reloaded) {
+			if (pipeline.generation != mReloadGenerations[pipeline.index]) {
+				vkDestroyPipeline(mContext->mDevice, pipeline.pipeline, nullptr);
+				ReleaseShaderModules(pipeline.modules);
+				continue;
+			}
+
+			std::unique_lock lock(mPipelinesMutex);
+			RetireAfterQueuedFrames([this, replaced = mPipelines[pipeline.index]] (const TimelineUsage& usage) {
+				mDeletionQueue.RetirePipeline(usage, replaced);
+			});
+			mPipelines[pipeline.index] = pipeline.pipeline;
+			mPipelineLayouts[pipeline.index] = pipeline.layout;
+			ReleaseShaderModules(mPipelineModules[pipeline.index]);
+			mPipelineModules[pipeline.index] = std::move(pipeline.modules);
+			RWD_LOG_INFO("Reloaded pipeline {0}", pipeline.index);
+		}
+
+		// Rebuild the pipelines using files that changed. If a shader fails to compile the
+		// old pipeline stays in use.
+		mChangedShaders.clear();
+		mShaderWatcher->Poll(mChangedShaders);
+		if (mChangedShaders.empty()) {
+			return;
+		}
+
+		// Sources are hashed again as they're resolved, so only the changed ones compile
+		{
+			std::lock_guard<std::mutex> lock(mResolvedShadersMutex);
+			mResolvedShaders.clear();
+		}
+
+		std::shared_lock lock(mPipelinesMutex);
+		for (const auto& [index, desc] : mPipelineDescs) {
+			bool changed = false;
+			for (const std::string* shader : { &desc.vertexShader, &desc.fragmentShader }) {
+				std::string filepath = Vfs::LoosePath(*shader);
+				changed = changed || std::find(mChangedShaders.begin(), mChangedShaders.end(), filepath) != mChangedShaders.end();
+			}
+
+			if (!changed) {
+				continue;
+			}
+
+			u32 generation = ++mReloadGenerations[index];
+			JobSystem::Execute(mShaderReloadCounter, [this, index, generation, desc, colorFormat = mSwapChainImageFormat.load()] {
+				BuiltPipeline built = BuildPipeline(desc, colorFormat);
+				if (built.pipeline == VK_NULL_HANDLE) {
+					return;
+				}
+
+				std::lock_guard<std::mutex> lock(mReloadedMutex);
+				mReloadedPipelines.push_back(ReloadedPipeline {
+					.index = index,
+					.generation = generation,
+					.pipeline = built.pipeline,
+					.layout = built.layout,
+					.modules = std::move(built.modules),
+				});
+			});
+		}
 	}
 
 	void VulkanRenderer::CreateRenderPass() {
@@ -597,7 +1070,7 @@ namespace rwd {
 	}
 
 	void VulkanRenderer::CreateCommandPool() {
-		QueueFamilyIndices queueFamilyIndices = mContext->FindQueueFamilies();
+		mQueueFamilies = mContext->FindQueueFamilies();
 
 		// Each command pool can only allocate command buffers that 
 		// are submitted on a single type of queue.
@@ -605,12 +1078,23 @@ namespace rwd {
 		VkCommandPoolCreateInfo poolInfo {
 			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
 			.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-			.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value(),
+			.queueFamilyIndex = mQueueFamilies.graphicsFamily.value(),
 		};
 
 		VkResult result = vkCreateCommandPool(mContext->mDevice, &poolInfo, nullptr, &mCommandPool);
 
 		RWD_ASSERT(result == VK_SUCCESS, "Failed to create Vulkan command pool");
+
+		// Compute command buffers are recorded once and thrown away
+		VkCommandPoolCreateInfo computePoolInfo {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex = mQueueFamilies.computeFamily.value(),
+		};
+
+		result = vkCreateCommandPool(mContext->mDevice, &computePoolInfo, nullptr, &mComputeCommandPool);
+
+		RWD_ASSERT(result == VK_SUCCESS, "Failed to create Vulkan compute command pool");
 	}
 
 	void VulkanRenderer::CreateCommandBuffers() {
@@ -631,22 +1115,19 @@ namespace rwd {
 	void VulkanRenderer::CreateSyncObjects() {
 		mImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		mRenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		mInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
 		VkSemaphoreCreateInfo semaphoreInfo {
 			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
 		};
 
-		VkFenceCreateInfo fenceInfo {
-			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-			// Set it to be signaled on creation so first call to wait doesn't block 
-			.flags = VK_FENCE_CREATE_SIGNALED_BIT,
-		};
-
 		for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			vkCreateSemaphore(mContext->mDevice, &semaphoreInfo, nullptr, &mImageAvailableSemaphores[i]);
 			vkCreateSemaphore(mContext->mDevice, &semaphoreInfo, nullptr, &mRenderFinishedSemaphores[i]);
-			vkCreateFence(mContext->mDevice, &fenceInfo, nullptr, &mInFlightFences[i]);
+		}
+
+		// Frame slots start at value 0, which the timelines already hold, so the first waits don't block
+		for (VulkanTimeline& timeline : mTimelines) {
+			timeline.Init(mContext->mDevice);
 		}
 	}
 
@@ -659,28 +1140,7 @@ namespace rwd {
 
 		VkResult result = vkBeginCommandBuffer(cmdBuffer, &beginInfo);
 
-		VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-
-		VkRenderPassBeginInfo renderPassInfo {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-			.renderPass = mRenderPass,
-			.framebuffer = mSwapChainFramebuffers[imageIndex],
-			.renderArea {
-				.offset = {0, 0}, 
-				.extent = mSwapChainExtent,
-			},
-			.clearValueCount = 1,
-			.pClearValues = &clearColor,
-		};
-
-		vkCmdBeginRenderPass(cmdBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelines[0]);
-
-		VkBuffer vertexBuffers[] = { vertexBuffer.Buffer() };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, vertexBuffers, offsets);
-
-		vkCmdBindIndexBuffer(cmdBuffer, indexBuffer.Buffer(), 0, VK_INDEX_TYPE_UINT16);
+		BeginSwapChainRendering(cmdBuffer, imageIndex);
 
 		// Set the dynamic states that were specified in the pipeline
 		{
@@ -702,12 +1162,169 @@ namespace rwd {
 			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 		}
 
-		vkCmdDrawIndexed(cmdBuffer, (uint32_t)indices.size(), 1, 0, 0, 0);
+		RecordDrawQueue(cmdBuffer);
 
-		vkCmdEndRenderPass(cmdBuffer);
+		EndSwapChainRendering(cmdBuffer, imageIndex);
 		vkEndCommandBuffer(cmdBuffer);
 	}
 
+	void VulkanRenderer::RecordDrawQueue(VkCommandBuffer cmdBuffer) {
+		mDrawQueue.Sort();
+
+		RenderQueueStats stats;
+
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+		VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+		VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+		VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+		VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+		// Sorting put draws sharing state next to each other, so most of these checks skip the bind
+		mDrawQueue.ForEach([&] (const VulkanDrawCommand& draw) {
+			if (draw.pipeline != boundPipeline) {
+				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+				boundPipeline = draw.pipeline;
+				stats.pipelineBinds++;
+			}
+
+			// Pipelines with identical layouts share one, so the set stays bound across pipeline changes between them
+			if (draw.descriptorSet != VK_NULL_HANDLE && (draw.descriptorSet != boundDescriptorSet || draw.layout != boundLayout)) {
+				vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.layout, 0, 1, &draw.descriptorSet, 0, nullptr);
+				boundDescriptorSet = draw.descriptorSet;
+				boundLayout = draw.layout;
+				stats.descriptorSetBinds++;
+			}
+
+			if (draw.vertexBuffer != boundVertexBuffer) {
+				VkDeviceSize offset = 0;
+				vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &draw.vertexBuffer, &offset);
+				boundVertexBuffer = draw.vertexBuffer;
+				stats.vertexBufferBinds++;
+			}
+
+			if (draw.indexBuffer != boundIndexBuffer || draw.indexType != boundIndexType) {
+				vkCmdBindIndexBuffer(cmdBuffer, draw.indexBuffer, 0, draw.indexType);
+				boundIndexBuffer = draw.indexBuffer;
+				boundIndexType = draw.indexType;
+				stats.indexBufferBinds++;
+			}
+
+			vkCmdDrawIndexed(cmdBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, 0, 0);
+			stats.draws++;
+		});
+
+		mDrawStats = stats;
+		mDrawQueue.Clear();
+	}
+
+	void VulkanRenderer::BeginSwapChainRendering(VkCommandBuffer cmdBuffer, u32 imageIndex) {
+		VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+		VkRect2D renderArea {
+			.offset = { 0, 0 },
+			.extent = mSwapChainExtent,
+		};
+
+		if (!mDynamicRendering) {
+			VkRenderPassBeginInfo renderPassInfo {
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+				.renderPass = mRenderPass,
+				.framebuffer = mSwapChainFramebuffers[imageIndex],
+				.renderArea = renderArea,
+				.clearValueCount = 1,
+				.pClearValues = &clearColor,
+			};
+
+			vkCmdBeginRenderPass(cmdBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			return;
+		}
+
+		// Without a render pass the layout transitions are ours to make. This one does what the render
+		// pass's external dependency did, it waits on the same stage the acquire semaphore is waited on,
+		// and the old contents are discarded since the attachment is cleared.
+		ImageBarrier(cmdBuffer, VkImageMemoryBarrier2KHR {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+			.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+			.srcAccessMask = VK_ACCESS_2_NONE_KHR,
+			.dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+			.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = mSwapChainImages[imageIndex],
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+		});
+
+		VkRenderingAttachmentInfoKHR colorAttachment {
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+			.imageView = mSwapChainImageViews[imageIndex],
+			.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.clearValue = clearColor,
+		};
+
+		VkRenderingInfoKHR renderingInfo {
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+			.renderArea = renderArea,
+			.layerCount = 1,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &colorAttachment,
+		};
+
+		mCmdBeginRendering(cmdBuffer, &renderingInfo);
+	}
+
+	void VulkanRenderer::EndSwapChainRendering(VkCommandBuffer cmdBuffer, u32 imageIndex) {
+		if (!mDynamicRendering) {
+			// The render pass transitions the image to its final present layout
+			vkCmdEndRenderPass(cmdBuffer);
+			return;
+		}
+
+		mCmdEndRendering(cmdBuffer);
+
+		// Presenting waits on the render finished semaphore, so nothing after the transition has to wait on it
+		ImageBarrier(cmdBuffer, VkImageMemoryBarrier2KHR {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+			.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+			.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+			.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR,
+			.dstAccessMask = VK_ACCESS_2_NONE_KHR,
+			.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = mSwapChainImages[imageIndex],
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+		});
+	}
+
+	void VulkanRenderer::ImageBarrier(VkCommandBuffer cmdBuffer, const VkImageMemoryBarrier2KHR& barrier) {
+		VkDependencyInfoKHR dependencyInfo {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+			.imageMemoryBarrierCount = 1,
+			.pImageMemoryBarriers = &barrier,
+		};
+
+		mCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+	}
+
+	void VulkanRenderer::LoadDynamicRenderingFunctions() {
+		// Only the names for how the device exposes them resolve, the core or the KHR extension ones
+		bool core = mContext->mCapabilities.apiVersion >= VK_API_VERSION_1_3;
+		VkDevice device = mContext->mDevice;
+
+		mCmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR");
+		mCmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR");
+		mCmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(device, core ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier2KHR");
+
+		RWD_ASSERT(mCmdBeginRendering && mCmdEndRendering && mCmdPipelineBarrier2, "Failed to load Vulkan dynamic rendering functions");
+	}
+
 	void VulkanRenderer::RecreateSwapChain() {
 		// Wait for operations on the GPU to finish
 		vkDeviceWaitIdle(mContext->mDevice);
@@ -716,7 +1333,11 @@ namespace rwd {
 
 		CreateSwapChain();
 		CreateSwapChainImageViews();
-		CreateFrameBuffers();
+
+		// Dynamic rendering renders straight into the new image views
+		if (!mDynamicRendering) {
+			CreateFrameBuffers();
+		}
 	}
 
 	void VulkanRenderer::DestroySwapChain() {
@@ -731,21 +1352,112 @@ namespace rwd {
 		vkDestroySwapchainKHR(mContext->mDevice, mSwapChain, nullptr);
 	}
 
-	void VulkanRenderer::CreateVulkanMesh(Mesh& mesh) {
-		VulkanVertexBuffer vertexBuffer((void*)mesh.mVerts.data(), mesh.VertexBufferSize(), mContext->mDevice, mAllocator);
-		VulkanIndexBuffer indexBuffer((void*)mesh.mIndices.data(), mesh.IndexBufferSize(), mContext->mDevice, mAllocator);
+	VulkanMesh VulkanRenderer::CreateVulkanMesh(Mesh& mesh) {
+		return CreateVulkanMesh(mesh.mVerts.data(), mesh.VertexBufferSize(), mesh.mIndices.data(), mesh.IndexBufferSize(), mesh.mLods);
+	}
+
+	VulkanMesh VulkanRenderer::CreateVulkanMesh(const MeshFileView& meshFile) {
+		// The view points straight into the memory mapped file, so the only copy 
+		// made is the one from the mapped pages into the staging buffer
+		std::vector<MeshLod> lods(meshFile.lods, meshFile.lods + meshFile.metadata->lodCount);
+		return CreateVulkanMesh(meshFile.verts, meshFile.VertexBufferSize(), meshFile.indices, meshFile.IndexBufferSize(), lods);
+	}
+
+	VulkanMesh VulkanRenderer::CreateVulkanMesh(const void* verts, size_t vertsSize, const void* indices, size_t indicesSize,
+		const std::vector<MeshLod>& lods)
+	{
+		VulkanVertexBuffer vertexBuffer(verts, (u32)vertsSize, mAllocator, mMemoryPools);
+		VulkanIndexBuffer indexBuffer(indices, (u32)indicesSize, mAllocator, mMemoryPools);
 
 		VulkanMesh vulkanMesh;
 		vulkanMesh.SetVertexBuffer(vertexBuffer);
 		vulkanMesh.SetIndexBuffer(indexBuffer);
 
-		CopyMeshToGpu(vulkanMesh);
+		// All LODs live in the same index buffer, so they upload along with the mesh
+		vulkanMesh.SetLods(lods);
+
+		TimelinePoint upload = CopyMeshToGpu(vulkanMesh);
+
+		vertexBuffer.RetireStagingBuffer(mDeletionQueue, upload);
+		indexBuffer.RetireStagingBuffer(mDeletionQueue, upload);
+
+		return vulkanMesh;
+	}
+
+	void VulkanRenderer::DestroyVulkanMesh(VulkanMesh& vulkanMesh) {
+		// Queued frames may still draw from the buffers
+		RetireAfterQueuedFrames([this, mesh = vulkanMesh] (const TimelineUsage& usage) mutable {
+			mesh.Retire(mDeletionQueue, usage);
+		});
+	}
+
+	void VulkanRenderer::DestroyVulkanTexture(VulkanTexture& texture) {
+		// Queued frames may still sample the image. The texture gives up its handles right away,
+		// the copy retires them later.
+		RetireAfterQueuedFrames([this, retired = texture] (const TimelineUsage& usage) mutable {
+			retired.Retire(mDeletionQueue, usage);
+		});
+		texture.Release();
+	}
 
-		vertexBuffer.FreeStagingBuffer(mContext->mDevice, mAllocator);
-		indexBuffer.FreeStagingBuffer(mContext->mDevice, mAllocator);
+	void VulkanRenderer::RetireAfterQueuedFrames(std::function<void(const TimelineUsage&)> retire) {
+		mDeferredRetires.push_back(DeferredRetire { .framesLeft = QUEUED_FRAMES_RETIRE_DELAY, .retire = std::move(retire) });
 	}
 
-	void VulkanRenderer::CopyMeshToGpu(VulkanMesh& vulkanMesh) {
+	// After the frame's submit, so the last frame that could hold the resources is in flight when they're retired
+	void VulkanRenderer::UpdateDeferredRetires() {
+		for (size_t i = 0; i < mDeferredRetires.size(); ) {
+			if (--mDeferredRetires[i].framesLeft == 0) {
+				mDeferredRetires[i].retire(InFlight());
+				mDeferredRetires[i] = std::move(mDeferredRetires.back());
+				mDeferredRetires.pop_back();
+			} else {
+				i++;
+			}
+		}
+	}
+
+	VkSampler VulkanRenderer::GetSampler(const SamplerDesc& desc) {
+		u64 key = HashBytes(&desc, sizeof(desc));
+
+		auto existing = mSamplers.find(key);
+		if (existing != mSamplers.end()) {
+			return existing->second;
+		}
+
+		// Anisotropy is only enabled on the device when it's supported
+		const VulkanCapabilities& capabilities = mContext->mCapabilities;
+		f32 anisotropy = capabilities.samplerAnisotropy ? std::min(desc.maxAnisotropy, capabilities.maxSamplerAnisotropy) : 1.0f;
+
+		VkSamplerCreateInfo samplerInfo {
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.magFilter = desc.filter,
+			.minFilter = desc.filter,
+			.mipmapMode = desc.mipmapMode,
+			.addressModeU = desc.addressMode,
+			.addressModeV = desc.addressMode,
+			.addressModeW = desc.addressMode,
+			.mipLodBias = desc.mipLodBias,
+			.anisotropyEnable = anisotropy > 1.0f ? VK_TRUE : VK_FALSE,
+			.maxAnisotropy = anisotropy,
+			.compareEnable = VK_FALSE,
+			.compareOp = VK_COMPARE_OP_ALWAYS,
+			.minLod = 0.0f,
+			.maxLod = VK_LOD_CLAMP_NONE,
+			.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+			.unnormalizedCoordinates = VK_FALSE,
+		};
+
+		VkSampler sampler;
+		VkResult result = vkCreateSampler(mContext->mDevice, &samplerInfo, nullptr, &sampler);
+
+		RWD_ASSERT(result == VK_SUCCESS, "Failed to create Vulkan sampler");
+
+		mSamplers[key] = sampler;
+		return sampler;
+	}
+
+	VkCommandBuffer VulkanRenderer::BeginOneTimeCommands() {
 		VkCommandBufferAllocateInfo allocInfo { };
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -760,6 +1472,176 @@ namespace rwd {
 		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		return commandBuffer;
+	}
+
+	TimelinePoint VulkanRenderer::EndOneTimeCommands(VkCommandBuffer commandBuffer) {
+		vkEndCommandBuffer(commandBuffer);
+
+		TimelinePoint upload = Submit(QueueType::Transfer, commandBuffer);
+		mDeletionQueue.RetireCommandBuffer(upload, mCommandPool, commandBuffer);
+
+		return upload;
+	}
+
+	TimelinePoint VulkanRenderer::Submit(QueueType queue, VkCommandBuffer commandBuffer, const std::vector<TimelineWait>& waits) {
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<VkPipelineStageFlags> waitStages;
+		std::vector<u64> waitValues;
+
+		for (const TimelineWait& wait : waits) {
+			// Skip what has already finished instead of making the GPU check
+			if (IsComplete(wait.point)) {
+				continue;
+			}
+
+			waitSemaphores.push_back(mTimelines[(u32)wait.point.queue].Semaphore());
+			waitStages.push_back(wait.stages);
+			waitValues.push_back(wait.point.value);
+		}
+
+		VulkanTimeline& timeline = mTimelines[(u32)queue];
+		VkSemaphore signalSemaphore = timeline.Semaphore();
+		u64 signalValue = timeline.Advance();
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo {
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.waitSemaphoreValueCount = (u32)waitValues.size(),
+			.pWaitSemaphoreValues = waitValues.data(),
+			.signalSemaphoreValueCount = 1,
+			.pSignalSemaphoreValues = &signalValue,
+		};
+
+		VkSubmitInfo submitInfo {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &timelineInfo,
+			.waitSemaphoreCount = (u32)waitSemaphores.size(),
+			.pWaitSemaphores = waitSemaphores.data(),
+			.pWaitDstStageMask = waitStages.data(),
+			.commandBufferCount = 1,
+			.pCommandBuffers = &commandBuffer,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &signalSemaphore,
+		};
+
+		// A failed submit never signals its value, anything waiting on it would hang
+		VkResult result = vkQueueSubmit(Queue(queue), 1, &submitInfo, VK_NULL_HANDLE);
+		RWD_ASSERT(result == VK_SUCCESS, "Failed to submit to the {0} queue", QueueTypeName(queue));
+
+		return TimelinePoint { .queue = queue, .value = signalValue };
+	}
+
+	TimelinePoint VulkanRenderer::LastSubmission(QueueType queue) const {
+		return TimelinePoint { .queue = queue, .value = mTimelines[(u32)queue].LastSubmitted() };
+	}
+
+	bool VulkanRenderer::IsComplete(TimelinePoint point) {
+		return mTimelines[(u32)point.queue].IsComplete(point.value);
+	}
+
+	void VulkanRenderer::Wait(TimelinePoint point) {
+		mTimelines[(u32)point.queue].Wait(point.value);
+	}
+
+	TimelineUsage VulkanRenderer::InFlight() const {
+		TimelineUsage usage;
+		for (u32 queue = 0; queue < (u32)QueueType::Count; queue++) {
+			usage.Add(LastSubmission((QueueType)queue));
+		}
+
+		return usage;
+	}
+
+	VulkanDeletionQueue& VulkanRenderer::DeletionQueue() {
+		return mDeletionQueue;
+	}
+
+	VkQueue VulkanRenderer::Queue(QueueType queue) const {
+		// Transfers share the graphics queue but still get their own timeline to wait on
+		return queue == QueueType::Compute ? mContext->mComputeQueue : mContext->mGraphicsQueue;
+	}
+
+	u32 VulkanRenderer::QueueFamily(QueueType queue) const {
+		return queue == QueueType::Compute ? mQueueFamilies.computeFamily.value() : mQueueFamilies.graphicsFamily.value();
+	}
+
+	VkCommandBuffer VulkanRenderer::BeginComputeCommands() {
+		VkCommandBufferAllocateInfo allocInfo {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = mComputeCommandPool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1,
+		};
+
+		VkCommandBuffer commandBuffer;
+		vkAllocateCommandBuffers(mContext->mDevice, &allocInfo, &commandBuffer);
+
+		VkCommandBufferBeginInfo beginInfo {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		};
+
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		return commandBuffer;
+	}
+
+	TimelinePoint VulkanRenderer::SubmitCompute(VkCommandBuffer commandBuffer, const std::vector<TimelineWait>& waits) {
+		vkEndCommandBuffer(commandBuffer);
+
+		TimelinePoint point = Submit(QueueType::Compute, commandBuffer, waits);
+		mDeletionQueue.RetireCommandBuffer(point, mComputeCommandPool, commandBuffer);
+
+		return point;
+	}
+
+	bool VulkanRenderer::HasAsyncCompute() const {
+		return mContext->mCapabilities.asyncCompute;
+	}
+
+	void VulkanRenderer::WaitInFrame(const TimelineWait& wait) {
+		if (!IsComplete(wait.point)) {
+			mFrameWaits.push_back(wait);
+		}
+	}
+
+	void VulkanRenderer::Draw(u64 sortKey, const VulkanDrawCommand& command) {
+		mDrawQueue.Push(sortKey, command);
+	}
+
+	u64 VulkanRenderer::DrawSortKey(const VulkanDrawCommand& command, u32 pipelineIndex, f32 depth, u32 layer, SortOrder order) const {
+		// Only the low bits make it into the key, a collision costs an extra bind but never a wrong one
+		u32 material = (u32)HashBytes(&command.descriptorSet, sizeof(command.descriptorSet));
+		u32 mesh = (u32)HashBytes(&command.vertexBuffer, sizeof(command.vertexBuffer));
+
+		return MakeSortKey(layer, pipelineIndex, material, mesh, depth, order);
+	}
+
+	const RenderQueueStats& VulkanRenderer::DrawStats() const {
+		return mDrawStats;
+	}
+
+	const Ref<VulkanContext>& VulkanRenderer::Context() const {
+		return mContext;
+	}
+
+	const VulkanCapabilities& VulkanRenderer::Capabilities() const {
+		return mContext->mCapabilities;
+	}
+
+	VmaAllocator VulkanRenderer::Allocator() const {
+		return mAllocator;
+	}
+
+	VulkanMemoryGovernor& VulkanRenderer::MemoryGovernor() {
+		return mMemoryGovernor;
+	}
+
+	VulkanMemoryPools& VulkanRenderer::MemoryPools() {
+		return mMemoryPools;
+	}
+
+	TimelinePoint VulkanRenderer::CopyMeshToGpu(VulkanMesh& vulkanMesh) {
+		VkCommandBuffer commandBuffer = BeginOneTimeCommands();
 
 		VkBufferCopy vertexCopyRegion { };
 		vertexCopyRegion.size = vulkanMesh.VertexBufferSize();
@@ -770,19 +1652,7 @@ namespace rwd {
 		vkCmdCopyBuffer(commandBuffer, vulkanMesh.VertexStagingBuffer(), vulkanMesh.VertexBuffer(), 1, &vertexCopyRegion);
 		vkCmdCopyBuffer(commandBuffer, vulkanMesh.IndexStagingBuffer(), vulkanMesh.IndexBuffer(), 1, &indexCopyRegion);
 
-		vkEndCommandBuffer(commandBuffer);
-
-		VkSubmitInfo submitInfo { };
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		vkQueueSubmit(mContext->mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-
-		// Wait for the queue to be finished
-		vkQueueWaitIdle(mContext->mGraphicsQueue);
-
-		vkFreeCommandBuffers(mContext->mDevice, mCommandPool, 1, &commandBuffer);
+		return EndOneTimeCommands(commandBuffer);
 	}
 
 	SwapChainSettings VulkanRenderer::GetOptimalSwapChainSettings(const SwapChainSupportDetails& supportDetails) {
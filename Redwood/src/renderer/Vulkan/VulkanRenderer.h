@@ -1,14 +1,63 @@
 #pragma once
 #include "pch.h"
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
 #include "vulkan/vulkan.h"
 #include "core/Core.h"
+#include "core/FileWatcher.h"
+#include "core/JobSystem.h"
 #include "renderer/Renderer.h"
 #include "renderer/Mesh.h"
+#include "renderer/RenderQueue.h"
+#include "renderer/ShaderCache.h"
 #include "VulkanContext.h"
+#include "VulkanBuffer.h"
+#include "VulkanTexture.h"
+#include "VulkanMemoryGovernor.h"
+#include "VulkanMemoryPools.h"
+#include "VulkanTimeline.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanPipelineLayoutCache.h"
+#include "VulkanShaderModuleCache.h"
 
 namespace rwd {
 
-	class VulkanMesh;
+	struct MeshFileView;
+
+	// A draw for the render queue. The handles are compared as the sorted queue is walked,
+	// so only state that differs from the previous draw gets bound.
+	struct VulkanDrawCommand {
+		VkPipeline pipeline = VK_NULL_HANDLE;
+
+		// The pipeline's layout, from PipelineLayout. Needed to bind the descriptor set.
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+
+		// Material bindings at set 0, left bound when null
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+		u32 firstIndex = 0;
+		u32 indexCount = 0;
+		u32 instanceCount = 1;
+	};
+
+	// What a pipeline is built from, kept so it can be rebuilt when its shaders change. Shaders are
+	// Vfs paths, either to SPIR-V (.spv) or to GLSL which is compiled as it's loaded.
+	//
+	// The layout and vertex input are reflected from the shaders. Vertex inputs are read from one
+	// interleaved buffer at binding 0, packed in location order with no padding.
+	struct VulkanPipelineDesc {
+		std::string vertexShader;
+		std::string fragmentShader;
+
+		// Compiled into both stages, each combination is its own permutation (see ShaderPermutation)
+		std::vector<std::string> defines;
+		u64 features = 0;
+	};
 
 	class VulkanRenderer : public Renderer {
 	public:
@@ -20,6 +69,95 @@ namespace rwd {
 		void Clear() override;
 
 		void DrawFrame();
+
+		// Queues a draw for the next frame. Draws are sorted by key before they're recorded, build
+		// the key with MakeSortKey or DrawSortKey. Only call from the thread running DrawFrame.
+		void Draw(u64 sortKey, const VulkanDrawCommand& command);
+
+		// Returns the index of the pipeline, for Pipeline and DrawSortKey
+		u32 CreatePipeline(const VulkanPipelineDesc& desc);
+
+		// Safe from any thread, a hot reload can replace the pipeline between frames
+		VkPipeline Pipeline(u32 index) const;
+
+		// Pipelines whose shaders declare the same bindings and push constants share a layout. A reload
+		// changing what the shaders declare gives the pipeline a new one.
+		VkPipelineLayout PipelineLayout(u32 index) const;
+
+		// For allocating the pipeline's descriptor sets, null if its shaders don't use the set
+		VkDescriptorSetLayout DescriptorSetLayout(u32 index, u32 set) const;
+
+		// Watches the loose shader files of pipelines created with a desc. When one changes the pipelines
+		// using it are rebuilt on the job system, compiling GLSL along the way, and swapped in at the start
+		// of the frame after they're ready. The old pipelines are destroyed once no frame can be using them.
+		void EnableShaderHotReload();
+
+		// Key for the command using the index of one of the renderer's pipelines, the material and mesh
+		// fields come from hashing the handles
+		u64 DrawSortKey(const VulkanDrawCommand& command, u32 pipelineIndex, f32 depth, u32 layer = 0,
+			SortOrder order = SortOrder::FrontToBack) const;
+
+		// Counts from walking the draw queue of the last recorded frame
+		const RenderQueueStats& DrawStats() const;
+
+		// Uploads mesh data through a staging buffer, the data only has to live for the duration of the call
+		VulkanMesh CreateVulkanMesh(Mesh& mesh);
+		VulkanMesh CreateVulkanMesh(const MeshFileView& meshFile);
+		VulkanMesh CreateVulkanMesh(const void* verts, size_t vertsSize, const void* indices, size_t indicesSize, 
+			const std::vector<MeshLod>& lods);
+
+		// Don't block, the resources are freed once the frames in flight are done with them. Frames
+		// already built may still draw with them, so they're only retired once those are submitted too.
+		void DestroyVulkanMesh(VulkanMesh& vulkanMesh);
+		void DestroyVulkanTexture(VulkanTexture& texture);
+
+		// For resources draws reference by handle. retire is called with everything in flight once every
+		// frame that may have been built with the resource is submitted. On the thread drawing frames.
+		void RetireAfterQueuedFrames(std::function<void(const TimelineUsage&)> retire);
+
+		// Samplers are immutable and shared, so identical descriptions return the same sampler
+		VkSampler GetSampler(const SamplerDesc& desc);
+
+		// Records into a throwaway command buffer for uploads. End submits it on the transfer timeline
+		// without waiting, frames wait for it on the GPU. Staging used by the commands should be
+		// retired with the returned point.
+		VkCommandBuffer BeginOneTimeCommands();
+		TimelinePoint EndOneTimeCommands(VkCommandBuffer commandBuffer);
+
+		// Submits to the queue, signalling its next timeline value once the work is done. Resources the
+		// work uses are safe to reuse or free once the returned point is complete.
+		TimelinePoint Submit(QueueType queue, VkCommandBuffer commandBuffer, const std::vector<TimelineWait>& waits = { });
+
+		// The work most recently submitted to the queue
+		TimelinePoint LastSubmission(QueueType queue) const;
+		bool IsComplete(TimelinePoint point);
+		void Wait(TimelinePoint point);
+
+		// Everything submitted so far on every queue, retiring with it is always safe
+		TimelineUsage InFlight() const;
+		VulkanDeletionQueue& DeletionQueue();
+
+		VkQueue Queue(QueueType queue) const;
+		u32 QueueFamily(QueueType queue) const;
+
+		// Compute work (culling, skinning, particles, post processing) for the async compute queue, where it
+		// overlaps graphics. Order it against graphics work with timeline waits. When HasAsyncCompute() is
+		// true the queue families differ, so resources written on one queue and read on the other need
+		// VK_SHARING_MODE_CONCURRENT or a queue family ownership transfer.
+		VkCommandBuffer BeginComputeCommands();
+		TimelinePoint SubmitCompute(VkCommandBuffer commandBuffer, const std::vector<TimelineWait>& waits = { });
+		bool HasAsyncCompute() const;
+
+		// The next frame's graphics submission waits for the point, e.g. on culling results
+		void WaitInFrame(const TimelineWait& wait);
+
+		const Ref<VulkanContext>& Context() const;
+
+		// What the device supports, check these before taking an optional fast path
+		const VulkanCapabilities& Capabilities() const;
+		VmaAllocator Allocator() const;
+		VulkanMemoryGovernor& MemoryGovernor();
+		VulkanMemoryPools& MemoryPools();
 	private:
 		void CreateSwapChain();
 		void CreateSwapChainImageViews();
@@ -28,41 +166,142 @@ namespace rwd {
 		void CreateCommandBuffers();
 		void CreateRenderPass();
 		void CreateSyncObjects();
+		void LoadDynamicRenderingFunctions();
+
+		// A pipeline holds the shader modules it was built from until it's replaced or destroyed
+		struct BuiltPipeline {
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkPipelineLayout layout = VK_NULL_HANDLE;
+			std::vector<u64> modules;
+		};
+
+		BuiltPipeline CreatePipelineForShader(Shader& shader);
+		VkPipeline BuildPipeline(const VkShaderModule (&modules)[2], const VkPipelineShaderStageModuleIdentifierCreateInfoEXT (&identifiers)[2],
+			const ShaderReflection& vertexReflection, VkPipelineLayout layout, VkFormat colorFormat);
 
-		VkPipeline CreatePipelineForShader(Shader& shader);
+		// Null pipeline if a shader fails to load, compile or reflect, with the errors logged. The
+		// format is passed in since a resize can change the swap chain's while a rebuild job runs.
+		BuiltPipeline BuildPipeline(const VulkanPipelineDesc& desc, VkFormat colorFormat);
+
+		// Finds the permutation's SPIR-V in the shader cache, compiling it if the source changed since.
+		// Returns the hash of the SPIR-V.
+		bool ResolveShader(const ShaderPermutation& permutation, u64& hash);
+		VkShaderModule AcquireShaderModule(u64 hash);
+		void ReleaseShaderModules(const std::vector<u64>& modules);
+
+		void OpenShaderCaches();
+		void SaveShaderCaches();
+
+		void UpdateDeferredRetires();
+
+		void WatchShaders(const VulkanPipelineDesc& desc);
+		void UpdateShaderHotReload();
 		void RecordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex);
+		void RecordDrawQueue(VkCommandBuffer commandBuffer);
+
+		// Starts and ends rendering to the swap chain image, through dynamic rendering when the device
+		// supports it and the render pass otherwise
+		void BeginSwapChainRendering(VkCommandBuffer commandBuffer, u32 imageIndex);
+		void EndSwapChainRendering(VkCommandBuffer commandBuffer, u32 imageIndex);
+		void ImageBarrier(VkCommandBuffer commandBuffer, const VkImageMemoryBarrier2KHR& barrier);
 
 		void RecreateSwapChain();
 		void DestroySwapChain();
 
-		void CreateVulkanMesh(Mesh& mesh);
-		void CopyMeshToGpu(VulkanMesh& vulkanMesh);
+		TimelinePoint CopyMeshToGpu(VulkanMesh& vulkanMesh);
 		SwapChainSettings GetOptimalSwapChainSettings(const SwapChainSupportDetails& supportDetails);
 	private:
 		Ref<VulkanContext> mContext;
+
+		// Replaced on the thread drawing frames, but CreatePipeline and DrawMesh can grow them from
+		// any thread, so every read takes the lock
 		std::vector<VkPipeline> mPipelines;
+		std::vector<VkPipelineLayout> mPipelineLayouts;
+		std::vector<std::vector<u64>> mPipelineModules;
+		mutable std::shared_mutex mPipelinesMutex;
+		std::unordered_map<u32, VulkanPipelineDesc> mPipelineDescs;
+
+		struct ReloadedPipeline {
+			u32 index;
+			u32 generation;
+			VkPipeline pipeline;
+			VkPipelineLayout layout;
+			std::vector<u64> modules;
+		};
+
+		Scope<FileWatcher> mShaderWatcher;
+		std::vector<std::string> mChangedShaders;
+		JobCounter mShaderReloadCounter;
+
+		// Bumped as each rebuild starts, so a slower earlier rebuild finishing last doesn't win
+		std::unordered_map<u32, u32> mReloadGenerations;
+		std::mutex mReloadedMutex;
+		std::vector<ReloadedPipeline> mReloadedPipelines;
 
 		VkSwapchainKHR mSwapChain;
-		VkFormat mSwapChainImageFormat;
+		// Written by CreateSwapChain, read by pipelines created from any thread
+		std::atomic<VkFormat> mSwapChainImageFormat;
 		VkExtent2D mSwapChainExtent;
 
 		std::vector<VkSemaphore> mImageAvailableSemaphores;
 		std::vector<VkSemaphore> mRenderFinishedSemaphores;
-		std::vector<VkFence> mInFlightFences;
+
+		// Graphics timeline value each frame slot signalled, waited on before the slot is reused
+		u64 mFrameValues[MAX_FRAMES_IN_FLIGHT] = { };
+		VulkanTimeline mTimelines[(u32)QueueType::Count];
+		std::vector<TimelineWait> mFrameWaits;
 
 		std::vector<VkImage> mSwapChainImages;
 		std::vector<VkImageView> mSwapChainImageViews;
 		std::vector<VkFramebuffer> mSwapChainFramebuffers;
 
 		VkCommandPool mCommandPool;
+		VkCommandPool mComputeCommandPool;
+		QueueFamilyIndices mQueueFamilies;
 		std::vector<VkCommandBuffer> mCommandBuffers;
 
-		VkPipelineLayout mPipelineLayout;
+		VulkanPipelineLayoutCache mLayoutCache;
+		VulkanShaderModuleCache mModuleCache;
+		ShaderCache mShaderCache;
+
+		// The driver's cache of compiled pipelines, kept across runs. Pipelines built from shader
+		// module identifiers can only come from it.
+		VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+		PFN_vkGetShaderModuleIdentifierEXT mGetShaderModuleIdentifier = nullptr;
+
+		// Permutation keys to SPIR-V hashes, so rebuilding skips reading the sources again. Cleared
+		// when a shader file changes.
+		std::mutex mResolvedShadersMutex;
+		std::unordered_map<u64, u64> mResolvedShaders;
+
+		// Only created for the fallback path, with dynamic rendering there are no render pass or framebuffer objects
 		VkRenderPass mRenderPass;
 
+		// Dynamic rendering and synchronization2 are used together, either as Vulkan 1.3 core or the KHR extensions
+		bool mDynamicRendering = false;
+		PFN_vkCmdBeginRenderingKHR mCmdBeginRendering = nullptr;
+		PFN_vkCmdEndRenderingKHR mCmdEndRendering = nullptr;
+		PFN_vkCmdPipelineBarrier2KHR mCmdPipelineBarrier2 = nullptr;
+
 		u32 mCurFrame;
 
+		RenderQueue<VulkanDrawCommand> mDrawQueue;
+		RenderQueueStats mDrawStats;
+
+		VulkanMesh mQuadMesh;
+		std::unordered_map<u64, VkSampler> mSamplers;
+
 		VmaAllocator mAllocator;
+		VulkanMemoryGovernor mMemoryGovernor;
+		VulkanMemoryPools mMemoryPools;
+		VulkanDeletionQueue mDeletionQueue;
+
+		struct DeferredRetire {
+			u32 framesLeft;
+			std::function<void(const TimelineUsage&)> retire;
+		};
+
+		std::vector<DeferredRetire> mDeferredRetires;
 	};
 
 }
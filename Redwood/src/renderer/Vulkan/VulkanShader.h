@@ -11,17 +11,11 @@ namespace rwd {
 		VulkanShader(std::string& vertFile, std::string& fragFile);
 		VulkanShader(std::string&& vertFile, std::string&& fragFile);
 
-		VkShaderModule VertexModule() const;
-		VkShaderModule FragmentModule() const;
-
-		void CreateShaderModules(const VkDevice device);
-		void FreeShaderModules(const VkDevice device);
+		const std::string& VertexFile() const;
+		const std::string& FragmentFile() const;
 	private:
 		std::string mVertexFileString;
 		std::string mFragmentFileString;
-
-		VkShaderModule mVertShaderModule;
-		VkShaderModule mFragShaderModule;
 	};
 
 }
@@ -0,0 +1,69 @@
+#include "pch.h"
+#include "core/Log.h"
+#include "VulkanShaderModuleCache.h"
+
+namespace rwd {
+
+	void VulkanShaderModuleCache::Init(VkDevice device) {
+		mDevice = device;
+	}
+
+	void VulkanShaderModuleCache::Deinit() {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		for (const auto& [hash, cached] : mModules) {
+			vkDestroyShaderModule(mDevice, cached.module, nullptr);
+		}
+
+		mModules.clear();
+	}
+
+	VkShaderModule VulkanShaderModuleCache::Acquire(u64 hash, std::span<const u32> code) {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto existing = mModules.find(hash);
+		if (existing != mModules.end()) {
+			existing->second.refCount++;
+			return existing->second.module;
+		}
+
+		VkShaderModuleCreateInfo createInfo {
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			.codeSize = code.size_bytes(),
+			.pCode = code.data(),
+		};
+
+		VkShaderModule module = VK_NULL_HANDLE;
+		if (code.empty() || vkCreateShaderModule(mDevice, &createInfo, nullptr, &module) != VK_SUCCESS) {
+			return VK_NULL_HANDLE;
+		}
+
+		mModules[hash] = CachedModule { .module = module, .refCount = 1 };
+		return module;
+	}
+
+	void VulkanShaderModuleCache::Release(u64 hash) {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto existing = mModules.find(hash);
+		RWD_ASSERT(existing != mModules.end(), "Released a shader module that was never acquired");
+
+		if (existing != mModules.end() && --existing->second.refCount == 0) {
+			vkDestroyShaderModule(mDevice, existing->second.module, nullptr);
+			mModules.erase(existing);
+		}
+	}
+
+	VkShaderModule VulkanShaderModuleCache::Find(u64 hash) const {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto existing = mModules.find(hash);
+		return existing != mModules.end() ? existing->second.module : VK_NULL_HANDLE;
+	}
+
+	u32 VulkanShaderModuleCache::ModuleCount() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return (u32)mModules.size();
+	}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "pch.h"
+#include <mutex>
+#include <span>
+#include "vulkan/vulkan.h"
+#include "core/Core.h"
+
+namespace rwd {
+
+	// Shader modules shared by the pipelines built from them, keyed by the hash of their SPIR-V.
+	//
+	// Pipelines acquire the modules of their stages as they're built and release them once they're
+	// replaced or destroyed, so a module lives as long as some pipeline using it. Building another
+	// pipeline from the same code, a permutation sharing a stage or a rebuild, reuses the module.
+	// Safe from any thread.
+	class VulkanShaderModuleCache {
+	public:
+		void Init(VkDevice device);
+		void Deinit();
+
+		// Creates the module the first time, null if the code is rejected
+		VkShaderModule Acquire(u64 hash, std::span<const u32> code);
+
+		// Destroyed when the last pipeline using it releases it, pipelines don't need their
+		// modules once they're created
+		void Release(u64 hash);
+
+		// Null if no pipeline holds the module
+		VkShaderModule Find(u64 hash) const;
+
+		u32 ModuleCount() const;
+	private:
+		struct CachedModule {
+			VkShaderModule module;
+			u32 refCount;
+		};
+	private:
+		VkDevice mDevice = VK_NULL_HANDLE;
+		mutable std::mutex mMutex;
+		std::unordered_map<u64, CachedModule> mModules;
+	};
+
+}
@@ -0,0 +1,453 @@
+#include "pch.h"
+#include <algorithm>
+#include "VulkanShaderReflection.h"
+
+namespace rwd {
+
+	const u32 SPIRV_MAGIC = 0x07230203;
+	const u32 SPIRV_HEADER_WORDS = 5;
+
+	// Ids past this are taken as a corrupt header rather than allocated for
+	const u32 SPIRV_MAX_BOUND = 1 << 22;
+
+	const u32 OP_ENTRY_POINT = 15;
+	const u32 OP_TYPE_INT = 21;
+	const u32 OP_TYPE_FLOAT = 22;
+	const u32 OP_TYPE_VECTOR = 23;
+	const u32 OP_TYPE_MATRIX = 24;
+	const u32 OP_TYPE_IMAGE = 25;
+	const u32 OP_TYPE_SAMPLER = 26;
+	const u32 OP_TYPE_SAMPLED_IMAGE = 27;
+	const u32 OP_TYPE_ARRAY = 28;
+	const u32 OP_TYPE_RUNTIME_ARRAY = 29;
+	const u32 OP_TYPE_STRUCT = 30;
+	const u32 OP_TYPE_POINTER = 32;
+	const u32 OP_CONSTANT = 43;
+	const u32 OP_VARIABLE = 59;
+	const u32 OP_DECORATE = 71;
+	const u32 OP_MEMBER_DECORATE = 72;
+	const u32 OP_TYPE_ACCELERATION_STRUCTURE = 5341;
+
+	const u32 DECORATION_BLOCK = 2;
+	const u32 DECORATION_BUFFER_BLOCK = 3;
+	const u32 DECORATION_ROW_MAJOR = 4;
+	const u32 DECORATION_ARRAY_STRIDE = 6;
+	const u32 DECORATION_MATRIX_STRIDE = 7;
+	const u32 DECORATION_BUILT_IN = 11;
+	const u32 DECORATION_LOCATION = 30;
+	const u32 DECORATION_BINDING = 33;
+	const u32 DECORATION_DESCRIPTOR_SET = 34;
+	const u32 DECORATION_OFFSET = 35;
+
+	const u32 STORAGE_UNIFORM_CONSTANT = 0;
+	const u32 STORAGE_INPUT = 1;
+	const u32 STORAGE_UNIFORM = 2;
+	const u32 STORAGE_PUSH_CONSTANT = 9;
+	const u32 STORAGE_STORAGE_BUFFER = 12;
+
+	const u32 IMAGE_DIM_BUFFER = 5;
+	const u32 IMAGE_DIM_SUBPASS_DATA = 6;
+	const u32 IMAGE_SAMPLED_STORAGE = 2;
+
+	const u32 SPIRV_NONE = ~0u;
+
+	struct SpirvMember {
+		u32 offset = 0;
+		u32 matrixStride = 0;
+		bool rowMajor = false;
+	};
+
+	// The instruction declaring an id and the decorations on it
+	struct SpirvId {
+		u32 opcode = 0;
+		u32 word = 0;
+
+		u32 set = SPIRV_NONE;
+		u32 binding = SPIRV_NONE;
+		u32 location = SPIRV_NONE;
+		u32 arrayStride = 0;
+		bool builtIn = false;
+		bool block = false;
+		bool bufferBlock = false;
+
+		std::vector<SpirvMember> members;
+	};
+
+	struct SpirvModule {
+		std::span<const u32> code;
+		std::vector<SpirvId> ids;
+
+		const SpirvId& Id(u32 id) const {
+			static const SpirvId none;
+			return id < ids.size() ? ids[id] : none;
+		}
+
+		// Operands count from the first word after the opcode, missing ones read as 0
+		u32 Operand(const SpirvId& id, u32 index) const {
+			if (id.opcode == 0) {
+				return 0;
+			}
+
+			u32 wordCount = code[id.word] >> 16;
+			return index + 1 < wordCount ? code[id.word + 1 + index] : 0;
+		}
+	};
+
+	static bool ParseModule(std::span<const u32> code, SpirvModule& module, u32& executionModel) {
+		if (code.size() < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC || code[3] > SPIRV_MAX_BOUND) {
+			return false;
+		}
+
+		module.code = code;
+		module.ids.resize(code[3]);
+
+		auto Decorate = [] (SpirvId& id, u32 decoration, u32 value) {
+			switch (decoration) {
+				case DECORATION_BLOCK:          id.block = true; break;
+				case DECORATION_BUFFER_BLOCK:   id.bufferBlock = true; break;
+				case DECORATION_ARRAY_STRIDE:   id.arrayStride = value; break;
+				case DECORATION_BUILT_IN:       id.builtIn = true; break;
+				case DECORATION_LOCATION:       id.location = value; break;
+				case DECORATION_BINDING:        id.binding = value; break;
+				case DECORATION_DESCRIPTOR_SET: id.set = value; break;
+			}
+		};
+
+		for (u32 word = SPIRV_HEADER_WORDS; word < code.size(); ) {
+			u32 opcode = code[word] & 0xFFFF;
+			u32 wordCount = code[word] >> 16;
+			if (wordCount == 0 || word + wordCount > code.size()) {
+				return false;
+			}
+
+			const u32* operands = &code[word + 1];
+
+			switch (opcode) {
+				case OP_ENTRY_POINT:
+					executionModel = operands[0];
+					break;
+
+				case OP_DECORATE:
+					if (wordCount >= 3 && operands[0] < module.ids.size()) {
+						Decorate(module.ids[operands[0]], operands[1], wordCount >= 4 ? operands[2] : 0);
+					}
+					break;
+
+				case OP_MEMBER_DECORATE:
+					if (wordCount >= 4 && operands[0] < module.ids.size()) {
+						std::vector<SpirvMember>& members = module.ids[operands[0]].members;
+						if (members.size() <= operands[1]) {
+							members.resize(operands[1] + 1);
+						}
+
+						SpirvMember& member = members[operands[1]];
+						u32 value = wordCount >= 5 ? operands[3] : 0;
+						switch (operands[2]) {
+							case DECORATION_OFFSET:        member.offset = value; break;
+							case DECORATION_MATRIX_STRIDE: member.matrixStride = value; break;
+							case DECORATION_ROW_MAJOR:     member.rowMajor = true; break;
+						}
+					}
+					break;
+
+				case OP_TYPE_INT:
+				case OP_TYPE_FLOAT:
+				case OP_TYPE_VECTOR:
+				case OP_TYPE_MATRIX:
+				case OP_TYPE_IMAGE:
+				case OP_TYPE_SAMPLER:
+				case OP_TYPE_SAMPLED_IMAGE:
+				case OP_TYPE_ARRAY:
+				case OP_TYPE_RUNTIME_ARRAY:
+				case OP_TYPE_STRUCT:
+				case OP_TYPE_POINTER:
+				case OP_TYPE_ACCELERATION_STRUCTURE:
+					if (wordCount >= 2 && operands[0] < module.ids.size()) {
+						module.ids[operands[0]].opcode = opcode;
+						module.ids[operands[0]].word = word;
+					}
+					break;
+
+				// Constants and variables have their type first
+				case OP_CONSTANT:
+				case OP_VARIABLE:
+					if (wordCount >= 3 && operands[1] < module.ids.size()) {
+						module.ids[operands[1]].opcode = opcode;
+						module.ids[operands[1]].word = word;
+					}
+					break;
+			}
+
+			word += wordCount;
+		}
+
+		return true;
+	}
+
+	static VkShaderStageFlagBits StageFromExecutionModel(u32 executionModel) {
+		switch (executionModel) {
+			case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+			case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+			case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+			case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+			case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+			default: return VK_SHADER_STAGE_ALL;
+		}
+	}
+
+	// Size in bytes as laid out in a block, matrices and arrays take the strides they were decorated with
+	static u32 TypeSize(const SpirvModule& module, u32 typeId, u32 matrixStride = 0, bool rowMajor = false) {
+		const SpirvId& type = module.Id(typeId);
+
+		switch (type.opcode) {
+			case OP_TYPE_INT:
+			case OP_TYPE_FLOAT:
+				return module.Operand(type, 1) / 8;
+
+			case OP_TYPE_VECTOR:
+				return module.Operand(type, 2) * TypeSize(module, module.Operand(type, 1));
+
+			case OP_TYPE_MATRIX: {
+				u32 columns = module.Operand(type, 2);
+				if (matrixStride == 0) {
+					return columns * TypeSize(module, module.Operand(type, 1));
+				}
+
+				u32 rows = module.Operand(module.Id(module.Operand(type, 1)), 2);
+				return (rowMajor ? rows : columns) * matrixStride;
+			}
+
+			case OP_TYPE_ARRAY: {
+				u32 length = module.Operand(module.Id(module.Operand(type, 2)), 2);
+				u32 stride = type.arrayStride != 0 ? type.arrayStride : TypeSize(module, module.Operand(type, 1), matrixStride, rowMajor);
+				return length * stride;
+			}
+
+			case OP_TYPE_STRUCT: {
+				u32 memberCount = ((module.code[type.word] >> 16) - 2);
+				u32 size = 0;
+				for (u32 i = 0; i < memberCount; i++) {
+					SpirvMember member = i < type.members.size() ? type.members[i] : SpirvMember { };
+					size = std::max(size, member.offset + TypeSize(module, module.Operand(type, i + 1), member.matrixStride, member.rowMajor));
+				}
+				return size;
+			}
+
+			default:
+				return 0;
+		}
+	}
+
+	// UNDEFINED for anything but 16, 32 and 64 bit scalars and vectors
+	static VkFormat VertexFormat(const SpirvModule& module, u32 typeId, u32& size) {
+		static const VkFormat sFloatFormats[3][4] = {
+			{ VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT },
+			{ VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+			{ VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT },
+		};
+
+		static const VkFormat sSintFormats[3][4] = {
+			{ VK_FORMAT_R16_SINT, VK_FORMAT_R16G16_SINT, VK_FORMAT_R16G16B16_SINT, VK_FORMAT_R16G16B16A16_SINT },
+			{ VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT },
+			{ VK_FORMAT_R64_SINT, VK_FORMAT_R64G64_SINT, VK_FORMAT_R64G64B64_SINT, VK_FORMAT_R64G64B64A64_SINT },
+		};
+
+		static const VkFormat sUintFormats[3][4] = {
+			{ VK_FORMAT_R16_UINT, VK_FORMAT_R16G16_UINT, VK_FORMAT_R16G16B16_UINT, VK_FORMAT_R16G16B16A16_UINT },
+			{ VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT },
+			{ VK_FORMAT_R64_UINT, VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64A64_UINT },
+		};
+
+		const SpirvId* component = &module.Id(typeId);
+		u32 components = 1;
+		if (component->opcode == OP_TYPE_VECTOR) {
+			components = module.Operand(*component, 2);
+			component = &module.Id(module.Operand(*component, 1));
+		}
+
+		u32 width = module.Operand(*component, 1);
+		u32 widthIndex = width == 16 ? 0 : width == 32 ? 1 : width == 64 ? 2 : 3;
+		if (components < 1 || components > 4 || widthIndex > 2) {
+			return VK_FORMAT_UNDEFINED;
+		}
+
+		size = width / 8 * components;
+
+		if (component->opcode == OP_TYPE_FLOAT) {
+			return sFloatFormats[widthIndex][components - 1];
+		}
+
+		if (component->opcode == OP_TYPE_INT) {
+			bool isSigned = module.Operand(*component, 2) != 0;
+			return isSigned ? sSintFormats[widthIndex][components - 1] : sUintFormats[widthIndex][components - 1];
+		}
+
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	// Arrays take a location per element and matrices one per column
+	static bool AddVertexInputs(const SpirvModule& module, u32 typeId, u32& location, std::vector<ShaderVertexInput>& inputs) {
+		const SpirvId& type = module.Id(typeId);
+
+		if (type.opcode == OP_TYPE_ARRAY || type.opcode == OP_TYPE_MATRIX) {
+			u32 count = type.opcode == OP_TYPE_ARRAY ? module.Operand(module.Id(module.Operand(type, 2)), 2) : module.Operand(type, 2);
+			for (u32 i = 0; i < count; i++) {
+				if (!AddVertexInputs(module, module.Operand(type, 1), location, inputs)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		u32 size = 0;
+		VkFormat format = VertexFormat(module, typeId, size);
+		if (format == VK_FORMAT_UNDEFINED) {
+			return false;
+		}
+
+		inputs.push_back(ShaderVertexInput { .location = location++, .format = format, .size = size });
+		return true;
+	}
+
+	static bool DescriptorType(const SpirvModule& module, u32 storageClass, const SpirvId& type, VkDescriptorType& descriptorType) {
+		switch (storageClass) {
+			case STORAGE_UNIFORM:
+				descriptorType = type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				return true;
+
+			case STORAGE_STORAGE_BUFFER:
+				descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				return true;
+
+			case STORAGE_UNIFORM_CONSTANT:
+				break;
+
+			default:
+				return false;
+		}
+
+		switch (type.opcode) {
+			case OP_TYPE_SAMPLER:
+				descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+				return true;
+
+			case OP_TYPE_SAMPLED_IMAGE:
+				descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				return true;
+
+			case OP_TYPE_ACCELERATION_STRUCTURE:
+				descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+				return true;
+
+			case OP_TYPE_IMAGE: {
+				u32 dim = module.Operand(type, 2);
+				bool storage = module.Operand(type, 6) == IMAGE_SAMPLED_STORAGE;
+
+				if (dim == IMAGE_DIM_BUFFER) {
+					descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				} else if (dim == IMAGE_DIM_SUBPASS_DATA) {
+					descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				} else {
+					descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				}
+				return true;
+			}
+
+			default:
+				return false;
+		}
+	}
+
+	bool ReflectSpirv(std::span<const u32> code, ShaderReflection& reflection) {
+		SpirvModule module;
+		u32 executionModel = SPIRV_NONE;
+		if (!ParseModule(code, module, executionModel)) {
+			return false;
+		}
+
+		reflection = ShaderReflection { };
+		reflection.stage = StageFromExecutionModel(executionModel);
+
+		u32 pushConstantEnd = 0;
+
+		for (const SpirvId& variable : module.ids) {
+			if (variable.opcode != OP_VARIABLE) {
+				continue;
+			}
+
+			u32 storageClass = module.Operand(variable, 2);
+			const SpirvId& pointer = module.Id(module.Operand(variable, 0));
+			const SpirvId* type = &module.Id(module.Operand(pointer, 2));
+
+			if (storageClass == STORAGE_INPUT) {
+				if (reflection.stage != VK_SHADER_STAGE_VERTEX_BIT || variable.builtIn || variable.location == SPIRV_NONE) {
+					continue;
+				}
+
+				u32 location = variable.location;
+				if (!AddVertexInputs(module, module.Operand(pointer, 2), location, reflection.vertexInputs)) {
+					return false;
+				}
+				continue;
+			}
+
+			if (storageClass == STORAGE_PUSH_CONSTANT) {
+				if (type->opcode != OP_TYPE_STRUCT) {
+					continue;
+				}
+
+				u32 offset = SPIRV_NONE;
+				for (const SpirvMember& member : type->members) {
+					offset = std::min(offset, member.offset);
+				}
+
+				reflection.pushConstantOffset = offset != SPIRV_NONE ? offset : 0;
+				pushConstantEnd = TypeSize(module, module.Operand(pointer, 2));
+				continue;
+			}
+
+			if (variable.binding == SPIRV_NONE) {
+				continue;
+			}
+
+			// Runtime sized arrays would need descriptor indexing, which the layouts don't enable
+			u32 count = 1;
+			if (type->opcode == OP_TYPE_ARRAY) {
+				count = module.Operand(module.Id(module.Operand(*type, 2)), 2);
+				type = &module.Id(module.Operand(*type, 1));
+			} else if (type->opcode == OP_TYPE_RUNTIME_ARRAY) {
+				type = &module.Id(module.Operand(*type, 1));
+			}
+
+			VkDescriptorType descriptorType;
+			if (!DescriptorType(module, storageClass, *type, descriptorType)) {
+				continue;
+			}
+
+			reflection.bindings.push_back(ShaderDescriptorBinding {
+				.set = variable.set != SPIRV_NONE ? variable.set : 0,
+				.binding = variable.binding,
+				.type = descriptorType,
+				.count = count,
+				.stages = (VkShaderStageFlags)reflection.stage,
+			});
+		}
+
+		// Push constant ranges have to be a multiple of 4 bytes
+		if (pushConstantEnd > reflection.pushConstantOffset) {
+			reflection.pushConstantSize = (pushConstantEnd - reflection.pushConstantOffset + 3) & ~3u;
+		}
+
+		std::sort(reflection.bindings.begin(), reflection.bindings.end(), [] (const ShaderDescriptorBinding& a, const ShaderDescriptorBinding& b) {
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		});
+
+		std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [] (const ShaderVertexInput& a, const ShaderVertexInput& b) {
+			return a.location < b.location;
+		});
+
+		return true;
+	}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "pch.h"
+#include <span>
+#include "vulkan/vulkan.h"
+#include "core/Core.h"
+
+namespace rwd {
+
+	struct ShaderDescriptorBinding {
+		u32 set;
+		u32 binding;
+		VkDescriptorType type;
+		u32 count;                 // Array size, runtime sized arrays count as 1
+		VkShaderStageFlags stages;
+	};
+
+	struct ShaderVertexInput {
+		u32 location;
+		VkFormat format;
+		u32 size;
+	};
+
+	// What a shader declares, read from its SPIR-V
+	struct ShaderReflection {
+		VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+
+		// Sorted by set, then binding
+		std::vector<ShaderDescriptorBinding> bindings;
+
+		// Bytes of the push constant block its members cover, size 0 without one
+		u32 pushConstantOffset = 0;
+		u32 pushConstantSize = 0;
+
+		// Vertex shaders only, sorted by location and without built-ins. Matrices take a location per column.
+		std::vector<ShaderVertexInput> vertexInputs;
+	};
+
+	// Walks the module's declarations without a full parse, only the entry point, decorations,
+	// types and variables are looked at. False if the code isn't SPIR-V, or it has a vertex
+	// input of a type no vertex format matches.
+	bool ReflectSpirv(std::span<const u32> code, ShaderReflection& reflection);
+
+}
@@ -0,0 +1,423 @@
+#include "pch.h"
+#include <cmath>
+#include "core/Log.h"
+#include "VulkanRenderer.h"
+#include "VulkanTexture.h"
+
+namespace rwd {
+
+	VkFormat ToVkFormat(TextureFormat format) {
+		switch (format) {
+			case(TextureFormat::RGBA8):         return VK_FORMAT_R8G8B8A8_UNORM;
+			case(TextureFormat::RGBA8_SRGB):    return VK_FORMAT_R8G8B8A8_SRGB;
+			case(TextureFormat::BGRA8):         return VK_FORMAT_B8G8R8A8_UNORM;
+			case(TextureFormat::BGRA8_SRGB):    return VK_FORMAT_B8G8R8A8_SRGB;
+			case(TextureFormat::RGBA16F):       return VK_FORMAT_R16G16B16A16_SFLOAT;
+			case(TextureFormat::BC1):           return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+			case(TextureFormat::BC1_SRGB):      return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+			case(TextureFormat::BC2):           return VK_FORMAT_BC2_UNORM_BLOCK;
+			case(TextureFormat::BC2_SRGB):      return VK_FORMAT_BC2_SRGB_BLOCK;
+			case(TextureFormat::BC3):           return VK_FORMAT_BC3_UNORM_BLOCK;
+			case(TextureFormat::BC3_SRGB):      return VK_FORMAT_BC3_SRGB_BLOCK;
+			case(TextureFormat::BC4):           return VK_FORMAT_BC4_UNORM_BLOCK;
+			case(TextureFormat::BC5):           return VK_FORMAT_BC5_UNORM_BLOCK;
+			case(TextureFormat::BC6H):          return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+			case(TextureFormat::BC7):           return VK_FORMAT_BC7_UNORM_BLOCK;
+			case(TextureFormat::BC7_SRGB):      return VK_FORMAT_BC7_SRGB_BLOCK;
+			case(TextureFormat::ASTC_4x4):      return VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+			case(TextureFormat::ASTC_4x4_SRGB): return VK_FORMAT_ASTC_4x4_SRGB_BLOCK;
+			case(TextureFormat::ASTC_6x6):      return VK_FORMAT_ASTC_6x6_UNORM_BLOCK;
+			case(TextureFormat::ASTC_6x6_SRGB): return VK_FORMAT_ASTC_6x6_SRGB_BLOCK;
+			case(TextureFormat::ASTC_8x8):      return VK_FORMAT_ASTC_8x8_UNORM_BLOCK;
+			case(TextureFormat::ASTC_8x8_SRGB): return VK_FORMAT_ASTC_8x8_SRGB_BLOCK;
+			default:                            return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	static void TransitionImage(VkCommandBuffer commandBuffer, VkImage image, u32 baseMip, u32 mipCount,
+		VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+	{
+		VkImageMemoryBarrier barrier {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = srcAccess,
+			.dstAccessMask = dstAccess,
+			.oldLayout = oldLayout,
+			.newLayout = newLayout,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = image,
+			.subresourceRange {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = baseMip,
+				.levelCount = mipCount,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	// Copies mips [firstMip, lastMip) of the texture data into a host visible buffer,
+	// recording a buffer to image copy for each into the image's matching level
+	static bool StageMips(VulkanRenderer& renderer, VkCommandBuffer commandBuffer, const TextureData& data,
+		u32 firstMip, u32 lastMip, u32 imageFirstMip, VkImage image, VkBuffer& stagingBuffer, VmaAllocation& stagingMemory)
+	{
+		size_t stagingSize = 0;
+		for (u32 mip = firstMip; mip < lastMip; mip++) {
+			if (data.mips[mip].data == nullptr) {
+				RWD_LOG_ERROR("Texture mip {0} was not loaded", mip);
+				return false;
+			}
+			stagingSize += data.mips[mip].size;
+		}
+
+		VkBufferCreateInfo bufferInfo {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = stagingSize,
+			.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		};
+
+		// Staging is freed right after the upload, in order, which is what the streaming ring expects
+		if (renderer.MemoryPools().CreateBuffer(MemoryPool::Streaming, bufferInfo, VMA_MEMORY_USAGE_CPU_TO_GPU, stagingBuffer, stagingMemory) != VK_SUCCESS) {
+			renderer.MemoryGovernor().ReportAllocationFailure("texture staging buffer");
+			return false;
+		}
+
+		TrackAllocation(renderer.Allocator(), stagingMemory, MemoryTag::Staging);
+
+		void* mapped;
+		vmaMapMemory(renderer.Allocator(), stagingMemory, &mapped);
+
+		std::vector<VkBufferImageCopy> regions;
+		size_t offset = 0;
+
+		for (u32 mip = firstMip; mip < lastMip; mip++) {
+			const TextureMip& textureMip = data.mips[mip];
+			memcpy((u8*)mapped + offset, textureMip.data, textureMip.size);
+
+			regions.push_back(VkBufferImageCopy {
+				.bufferOffset = offset,
+				.bufferRowLength = 0, // Tightly packed
+				.bufferImageHeight = 0,
+				.imageSubresource {
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = mip - imageFirstMip,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+				.imageOffset = { 0, 0, 0 },
+				.imageExtent = { textureMip.width, textureMip.height, 1 },
+			});
+
+			offset += textureMip.size;
+		}
+
+		vmaUnmapMemory(renderer.Allocator(), stagingMemory);
+
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (u32)regions.size(), regions.data());
+		return true;
+	}
+
+	bool VulkanTexture::Create(VulkanRenderer& renderer, const TextureData& data) {
+		mTextureFormat = data.format;
+		mFormat = ToVkFormat(data.format);
+		mWidth = data.width;
+		mHeight = data.height;
+		mMipCount = data.mipCount;
+		mFirstResidentMip = data.firstMip;
+
+		const TextureFormatInfo& info = GetTextureFormatInfo(data.format);
+
+		// BC is only guaranteed on desktop and ASTC on mobile, we don't transcode so the asset has to match the GPU
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(renderer.Context()->mPhysicalDevice, mFormat, &formatProperties);
+
+		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+			RWD_LOG_ERROR("This GPU can't sample {0} textures", info.name);
+			return false;
+		}
+
+		const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+		bool generateMips = false;
+		if (data.generateMips) {
+			if (!info.compressed && (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures) {
+				generateMips = true;
+				mMipCount = std::min(TEXTURE_MAX_MIPS, (u32)std::floor(std::log2(std::max(mWidth, mHeight))) + 1);
+			} else {
+				RWD_LOG_WARN("Can't generate mips for {0} textures on the GPU, they should be built offline", info.name);
+			}
+		}
+
+		if (!AllocateImage(renderer, mFirstResidentMip, mImage, mAllocation, mView)) {
+			return false;
+		}
+
+		VkCommandBuffer commandBuffer = renderer.BeginOneTimeCommands();
+
+		const u32 residentCount = mMipCount - mFirstResidentMip;
+		TransitionImage(commandBuffer, mImage, 0, residentCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;
+		VmaAllocation stagingMemory = VK_NULL_HANDLE;
+		bool staged = StageMips(renderer, commandBuffer, data, data.firstMip, data.mipCount, mFirstResidentMip, mImage, stagingBuffer, stagingMemory);
+
+		if (generateMips) {
+			// Each level is blitted down from the one above it, so the source level
+			// has to finish being written and move to a transfer source layout first
+			for (u32 level = 1; level < residentCount; level++) {
+				TransitionImage(commandBuffer, mImage, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+				VkImageBlit blit {
+					.srcSubresource { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 },
+					.srcOffsets { { 0, 0, 0 }, { (i32)TextureMipDimension(mWidth, level - 1), (i32)TextureMipDimension(mHeight, level - 1), 1 } },
+					.dstSubresource { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 },
+					.dstOffsets { { 0, 0, 0 }, { (i32)TextureMipDimension(mWidth, level), (i32)TextureMipDimension(mHeight, level), 1 } },
+				};
+
+				vkCmdBlitImage(commandBuffer, mImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1, &blit, VK_FILTER_LINEAR);
+			}
+
+			// Every level but the last is now a transfer source
+			TransitionImage(commandBuffer, mImage, 0, residentCount - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			TransitionImage(commandBuffer, mImage, residentCount - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		} else {
+			TransitionImage(commandBuffer, mImage, 0, residentCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+
+		TimelinePoint upload = renderer.EndOneTimeCommands(commandBuffer);
+
+		if (stagingBuffer != VK_NULL_HANDLE) {
+			renderer.DeletionQueue().RetireBuffer(upload, stagingBuffer, stagingMemory);
+		}
+
+		if (!staged) {
+			Retire(renderer.DeletionQueue(), upload);
+			return false;
+		}
+
+		VmaAllocationInfo allocationInfo;
+		vmaGetAllocationInfo(renderer.Allocator(), mAllocation, &allocationInfo);
+		mMemorySize = allocationInfo.size;
+
+		return true;
+	}
+
+	bool VulkanTexture::SetFirstResidentMip(VulkanRenderer& renderer, u32 firstMip, const TextureData* data) {
+		RWD_ASSERT(firstMip < mMipCount, "Resident mip {0} is out of range", firstMip);
+
+		if (firstMip == mFirstResidentMip) {
+			return true;
+		}
+
+		const u32 oldFirstMip = mFirstResidentMip;
+		const bool promoting = firstMip < oldFirstMip;
+
+		if (promoting && (data == nullptr || data->format != mTextureFormat || data->firstMip > firstMip)) {
+			RWD_LOG_ERROR("Texture data is missing the mips being streamed in");
+			return false;
+		}
+
+		VkImage image;
+		VmaAllocation allocation;
+		VkImageView view;
+		if (!AllocateImage(renderer, firstMip, image, allocation, view)) {
+			return false;
+		}
+
+		VkCommandBuffer commandBuffer = renderer.BeginOneTimeCommands();
+
+		TransitionImage(commandBuffer, image, 0, mMipCount - firstMip, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		TransitionImage(commandBuffer, mImage, 0, mMipCount - oldFirstMip, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+		// The mips both images hold never leave the GPU
+		std::vector<VkImageCopy> copies;
+		for (u32 mip = std::max(firstMip, oldFirstMip); mip < mMipCount; mip++) {
+			copies.push_back(VkImageCopy {
+				.srcSubresource { VK_IMAGE_ASPECT_COLOR_BIT, mip - oldFirstMip, 0, 1 },
+				.srcOffset = { 0, 0, 0 },
+				.dstSubresource { VK_IMAGE_ASPECT_COLOR_BIT, mip - firstMip, 0, 1 },
+				.dstOffset = { 0, 0, 0 },
+				.extent = { TextureMipDimension(mWidth, mip), TextureMipDimension(mHeight, mip), 1 },
+			});
+		}
+
+		vkCmdCopyImage(commandBuffer, mImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			(u32)copies.size(), copies.data());
+
+		// Frames already queued still sample the old image, so it goes back to the layout they expect
+		TransitionImage(commandBuffer, mImage, 0, mMipCount - oldFirstMip, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;
+		VmaAllocation stagingMemory = VK_NULL_HANDLE;
+		bool staged = !promoting || StageMips(renderer, commandBuffer, *data, firstMip, oldFirstMip, firstMip, image, stagingBuffer, stagingMemory);
+
+		TransitionImage(commandBuffer, image, 0, mMipCount - firstMip, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		TimelinePoint upload = renderer.EndOneTimeCommands(commandBuffer);
+
+		if (stagingBuffer != VK_NULL_HANDLE) {
+			renderer.DeletionQueue().RetireBuffer(upload, stagingBuffer, stagingMemory);
+		}
+
+		if (!staged) {
+			renderer.DeletionQueue().RetireImageView(upload, view);
+			renderer.DeletionQueue().RetireImage(upload, image, allocation);
+			return false;
+		}
+
+		// Queued frames may still sample the old image and the upload copies from it,
+		// so it's retired once they're submitted instead of waiting on the GPU
+		renderer.DestroyVulkanTexture(*this);
+		mImage = image;
+		mAllocation = allocation;
+		mView = view;
+		mFirstResidentMip = firstMip;
+
+		VmaAllocationInfo allocationInfo;
+		vmaGetAllocationInfo(renderer.Allocator(), mAllocation, &allocationInfo);
+		mMemorySize = allocationInfo.size;
+
+		return true;
+	}
+
+	bool VulkanTexture::AllocateImage(VulkanRenderer& renderer, u32 firstMip, VkImage& image, VmaAllocation& allocation, VkImageView& view) {
+		VkImageCreateInfo imageInfo {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = mFormat,
+			.extent = { TextureMipDimension(mWidth, firstMip), TextureMipDimension(mHeight, firstMip), 1 },
+			.mipLevels = mMipCount - firstMip,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+
+			// Transfer source so the image can be blitted for mip generation and copied from when streaming
+			.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		};
+
+		VkResult result = renderer.MemoryPools().CreateImage(MemoryPool::Textures, imageInfo, image, allocation);
+
+		if (result != VK_SUCCESS) {
+			RWD_LOG_ERROR("Failed to allocate a {0}x{1} texture", imageInfo.extent.width, imageInfo.extent.height);
+			renderer.MemoryGovernor().ReportAllocationFailure("texture image");
+			return false;
+		}
+
+		TrackAllocation(renderer.Allocator(), allocation, MemoryTag::Textures);
+
+		VkImageViewCreateInfo viewInfo {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = mFormat,
+			.components = {
+				VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+				VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+			},
+			.subresourceRange {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = imageInfo.mipLevels,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+		};
+
+		result = vkCreateImageView(renderer.Context()->mDevice, &viewInfo, nullptr, &view);
+		RWD_ASSERT(result == VK_SUCCESS, "Failed to create a texture image view");
+
+		return true;
+	}
+
+	void VulkanTexture::Free(VkDevice device, VmaAllocator allocator) {
+		if (mView != VK_NULL_HANDLE) {
+			vkDestroyImageView(device, mView, nullptr);
+		}
+
+		if (mImage != VK_NULL_HANDLE) {
+			UntrackAllocation(allocator, mAllocation);
+			vmaDestroyImage(allocator, mImage, mAllocation);
+		}
+
+		mView = VK_NULL_HANDLE;
+		mImage = VK_NULL_HANDLE;
+		mAllocation = VK_NULL_HANDLE;
+		mMemorySize = 0;
+	}
+
+	void VulkanTexture::Retire(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage) {
+		if (mView != VK_NULL_HANDLE) {
+			deletionQueue.RetireImageView(usage, mView);
+		}
+
+		if (mImage != VK_NULL_HANDLE) {
+			deletionQueue.RetireImage(usage, mImage, mAllocation);
+		}
+
+		mView = VK_NULL_HANDLE;
+		mImage = VK_NULL_HANDLE;
+		mAllocation = VK_NULL_HANDLE;
+		mMemorySize = 0;
+	}
+
+	void VulkanTexture::Release() {
+		mView = VK_NULL_HANDLE;
+		mImage = VK_NULL_HANDLE;
+		mAllocation = VK_NULL_HANDLE;
+		mMemorySize = 0;
+	}
+
+	VkImage VulkanTexture::Image() const {
+		return mImage;
+	}
+
+	VkImageView VulkanTexture::View() const {
+		return mView;
+	}
+
+	VkFormat VulkanTexture::Format() const {
+		return mFormat;
+	}
+
+	TextureFormat VulkanTexture::SourceFormat() const {
+		return mTextureFormat;
+	}
+
+	u32 VulkanTexture::Width() const {
+		return mWidth;
+	}
+
+	u32 VulkanTexture::Height() const {
+		return mHeight;
+	}
+
+	u32 VulkanTexture::MipCount() const {
+		return mMipCount;
+	}
+
+	u32 VulkanTexture::FirstResidentMip() const {
+		return mFirstResidentMip;
+	}
+
+	size_t VulkanTexture::MemorySize() const {
+		return mMemorySize;
+	}
+
+}
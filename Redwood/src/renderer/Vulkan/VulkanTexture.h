@@ -0,0 +1,80 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "core/Core.h"
+#include "renderer/TextureFile.h"
+
+namespace rwd {
+
+	class VulkanRenderer;
+	class VulkanDeletionQueue;
+	struct TimelineUsage;
+
+	VkFormat ToVkFormat(TextureFormat format);
+
+	struct SamplerDesc {
+		VkFilter filter = VK_FILTER_LINEAR;
+		VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		f32 mipLodBias = 0.0f;
+
+		// Clamped to what the device supports, 1 disables anisotropic filtering
+		f32 maxAnisotropy = 16.0f;
+	};
+
+	// A sampled 2D image which may only hold the smaller part of its mip chain.
+	//
+	// Streaming works by reallocating: the image always holds mips [FirstResidentMip(), MipCount()),
+	// so the resident mips are what it costs in memory. Changing the first resident mip creates a
+	// new image, copies the mips both share on the GPU and uploads the rest. The image and view
+	// change when that happens, so descriptors should be written from Image() / View() each frame.
+	class VulkanTexture {
+	public:
+		// Uploads mips [data.firstMip, data.mipCount). If the file asks for generated mips
+		// and the format supports blitting, the rest of the chain is built on the GPU.
+		bool Create(VulkanRenderer& renderer, const TextureData& data);
+
+		// Mips not currently resident are uploaded from data, which has to contain them
+		bool SetFirstResidentMip(VulkanRenderer& renderer, u32 firstMip, const TextureData* data);
+
+		void Free(VkDevice device, VmaAllocator allocator);
+
+		// Hands the image to the deletion queue, freed once the GPU has passed usage
+		void Retire(VulkanDeletionQueue& deletionQueue, const TimelineUsage& usage);
+
+		// Lets go of the image without freeing it, for when a copy of the texture retires it later
+		void Release();
+
+		VkImage Image() const;
+		VkImageView View() const;
+		VkFormat Format() const;
+
+		// Format of the file the texture was loaded from
+		TextureFormat SourceFormat() const;
+
+		// Size of mip 0, even if it isn't resident
+		u32 Width() const;
+		u32 Height() const;
+
+		u32 MipCount() const;
+		u32 FirstResidentMip() const;
+
+		// Bytes of device memory held by the resident mips
+		size_t MemorySize() const;
+	private:
+		bool AllocateImage(VulkanRenderer& renderer, u32 firstMip, VkImage& image, VmaAllocation& allocation, VkImageView& view);
+	private:
+		VkImage mImage = VK_NULL_HANDLE;
+		VmaAllocation mAllocation = VK_NULL_HANDLE;
+		VkImageView mView = VK_NULL_HANDLE;
+
+		TextureFormat mTextureFormat = TextureFormat::Unknown;
+		VkFormat mFormat = VK_FORMAT_UNDEFINED;
+		u32 mWidth = 0;
+		u32 mHeight = 0;
+		u32 mMipCount = 0;
+		u32 mFirstResidentMip = 0;
+		size_t mMemorySize = 0;
+	};
+
+}
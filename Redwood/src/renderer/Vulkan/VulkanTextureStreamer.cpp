@@ -0,0 +1,285 @@
+#include "pch.h"
+#include <cmath>
+#include <thread>
+#include "core/Log.h"
+#include "core/JobSystem.h"
+#include "core/Vfs.h"
+#include "renderer/TextureFile.h"
+#include "VulkanRenderer.h"
+#include "VulkanAssetLoaders.h"
+#include "VulkanTextureStreamer.h"
+
+namespace rwd {
+
+	VulkanTextureStreamer::VulkanTextureStreamer(VulkanRenderer* renderer, size_t memoryBudget)
+		: mRenderer(renderer), mMemoryBudget(memoryBudget), mJobs(MakeScope<JobCounter>()) { }
+
+	VulkanTextureStreamer::~VulkanTextureStreamer() {
+		// Reads in flight call back into the streamer, so wait them out
+		while (mReadsInFlight.load() > 0) {
+			JobSystem::Wait(*mJobs);
+			std::this_thread::yield();
+		}
+	}
+
+	void VulkanTextureStreamer::Register(TextureAsset& texture) {
+		u32 id = mNextId++;
+		texture.mStreamingId = id;
+
+		mTextures[id] = StreamedTexture {
+			.texture = &texture,
+			.tailMip = texture.mTexture.FirstResidentMip(),
+			.desiredMip = texture.mTexture.FirstResidentMip(),
+			.lastRequestFrame = mFrame,
+			.reading = false,
+		};
+
+		mMemoryUsed += texture.mTexture.MemorySize();
+	}
+
+	void VulkanTextureStreamer::Unregister(TextureAsset& texture) {
+		auto streamed = mTextures.find(texture.mStreamingId);
+		if (streamed == mTextures.end()) {
+			return;
+		}
+
+		// A read in flight for it gets dropped when it lands, since the id no longer resolves
+		mMemoryUsed -= texture.mTexture.MemorySize();
+		mTextures.erase(streamed);
+		texture.mStreamingId = 0;
+	}
+
+	void VulkanTextureStreamer::Update() {
+		mFrame++;
+
+		UploadCompletedReads();
+		UpdateDesiredMips();
+		Rebalance();
+	}
+
+	void VulkanTextureStreamer::UploadCompletedReads() {
+		std::vector<CompletedRead> completed;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			completed.swap(mCompletedReads);
+		}
+
+		for (CompletedRead& read : completed) {
+			mMemoryReserved -= read.reserved;
+
+			auto streamed = mTextures.find(read.id);
+			if (streamed == mTextures.end()) {
+				continue;
+			}
+
+			StreamedTexture& texture = streamed->second;
+			texture.reading = false;
+
+			if (!read.success) {
+				continue;
+			}
+
+			VulkanTexture& vulkanTexture = texture.texture->mTexture;
+			size_t previousSize = vulkanTexture.MemorySize();
+			u32 previousMip = vulkanTexture.FirstResidentMip();
+
+			if (vulkanTexture.SetFirstResidentMip(*mRenderer, read.targetMip, read.data.get())) {
+				mMemoryUsed += vulkanTexture.MemorySize() - previousSize;
+				mStats.bytesStreamedIn += MipChainSize(texture, read.targetMip) - MipChainSize(texture, previousMip);
+				mStats.promotionCount++;
+			}
+		}
+	}
+
+	void VulkanTextureStreamer::UpdateDesiredMips() {
+		for (auto& [id, streamed] : mTextures) {
+			u32 requested = streamed.texture->mRequestedMip.exchange(UINT32_MAX);
+
+			if (requested != UINT32_MAX) {
+				streamed.desiredMip = std::min(requested + mMipBias, streamed.tailMip);
+				streamed.lastRequestFrame = mFrame;
+			} else if (mFrame - streamed.lastRequestFrame > TEXTURE_STREAMING_IDLE_FRAMES) {
+				streamed.desiredMip = streamed.tailMip;
+			}
+		}
+	}
+
+	void VulkanTextureStreamer::Rebalance() {
+		std::vector<std::pair<u32, StreamedTexture*>> promotions;
+		std::vector<StreamedTexture*> demotions;
+
+		for (auto& [id, streamed] : mTextures) {
+			if (streamed.reading) {
+				continue;
+			}
+
+			u32 resident = streamed.texture->mTexture.FirstResidentMip();
+			if (streamed.desiredMip < resident) {
+				promotions.push_back({ id, &streamed });
+			} else if (streamed.desiredMip > resident) {
+				demotions.push_back(&streamed);
+			}
+		}
+
+		// Textures missing the most mips are the blurriest on screen, so they go first
+		std::sort(promotions.begin(), promotions.end(), [] (const auto& lhs, const auto& rhs) {
+			u32 lhsMissing = lhs.second->texture->mTexture.FirstResidentMip() - lhs.second->desiredMip;
+			u32 rhsMissing = rhs.second->texture->mTexture.FirstResidentMip() - rhs.second->desiredMip;
+			return lhsMissing > rhsMissing;
+		});
+
+		// Give back memory from whatever has gone the longest without being asked for
+		std::sort(demotions.begin(), demotions.end(), [] (const StreamedTexture* lhs, const StreamedTexture* rhs) {
+			return lhs->lastRequestFrame < rhs->lastRequestFrame;
+		});
+
+		auto demotion = demotions.begin();
+
+		for (auto& [id, streamed] : promotions) {
+			if (mReadsInFlight.load() >= TEXTURE_STREAMING_MAX_READS) {
+				break;
+			}
+
+			u32 resident = streamed->texture->mTexture.FirstResidentMip();
+			size_t cost = MipChainSize(*streamed, streamed->desiredMip) - MipChainSize(*streamed, resident);
+
+			while (mMemoryUsed + mMemoryReserved + cost > mMemoryBudget && demotion != demotions.end()) {
+				Demote(**demotion, (*demotion)->desiredMip);
+				demotion++;
+			}
+
+			// Still doesn't fit, a cheaper promotion further down the list might
+			if (mMemoryUsed + mMemoryReserved + cost > mMemoryBudget) {
+				continue;
+			}
+
+			RequestMips(id, *streamed, streamed->desiredMip);
+		}
+
+		// The budget may have been lowered under us
+		while (mMemoryUsed > mMemoryBudget && demotion != demotions.end()) {
+			Demote(**demotion, (*demotion)->desiredMip);
+			demotion++;
+		}
+	}
+
+	void VulkanTextureStreamer::Demote(StreamedTexture& streamed, u32 mip) {
+		VulkanTexture& texture = streamed.texture->mTexture;
+		size_t previousSize = texture.MemorySize();
+
+		// Dropping mips never needs the file, the mips that stay are copied on the GPU
+		if (texture.SetFirstResidentMip(*mRenderer, mip, nullptr)) {
+			mMemoryUsed -= previousSize - texture.MemorySize();
+			mStats.demotionCount++;
+		}
+	}
+
+	void VulkanTextureStreamer::RequestMips(u32 id, StreamedTexture& streamed, u32 mip) {
+		const VulkanTexture& texture = streamed.texture->mTexture;
+		const u32 maxSize = TextureMipDimension(std::max(texture.Width(), texture.Height()), mip);
+		const size_t reserved = MipChainSize(streamed, mip) - MipChainSize(streamed, texture.FirstResidentMip());
+
+		streamed.reading = true;
+		mMemoryReserved += reserved;
+		mReadsInFlight++;
+
+		// The whole file is read again, the high mips make up almost all of it anyway.
+		// Only the mips from the target down are decompressed though.
+		Vfs::ReadFile(streamed.texture->mPath, [this, id, mip, maxSize, reserved] (ReadResult&& result) {
+			Ref<ReadResult> file = MakeRef<ReadResult>(std::move(result));
+
+			JobSystem::Execute(*mJobs, [this, id, mip, maxSize, reserved, file] {
+				Ref<TextureData> data = MakeRef<TextureData>();
+				bool success = file->success && TextureFile::Read(file->buffer.Data(), file->buffer.Size(), *data, maxSize)
+					&& data->firstMip <= mip;
+
+				if (!success) {
+					RWD_LOG_ERROR("Failed to stream in mips of {0}", file->filepath);
+				}
+
+				std::lock_guard<std::mutex> lock(mMutex);
+				mCompletedReads.push_back(CompletedRead {
+					.id = id,
+					.targetMip = mip,
+					.reserved = reserved,
+					.file = file,
+					.data = data,
+					.success = success,
+				});
+
+				mReadsInFlight--;
+			});
+		});
+	}
+
+	size_t VulkanTextureStreamer::MipChainSize(const StreamedTexture& streamed, u32 firstMip) const {
+		const VulkanTexture& texture = streamed.texture->mTexture;
+		return TextureMipChainSize(texture.SourceFormat(), texture.Width(), texture.Height(), firstMip, texture.MipCount());
+	}
+
+	void VulkanTextureStreamer::SetMemoryBudget(size_t bytes) {
+		mMemoryBudget = bytes;
+	}
+
+	void VulkanTextureStreamer::SetMipBias(u32 bias) {
+		mMipBias = bias;
+	}
+
+	size_t VulkanTextureStreamer::Trim(size_t bytes) {
+		std::vector<StreamedTexture*> candidates;
+		for (auto& [id, streamed] : mTextures) {
+			if (!streamed.reading && streamed.texture->mTexture.FirstResidentMip() < streamed.tailMip) {
+				candidates.push_back(&streamed);
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [] (const StreamedTexture* lhs, const StreamedTexture* rhs) {
+			return lhs->lastRequestFrame < rhs->lastRequestFrame;
+		});
+
+		const size_t previousUsed = mMemoryUsed;
+		for (StreamedTexture* streamed : candidates) {
+			if (previousUsed - mMemoryUsed >= bytes) {
+				break;
+			}
+
+			// Stays at the tail until it's asked for again
+			streamed->desiredMip = streamed->tailMip;
+			Demote(*streamed, streamed->tailMip);
+		}
+
+		return previousUsed - mMemoryUsed;
+	}
+
+	TextureStreamingStats VulkanTextureStreamer::Stats() {
+		TextureStreamingStats stats = mStats;
+		stats.textureCount = (u32)mTextures.size();
+		stats.readsInFlight = mReadsInFlight.load();
+		stats.memoryUsed = mMemoryUsed;
+		stats.memoryBudget = mMemoryBudget;
+		return stats;
+	}
+
+	//-------------------------------------------------------------------------
+	//
+	// Texture Asset
+	//
+	//-------------------------------------------------------------------------
+
+	void TextureAsset::RequestScreenSize(f32 screenSize) {
+		const u32 size = std::max(mTexture.Width(), mTexture.Height());
+		if (size == 0 || mTexture.MipCount() == 0) {
+			return;
+		}
+
+		// Mip n is size / 2^n texels across, the one that matches the screen is log2(size / screenSize)
+		f32 ratio = (f32)size / std::max(screenSize, 1.0f);
+		u32 mip = ratio <= 1.0f ? 0 : (u32)std::floor(std::log2(ratio));
+		mip = std::min(mip, mTexture.MipCount() - 1);
+
+		// Keep the smallest mip anyone asked for
+		u32 current = mRequestedMip.load(std::memory_order_relaxed);
+		while (mip < current && !mRequestedMip.compare_exchange_weak(current, mip, std::memory_order_relaxed)) { }
+	}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "pch.h"
+#include <mutex>
+#include <atomic>
+#include "core/Core.h"
+
+namespace rwd {
+
+	class VulkanRenderer;
+	class TextureAsset;
+	class JobCounter;
+	struct TextureData;
+	struct ReadResult;
+
+	// Textures load with their mips up to this size resident, the streamer brings in anything larger
+	const u32 TEXTURE_STREAMING_TAIL_SIZE = 128;
+
+	// Frames without any screen size feedback before a texture's extra mips become eviction candidates
+	const u64 TEXTURE_STREAMING_IDLE_FRAMES = 120;
+
+	// Upper bound on file reads in flight, so streaming can't starve other I/O
+	const u32 TEXTURE_STREAMING_MAX_READS = 8;
+
+	struct TextureStreamingStats {
+		u32 textureCount = 0;
+		u32 readsInFlight = 0;
+		size_t memoryUsed = 0;
+		size_t memoryBudget = 0;
+		u64 bytesStreamedIn = 0;
+		u32 promotionCount = 0;
+		u32 demotionCount = 0;
+	};
+
+	// Streams the high resolution mips of textures in and out under a fixed memory budget.
+	//
+	// Each frame every registered texture's screen size feedback (TextureAsset::RequestScreenSize) is
+	// turned into the mip it actually needs. Textures short of that mip are promoted, most mips missing
+	// first, by re-reading the file and uploading only the missing mips. When a promotion doesn't fit in
+	// the budget, textures holding more mips than they need give them up, least recently requested first.
+	class VulkanTextureStreamer {
+	public:
+		VulkanTextureStreamer(VulkanRenderer* renderer, size_t memoryBudget = 256ull * 1024 * 1024);
+		~VulkanTextureStreamer();
+
+		// Called by the texture loader once a texture is uploaded and before it's unloaded
+		void Register(TextureAsset& texture);
+		void Unregister(TextureAsset& texture);
+
+		// Call once per frame on the render thread
+		void Update();
+
+		void SetMemoryBudget(size_t bytes);
+
+		// Added to every requested mip, so a bias of 1 streams textures at half resolution
+		void SetMipBias(u32 bias);
+
+		// Drops textures back to their tail, least recently requested first, until at least bytes
+		// are freed. Returns the bytes actually freed.
+		size_t Trim(size_t bytes);
+
+		TextureStreamingStats Stats();
+	private:
+		struct StreamedTexture {
+			TextureAsset* texture;
+			u32 tailMip;      // Never streamed out past this
+			u32 desiredMip;
+			u64 lastRequestFrame;
+			bool reading;
+		};
+
+		struct CompletedRead {
+			u32 id;
+			u32 targetMip;
+			size_t reserved;
+			Ref<ReadResult> file;
+			Ref<TextureData> data;
+			bool success;
+		};
+
+		void UploadCompletedReads();
+		void UpdateDesiredMips();
+		void Rebalance();
+		void Demote(StreamedTexture& streamed, u32 mip);
+		void RequestMips(u32 id, StreamedTexture& streamed, u32 mip);
+		size_t MipChainSize(const StreamedTexture& streamed, u32 firstMip) const;
+	private:
+		VulkanRenderer* mRenderer;
+
+		std::unordered_map<u32, StreamedTexture> mTextures;
+		u32 mNextId = 1;
+		u64 mFrame = 0;
+
+		size_t mMemoryBudget;
+		size_t mMemoryUsed = 0;
+		u32 mMipBias = 0;
+
+		// Memory the reads in flight will need once they land
+		size_t mMemoryReserved = 0;
+
+		TextureStreamingStats mStats;
+
+		std::mutex mMutex;
+		std::vector<CompletedRead> mCompletedReads;
+
+		Scope<JobCounter> mJobs;
+		std::atomic<u32> mReadsInFlight = 0;
+	};
+
+}
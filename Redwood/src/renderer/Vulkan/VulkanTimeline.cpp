@@ -0,0 +1,88 @@
+#include "pch.h"
+#include "core/Log.h"
+#include "VulkanTimeline.h"
+
+namespace rwd {
+
+	const char* QueueTypeName(QueueType queue) {
+		switch (queue) {
+			case(QueueType::Graphics): return "Graphics";
+			case(QueueType::Compute):  return "Compute";
+			case(QueueType::Transfer): return "Transfer";
+			default:                   return "Unknown";
+		}
+	}
+
+	void VulkanTimeline::Init(VkDevice device) {
+		mDevice = device;
+
+		VkSemaphoreTypeCreateInfo typeInfo {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+			.initialValue = 0,
+		};
+
+		VkSemaphoreCreateInfo semaphoreInfo {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = &typeInfo,
+		};
+
+		VkResult result = vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mSemaphore);
+		RWD_ASSERT(result == VK_SUCCESS, "Failed to create a timeline semaphore");
+
+		mSubmitted = 0;
+		mCompleted = 0;
+	}
+
+	void VulkanTimeline::Free(VkDevice device) {
+		if (mSemaphore != VK_NULL_HANDLE) {
+			vkDestroySemaphore(device, mSemaphore, nullptr);
+			mSemaphore = VK_NULL_HANDLE;
+		}
+	}
+
+	u64 VulkanTimeline::Advance() {
+		return ++mSubmitted;
+	}
+
+	u64 VulkanTimeline::LastSubmitted() const {
+		return mSubmitted;
+	}
+
+	u64 VulkanTimeline::Completed() {
+		vkGetSemaphoreCounterValue(mDevice, mSemaphore, &mCompleted);
+		return mCompleted;
+	}
+
+	bool VulkanTimeline::IsComplete(u64 value) {
+		// Most checks are for values the cached counter already covers, which saves a driver call
+		if (value <= mCompleted) {
+			return true;
+		}
+
+		return Completed() >= value;
+	}
+
+	void VulkanTimeline::Wait(u64 value) {
+		if (IsComplete(value)) {
+			return;
+		}
+
+		RWD_ASSERT(value <= mSubmitted, "Waiting on timeline value {0} which was never submitted", value);
+
+		VkSemaphoreWaitInfo waitInfo {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+			.semaphoreCount = 1,
+			.pSemaphores = &mSemaphore,
+			.pValues = &value,
+		};
+
+		vkWaitSemaphores(mDevice, &waitInfo, UINT64_MAX);
+		mCompleted = std::max(mCompleted, value);
+	}
+
+	VkSemaphore VulkanTimeline::Semaphore() const {
+		return mSemaphore;
+	}
+
+}
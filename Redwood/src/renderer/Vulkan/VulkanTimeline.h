@@ -0,0 +1,74 @@
+#pragma once
+#include "pch.h"
+#include "vulkan/vulkan.h"
+#include "core/Core.h"
+
+namespace rwd {
+
+	enum class QueueType : u32 {
+		Graphics,
+		Compute,
+		Transfer,
+		Count,
+	};
+
+	const char* QueueTypeName(QueueType queue);
+
+	// A point on a queue's timeline. Everything submitted to the queue up to and including
+	// the submission that signalled value has finished once the timeline reaches it.
+	struct TimelinePoint {
+		QueueType queue = QueueType::Graphics;
+		u64 value = 0;
+	};
+
+	// Latest use of a resource on every queue, the resource is idle once the GPU has passed all of them
+	struct TimelineUsage {
+		u64 values[(u32)QueueType::Count] = { };
+
+		TimelineUsage() = default;
+		TimelineUsage(TimelinePoint point) { Add(point); }
+
+		void Add(TimelinePoint point) {
+			u64& value = values[(u32)point.queue];
+			value = std::max(value, point.value);
+		}
+	};
+
+	struct TimelineWait {
+		TimelinePoint point;
+		VkPipelineStageFlags stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT; // Stages of the new work that wait
+	};
+
+	// Timeline semaphore counting the submissions made to one queue.
+	//
+	// Every submission signals the next value, so a resource only has to remember the value of the
+	// last submission that used it to know when it's free again. Replaces per frame fences and
+	// vkQueueWaitIdle, waiting on a value only blocks until that submission is done.
+	//
+	// Not thread safe, submissions and queries are made from the render thread.
+	class VulkanTimeline {
+	public:
+		void Init(VkDevice device);
+		void Free(VkDevice device);
+
+		// Reserves the value the next submission signals
+		u64 Advance();
+
+		u64 LastSubmitted() const;
+
+		// Last value the GPU reached, refreshed from the semaphore when asked about a later one
+		u64 Completed();
+		bool IsComplete(u64 value);
+
+		// Blocks the calling thread until the GPU reaches value
+		void Wait(u64 value);
+
+		VkSemaphore Semaphore() const;
+	private:
+		VkDevice mDevice = VK_NULL_HANDLE;
+		VkSemaphore mSemaphore = VK_NULL_HANDLE;
+		u64 mSubmitted = 0;
+		u64 mCompleted = 0;
+	};
+
+}
@@ -0,0 +1,257 @@
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include "pch.h"
+#include "core/Log.h"
+#include "core/System.h"
+#include "core/MappedFile.h"
+#include "core/JobSystem.h"
+#include "core/PackFile.h"
+#include "core/Vfs.h"
+#include "renderer/Mesh.h"
+#include "renderer/MeshFile.h"
+#include "renderer/TextureFile.h"
+
+// Converts source meshes into the binary .rwdmesh format, generating LODs at import time,
+// builds texture mip chains offline and packs asset directories into .rwdpak archives
+//
+// Usage:
+//   AssetConverter <input.obj> <output.rwdmesh>
+//   AssetConverter --bench <input.obj> <input.rwdmesh> [iterations]
+//   AssetConverter --pack <inputDirectory> <output.rwdpak> [lz4|zstd]
+//   AssetConverter --mips <input.ktx2|dds> <output.ktx2> [zstd]
+
+using namespace rwd;
+
+// Parses the positions and faces of an OBJ file, polygons are triangulated as fans.
+// This mirrors the text parsing path the engine used before the binary format.
+// Returns nothing with the error logged if a face has an index that isn't a vertex.
+static std::optional<Mesh> ParseObj(const std::vector<u8>& contents) {
+	std::vector<f32> verts;
+	std::vector<u32> indices;
+
+	std::istringstream stream(std::string(contents.begin(), contents.end()));
+	std::string line;
+	u32 lineNumber = 0;
+
+	while (std::getline(stream, line)) {
+		lineNumber++;
+
+		std::istringstream lineStream(line);
+		std::string type;
+		lineStream >> type;
+
+		if (type == "v") {
+			f32 x = 0.0f, y = 0.0f, z = 0.0f;
+			lineStream >> x >> y >> z;
+			verts.insert(verts.end(), { x, y, z });
+		}
+		else if (type == "f") {
+			std::vector<u32> face;
+			std::string corner;
+
+			while (lineStream >> corner) {
+				// Only the position index matters, anything after a '/' is ignored
+				i32 index = 0;
+				const char* end = corner.data() + std::min(corner.find('/'), corner.size());
+				auto [parsedEnd, error] = std::from_chars(corner.data(), end, index);
+
+				// Negative indices are relative to the end of the vertex list, 0 is never valid
+				long long vertexCount = (long long)(verts.size() / 3);
+				long long resolved = index < 0 ? vertexCount + index : (long long)index - 1;
+
+				if (error != std::errc() || parsedEnd != end || index == 0 || resolved < 0 || resolved >= vertexCount) {
+					RWD_LOG_ERROR("Face on line {0} has invalid vertex index '{1}', there are {2} vertices so far", lineNumber, corner, vertexCount);
+					return std::nullopt;
+				}
+
+				face.push_back((u32)resolved);
+			}
+
+			for (size_t i = 1; i + 1 < face.size(); i++) {
+				indices.insert(indices.end(), { face[0], face[i], face[i + 1] });
+			}
+		}
+	}
+
+	return Mesh(std::move(verts), std::move(indices));
+}
+
+static i32 Convert(const std::string& inputPath, const std::string& outputPath) {
+	std::vector<u8> contents;
+	System::ReadFile(inputPath, contents);
+
+	std::optional<Mesh> parsed = ParseObj(contents);
+	if (!parsed) {
+		RWD_LOG_ERROR("Failed to convert {0}", inputPath);
+		return 1;
+	}
+
+	Mesh& mesh = *parsed;
+	mesh.GenerateLods();
+
+	if (!MeshFile::Write(mesh, outputPath)) {
+		return 1;
+	}
+
+	std::cout << "Wrote " << outputPath << " (" << mesh.VertexCount() << " vertices, " 
+		<< mesh.LodCount() << " LODs)" << std::endl;
+
+	for (u32 i = 0; i < mesh.LodCount(); i++) {
+		std::cout << "  LOD " << i << ": " << mesh.mLods[i].indexCount / 3 << " triangles, error " 
+			<< mesh.mLods[i].error << std::endl;
+	}
+
+	return 0;
+}
+
+// Times loading a mesh through the old read + parse path against mapping the binary file.
+// Run it twice to compare warm page cache numbers, the first run includes cold disk reads.
+static i32 Benchmark(const std::string& objPath, const std::string& binaryPath, u32 iterations) {
+	using Clock = std::chrono::high_resolution_clock;
+
+	size_t checksum = 0;
+
+	auto textStart = Clock::now();
+	for (u32 i = 0; i < iterations; i++) {
+		std::vector<u8> contents;
+		System::ReadFile(objPath, contents);
+		std::optional<Mesh> mesh = ParseObj(contents);
+		if (!mesh) {
+			return 1;
+		}
+		checksum += mesh->mIndices.size();
+	}
+	auto textEnd = Clock::now();
+
+	auto binaryStart = Clock::now();
+	for (u32 i = 0; i < iterations; i++) {
+		MappedFile file(binaryPath);
+		MeshFileView view;
+		if (!MeshFile::Read(file, view)) {
+			return 1;
+		}
+
+		// Touch every page like the staging buffer upload would
+		u64 sum = 0;
+		for (size_t offset = 0; offset < file.Size(); offset += 4096) {
+			sum += (u64)file.Data()[offset];
+		}
+		checksum += view.metadata->indexCount + (size_t)(sum & 1);
+	}
+	auto binaryEnd = Clock::now();
+
+	f64 textMs = std::chrono::duration<f64, std::milli>(textEnd - textStart).count() / iterations;
+	f64 binaryMs = std::chrono::duration<f64, std::milli>(binaryEnd - binaryStart).count() / iterations;
+
+	std::cout << "ReadFile + parse : " << textMs << " ms" << std::endl;
+	std::cout << "mmap .rwdmesh    : " << binaryMs << " ms" << std::endl;
+	std::cout << "Speedup          : " << textMs / binaryMs << "x (checksum " << checksum << ")" << std::endl;
+
+	return 0;
+}
+
+// Packs every file under the directory, paths in the pack are relative to it
+static i32 Pack(const std::string& directory, const std::string& outputPath, PackCodec codec) {
+	PackWriter writer;
+	u32 fileCount = 0;
+
+	for (const auto& file : std::filesystem::recursive_directory_iterator(directory)) {
+		if (!file.is_regular_file()) {
+			continue;
+		}
+
+		std::vector<u8> contents;
+		System::ReadFile(file.path().string(), contents);
+
+		std::string path = Vfs::NormalizePath(std::filesystem::relative(file.path(), directory).generic_string());
+		writer.AddFile(path, std::move(contents), codec);
+		fileCount++;
+	}
+
+	if (!writer.Write(outputPath)) {
+		return 1;
+	}
+
+	std::cout << "Packed " << fileCount << " files into " << outputPath << " (" 
+		<< std::filesystem::file_size(outputPath) << " bytes)" << std::endl;
+	return 0;
+}
+
+// Writes the texture back out as KTX2 with a full mip chain. Uncompressed single level textures get
+// their mips box filtered here, so they don't have to be generated every time the texture loads.
+// Block compressed textures have to come in with their mips already built by the compressor.
+static i32 BuildMips(const std::string& inputPath, const std::string& outputPath, bool zstd) {
+	MappedFile file;
+	if (!file.Open(inputPath)) {
+		return 1;
+	}
+
+	TextureData texture;
+	if (!TextureFile::Read(file.Data(), file.Size(), texture)) {
+		return 1;
+	}
+
+	const TextureFormatInfo& info = GetTextureFormatInfo(texture.format);
+	std::vector<std::vector<u8>> mips;
+
+	if (texture.mipCount == 1 && !info.compressed && info.bytesPerBlock == 4) {
+		mips = TextureFile::GenerateMips(texture.mips[0].data, texture.width, texture.height, info.srgb);
+	} else {
+		if (texture.mipCount == 1 && texture.width * texture.height > 1) {
+			std::cout << "Can't generate mips for " << info.name << ", writing the single level as is" << std::endl;
+		}
+
+		for (u32 mip = 0; mip < texture.mipCount; mip++) {
+			mips.emplace_back(texture.mips[mip].data, texture.mips[mip].data + texture.mips[mip].size);
+		}
+	}
+
+	if (!TextureFile::WriteKtx2(outputPath, texture.format, texture.width, texture.height, mips, zstd)) {
+		return 1;
+	}
+
+	std::cout << "Wrote " << mips.size() << " " << info.name << " mips to " << outputPath << " ("
+		<< std::filesystem::file_size(outputPath) << " bytes)" << std::endl;
+	return 0;
+}
+
+static i32 Run(int argc, char** argv) {
+	if (argc >= 4 && strcmp(argv[1], "--bench") == 0) {
+		u32 iterations = argc >= 5 ? (u32)std::stoul(argv[4]) : 10;
+		return Benchmark(argv[2], argv[3], iterations);
+	}
+
+	if (argc >= 4 && strcmp(argv[1], "--pack") == 0) {
+		PackCodec codec = argc >= 5 && strcmp(argv[4], "zstd") == 0 ? PackCodec::Zstd : PackCodec::LZ4;
+		return Pack(argv[2], argv[3], codec);
+	}
+
+	if (argc >= 4 && strcmp(argv[1], "--mips") == 0) {
+		bool zstd = argc >= 5 && strcmp(argv[4], "zstd") == 0;
+		return BuildMips(argv[2], argv[3], zstd);
+	}
+
+	if (argc == 3) {
+		return Convert(argv[1], argv[2]);
+	}
+
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  AssetConverter <input.obj> <output.rwdmesh>" << std::endl;
+	std::cout << "  AssetConverter --bench <input.obj> <input.rwdmesh> [iterations]" << std::endl;
+	std::cout << "  AssetConverter --pack <inputDirectory> <output.rwdpak> [lz4|zstd]" << std::endl;
+	std::cout << "  AssetConverter --mips <input.ktx2|dds> <output.ktx2> [zstd]" << std::endl;
+	return 1;
+}
+
+int main(int argc, char** argv) {
+	Log::Init();
+	JobSystem::Init();
+
+	i32 result = Run(argc, argv);
+
+	JobSystem::Shutdown();
+	return result;
+}
@@ -0,0 +1,262 @@
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include "pch.h"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/ext/matrix_clip_space.hpp"
+#include "core/Log.h"
+#include "core/JobSystem.h"
+#include "core/SimdMath.h"
+
+// Times the batch functions in core/SimdMath.h against the plain glm code they replace,
+// on every SIMD path the CPU supports, single threaded and split over the job system.
+//
+// Usage:
+//   MathBenchmark [objectCount] [iterations]
+
+using namespace rwd;
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Objects handed to each job in the threaded runs
+const size_t OBJECTS_PER_JOB = 16384;
+
+struct Scene {
+	std::vector<Quat> rotations;
+	std::vector<Vec3> positions;
+	std::vector<Vec3> scales;
+	std::vector<Mat4> parents;
+
+	// The same objects' bounds as one array per component
+	std::vector<f32> x, y, z, radius;
+	std::vector<f32> extentX, extentY, extentZ;
+
+	Frustum frustum;
+};
+
+static Scene MakeScene(size_t count) {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<f32> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<f32> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<f32> size(0.5f, 4.0f);
+
+	Scene scene;
+	scene.rotations.resize(count);
+	scene.positions.resize(count);
+	scene.scales.resize(count);
+	scene.parents.resize(count);
+	scene.x.resize(count);
+	scene.y.resize(count);
+	scene.z.resize(count);
+	scene.radius.resize(count);
+	scene.extentX.resize(count);
+	scene.extentY.resize(count);
+	scene.extentZ.resize(count);
+
+	for (size_t i = 0; i < count; i++) {
+		Quat q = glm::normalize(Quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+		Vec3 p(position(rng), position(rng) * 0.1f, position(rng));
+		Vec3 s(size(rng), size(rng), size(rng));
+
+		scene.rotations[i] = q;
+		scene.positions[i] = p;
+		scene.scales[i] = s;
+		scene.parents[i] = glm::translate(Mat4(1.0f), Vec3(unit(rng), unit(rng), unit(rng)));
+
+		scene.x[i] = p.x;
+		scene.y[i] = p.y;
+		scene.z[i] = p.z;
+		scene.extentX[i] = s.x;
+		scene.extentY[i] = s.y;
+		scene.extentZ[i] = s.z;
+		scene.radius[i] = glm::length(s);
+	}
+
+	// A camera at the origin looking down -z sees roughly a quarter of the objects
+	Mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	Mat4 view = glm::lookAt(Vec3(0.0f, 10.0f, 0.0f), Vec3(0.0f, 10.0f, -1.0f), Vec3(0.0f, 1.0f, 0.0f));
+	scene.frustum = Frustum::FromViewProjection(projection * view);
+
+	return scene;
+}
+
+// Best of the iterations, the least disturbed by the rest of the system
+template<typename Fn>
+static f64 Time(u32 iterations, Fn&& fn) {
+	f64 best = std::numeric_limits<f64>::max();
+
+	for (u32 i = 0; i < iterations; i++) {
+		auto start = Clock::now();
+		fn();
+		auto end = Clock::now();
+
+		best = std::min(best, std::chrono::duration<f64, std::milli>(end - start).count());
+	}
+
+	return best;
+}
+
+// Runs fn(begin, end) over the objects in chunks on the job system
+template<typename Fn>
+static void Parallel(size_t count, Fn&& fn) {
+	JobCounter counter;
+	u32 jobCount = (u32)((count + OBJECTS_PER_JOB - 1) / OBJECTS_PER_JOB);
+
+	JobSystem::Dispatch(counter, jobCount, 1, [&fn, count] (JobArgs args) {
+		size_t begin = (size_t)args.jobIndex * OBJECTS_PER_JOB;
+		fn(begin, std::min(begin + OBJECTS_PER_JOB, count));
+	});
+
+	JobSystem::Wait(counter);
+}
+
+static void Report(const char* name, f64 ms, f64 baselineMs) {
+	std::cout << "  " << std::left << std::setw(28) << name << std::right << std::setw(9) << std::fixed
+		<< std::setprecision(3) << ms << " ms" << std::setw(8) << std::setprecision(1) << baselineMs / ms << "x" << std::endl;
+}
+
+static void BenchmarkGlm(const Scene& scene, size_t count, u32 iterations, f64 baselines[5]) {
+	std::vector<Mat4> matrices(count);
+	std::vector<Vec3> points(count);
+	std::vector<u32> visible(count);
+	size_t visibleCount = 0;
+
+	std::cout << "glm" << std::endl;
+
+	baselines[0] = Time(iterations, [&] {
+		for (size_t i = 0; i < count; i++) {
+			matrices[i] = glm::translate(Mat4(1.0f), scene.positions[i]) * glm::mat4_cast(scene.rotations[i])
+				* glm::scale(Mat4(1.0f), scene.scales[i]);
+		}
+	});
+	Report("Compose TRS", baselines[0], baselines[0]);
+
+	baselines[1] = Time(iterations, [&] {
+		for (size_t i = 0; i < count; i++) {
+			matrices[i] = scene.parents[i] * matrices[i];
+		}
+	});
+	Report("Multiply 4x4", baselines[1], baselines[1]);
+
+	baselines[2] = Time(iterations, [&] {
+		const Mat4& matrix = scene.parents[0];
+		for (size_t i = 0; i < count; i++) {
+			points[i] = Vec3(matrix * Vec4(scene.positions[i], 1.0f));
+		}
+	});
+	Report("Transform points", baselines[2], baselines[2]);
+
+	baselines[3] = Time(iterations, [&] {
+		visibleCount = 0;
+		for (size_t i = 0; i < count; i++) {
+			Vec3 center(scene.x[i], scene.y[i], scene.z[i]);
+
+			bool inside = true;
+			for (const Vec4& plane : scene.frustum.planes) {
+				inside = inside && glm::dot(Vec3(plane), center) + plane.w >= -scene.radius[i];
+			}
+
+			if (inside) {
+				visible[visibleCount++] = (u32)i;
+			}
+		}
+	});
+	Report("Cull spheres", baselines[3], baselines[3]);
+
+	baselines[4] = Time(iterations, [&] {
+		visibleCount = 0;
+		for (size_t i = 0; i < count; i++) {
+			Vec3 center(scene.x[i], scene.y[i], scene.z[i]);
+			Vec3 extent(scene.extentX[i], scene.extentY[i], scene.extentZ[i]);
+
+			bool inside = true;
+			for (const Vec4& plane : scene.frustum.planes) {
+				Vec3 normal(plane);
+				inside = inside && glm::dot(normal, center) + plane.w >= -glm::dot(glm::abs(normal), extent);
+			}
+
+			if (inside) {
+				visible[visibleCount++] = (u32)i;
+			}
+		}
+	});
+	Report("Cull AABBs", baselines[4], baselines[4]);
+
+	std::cout << "  " << visibleCount << " of " << count << " objects visible" << std::endl;
+}
+
+static void BenchmarkSimd(const Scene& scene, size_t count, u32 iterations, const f64 baselines[5], bool threaded) {
+	std::vector<Mat4> matrices(count);
+	std::vector<f32> outX(count), outY(count), outZ(count);
+	std::vector<u32> visible(count);
+
+	std::cout << SimdLevelName(ActiveSimdLevel()) << (threaded ? ", threaded" : "") << std::endl;
+
+	SphereBoundsSoA spheres { scene.x.data(), scene.y.data(), scene.z.data(), scene.radius.data() };
+	AabbBoundsSoA boxes { scene.x.data(), scene.y.data(), scene.z.data(), scene.extentX.data(), scene.extentY.data(), scene.extentZ.data() };
+
+	// Threaded culling writes each chunk's indices at the chunk's offset, compacting them is left to the caller
+	auto run = [&] (auto&& fn) {
+		return Time(iterations, [&] {
+			if (threaded) {
+				Parallel(count, fn);
+			} else {
+				fn(0, count);
+			}
+		});
+	};
+
+	Report("Compose TRS", run([&] (size_t begin, size_t end) {
+		ComposeTransforms(scene.rotations.data() + begin, scene.positions.data() + begin, scene.scales.data() + begin,
+			matrices.data() + begin, end - begin);
+	}), baselines[0]);
+
+	Report("Multiply 4x4", run([&] (size_t begin, size_t end) {
+		MulMat4(scene.parents.data() + begin, matrices.data() + begin, matrices.data() + begin, end - begin);
+	}), baselines[1]);
+
+	Report("Transform points (SoA)", run([&] (size_t begin, size_t end) {
+		TransformPointsSoA(scene.parents[0], scene.x.data() + begin, scene.y.data() + begin, scene.z.data() + begin,
+			outX.data() + begin, outY.data() + begin, outZ.data() + begin, end - begin);
+	}), baselines[2]);
+
+	Report("Cull spheres", run([&] (size_t begin, size_t end) {
+		SphereBoundsSoA chunk { spheres.x + begin, spheres.y + begin, spheres.z + begin, spheres.radius + begin };
+		CullSpheres(scene.frustum, chunk, end - begin, visible.data() + begin);
+	}), baselines[3]);
+
+	Report("Cull AABBs", run([&] (size_t begin, size_t end) {
+		AabbBoundsSoA chunk { boxes.centerX + begin, boxes.centerY + begin, boxes.centerZ + begin,
+			boxes.extentX + begin, boxes.extentY + begin, boxes.extentZ + begin };
+		CullAabbs(scene.frustum, chunk, end - begin, visible.data() + begin);
+	}), baselines[4]);
+}
+
+int main(int argc, char** argv) {
+	Log::Init();
+	JobSystem::Init();
+
+	size_t count = argc >= 2 ? (size_t)std::stoull(argv[1]) : 1000000;
+	u32 iterations = argc >= 3 ? (u32)std::stoul(argv[2]) : 20;
+
+	std::cout << count << " objects, best of " << iterations << " runs, " << JobSystem::ThreadCount() << " worker threads" << std::endl;
+
+	Scene scene = MakeScene(count);
+
+	f64 baselines[5];
+	BenchmarkGlm(scene, count, iterations, baselines);
+
+	SimdLevel best = ActiveSimdLevel();
+	for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse4, SimdLevel::Avx2, SimdLevel::Neon }) {
+		ForceSimdLevel(level);
+		if (ActiveSimdLevel() == level) {
+			BenchmarkSimd(scene, count, iterations, baselines, false);
+		}
+	}
+
+	ForceSimdLevel(best);
+	BenchmarkSimd(scene, count, iterations, baselines, true);
+
+	JobSystem::Shutdown();
+	return 0;
+}
@@ -27,6 +27,10 @@ project "Redwood"
 		"%{prj.name}/src/**.h",
 		"%{prj.name}/src/**.cpp",
 		"%{prj.name}/vendor/glad/glad/*.c",
+		"%{prj.name}/vendor/lz4/lib/lz4.c",
+		"%{prj.name}/vendor/zstd/lib/common/*.c",
+		"%{prj.name}/vendor/zstd/lib/compress/*.c",
+		"%{prj.name}/vendor/zstd/lib/decompress/*.c",
 	}
 
 	includedirs {
@@ -36,6 +40,8 @@ project "Redwood"
 		"%{prj.name}/vendor/glm",
 		"%{prj.name}/vendor/glad",
 		"%{prj.name}/vendor/VulkanMemoryAllocator/include",
+		"%{prj.name}/vendor/lz4/lib",
+		"%{prj.name}/vendor/zstd/lib",
 	}
 
 	libdirs {
@@ -51,6 +57,14 @@ project "Redwood"
 	filter "files:Redwood/vendor/glad/glad/*.c"
 		flags "NoPCH"
 
+	filter "files:Redwood/vendor/lz4/lib/*.c or Redwood/vendor/zstd/lib/**.c"
+		flags "NoPCH"
+
+		-- Zstd's hand written x64 decoder is a .S file that MSVC can't assemble
+		defines {
+			"ZSTD_DISABLE_ASM",
+		}
+
 	-- Platforms
 
 	filter "system:windows"
@@ -69,6 +83,20 @@ project "Redwood"
 			("{COPY} %{cfg.buildtarget.relpath} ../bin/"..outputDir.."/Sandbox"),
 		}
 
+	filter "system:linux"
+		cppdialect "C++20"
+		pic "On"
+
+		-- Batch file reads through io_uring (see core/AsyncIO.h), requires liburing
+		defines {
+			"RWD_BUILD_DLL",
+			"RWD_IO_URING",
+		}
+
+		links {
+			"uring",
+		}
+
 	-- Configurations
 
 	filter "configurations:Debug"
@@ -104,7 +132,8 @@ project "Sandbox"
 	}
 
 	includedirs {
-		"Redwood/src"
+		"Redwood/src",
+		"Redwood/vendor/glm",
 	}
 
 	links {
@@ -138,6 +167,110 @@ project "Sandbox"
 			"RWD_PRODUCTION"
 		}
 
+project "AssetConverter"
+
+	location "Tools/AssetConverter"
+	kind "ConsoleApp"
+	language "C++"
+
+	targetdir ("bin/"..outputDir.."/%{prj.name}")
+	objdir ("obj/"..outputDir.."/%{prj.name}")
+
+	files {
+		"Tools/%{prj.name}/src/**.h",
+		"Tools/%{prj.name}/src/**.cpp",
+	}
+
+	includedirs {
+		"Redwood/src",
+		"Redwood/vendor/spdlog/include",
+		"Redwood/vendor/glm",
+	}
+
+	links {
+		"Redwood"
+	}
+
+	postbuildcommands {
+		("{COPY} ../../%{wks.name}/vendor/"..sdlFolder.."/lib/x64/*.dll ../../bin/"..outputDir.."/%{prj.name}"),
+		("{COPY} ../../bin/"..outputDir.."/Redwood/Redwood.dll ../../bin/"..outputDir.."/%{prj.name}"),
+	}
+
+	filter "system:windows"
+		cppdialect "C++20"
+		staticruntime "On"
+		systemversion "latest"
+
+	filter "configurations:Debug"
+		symbols "On" 
+		defines {
+			"RWD_DEBUG"
+		}
+
+	filter "configurations:Release"
+		optimize "On" 
+		defines {
+			"RWD_RELEASE"
+		}
+
+	filter "configurations:Production"
+		optimize "On" 
+		defines {
+			"RWD_PRODUCTION"
+		}
+
+project "MathBenchmark"
+
+	location "Tools/MathBenchmark"
+	kind "ConsoleApp"
+	language "C++"
+
+	targetdir ("bin/"..outputDir.."/%{prj.name}")
+	objdir ("obj/"..outputDir.."/%{prj.name}")
+
+	files {
+		"Tools/%{prj.name}/src/**.h",
+		"Tools/%{prj.name}/src/**.cpp",
+	}
+
+	includedirs {
+		"Redwood/src",
+		"Redwood/vendor/spdlog/include",
+		"Redwood/vendor/glm",
+	}
+
+	links {
+		"Redwood"
+	}
+
+	postbuildcommands {
+		("{COPY} ../../%{wks.name}/vendor/"..sdlFolder.."/lib/x64/*.dll ../../bin/"..outputDir.."/%{prj.name}"),
+		("{COPY} ../../bin/"..outputDir.."/Redwood/Redwood.dll ../../bin/"..outputDir.."/%{prj.name}"),
+	}
+
+	filter "system:windows"
+		cppdialect "C++20"
+		staticruntime "On"
+		systemversion "latest"
+
+	filter "configurations:Debug"
+		symbols "On" 
+		defines {
+			"RWD_DEBUG"
+		}
+
+	filter "configurations:Release"
+		optimize "On" 
+		defines {
+			"RWD_RELEASE"
+		}
+
+	filter "configurations:Production"
+		optimize "On" 
+		defines {
+			"RWD_PRODUCTION"
+		}
+
 -- Download SDL2 release .zip and extract it
 
 print("Downloading SDL2...")